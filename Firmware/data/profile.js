@@ -0,0 +1,101 @@
+// Chart instance
+let profileChart = null;
+
+// Initialize chart: avg, p99 and max per section, log scale since they span
+// microseconds to seconds
+function initChart() {
+  const ctx = document.getElementById('profileChart').getContext('2d');
+  profileChart = new Chart(ctx, {
+    type: 'bar',
+    data: {
+      labels: [],
+      datasets: [
+        { label: 'Avg (µs)', data: [], backgroundColor: '#8b5cf6' },
+        { label: 'p99 (µs)', data: [], backgroundColor: '#f59e0b' },
+        { label: 'Max (µs)', data: [], backgroundColor: '#ef4444' }
+      ]
+    },
+    options: {
+      responsive: true,
+      maintainAspectRatio: false,
+      plugins: {
+        legend: {
+          labels: {
+            color: '#fff'
+          }
+        }
+      },
+      scales: {
+        x: {
+          ticks: {
+            color: '#c084fc'
+          },
+          grid: {
+            color: 'rgba(192, 132, 252, 0.1)'
+          }
+        },
+        y: {
+          type: 'logarithmic',
+          ticks: {
+            color: '#c084fc'
+          },
+          grid: {
+            color: 'rgba(192, 132, 252, 0.1)'
+          }
+        }
+      }
+    }
+  });
+}
+
+function updateProfile(data) {
+  document.getElementById('cpuMHz').textContent = data.cpuMHz + ' MHz';
+  document.getElementById('window').textContent = Math.round(data.sinceMs / 1000) + ' s';
+  document.getElementById('overhead').textContent =
+    data.overheadPercent.toFixed(4) + '% (' + data.overheadCycles + ' cycles/section)';
+  
+  const body = document.getElementById('profileTableBody');
+  body.innerHTML = '';
+  data.zones.forEach(zone => {
+    const row = document.createElement('tr');
+    [zone.name, zone.count, zone.minUs, zone.avgUs, zone.p99Us, zone.maxUs, zone.sharePercent.toFixed(2) + '%']
+      .forEach(value => {
+        const cell = document.createElement('td');
+        cell.textContent = value;
+        row.appendChild(cell);
+      });
+    body.appendChild(row);
+  });
+  
+  profileChart.data.labels = data.zones.map(zone => zone.name);
+  profileChart.data.datasets[0].data = data.zones.map(zone => zone.avgUs);
+  profileChart.data.datasets[1].data = data.zones.map(zone => zone.p99Us);
+  profileChart.data.datasets[2].data = data.zones.map(zone => zone.maxUs);
+  profileChart.update('none');
+}
+
+function fetchProfile() {
+  fetch('/api/profile')
+    .then(r => r.json())
+    .then(updateProfile)
+    .catch(error => {
+      console.error('Error fetching profile:', error);
+    });
+}
+
+function resetProfile() {
+  fetch('/api/profile/reset', { method: 'POST' })
+    .then(() => fetchProfile())
+    .catch(error => {
+      console.error('Error resetting profile:', error);
+    });
+}
+
+// Initialize on page load
+document.addEventListener('DOMContentLoaded', function() {
+  initChart();
+  fetchProfile();
+  
+  // Update every 2 seconds
+  setInterval(fetchProfile, 2000);
+});
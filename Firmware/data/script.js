@@ -102,12 +102,17 @@ function updateData() {
     });
 }
 
-function toggleLED() {
-  fetch('/led').then(() => updateData());
+// Optional beaconId targets a specific collar (default: primary beacon)
+function controlUrl(path, beaconId) {
+  return beaconId ? path + '?id=' + encodeURIComponent(beaconId) : path;
 }
 
-function toggleBuzzer() {
-  fetch('/buzzer').then(() => updateData());
+function toggleLED(beaconId) {
+  fetch(controlUrl('/led', beaconId)).then(() => updateData());
+}
+
+function toggleBuzzer(beaconId) {
+  fetch(controlUrl('/buzzer', beaconId)).then(() => updateData());
 }
 
 function resetWiFi() {
@@ -0,0 +1,105 @@
+// LoRa time-on-air and duty-cycle accounting
+//
+// loraTimeOnAirUs() follows the SX1261/2 datasheet formula (section 6.1.4) for
+// SF7-SF12. AirtimeLedger keeps the airtime transmitted in one sub-band over
+// a sliding window, in fixed buckets so it costs the same at any frame rate.
+//
+// AirtimeLedger is plain data with no constructor (zero-initialised globals
+// start empty) so it can also live in RTC memory.
+
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct LoRaModulation {
+  uint8_t spreadingFactor;  // 7-12
+  float bandwidthKHz;
+  uint8_t codingRate;       // Denominator of 4/x: 5-8
+  uint16_t preambleLength;  // Symbols
+  bool crc;
+  bool implicitHeader;
+};
+
+// Modulation of both roles (must match on both sides)
+const LoRaModulation LORA_MODULATION = {7, 125.0, 5, 8, true, false}; // SF7, BW125, CR 4/5, 8-symbol preamble, CRC
+
+inline uint32_t loraTimeOnAirUs(const LoRaModulation &m, size_t payloadLen) {
+  float symbolUs = (float)(1UL << m.spreadingFactor) * 1000.0f / m.bandwidthKHz;
+  bool lowDataRateOptimize = symbolUs > 16000.0f; // SF11/SF12 at 125 kHz
+
+  int32_t bits = 8 * (int32_t)payloadLen - 4 * m.spreadingFactor + 28 +
+                 (m.crc ? 16 : 0) - (m.implicitHeader ? 20 : 0);
+  int32_t bitsPerSymbolGroup = 4 * (m.spreadingFactor - (lowDataRateOptimize ? 2 : 0));
+  uint32_t payloadSymbols = 8;
+  if (bits > 0) {
+    payloadSymbols += ((bits + bitsPerSymbolGroup - 1) / bitsPerSymbolGroup) * m.codingRate;
+  }
+
+  float preambleSymbols = m.preambleLength + 4.25f;
+  return (uint32_t)((preambleSymbols + payloadSymbols) * symbolUs + 0.5f);
+}
+
+// ETSI EN 300 220 measures duty cycle over one hour
+const uint32_t DUTY_CYCLE_WINDOW_MS = 3600000UL;
+const uint8_t AIRTIME_BUCKETS = 60;
+const uint32_t AIRTIME_BUCKET_MS = DUTY_CYCLE_WINDOW_MS / AIRTIME_BUCKETS;
+
+// Airtime allowed per window for a duty cycle in permille (1000 = 100%)
+inline uint32_t dutyCycleBudgetUs(uint16_t permille, uint8_t budgetPercent) {
+  return (uint32_t)((uint64_t)DUTY_CYCLE_WINDOW_MS * permille * budgetPercent / 100);
+}
+
+struct AirtimeLedger {
+  uint32_t bucketUs[AIRTIME_BUCKETS];
+  uint32_t bucketStartMs;  // Start of the newest bucket
+  uint8_t newest;
+  bool started;
+  uint32_t totalUs;        // All airtime ever recorded
+
+  void record(uint32_t nowMs, uint32_t airUs) {
+    advance(nowMs);
+    bucketUs[newest] += airUs;
+    totalUs += airUs;
+  }
+
+  // Airtime in the last window. The oldest bucket counts in full, so this
+  // errs on the side of reporting slightly more than was really used.
+  // Read-only, so other tasks may call it while the owner records.
+  uint32_t usedUs(uint32_t nowMs) const {
+    if (!started) return 0;
+    uint32_t steps = (nowMs - bucketStartMs) / AIRTIME_BUCKET_MS;
+    if (steps >= AIRTIME_BUCKETS) return 0;
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < AIRTIME_BUCKETS - steps; i++) {
+      sum += bucketUs[(newest + AIRTIME_BUCKETS - i) % AIRTIME_BUCKETS];
+    }
+    return sum;
+  }
+
+  bool allows(uint32_t nowMs, uint32_t airUs, uint32_t budgetUs) const {
+    return usedUs(nowMs) + airUs <= budgetUs;
+  }
+
+private:
+  void advance(uint32_t nowMs) {
+    if (!started) {
+      for (uint8_t i = 0; i < AIRTIME_BUCKETS; i++) bucketUs[i] = 0;
+      bucketStartMs = nowMs;
+      newest = 0;
+      started = true;
+      return;
+    }
+    uint32_t steps = (nowMs - bucketStartMs) / AIRTIME_BUCKET_MS;
+    if (steps == 0) return;
+    if (steps > AIRTIME_BUCKETS) steps = AIRTIME_BUCKETS;
+    for (uint32_t i = 0; i < steps; i++) {
+      newest = (newest + 1) % AIRTIME_BUCKETS;
+      bucketUs[newest] = 0;
+    }
+    bucketStartMs += ((nowMs - bucketStartMs) / AIRTIME_BUCKET_MS) * AIRTIME_BUCKET_MS;
+  }
+};
+
+#endif // AIRTIME_H
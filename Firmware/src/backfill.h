@@ -0,0 +1,247 @@
+// Store-and-forward backlog of beacon fixes
+//
+// The beacon records every fix it transmits. The station periodically acks the
+// highest seq it has heard plus a bitmap of the 16 before it; acked fixes are
+// dropped, fixes older than the last ack that were not covered were lost on
+// air and are sent again in BackfillMessage frames.
+//
+// FixBacklog is plain data with no constructor so it can live in RTC memory
+// (RTC_DATA_ATTR) and survive deep sleep; call begin() once per boot.
+
+#ifndef BACKFILL_H
+#define BACKFILL_H
+
+#include <stdint.h>
+#include <string.h>
+#include "protocol.h"
+
+const uint16_t BACKLOG_CAPACITY = 320;  // ~10 min at the average 2 s beacon interval
+const uint32_t BACKLOG_MAGIC = 0x50574246; // "PWBF"
+const uint8_t ACK_WINDOW = 16;          // Seqs covered by ackBitmap
+
+// True if seq is acknowledged by an (ackSeq, ackBitmap) pair
+inline bool seqIsAcked(uint16_t seq, uint16_t ackSeq, uint16_t ackBitmap) {
+  int16_t d = (int16_t)(ackSeq - seq);
+  if (d == 0) return true;
+  if (d < 1 || d > ACK_WINDOW) return false;
+  return (ackBitmap >> (d - 1)) & 1;
+}
+
+struct FixBacklog {
+  uint32_t magic;
+  uint16_t head;          // Index of oldest slot
+  uint16_t used;          // Slots in use, including removed ones not yet reclaimed
+  uint16_t pending;       // Fixes still waiting for an ack
+  uint16_t nextSeq;       // seq for the next BeaconMessage
+  uint16_t lastAckSeq;    // ackSeq from the most recent ack
+  bool hasAck;            // At least one ack received since the backlog was reset
+  uint32_t dropped;       // Fixes overwritten before they could be delivered
+  uint8_t inFlight;       // Entries in the last BackfillMessage
+  uint16_t inFlightSeq[BACKFILL_FIXES_PER_FRAME];
+  BackfillFix fixes[BACKLOG_CAPACITY]; // timestamp 0 marks a removed entry
+
+  // Keep contents retained across sleep, reset after a cold boot
+  void begin() {
+    if (magic == BACKLOG_MAGIC && head < BACKLOG_CAPACITY && used <= BACKLOG_CAPACITY) {
+      return;
+    }
+    magic = BACKLOG_MAGIC;
+    head = 0;
+    used = 0;
+    pending = 0;
+    nextSeq = 0;
+    lastAckSeq = 0;
+    hasAck = false;
+    dropped = 0;
+    inFlight = 0;
+  }
+
+  uint16_t takeSeq() {
+    return nextSeq++;
+  }
+
+  // Record a transmitted fix until it is acknowledged (needs a GPS timestamp)
+  void add(const BackfillFix &fix) {
+    if (fix.timestamp == 0) return;
+    if (used == BACKLOG_CAPACITY) {
+      if (isLive(head)) {
+        remove(head);
+        dropped++;
+      }
+      head = (head + 1) % BACKLOG_CAPACITY;
+      used--;
+    }
+    uint16_t idx = (head + used) % BACKLOG_CAPACITY;
+    fixes[idx] = fix;
+    used++;
+    pending++;
+  }
+
+  // Apply an ack for live frames
+  void ack(uint16_t ackSeq, uint16_t ackBitmap) {
+    for (uint16_t i = 0; i < used; i++) {
+      uint16_t idx = (head + i) % BACKLOG_CAPACITY;
+      if (isLive(idx) && seqIsAcked(fixes[idx].seq, ackSeq, ackBitmap)) {
+        remove(idx);
+      }
+    }
+    lastAckSeq = ackSeq;
+    hasAck = true;
+    compact();
+  }
+
+  // Apply an ack for the last BackfillMessage built by fillFrame()
+  void ackBackfill() {
+    for (uint8_t f = 0; f < inFlight; f++) {
+      for (uint16_t i = 0; i < used; i++) {
+        uint16_t idx = (head + i) % BACKLOG_CAPACITY;
+        if (isLive(idx) && fixes[idx].seq == inFlightSeq[f]) {
+          remove(idx);
+          break;
+        }
+      }
+    }
+    inFlight = 0;
+    compact();
+  }
+
+  // Fixes older than the last ack that it did not cover - lost on air
+  bool isMissed(const BackfillFix &fix) const {
+    return hasAck && (int16_t)(lastAckSeq - fix.seq) > 0;
+  }
+
+  uint16_t missedCount() const {
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < used; i++) {
+      uint16_t idx = (head + i) % BACKLOG_CAPACITY;
+      if (isLive(idx) && isMissed(fixes[idx])) n++;
+    }
+    return n;
+  }
+
+  // Copy up to BACKFILL_FIXES_PER_FRAME missed fixes, oldest first
+  uint8_t fillFrame(BackfillMessage &msg) {
+    inFlight = 0;
+    for (uint16_t i = 0; i < used && inFlight < BACKFILL_FIXES_PER_FRAME; i++) {
+      uint16_t idx = (head + i) % BACKLOG_CAPACITY;
+      if (isLive(idx) && isMissed(fixes[idx])) {
+        msg.fixes[inFlight] = fixes[idx];
+        inFlightSeq[inFlight] = fixes[idx].seq;
+        inFlight++;
+      }
+    }
+    msg.count = inFlight;
+    return inFlight;
+  }
+
+private:
+  bool isLive(uint16_t idx) const {
+    return fixes[idx].timestamp != 0;
+  }
+
+  void remove(uint16_t idx) {
+    fixes[idx].timestamp = 0;
+    pending--;
+  }
+
+  // Reclaim removed slots at the head of the ring
+  void compact() {
+    while (used > 0 && !isLive(head)) {
+      head = (head + 1) % BACKLOG_CAPACITY;
+      used--;
+    }
+  }
+};
+
+// Station side: which seqs have been heard from one beacon
+struct SeqWindow {
+  uint16_t lastSeq = 0;
+  uint16_t bitmap = 0;   // Bit i set = seq (lastSeq - 1 - i) received
+  bool valid = false;
+
+  void record(uint16_t seq) {
+    int16_t d = (int16_t)(seq - lastSeq);
+    if (!valid || d < -ACK_WINDOW) {
+      // First frame, or the beacon restarted its sequence
+      lastSeq = seq;
+      bitmap = 0;
+      valid = true;
+    } else if (d > 0) {
+      bitmap = (d > ACK_WINDOW) ? 0 : (uint16_t)((bitmap << d) | (1u << (d - 1)));
+      lastSeq = seq;
+    } else if (d < 0) {
+      bitmap |= (uint16_t)(1u << (-d - 1));
+    }
+  }
+};
+
+// Station side: which seqs from one beacon are already in the history. A fix
+// that was stored live but whose ack never reached the beacon comes back as
+// backfill; this is what keeps it from being stored twice.
+const uint16_t STORED_SEQ_WINDOW = 512;  // More than BACKLOG_CAPACITY, so it spans every seq a beacon can backfill
+
+struct StoredSeqs {
+  uint16_t lastSeq = 0;  // Highest seq stored
+  bool valid = false;
+  uint8_t bits[STORED_SEQ_WINDOW / 8] = {}; // Bit (seq % STORED_SEQ_WINDOW) set = stored
+
+  // A live fix was stored. Live seqs only go up, so one at or below lastSeq
+  // means the beacon restarted its sequence.
+  void markLive(uint16_t seq) {
+    if (!valid || (int16_t)(seq - lastSeq) <= 0) reset(seq);
+    mark(seq);
+  }
+
+  // False if the backfilled fix is already stored, else marks it stored
+  bool markBackfill(uint16_t seq) {
+    if (!valid) reset(seq);
+    int16_t d = (int16_t)(lastSeq - seq);
+    if (d >= (int16_t)STORED_SEQ_WINDOW) return true; // Older than the window, cannot tell
+    if (d >= 0 && isSet(seq)) return false;
+    mark(seq);
+    return true;
+  }
+
+private:
+  bool isSet(uint16_t seq) const {
+    uint16_t bit = seq % STORED_SEQ_WINDOW;
+    return (bits[bit / 8] >> (bit % 8)) & 1;
+  }
+
+  void reset(uint16_t seq) {
+    memset(bits, 0, sizeof(bits));
+    lastSeq = seq;
+    valid = true;
+  }
+
+  // Set seq's bit, clearing the bits of seqs skipped on the way up to it
+  void mark(uint16_t seq) {
+    int16_t d = (int16_t)(seq - lastSeq);
+    if (d >= (int16_t)STORED_SEQ_WINDOW) {
+      memset(bits, 0, sizeof(bits));
+    } else {
+      for (int16_t i = 1; i <= d; i++) {
+        uint16_t bit = (uint16_t)(lastSeq + i) % STORED_SEQ_WINDOW;
+        bits[bit / 8] &= (uint8_t)~(1u << (bit % 8));
+      }
+    }
+    if (d > 0) lastSeq = seq;
+    uint16_t bit = seq % STORED_SEQ_WINDOW;
+    bits[bit / 8] |= (uint8_t)(1u << (bit % 8));
+  }
+};
+
+// Drop the fixes of a backfill frame that are already stored; returns how many were dropped
+inline uint8_t dropStoredFixes(BackfillMessage &bf, StoredSeqs &stored) {
+  uint8_t kept = 0;
+  uint8_t count = bf.count < BACKFILL_FIXES_PER_FRAME ? bf.count : BACKFILL_FIXES_PER_FRAME;
+  for (uint8_t i = 0; i < count; i++) {
+    if (stored.markBackfill(bf.fixes[i].seq)) {
+      bf.fixes[kept++] = bf.fixes[i];
+    }
+  }
+  bf.count = kept;
+  return count - kept;
+}
+
+#endif // BACKFILL_H
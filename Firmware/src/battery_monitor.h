@@ -0,0 +1,59 @@
+// Battery voltage filter and discharge-rate estimate
+//
+// batteryTask (main.cpp) feeds it one calibrated, oversampled reading per
+// sample interval. A first-order IIR smooths ADC noise and the sag under radio
+// bursts. The discharge rate is the slope of the filtered voltage over
+// RATE_WINDOW_MS, smoothed again across windows so one window cannot swing it.
+//
+// Plain data with no constructor so the beacon can keep it in RTC memory
+// (RTC_DATA_ATTR) across deep sleep; call begin() once per boot.
+
+#ifndef BATTERY_MONITOR_H
+#define BATTERY_MONITOR_H
+
+#include <stdint.h>
+#include <string.h>
+
+struct BatteryFilter {
+  static const uint32_t MAGIC = 0x50574246;      // "PWBF"
+  static constexpr float ALPHA = 0.2f;           // Weight of a new sample
+  static const uint32_t RATE_WINDOW_MS = 600000; // Slope measured over 10 minutes
+  static constexpr float RATE_ALPHA = 0.5f;      // Weight of a new window's slope
+
+  uint32_t magic;
+  float volts;          // Filtered
+  uint32_t samples;
+  float rateRefVolts;   // Filtered voltage at the start of the rate window
+  uint32_t rateRefMs;
+  float mvPerHour;      // Positive while discharging, negative while charging
+  bool rateValid;       // At least one full window seen
+
+  // Keeps the history only if resuming (times must be on the same clock)
+  void begin(bool resuming) {
+    if (resuming && magic == MAGIC) return;
+    memset(this, 0, sizeof(*this));
+    magic = MAGIC;
+  }
+
+  void add(float sampleVolts, uint32_t nowMs) {
+    if (samples == 0) {
+      volts = sampleVolts;
+      rateRefVolts = sampleVolts;
+      rateRefMs = nowMs;
+    } else {
+      volts += ALPHA * (sampleVolts - volts);
+    }
+    samples++;
+
+    uint32_t elapsedMs = nowMs - rateRefMs;
+    if (elapsedMs >= RATE_WINDOW_MS) {
+      float rate = (rateRefVolts - volts) * 1000.0f * 3600000.0f / elapsedMs;
+      mvPerHour = rateValid ? mvPerHour + RATE_ALPHA * (rate - mvPerHour) : rate;
+      rateValid = true;
+      rateRefVolts = volts;
+      rateRefMs = nowMs;
+    }
+  }
+};
+
+#endif // BATTERY_MONITOR_H
@@ -0,0 +1,89 @@
+// PupBeacon frame protocol, shared with the host build
+//
+// The beacon cycle in main.cpp decides with these what goes into each frame
+// and what a station reply acknowledges; radio timing and sleep stay there.
+
+#ifndef BEACON_CORE_H
+#define BEACON_CORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <string.h>
+#include "protocol.h"
+#include "backfill.h"
+
+const uint32_t BEACON_SEND_INTERVAL_MS = 1000;   // How often to send GPS fix (1 second for status updates)
+const uint32_t BEACON_SEND_JITTER_MS = 2000;     // Random extra delay per cycle, against repeated collisions
+const uint8_t ACK_REQUEST_EVERY = 8;             // Frames between ack requests while in range
+const uint8_t LISTEN_EVERY = 4;                  // Frames between RX windows while the station is idle
+const uint32_t BACKFILL_INTERVAL_MS = 4000;      // At most one backfill frame per interval
+const uint32_t BACKFILL_LINK_TIMEOUT_MS = 10000; // Only drain while the station answered recently
+
+// BEACON_FLAG_* for frame seq. Asks for an ack every few frames, and on every
+// frame until the station answers. Skips the RX window while the station has
+// said nothing is pending, but still checks in every LISTEN_EVERY frames so
+// new commands get through.
+inline uint8_t beaconFrameFlags(const FixBacklog& backlog, uint16_t seq, bool stationIdle) {
+  uint8_t flags = 0;
+  if (!backlog.hasAck || (uint16_t)(seq - backlog.lastAckSeq) >= ACK_REQUEST_EVERY) {
+    flags |= BEACON_FLAG_ACK_REQUEST;
+  }
+  if (!stationIdle || (flags & BEACON_FLAG_ACK_REQUEST) || (seq % LISTEN_EVERY == 0)) {
+    flags |= BEACON_FLAG_LISTENING;
+  }
+  return flags;
+}
+
+// Backlog entry for a fix sent in frame seq
+inline BackfillFix makeBacklogFix(uint32_t unixTime, double latitude, double longitude,
+                                  float altitude, float speedKmph, uint16_t seq) {
+  BackfillFix fix{};
+  fix.timestamp = unixTime;
+  fix.latE7 = (int32_t)lround(latitude * 1e7);
+  fix.lonE7 = (int32_t)lround(longitude * 1e7);
+  fix.altitude = (int16_t)altitude;
+  fix.speedX10 = (uint16_t)(speedKmph * 10.0f);
+  fix.seq = seq;
+  return fix;
+}
+
+// Backfill is sent while the station answered within BACKFILL_LINK_TIMEOUT_MS,
+// at most once per BACKFILL_INTERVAL_MS (so live updates keep most of the
+// airtime), and only if the station missed something
+inline bool backfillDue(const FixBacklog& backlog, uint32_t nowMs, uint32_t lastRxMs, uint32_t lastBackfillMs) {
+  if (lastRxMs == 0 || nowMs - lastRxMs > BACKFILL_LINK_TIMEOUT_MS) return false;
+  if (nowMs - lastBackfillMs < BACKFILL_INTERVAL_MS) return false;
+  return backlog.missedCount() > 0;
+}
+
+// Fill bf with the oldest missed fixes; returns the bytes to send
+inline size_t buildBackfillFrame(FixBacklog& backlog, const char* beaconId, BackfillMessage& bf) {
+  memset(&bf, 0, sizeof(bf));
+  bf.msgType = MSG_BACKFILL;
+  memcpy(bf.beaconId, beaconId, sizeof(bf.beaconId));
+  bf.beaconId[sizeof(bf.beaconId) - 1] = '\0';
+  uint8_t count = backlog.fillFrame(bf);
+  return offsetof(BackfillMessage, fixes) + count * sizeof(BackfillFix);
+}
+
+// Book the acks and idle flag of a station reply. Returns false if the frame
+// is not a control/ack frame for this beacon (empty beaconId = broadcast).
+inline bool applyStationReply(FixBacklog& backlog, ControlMessage& ctrl, const char* myBeaconId,
+                              bool& stationIdle) {
+  ctrl.beaconId[sizeof(ctrl.beaconId) - 1] = '\0';
+  bool forUs = ctrl.beaconId[0] == '\0' || strcmp(ctrl.beaconId, myBeaconId) == 0;
+  if (!forUs || (ctrl.msgType != MSG_CONTROL && ctrl.msgType != MSG_ACK)) {
+    return false;
+  }
+  stationIdle = (ctrl.flags & CONTROL_FLAG_IDLE) != 0;
+  if (ctrl.flags & CONTROL_FLAG_ACK) {
+    backlog.ack(ctrl.ackSeq, ctrl.ackBitmap);
+  }
+  if (ctrl.flags & CONTROL_FLAG_BACKFILL_ACK) {
+    backlog.ackBackfill();
+  }
+  return true;
+}
+
+#endif // BEACON_CORE_H
@@ -0,0 +1,98 @@
+// Fixed-capacity table of per-beacon state, keyed by the beacon's chip ID
+//
+// Entries live in a dense array in the order they were added and are never
+// removed, so a pointer or index to one stays valid. Lookup goes through an
+// open-addressing index twice the capacity (load factor <= 0.5, linear
+// probing), so find() costs one or two probes and never touches the heap.
+//
+// The whole table is plain data: it can be copied as is, e.g. into a
+// Snapshot<> for other tasks, and the copy is searchable the same way.
+
+#ifndef BEACON_REGISTRY_H
+#define BEACON_REGISTRY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Beacon IDs go on air as 8 hex digits of the chip ID
+inline bool parseBeaconId(const char* text, uint32_t &id) {
+  if (text == nullptr || text[0] == '\0') return false;
+  char* end;
+  unsigned long value = strtoul(text, &end, 16);
+  if (*end != '\0' || end - text > 8) return false;
+  id = (uint32_t)value;
+  return true;
+}
+
+inline void formatBeaconId(uint32_t id, char (&out)[9]) {
+  snprintf(out, sizeof(out), "%08X", (unsigned)id);
+}
+
+template <typename T, uint8_t CAPACITY>
+class BeaconRegistry {
+  static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0 && CAPACITY <= 128,
+                "BeaconRegistry capacity must be a power of two up to 128");
+
+public:
+  T* find(uint32_t id) {
+    int16_t entry = lookup(id);
+    return entry < 0 ? nullptr : &values[entry];
+  }
+
+  const T* find(uint32_t id) const {
+    int16_t entry = lookup(id);
+    return entry < 0 ? nullptr : &values[entry];
+  }
+
+  // Existing entry, or a new default-initialised one. nullptr if the table is full.
+  T* findOrAdd(uint32_t id, bool* added = nullptr) {
+    if (added) *added = false;
+    uint16_t slot = home(id);
+    while (index[slot] != 0) {
+      uint8_t entry = index[slot] - 1;
+      if (ids[entry] == id) return &values[entry];
+      slot = (slot + 1) & (INDEX_SLOTS - 1);
+    }
+    if (count == CAPACITY) return nullptr;
+
+    ids[count] = id;
+    values[count] = T();
+    index[slot] = count + 1;
+    if (added) *added = true;
+    return &values[count++];
+  }
+
+  uint8_t size() const { return count; }
+  static constexpr uint8_t capacity() { return CAPACITY; }
+
+  // Entries in insertion order, 0 <= i < size()
+  uint32_t idAt(uint8_t i) const { return ids[i]; }
+  T& at(uint8_t i) { return values[i]; }
+  const T& at(uint8_t i) const { return values[i]; }
+
+private:
+  static const uint16_t INDEX_SLOTS = CAPACITY * 2;
+
+  // Fibonacci hashing: chip IDs share their vendor bytes, so mix all bits
+  static uint16_t home(uint32_t id) {
+    return (uint16_t)((id * 2654435769u) >> 16) & (INDEX_SLOTS - 1);
+  }
+
+  int16_t lookup(uint32_t id) const {
+    uint16_t slot = home(id);
+    while (index[slot] != 0) {
+      uint8_t entry = index[slot] - 1;
+      if (ids[entry] == id) return entry;
+      slot = (slot + 1) & (INDEX_SLOTS - 1);
+    }
+    return -1;
+  }
+
+  uint8_t index[INDEX_SLOTS] = {};  // Entry number + 1, 0 = empty
+  uint32_t ids[CAPACITY] = {};
+  T values[CAPACITY];
+  uint8_t count = 0;
+};
+
+#endif // BEACON_REGISTRY_H
@@ -0,0 +1,63 @@
+// Host micro-benchmarks (pio run -e bench)
+//
+// Runs bench_suite.h on this machine and prints the results as JSON, one
+// case per line, for comparing commits:
+//
+//   .pio/build/bench/program [--filter NAME] [--dir PATH] > bench.json
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <string>
+#include "hal_native.h"
+#include "bench_suite.h"
+
+static const auto benchStart = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - benchStart).count();
+}
+
+static void usage(const char* prog) {
+  fprintf(stderr, "usage: %s [--filter NAME] [--dir PATH]\n", prog);
+}
+
+int main(int argc, char** argv) {
+  const char* filter = nullptr;
+  std::string dir;
+  for (int i = 1; i < argc; i++) {
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(argv[i], "--filter") == 0 && value) {
+      filter = value;
+    } else if (strcmp(argv[i], "--dir") == 0 && value) {
+      dir = value;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+  }
+
+  // GPS time goes through mktime(), which is UTC on the station
+  setenv("TZ", "UTC", 1);
+  tzset();
+
+  if (dir.empty()) {
+    char tmpl[] = "/tmp/pawbench-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+      perror("mkdtemp");
+      return 1;
+    }
+    dir = tmpl;
+  }
+  DirFileSystem fs(dir);
+
+  BenchRunner bench(1000);  // profileCycles() counts nanoseconds on a host
+  bench.filter = filter;
+  runBenchSuite(bench, fs);
+  fputs(bench.json("host").c_str(), stdout);
+  return 0;
+}
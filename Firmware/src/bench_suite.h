@@ -0,0 +1,365 @@
+// Micro-benchmarks of the station's per-frame and per-request paths
+//
+// Runs the firmware's own code on synthetic but realistic inputs: frame
+// decode and validation, beacon table updates, history lines (format and
+// append), the /api/data body for 1-64 beacons, the /api/stats history tail,
+// CSV and GPX export per 1000 records and NMEA parsing per 1000 sentences.
+// profile_zone measures the profiler itself: what one PROFILE_ZONE adds with
+// PAW_PROFILE=1.
+// Used by the host benchmark (env:bench) and by POST /api/bench on a station.
+//
+// Each case is timed on the cycle counter (profileCycles(), nanoseconds on a
+// host): the iteration count is doubled until one sample takes BENCH_SAMPLE_US,
+// then BENCH_SAMPLES samples are taken and the median and minimum time per
+// operation reported. Inputs are fixed, so results compare across commits on
+// the same machine.
+
+#ifndef BENCH_SUITE_H
+#define BENCH_SUITE_H
+
+#include <Arduino.h>
+#include <TinyGPSPlus.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "profiler.h"
+#include "hal.h"
+#include "gps_fix.h"
+#include "station_core.h"
+#include "history_store.h"
+#include "web_json.h"
+
+const uint32_t BENCH_SAMPLES = 7;           // Median of this many samples
+const uint32_t BENCH_SAMPLE_US = 20000;     // Minimum length of one sample
+const uint32_t BENCH_MAX_ITERATIONS = 1u << 24;
+const uint16_t BENCH_RECORDS = 1000;        // Per export and NMEA case
+const uint8_t BENCH_LINES = 100;            // Distinct history lines and NMEA sentences, cycled
+const uint8_t BENCH_STATS_ENTRIES = 100;    // /api/stats history tail
+const uint32_t BENCH_BASE_TIME = 1760000000;
+
+struct BenchResult {
+  const char* name;
+  uint32_t n;             // Beacons, records or sentences per operation
+  uint32_t iterations;    // Per sample
+  double nsPerOp;         // Median
+  double minNsPerOp;
+};
+
+static volatile uint32_t benchSink = 0;  // Keeps results from being optimized away
+
+class BenchRunner {
+public:
+  std::vector<BenchResult> results;
+  const char* filter = nullptr;  // Only cases whose name contains this
+
+  explicit BenchRunner(uint32_t cyclesPerUs) : cyclesPerUs(cyclesPerUs) {}
+
+  bool wanted(const char* name) const {
+    return !filter || strstr(name, filter) != nullptr;
+  }
+
+  template <typename Op>
+  void run(const char* name, uint32_t n, Op op) {
+    if (!wanted(name)) return;
+    uint32_t target = BENCH_SAMPLE_US * cyclesPerUs;
+    uint32_t iterations = 1;
+    while (iterations < BENCH_MAX_ITERATIONS && timeCycles(op, iterations) < target) {
+      iterations *= 2;
+    }
+
+    double samples[BENCH_SAMPLES];
+    for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+      samples[i] = timeCycles(op, iterations) * 1000.0 / cyclesPerUs / iterations;
+    }
+    std::sort(samples, samples + BENCH_SAMPLES);
+
+    BenchResult r;
+    r.name = name;
+    r.n = n;
+    r.iterations = iterations;
+    r.nsPerOp = samples[BENCH_SAMPLES / 2];
+    r.minNsPerOp = samples[0];
+    results.push_back(r);
+  }
+
+  // {"platform":...,"samples":7,"sampleUs":20000,"results":[...]}, one case per line
+  String json(const char* platform) const {
+    String json = "{\"platform\":\"" + String(platform) + "\",";
+    json += "\"samples\":" + String(BENCH_SAMPLES) + ",";
+    json += "\"sampleUs\":" + String(BENCH_SAMPLE_US) + ",";
+    json += "\"results\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+      const BenchResult& r = results[i];
+      if (i > 0) json += ",";
+      json += "\n{\"name\":\"" + String(r.name) + "\",";
+      json += "\"n\":" + String(r.n) + ",";
+      json += "\"iterations\":" + String(r.iterations) + ",";
+      json += "\"nsPerOp\":" + String(r.nsPerOp, 1) + ",";
+      json += "\"minNsPerOp\":" + String(r.minNsPerOp, 1) + "}";
+    }
+    json += "\n]}\n";
+    return json;
+  }
+
+private:
+  uint32_t cyclesPerUs;
+
+  template <typename Op>
+  uint32_t timeCycles(Op& op, uint32_t iterations) {
+    uint32_t start = profileCycles();
+    for (uint32_t i = 0; i < iterations; i++) {
+      op();
+    }
+    return profileCycles() - start;
+  }
+};
+
+// The file system with every path renamed to /bench_<name>, so the append
+// case never touches the real history file
+class BenchFileSystem : public HalFileSystem {
+public:
+  explicit BenchFileSystem(HalFileSystem& fs) : fs(fs) {}
+
+  std::unique_ptr<HalFile> open(const char* path, HalFileMode mode) override {
+    char mapped[64];
+    return fs.open(map(path, mapped, sizeof(mapped)), mode);
+  }
+  bool exists(const char* path) override {
+    char mapped[64];
+    return fs.exists(map(path, mapped, sizeof(mapped)));
+  }
+  bool remove(const char* path) override {
+    char mapped[64];
+    return fs.remove(map(path, mapped, sizeof(mapped)));
+  }
+  bool rename(const char* from, const char* to) override {
+    char mappedFrom[64];
+    char mappedTo[64];
+    return fs.rename(map(from, mappedFrom, sizeof(mappedFrom)), map(to, mappedTo, sizeof(mappedTo)));
+  }
+
+private:
+  HalFileSystem& fs;
+
+  static const char* map(const char* path, char* out, size_t size) {
+    snprintf(out, size, "/bench_%s", path[0] == '/' ? path + 1 : path);
+    return out;
+  }
+};
+
+// Beacon i of the synthetic fleet: walking around Barcelona, fix every second
+inline BeaconMessage benchBeaconMessage(uint32_t i, uint32_t t) {
+  BeaconMessage msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msgType = MSG_BEACON;
+  char id[9];
+  formatBeaconId(0xB0000000u + i, id);
+  memcpy(msg.beaconId, id, sizeof(msg.beaconId));
+  msg.latitude = 41.3874f + 0.0001f * (i % 16) + 0.00001f * (t % 100);
+  msg.longitude = 2.1686f + 0.0001f * (i / 16) - 0.00001f * (t % 100);
+  msg.hdop = 0.9f;
+  msg.sats = 9;
+  msg.batteryVoltage = 3.6f + 0.01f * (i % 50);
+  msg.speed = 4.5f;
+  msg.altitude = 12.0f;
+  msg.uptime = t;
+  msg.seq = (uint16_t)t;
+  msg.flags = BEACON_FLAG_ACK_REQUEST | BEACON_FLAG_LISTENING;
+  msg.awakeMs = 180;
+  msg.batteryLifeH = 72;
+  return msg;
+}
+
+// NMEA sentence with its checksum and CRLF
+inline void benchNmeaSentence(char* out, size_t size, const char* body) {
+  uint8_t sum = 0;
+  for (const char* p = body; *p; p++) sum ^= (uint8_t)*p;
+  snprintf(out, size, "$%s*%02X\r\n", body, sum);
+}
+
+// GPRMC and GPGGA pairs, one second apart
+inline void benchNmeaStream(std::vector<char>& stream) {
+  char body[96];
+  char sentence[112];
+  for (uint8_t i = 0; i < BENCH_LINES / 2; i++) {
+    unsigned minute = i / 60;
+    unsigned second = i % 60;
+    snprintf(body, sizeof(body), "GPRMC,12%02u%02u.00,A,4123.%04u,N,00210.%04u,E,2.4,87.5,181026,,,A",
+             minute, second, 2440 + i, 1160 + i);
+    benchNmeaSentence(sentence, sizeof(sentence), body);
+    stream.insert(stream.end(), sentence, sentence + strlen(sentence));
+    snprintf(body, sizeof(body), "GPGGA,12%02u%02u.00,4123.%04u,N,00210.%04u,E,1,09,0.9,12.%u,M,50.0,M,,",
+             minute, second, 2440 + i, 1160 + i, i % 10);
+    benchNmeaSentence(sentence, sizeof(sentence), body);
+    stream.insert(stream.end(), sentence, sentence + strlen(sentence));
+  }
+}
+
+// Runs every case that bench.filter selects. fs is where the append case
+// writes (as /bench_history.csv, removed afterwards).
+inline void runBenchSuite(BenchRunner& bench, HalFileSystem& fs) {
+  const uint32_t TABLE_SIZES[] = {1, 16, 64};
+  const uint32_t DATA_SIZES[] = {1, 8, 16, 32, 64};
+
+  std::unique_ptr<BeaconTable> table(new BeaconTable());
+  std::vector<BeaconMessage> messages;
+  for (uint32_t i = 0; i < MAX_BEACONS; i++) {
+    messages.push_back(benchBeaconMessage(i, 1000 + i));
+  }
+
+  // Frame decode and range check, as processFrame() does first
+  {
+    uint32_t i = 0;
+    bench.run("decode_validate", 1, [&]() {
+      const BeaconMessage& frame = messages[i++ % MAX_BEACONS];
+      BeaconMessage msg;
+      if (decodeBeaconMessage((const uint8_t*)&frame, sizeof(frame), msg) && beaconDataInRange(msg)) {
+        benchSink += msg.seq;
+      }
+    });
+  }
+
+  // Profiler cost per zone: an empty timed section. The zone is unlisted, so
+  // it stays out of /api/profile, and used directly so the case exists with
+  // PAW_PROFILE=0 too.
+  {
+    static ProfileZone benchZone("bench", false);
+    bench.run("profile_zone", 1, [&]() {
+      ProfileScope scope(benchZone);
+    });
+  }
+
+  // Lookup and update of one beacon in a table of n
+  for (uint32_t n : TABLE_SIZES) {
+    table.reset(new BeaconTable());
+    uint32_t i = 0;
+    uint32_t now = 0;
+    bench.run("table_update", n, [&]() {
+      const BeaconMessage& msg = messages[i++ % n];
+      bool added;
+      LatestBeaconData* beacon = findOrAddBeacon(*table, msg.beaconId, added);
+      if (beacon) {
+        applyBeaconMessage(*beacon, msg, -92.5f, 7.25f, now++);
+        benchSink += beacon->rxFrames;
+      }
+    });
+  }
+
+  std::vector<HistoryRecord> records;
+  for (uint32_t i = 0; i < BENCH_LINES; i++) {
+    records.push_back(beaconHistoryRecord(messages[i % MAX_BEACONS], -92.5f - (i % 20), 7.25f, BENCH_BASE_TIME + i));
+  }
+  std::vector<String> lines;
+  for (const HistoryRecord& r : records) {
+    char line[HISTORY_LINE_MAX];
+    size_t n = formatHistoryLine(line, sizeof(line), r);
+    while (n > 0 && (line[n - 1] == '\r' || line[n - 1] == '\n')) line[--n] = '\0';
+    lines.push_back(String(line));
+  }
+
+  {
+    uint32_t i = 0;
+    bench.run("history_format", 1, [&]() {
+      char line[HISTORY_LINE_MAX];
+      benchSink += formatHistoryLine(line, sizeof(line), records[i++ % BENCH_LINES]);
+    });
+  }
+
+  // Append to a history file, with rotation when it fills up
+  if (bench.wanted("history_append")) {
+    BenchFileSystem benchFs(fs);
+    benchFs.remove(HISTORY_FILE);
+    uint32_t i = 0;
+    bench.run("history_append", 1, [&]() {
+      HistoryRecord r = records[i % BENCH_LINES];
+      r.timestamp = BENCH_BASE_TIME + i++;
+      benchSink += appendHistoryRecord(benchFs, r);
+    });
+    benchFs.remove(HISTORY_FILE);
+    benchFs.remove(HISTORY_TMP_FILE);
+  }
+
+  // GET /api/data with n beacons heard
+  for (uint32_t n : DATA_SIZES) {
+    table.reset(new BeaconTable());
+    for (uint32_t i = 0; i < n; i++) {
+      bool added;
+      LatestBeaconData* beacon = findOrAddBeacon(*table, messages[i].beaconId, added);
+      if (beacon) applyBeaconMessage(*beacon, messages[i], -92.5f, 7.25f, 5000 + i);
+    }
+    StationLocation station;
+    station.latitude = 41.3870f;
+    station.longitude = 2.1690f;
+    station.sats = 11;
+    station.hasValidFix = true;
+    const LatestBeaconData& primary = table->at(0);
+    bench.run("data_json", n, [&]() {
+      String json = dataJson(primary, *table, station, 123456);
+      benchSink += json.length();
+    });
+  }
+
+  // The history part of GET /api/stats: the newest entries as JSON, from the
+  // points storageTask publishes
+  std::vector<StatsHistoryPoint> points(BENCH_LINES);
+  for (uint32_t i = 0; i < BENCH_LINES; i++) {
+    parseStatsHistoryPoint(lines[i].c_str(), points[i]);
+  }
+  bench.run("stats_history_json", BENCH_STATS_ENTRIES, [&]() {
+    String json = "[";
+    for (uint32_t i = 0; i < BENCH_STATS_ENTRIES; i++) {
+      if (i > 0) json += ",";
+      json += statsHistoryEntryJson(points[i % BENCH_LINES], 4.05f);
+    }
+    json += "]";
+    benchSink += json.length();
+  });
+
+  // History rows as CSV lines, i.e. the bytes of /api/history/export
+  bench.run("csv_export", BENCH_RECORDS, [&]() {
+    char line[HISTORY_LINE_MAX];
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+      bytes += formatHistoryLine(line, sizeof(line), records[i % BENCH_LINES]);
+    }
+    benchSink += bytes;
+  });
+
+  // /api/history/export/gpx track points; the document is restarted every
+  // BENCH_LINES points so the case fits in a station's heap
+  bench.run("gpx_export", BENCH_RECORDS, [&]() {
+    String gpx;
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+      gpx += gpxTrackPoint(lines[i % BENCH_LINES]);
+      if ((i + 1) % BENCH_LINES == 0) {
+        bytes += gpx.length();
+        gpx = String();
+      }
+    }
+    benchSink += bytes;
+  });
+
+  // TinyGPS++ and the GpsFix update, as gpsTask runs them
+  if (bench.wanted("nmea_parse")) {
+    std::vector<char> stream;
+    benchNmeaStream(stream);
+    std::unique_ptr<TinyGPSPlus> gps(new TinyGPSPlus());
+    GpsFix fix;
+    bench.run("nmea_parse", BENCH_RECORDS, [&]() {
+      for (uint32_t pass = 0; pass < BENCH_RECORDS / BENCH_LINES; pass++) {
+        for (char c : stream) {
+          if (gps->encode(c)) {
+            updateGpsFix(*gps, fix, millis());
+          }
+        }
+      }
+      benchSink += fix.fixCount;
+    });
+  }
+}
+
+#endif // BENCH_SUITE_H
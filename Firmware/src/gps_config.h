@@ -0,0 +1,124 @@
+// GNSS receiver configuration: NMEA command framing, a census of the
+// sentences the receiver actually sends, and the motion profiles that pick
+// the output rate.
+//
+// The receiver does not reliably answer configuration commands, so a command
+// counts as accepted only once the NMEA stream shows its effect: disabled
+// sentences stop arriving and RMC arrives at the requested period.
+
+#ifndef GPS_CONFIG_H
+#define GPS_CONFIG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Sentence types told apart by the census
+enum NmeaSentence : uint8_t {
+  NMEA_RMC = 0,
+  NMEA_GGA,
+  NMEA_OTHER,        // Any sentence we parse nothing from (GSV, GSA, TXT, ...)
+  NMEA_SENTENCE_TYPES
+};
+
+// "$<body>*<checksum>\r\n" into out. Returns the length, 0 if it does not fit.
+inline size_t formatNmeaCommand(char* out, size_t size, const char* body) {
+  uint8_t checksum = 0;
+  for (const char* p = body; *p; p++) {
+    checksum ^= (uint8_t)*p;
+  }
+  int n = snprintf(out, size, "$%s*%02X\r\n", body, checksum);
+  return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+}
+
+// Counts sentences by type from the raw character stream. Only looks at the
+// address field ("$GNRMC" -> RMC), so it costs a few compares per sentence.
+class NmeaCensus {
+public:
+  void feed(char c) {
+    if (c == '$') {
+      addressLen = 0;
+      inAddress = true;
+      return;
+    }
+    if (!inAddress) return;
+    if (c == ',' || addressLen == sizeof(address)) {
+      inAddress = false;
+      counts[classify()]++;
+      return;
+    }
+    address[addressLen++] = c;
+  }
+
+  void reset() {
+    memset(counts, 0, sizeof(counts));
+    inAddress = false;
+  }
+
+  uint16_t count(NmeaSentence type) const { return counts[type]; }
+
+private:
+  // Talker (2 chars) + type (3 chars); proprietary sentences start with 'P'
+  NmeaSentence classify() const {
+    if (addressLen != 5 || address[0] == 'P') return NMEA_OTHER;
+    const char* type = address + 2;
+    if (memcmp(type, "RMC", 3) == 0) return NMEA_RMC;
+    if (memcmp(type, "GGA", 3) == 0) return NMEA_GGA;
+    return NMEA_OTHER;
+  }
+
+  char address[8];
+  uint8_t addressLen = 0;
+  bool inAddress = false;
+  uint16_t counts[NMEA_SENTENCE_TYPES] = {};
+};
+
+// Output rate follows how the collar moves: every second while the dog moves,
+// every few seconds while it lies still.
+enum GpsMotionProfile : uint8_t {
+  GPS_PROFILE_MOVING = 0,
+  GPS_PROFILE_STATIONARY
+};
+
+struct GpsProfileConfig {
+  const char* name;
+  uint8_t outputPeriodS;  // Seconds between RMC/GGA sentences
+};
+
+const GpsProfileConfig GPS_PROFILES[] = {
+  {"moving", 1},
+  {"stationary", 5},
+};
+
+// Moving as soon as speed passes MOVING_KMPH; stationary only after staying
+// below it for STILL_MS, so a pause at a tree does not flip the profile.
+class MotionDetector {
+public:
+  static constexpr float MOVING_KMPH = 3.0f;
+  static constexpr uint32_t STILL_MS = 60000;
+
+  GpsMotionProfile update(float speedKmph, uint32_t nowMs) {
+    if (speedKmph >= MOVING_KMPH) {
+      lastMovingMs = nowMs;
+      profile = GPS_PROFILE_MOVING;
+    } else if (profile == GPS_PROFILE_MOVING && nowMs - lastMovingMs >= STILL_MS) {
+      profile = GPS_PROFILE_STATIONARY;
+    }
+    return profile;
+  }
+
+  GpsMotionProfile current() const { return profile; }
+  uint32_t lastMoving() const { return lastMovingMs; }
+
+  // Carry the state over a deep sleep (times in the same clock as update())
+  void restore(GpsMotionProfile savedProfile, uint32_t savedLastMovingMs) {
+    profile = savedProfile;
+    lastMovingMs = savedLastMovingMs;
+  }
+
+private:
+  GpsMotionProfile profile = GPS_PROFILE_MOVING;
+  uint32_t lastMovingMs = 0;
+};
+
+#endif // GPS_CONFIG_H
@@ -0,0 +1,84 @@
+// Latest GPS fix as the firmware sees it, from TinyGPS++
+//
+// gpsTask feeds the NMEA stream into a TinyGPSPlus parser and copies what it
+// updated into a GpsFix with updateGpsFix(); the host replay tool does the
+// same with recorded NMEA. Times are the caller's millis().
+
+#ifndef GPS_FIX_H
+#define GPS_FIX_H
+
+#include <stdint.h>
+#include <time.h>
+#include <TinyGPSPlus.h>
+
+struct GpsFix {
+  bool valid = false;          // Location fixed at least once
+  double latitude = 0;
+  double longitude = 0;
+  float hdop = 0;              // Quality: lower is better
+  uint8_t sats = 0;            // Satellites in use, also before the first fix
+  float speedKmph = 0;
+  float altitude = 0;          // Meters
+  uint32_t fixMillis = 0;      // millis() when the location was measured
+  uint32_t fixCount = 0;       // Location updates so far
+  uint32_t periodMs = 1000;    // Expected time between fixes (motion profile)
+  uint32_t burstMillis = 0;    // millis() when the last NMEA burst was read
+  uint32_t unixTime = 0;       // UTC at timeMillis, 0 until date and time are known
+  uint32_t timeMillis = 0;
+};
+
+// Copy whatever the parser has updated into `fix`. True if anything changed.
+// mktime() must run in UTC (the ESP32 default; the host tools set TZ).
+inline bool updateGpsFix(TinyGPSPlus &gps, GpsFix &fix, uint32_t now) {
+  bool changed = false;
+  
+  if (gps.location.isUpdated() && gps.location.isValid()) {
+    fix.valid = true;
+    fix.latitude = gps.location.lat();
+    fix.longitude = gps.location.lng();
+    fix.fixMillis = now - gps.location.age();
+    fix.fixCount++;
+    changed = true;
+  }
+  if (gps.hdop.isUpdated()) {
+    fix.hdop = gps.hdop.hdop();
+    changed = true;
+  }
+  if (gps.satellites.isUpdated()) {
+    fix.sats = gps.satellites.value();
+    changed = true;
+  }
+  if (gps.speed.isUpdated()) {
+    fix.speedKmph = gps.speed.kmph();
+    changed = true;
+  }
+  if (gps.altitude.isUpdated()) {
+    fix.altitude = gps.altitude.meters();
+    changed = true;
+  }
+  if (gps.time.isUpdated() && gps.time.isValid() && gps.date.isValid()) {
+    struct tm timeinfo;
+    timeinfo.tm_year = gps.date.year() - 1900;
+    timeinfo.tm_mon = gps.date.month() - 1;
+    timeinfo.tm_mday = gps.date.day();
+    timeinfo.tm_hour = gps.time.hour();
+    timeinfo.tm_min = gps.time.minute();
+    timeinfo.tm_sec = gps.time.second();
+    timeinfo.tm_isdst = 0;
+    fix.unixTime = mktime(&timeinfo);
+    fix.timeMillis = now - gps.time.age();
+    changed = true;
+  }
+  return changed;
+}
+
+// Unix timestamp at `now`, 0 if GPS time is not valid yet. Runs on from the
+// last RMC/GGA time with millis() between sentences.
+inline uint32_t gpsFixUnixTime(const GpsFix &fix, uint32_t now) {
+  if (fix.unixTime == 0) {
+    return 0;
+  }
+  return fix.unixTime + (now - fix.timeMillis) / 1000;
+}
+
+#endif // GPS_FIX_H
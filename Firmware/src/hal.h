@@ -0,0 +1,101 @@
+// Hardware abstraction for logic shared by the firmware and the host build
+//
+// The portable modules (station_core.h, beacon_core.h, history_store.h) reach
+// hardware only through these interfaces, so the same code runs on the
+// Wireless Tracker and in `pio run -e native`. main.cpp implements them over
+// the SX1262, GPSSerial, LittleFS, the TFT and the battery monitor (section
+// "Hardware abstraction"); hal_native.h has the Linux stand-ins.
+//
+// The interfaces cover what the shared logic needs, not the whole driver:
+// radio IRQs, sleep and WiFi stay in main.cpp.
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+
+class HalClock {
+public:
+  virtual ~HalClock() {}
+  virtual uint32_t millis() = 0;
+  virtual uint32_t micros() = 0;
+  virtual void delayMs(uint32_t ms) = 0;
+};
+
+// One LoRa modem with fixed modulation (set up by its owner)
+class HalRadio {
+public:
+  virtual ~HalRadio() {}
+
+  // Blocking send. 0 when the frame went out, otherwise a negative driver code.
+  virtual int transmit(const uint8_t* data, size_t len) = 0;
+
+  // Copy out the frame that just arrived (up to size bytes). Returns its
+  // length, 0 if none is waiting, or a negative driver code (CRC error...).
+  virtual int receive(uint8_t* data, size_t size, float& rssi, float& snr) = 0;
+
+  // Back to continuous receive after a transmit or receive
+  virtual void startReceive() = 0;
+};
+
+// NMEA byte stream from the GNSS receiver, and its command input
+class HalGnss {
+public:
+  virtual ~HalGnss() {}
+  virtual size_t read(uint8_t* data, size_t size) = 0;  // What is buffered, 0 if nothing
+  virtual size_t write(const uint8_t* data, size_t len) = 0;
+};
+
+enum HalFileMode : uint8_t {
+  HAL_FILE_READ,
+  HAL_FILE_WRITE,    // Truncates
+  HAL_FILE_APPEND
+};
+
+// Open file; closed when destroyed
+class HalFile {
+public:
+  virtual ~HalFile() {}
+  virtual size_t write(const char* data, size_t len) = 0;
+  virtual size_t read(char* data, size_t len) = 0;  // Bytes read, 0 at the end
+  // Next line without its line ending (truncated to size - 1), -1 at the end
+  virtual int readLine(char* line, size_t size) = 0;
+  virtual bool seek(size_t pos) = 0;
+  virtual size_t size() = 0;
+};
+
+class HalFileSystem {
+public:
+  virtual ~HalFileSystem() {}
+  virtual std::unique_ptr<HalFile> open(const char* path, HalFileMode mode) = 0;  // nullptr on failure
+  virtual bool exists(const char* path) = 0;
+  virtual bool remove(const char* path) = 0;
+  virtual bool rename(const char* from, const char* to) = 0;
+};
+
+class HalDisplay {
+public:
+  virtual ~HalDisplay() {}
+  virtual void clear() = 0;
+  virtual void drawText(int16_t x, int16_t y, const char* text, uint16_t color, uint8_t size) = 0;
+  virtual void setBacklight(bool on) = 0;
+};
+
+class HalBattery {
+public:
+  virtual ~HalBattery() {}
+  virtual float volts() = 0;  // Filtered, never blocks on the ADC
+};
+
+struct Hal {
+  HalClock& clock;
+  HalRadio& radio;
+  HalGnss& gnss;
+  HalFileSystem& fs;
+  HalDisplay& display;
+  HalBattery& battery;
+};
+
+#endif // HAL_H
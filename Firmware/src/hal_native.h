@@ -0,0 +1,221 @@
+// Linux stand-ins for hal.h (env:native)
+//
+// Deterministic where it matters: ManualClock only moves when told to, and
+// LoopbackRadio delivers exactly what was sent. DirFileSystem maps the
+// station's LittleFS paths into a host directory and counts the bytes written.
+
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include "hal.h"
+
+// Wall clock from process start
+class SystemClock : public HalClock {
+public:
+  uint32_t millis() override { return (uint32_t)(elapsedUs() / 1000); }
+  uint32_t micros() override { return (uint32_t)elapsedUs(); }
+  void delayMs(uint32_t ms) override { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+private:
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  uint64_t elapsedUs() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+};
+
+// Simulated time: advances only through advanceUs() and delayMs()
+class ManualClock : public HalClock {
+public:
+  uint64_t nowUs = 0;
+
+  uint32_t millis() override { return (uint32_t)(nowUs / 1000); }
+  uint32_t micros() override { return (uint32_t)nowUs; }
+  void delayMs(uint32_t ms) override { nowUs += (uint64_t)ms * 1000; }
+  void advanceUs(uint64_t us) { nowUs += us; }
+};
+
+// Ideal shared channel: transmit() hands the frame to every peer's inbox with
+// a fixed RSSI/SNR (receivers filter by beacon ID, as on air). Frames can also
+// be injected with deliver().
+class LoopbackRadio : public HalRadio {
+public:
+  struct Frame {
+    std::vector<uint8_t> data;
+    float rssi;
+    float snr;
+  };
+
+  std::vector<LoopbackRadio*> peers;
+  float linkRssi = -80.0f;
+  float linkSnr = 9.0f;
+  uint32_t framesSent = 0;
+
+  void deliver(const uint8_t* data, size_t len, float rssi, float snr) {
+    inbox.push_back(Frame{std::vector<uint8_t>(data, data + len), rssi, snr});
+  }
+
+  int transmit(const uint8_t* data, size_t len) override {
+    framesSent++;
+    for (LoopbackRadio* peer : peers) peer->deliver(data, len, linkRssi, linkSnr);
+    return 0;
+  }
+
+  int receive(uint8_t* data, size_t size, float& rssi, float& snr) override {
+    if (inbox.empty()) return 0;
+    Frame frame = inbox.front();
+    inbox.pop_front();
+    size_t len = frame.data.size() < size ? frame.data.size() : size;
+    memcpy(data, frame.data.data(), len);
+    rssi = frame.rssi;
+    snr = frame.snr;
+    return (int)len;
+  }
+
+  void startReceive() override {}
+
+  size_t pending() const { return inbox.size(); }
+
+private:
+  std::deque<Frame> inbox;
+};
+
+// NMEA bytes from memory or a capture file, handed out chunkBytes at a time;
+// commands written to the receiver are kept in `commands`
+class BufferGnss : public HalGnss {
+public:
+  std::string commands;
+  size_t chunkBytes = 256;
+
+  void feed(const char* text) { bytes.insert(bytes.end(), text, text + strlen(text)); }
+
+  bool load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) bytes.insert(bytes.end(), buf, buf + n);
+    fclose(f);
+    return true;
+  }
+
+  size_t read(uint8_t* data, size_t size) override {
+    size_t n = bytes.size() - pos;
+    if (n > size) n = size;
+    if (n > chunkBytes) n = chunkBytes;
+    memcpy(data, bytes.data() + pos, n);
+    pos += n;
+    return n;
+  }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    commands.append((const char*)data, len);
+    return len;
+  }
+
+private:
+  std::vector<uint8_t> bytes;
+  size_t pos = 0;
+};
+
+class NativeFile : public HalFile {
+public:
+  NativeFile(FILE* f, uint64_t& bytesWritten) : f(f), bytesWritten(bytesWritten) {}
+  ~NativeFile() override { fclose(f); }
+
+  size_t write(const char* data, size_t len) override {
+    size_t n = fwrite(data, 1, len, f);
+    bytesWritten += n;
+    return n;
+  }
+
+  size_t read(char* data, size_t len) override { return fread(data, 1, len, f); }
+
+  int readLine(char* line, size_t size) override {
+    int c = fgetc(f);
+    if (c == EOF) return -1;
+    size_t n = 0;
+    while (c != EOF && c != '\n') {
+      if (n + 1 < size) line[n++] = (char)c;
+      c = fgetc(f);
+    }
+    if (n > 0 && line[n - 1] == '\r') n--;
+    line[n] = '\0';
+    return (int)n;
+  }
+
+  bool seek(size_t pos) override { return fseek(f, (long)pos, SEEK_SET) == 0; }
+
+  size_t size() override {
+    long pos = ftell(f);
+    fseek(f, 0, SEEK_END);
+    long end = ftell(f);
+    fseek(f, pos, SEEK_SET);
+    return end < 0 ? 0 : (size_t)end;
+  }
+
+private:
+  FILE* f;
+  uint64_t& bytesWritten;
+};
+
+// "/history.csv" -> "<root>/history.csv"; root must exist
+class DirFileSystem : public HalFileSystem {
+public:
+  uint64_t bytesWritten = 0;  // Through any file, like flash wear
+
+  explicit DirFileSystem(const std::string& root) : root(root) {}
+
+  std::unique_ptr<HalFile> open(const char* path, HalFileMode mode) override {
+    const char* fmode = mode == HAL_FILE_READ ? "rb" : mode == HAL_FILE_WRITE ? "wb" : "ab";
+    FILE* f = fopen(hostPath(path).c_str(), fmode);
+    if (!f) return nullptr;
+    return std::unique_ptr<HalFile>(new NativeFile(f, bytesWritten));
+  }
+
+  bool exists(const char* path) override {
+    FILE* f = fopen(hostPath(path).c_str(), "rb");
+    if (!f) return false;
+    fclose(f);
+    return true;
+  }
+
+  bool remove(const char* path) override { return ::remove(hostPath(path).c_str()) == 0; }
+  bool rename(const char* from, const char* to) override {
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+  }
+
+  std::string hostPath(const char* path) const { return root + path; }
+
+private:
+  std::string root;
+};
+
+// Keeps the last text drawn instead of drawing it
+class NullDisplay : public HalDisplay {
+public:
+  std::string lastText;
+  bool backlight = true;
+
+  void clear() override { lastText.clear(); }
+  void drawText(int16_t, int16_t, const char* text, uint16_t, uint8_t) override { lastText = text; }
+  void setBacklight(bool on) override { backlight = on; }
+};
+
+class FixedBattery : public HalBattery {
+public:
+  float voltsValue;
+  explicit FixedBattery(float volts = 4.0f) : voltsValue(volts) {}
+  float volts() override { return voltsValue; }
+};
+
+#endif // HAL_NATIVE_H
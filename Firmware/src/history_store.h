@@ -0,0 +1,161 @@
+// history.csv on the station's file system, through HalFileSystem
+//
+// storageTask appends live fixes and merges backfilled ones in batches; the
+// host tools run the same code against a directory. Every function returns
+// the bytes it wrote (rotations and merges rewrite the file), which is what
+// wears the flash.
+
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "hal.h"
+#include "station_core.h"
+
+const char* const HISTORY_FILE = "/history.csv";
+const char* const HISTORY_TMP_FILE = "/history.tmp";
+const uint32_t MAX_HISTORY_FILE_SIZE = 50 * 1024; // 50KB max (about 1000-1500 entries)
+const char* const HISTORY_CSV_HEADER = "timestamp,beaconId,latitude,longitude,speed,altitude,battery,rssi,snr";
+const size_t HISTORY_LINE_MAX = 128;
+const size_t BACKFILL_MERGE_BATCH = 64;          // Merge once this many fixes are waiting
+const uint32_t BACKFILL_MERGE_IDLE_MS = 10000;   // ...or when no backfill arrived for this long
+
+// One history line with its CRLF (compact format with full precision for GPS
+// coordinates). Returns its length.
+inline size_t formatHistoryLine(char* out, size_t size, const HistoryRecord& r) {
+  char lat[16] = "0";  // Single 0 for zero coordinates to save space
+  char lon[16] = "0";
+  if (r.latitude != 0.0) snprintf(lat, sizeof(lat), "%.6f", r.latitude);  // ~11cm precision
+  if (r.longitude != 0.0) snprintf(lon, sizeof(lon), "%.6f", r.longitude);
+  int n = snprintf(out, size, "%lu,%s,%s,%s,%.1f,%.1f,%.2f,%.1f,%.1f\r\n",
+                   (unsigned long)r.timestamp, r.beaconId, lat, lon,
+                   r.speed, r.altitude, r.battery, r.rssi, r.snr);
+  if (n < 0) return 0;
+  return (size_t)n < size ? (size_t)n : size - 1;
+}
+
+inline size_t writeHistoryLine(HalFile& file, const HistoryRecord& r) {
+  char line[HISTORY_LINE_MAX];
+  size_t n = formatHistoryLine(line, sizeof(line), r);
+  return file.write(line, n);
+}
+
+inline size_t writeTextLine(HalFile& file, const char* text) {
+  return file.write(text, strlen(text)) + file.write("\r\n", 2);
+}
+
+// Drop the oldest quarter of the rows once the file reaches MAX_HISTORY_FILE_SIZE
+inline size_t rotateHistory(HalFileSystem& fs) {
+  size_t written = 0;
+  {
+    std::unique_ptr<HalFile> in = fs.open(HISTORY_FILE, HAL_FILE_READ);
+    if (!in) return 0;
+    size_t currentSize = in->size();
+    if (currentSize < MAX_HISTORY_FILE_SIZE) return 0;
+    std::unique_ptr<HalFile> out = fs.open(HISTORY_TMP_FILE, HAL_FILE_WRITE);
+    if (!out) return 0;
+
+    char line[HISTORY_LINE_MAX];
+    if (in->readLine(line, sizeof(line)) < 0) return 0;
+    written += writeTextLine(*out, line);
+
+    size_t bytesToSkip = currentSize / 4;
+    size_t bytesSkipped = 0;
+    int len;
+    while (bytesSkipped < bytesToSkip && (len = in->readLine(line, sizeof(line))) >= 0) {
+      bytesSkipped += len + 2;
+    }
+    while ((len = in->readLine(line, sizeof(line))) >= 0) {
+      if (len > 0) written += writeTextLine(*out, line);
+    }
+  }
+  fs.remove(HISTORY_FILE);
+  fs.rename(HISTORY_TMP_FILE, HISTORY_FILE);
+  return written;
+}
+
+// Append a live fix, creating or rotating the file first as needed
+inline size_t appendHistoryRecord(HalFileSystem& fs, const HistoryRecord& r) {
+  size_t written = rotateHistory(fs);
+
+  if (!fs.exists(HISTORY_FILE)) {
+    std::unique_ptr<HalFile> file = fs.open(HISTORY_FILE, HAL_FILE_WRITE);
+    if (file) written += writeTextLine(*file, HISTORY_CSV_HEADER);
+  }
+
+  std::unique_ptr<HalFile> file = fs.open(HISTORY_FILE, HAL_FILE_APPEND);
+  if (!file) return written;
+  return written + writeHistoryLine(*file, r);
+}
+
+// True if a history line is the row of beaconId at timestamp
+inline bool historyLineMatches(const char* line, uint32_t timestamp, const char* beaconId) {
+  char* end;
+  if (strtoul(line, &end, 10) != timestamp || *end != ',') return false;
+  size_t n = strlen(beaconId);
+  return strncmp(end + 1, beaconId, n) == 0 && end[1 + n] == ',';
+}
+
+// Rewrite the file with pending inserted in timestamp order, skipping
+// duplicates from retransmitted backfill frames and rows the file already
+// has, then rotate as an append would. Clears pending; merged gets the rows
+// added.
+inline size_t mergeHistoryRecords(HalFileSystem& fs, std::vector<HistoryRecord>& pending, size_t& merged) {
+  merged = 0;
+  if (pending.empty()) return 0;
+
+  std::sort(pending.begin(), pending.end(),
+            [](const HistoryRecord& a, const HistoryRecord& b) { return a.timestamp < b.timestamp; });
+  std::vector<bool> stored(pending.size(), false);  // Already in the file
+
+  size_t written = 0;
+  {
+    std::unique_ptr<HalFile> out = fs.open(HISTORY_TMP_FILE, HAL_FILE_WRITE);
+    if (!out) return 0;
+
+    size_t next = 0;
+    auto writeUntil = [&](uint32_t timestamp) {
+      while (next < pending.size() && pending[next].timestamp < timestamp) {
+        const HistoryRecord& r = pending[next++];
+        if (stored[next - 1]) continue;
+        if (next > 1 && pending[next - 2].timestamp == r.timestamp &&
+            strcmp(pending[next - 2].beaconId, r.beaconId) == 0) {
+          continue;
+        }
+        written += writeHistoryLine(*out, r);
+        merged++;
+      }
+    };
+
+    std::unique_ptr<HalFile> in = fs.open(HISTORY_FILE, HAL_FILE_READ);
+    char line[HISTORY_LINE_MAX];
+    if (in && in->readLine(line, sizeof(line)) >= 0) {
+      written += writeTextLine(*out, line);
+      int len;
+      while ((len = in->readLine(line, sizeof(line))) >= 0) {
+        if (len == 0) continue;
+        uint32_t timestamp = (uint32_t)strtoul(line, nullptr, 10);
+        writeUntil(timestamp);
+        for (size_t i = next; i < pending.size() && pending[i].timestamp == timestamp; i++) {
+          if (historyLineMatches(line, timestamp, pending[i].beaconId)) stored[i] = true;
+        }
+        written += writeTextLine(*out, line);
+      }
+    } else {
+      written += writeTextLine(*out, HISTORY_CSV_HEADER);
+    }
+    writeUntil(UINT32_MAX);
+  }
+
+  fs.remove(HISTORY_FILE);
+  fs.rename(HISTORY_TMP_FILE, HISTORY_FILE);
+  pending.clear();
+  return written + rotateHistory(fs);
+}
+
+#endif // HISTORY_STORE_H
@@ -0,0 +1,32 @@
+// Just enough of Arduino.h for TinyGPS++ and web_json.h on a host
+// (env:replay, env:bench, test/test_uplink)
+//
+// millis() is defined by the host program, so the replay can run TinyGPS++
+// on the captured clock rather than the wall clock.
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "WString.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+
+#define radians(deg) ((deg) * (PI / 180.0))
+#define degrees(rad) ((rad) * (180.0 / PI))
+#define sq(x) ((x) * (x))
+
+unsigned long millis();
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,2 @@
+// Pre-1.0 name of Arduino.h; TinyGPS++ asks for it when ARDUINO is not defined
+#include "Arduino.h"
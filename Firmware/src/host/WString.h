@@ -0,0 +1,79 @@
+// Arduino String over std::string, for host builds of code that builds text
+// with it (web_json.h). Numbers format as the ESP32 core does: integers in
+// base 10, floats with a fixed number of decimals (2 by default).
+
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+class String {
+public:
+  String(const char* s = "") : s(s ? s : "") {}
+  String(const std::string& s) : s(s) {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(int v) : s(std::to_string(v)) {}
+  explicit String(unsigned int v) : s(std::to_string(v)) {}
+  explicit String(long v) : s(std::to_string(v)) {}
+  explicit String(unsigned long v) : s(std::to_string(v)) {}
+  explicit String(unsigned char v) : s(std::to_string(v)) {}
+  explicit String(float v, unsigned int decimals = 2) : s(fixed(v, decimals)) {}
+  explicit String(double v, unsigned int decimals = 2) : s(fixed(v, decimals)) {}
+
+  unsigned int length() const { return (unsigned int)s.size(); }
+  bool isEmpty() const { return s.empty(); }
+  const char* c_str() const { return s.c_str(); }
+  bool reserve(unsigned int size) { s.reserve(size); return true; }
+
+  String& operator+=(const String& rhs) { s += rhs.s; return *this; }
+  String& operator+=(const char* rhs) { s += rhs; return *this; }
+  String& operator+=(char c) { s += c; return *this; }
+
+  bool operator==(const String& rhs) const { return s == rhs.s; }
+  bool operator!=(const String& rhs) const { return s != rhs.s; }
+  char operator[](unsigned int i) const { return i < s.size() ? s[i] : '\0'; }
+
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t i = s.find(c, from);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) { unsigned int t = from; from = to; to = t; }
+    if (from >= s.size()) return String();
+    return String(s.substr(from, to - from));
+  }
+  long toInt() const { return atol(s.c_str()); }
+  float toFloat() const { return (float)atof(s.c_str()); }
+
+private:
+  std::string s;
+
+  static std::string fixed(double v, unsigned int decimals) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    return buf;
+  }
+};
+
+inline String operator+(const String& lhs, const String& rhs) {
+  String out = lhs;
+  out += rhs;
+  return out;
+}
+
+inline String operator+(const String& lhs, const char* rhs) {
+  String out = lhs;
+  out += rhs;
+  return out;
+}
+
+inline String operator+(const char* lhs, const String& rhs) {
+  String out(lhs);
+  out += rhs;
+  return out;
+}
+
+#endif // HOST_WSTRING_H
@@ -0,0 +1,269 @@
+// Leveled, structured logging into a RAM ring
+//
+// LOG_INFO(LOG_RADIO, "Frame from %s, RSSI %.1f", id, rssi) does not format
+// anything: it stores the format pointer, up to MAX_ARGS numbers and a copy of
+// the strings in a fixed-size LogRecord, which takes well under a
+// microsecond. Formatting happens later, when the record is drained to Serial
+// or served by /api/logs. Levels above PAW_LOG_LEVEL compile to nothing and
+// their arguments are never evaluated.
+//
+// Rules for call sites: the format must be a string literal (only its pointer
+// is kept), numbers beyond MAX_ARGS print as "?", and strings share TEXT_SIZE
+// bytes (IDs and short names, not free text).
+//
+// logCommit() is the sink, defined by the firmware (a LogRing behind a
+// critical section, since every task may log).
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef PAW_LOG_LEVEL
+#define PAW_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+enum LogModule : uint8_t {
+  LOG_SYSTEM,
+  LOG_RADIO,
+  LOG_BEACON,
+  LOG_GPS,
+  LOG_STORAGE,
+  LOG_UPLINK,
+  LOG_WEB,
+  LOG_POWER,
+  LOG_MODULE_COUNT
+};
+
+const char* const LOG_MODULE_NAMES[LOG_MODULE_COUNT] = {
+  "system", "radio", "beacon", "gps", "storage", "uplink", "web", "power"
+};
+
+inline const char* logModuleName(uint8_t module) {
+  return module < LOG_MODULE_COUNT ? LOG_MODULE_NAMES[module] : "?";
+}
+
+inline char logLevelChar(uint8_t level) {
+  static const char LEVEL_CHARS[] = "-EWID";
+  return level <= LOG_LEVEL_DEBUG ? LEVEL_CHARS[level] : '?';
+}
+
+struct LogRecord {
+  static const uint8_t MAX_ARGS = 6;
+  static const uint8_t TEXT_SIZE = 20;
+
+  uint32_t seq;             // Assigned by LogRing::append, starts at 1
+  uint32_t timeMs;          // millis()
+  const char* format;
+  uint32_t args[MAX_ARGS];  // Integers, or floats by bit pattern (floatMask)
+  char text[TEXT_SIZE];     // The %s arguments, each NUL-terminated, in order
+  uint8_t level;
+  uint8_t module;
+  uint8_t argCount;
+  uint8_t floatMask;        // Bit i set: args[i] holds a float
+};
+
+// Last N records; older ones are overwritten. Not thread-safe: the caller
+// serialises append() and get().
+template <uint32_t N>
+class LogRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "LogRing capacity must be a power of two");
+
+public:
+  uint32_t append(LogRecord& r) {
+    r.seq = ++lastSeq;
+    items[r.seq & (N - 1)] = r;
+    return r.seq;
+  }
+
+  // False if seq has not been written yet or was overwritten
+  bool get(uint32_t seq, LogRecord& r) const {
+    if (seq == 0 || seq > lastSeq || lastSeq - seq >= N) return false;
+    r = items[seq & (N - 1)];
+    return true;
+  }
+
+  uint32_t last() const { return lastSeq; }
+  uint32_t oldest() const { return lastSeq >= N ? lastSeq - N + 1 : 1; }
+
+  static constexpr uint32_t capacity() { return N; }
+
+private:
+  LogRecord items[N];
+  uint32_t lastSeq = 0;
+};
+
+// -----------------------------------------------------------------------------
+// Recording
+
+void logCommit(LogRecord& r);
+uint32_t logMillis();
+
+struct LogPacker {
+  LogRecord& r;
+  uint8_t textUsed;
+
+  void add(const char* s) {
+    if (textUsed >= LogRecord::TEXT_SIZE) return;
+    size_t room = LogRecord::TEXT_SIZE - textUsed - 1;
+    size_t len = s ? strnlen(s, room) : 0;
+    if (len) memcpy(r.text + textUsed, s, len);
+    r.text[textUsed + len] = '\0';
+    textUsed += len + 1;
+  }
+
+  void add(double v) {
+    if (r.argCount >= LogRecord::MAX_ARGS) return;
+    float f = (float)v;
+    memcpy(&r.args[r.argCount], &f, sizeof(f));
+    r.floatMask |= 1 << r.argCount;
+    r.argCount++;
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type add(T v) {
+    if (r.argCount >= LogRecord::MAX_ARGS) return;
+    r.args[r.argCount++] = (uint32_t)v;
+  }
+
+  void addAll() {}
+
+  template <typename T, typename... Rest>
+  void addAll(T first, Rest... rest) {
+    add(first);
+    addAll(rest...);
+  }
+};
+
+template <typename... Args>
+void logWrite(uint8_t level, uint8_t module, const char* format, Args... args) {
+  LogRecord r;
+  r.timeMs = logMillis();
+  r.format = format;
+  r.level = level;
+  r.module = module;
+  r.argCount = 0;
+  r.floatMask = 0;
+  memset(r.text, 0, sizeof(r.text));
+  LogPacker packer{r, 0};
+  packer.addAll(args...);
+  logCommit(r);
+}
+
+// Still type-checked, so variables used only for logging stay "used", but
+// the dead branch leaves no code and evaluates nothing
+#define LOG_DISABLED(module, ...) do { if (false) logWrite(0, module, __VA_ARGS__); } while (0)
+
+#if PAW_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(module, ...) logWrite(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#else
+#define LOG_ERROR(module, ...) LOG_DISABLED(module, __VA_ARGS__)
+#endif
+
+#if PAW_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(module, ...) logWrite(LOG_LEVEL_WARN, module, __VA_ARGS__)
+#else
+#define LOG_WARN(module, ...) LOG_DISABLED(module, __VA_ARGS__)
+#endif
+
+#if PAW_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(module, ...) logWrite(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#else
+#define LOG_INFO(module, ...) LOG_DISABLED(module, __VA_ARGS__)
+#endif
+
+#if PAW_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(module, ...) logWrite(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#else
+#define LOG_DEBUG(module, ...) LOG_DISABLED(module, __VA_ARGS__)
+#endif
+
+// -----------------------------------------------------------------------------
+// Formatting
+
+// Expand the record's message into out (always NUL-terminated). Each
+// conversion takes the next string or the next number, converted to what the
+// conversion expects; length modifiers in the format are ignored.
+inline size_t formatLogRecord(const LogRecord& r, char* out, size_t size) {
+  if (size == 0) return 0;
+  size_t used = 0;
+  uint8_t argIndex = 0;
+  const char* text = r.text;
+  const char* textEnd = r.text + LogRecord::TEXT_SIZE;
+  const char* p = r.format ? r.format : "";
+
+  while (*p && used + 1 < size) {
+    if (*p != '%') {
+      out[used++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[used++] = '%';
+      p += 2;
+      continue;
+    }
+
+    // Copy flags, width and precision; drop length modifiers
+    char spec[16];
+    size_t specLen = 0;
+    spec[specLen++] = *p++;
+    while (*p && strchr("-+ #0123456789.", *p) && specLen < sizeof(spec) - 4) {
+      spec[specLen++] = *p++;
+    }
+    while (*p && strchr("hlLzjt", *p)) p++;
+    char conv = *p;
+    if (!conv) break;
+    p++;
+
+    size_t room = size - used;
+    int n = 0;
+    if (conv == 's') {
+      const char* s = "?";
+      if (text < textEnd) {
+        s = text;
+        text += strlen(text) + 1;
+      }
+      spec[specLen++] = 's';
+      spec[specLen] = '\0';
+      n = snprintf(out + used, room, spec, s);
+    } else if (argIndex >= r.argCount) {
+      n = snprintf(out + used, room, "?");
+    } else {
+      bool isFloat = (r.floatMask >> argIndex) & 1;
+      uint32_t raw = r.args[argIndex++];
+      float f;
+      memcpy(&f, &raw, sizeof(f));
+      if (strchr("fFeEgG", conv)) {
+        spec[specLen++] = conv;
+        spec[specLen] = '\0';
+        n = snprintf(out + used, room, spec, isFloat ? (double)f : (double)(int32_t)raw);
+      } else if (conv == 'd' || conv == 'i' || conv == 'c') {
+        if (conv != 'c') spec[specLen++] = 'l';
+        spec[specLen++] = conv;
+        spec[specLen] = '\0';
+        long v = isFloat ? (long)f : (long)(int32_t)raw;
+        n = conv == 'c' ? snprintf(out + used, room, spec, (int)v) : snprintf(out + used, room, spec, v);
+      } else {
+        spec[specLen++] = 'l';
+        spec[specLen++] = strchr("uxXo", conv) ? conv : 'u';
+        spec[specLen] = '\0';
+        n = snprintf(out + used, room, spec, isFloat ? (unsigned long)f : (unsigned long)raw);
+      }
+    }
+    if (n < 0) break;
+    used += (size_t)n < room ? (size_t)n : room - 1;
+  }
+  out[used] = '\0';
+  return used;
+}
+
+#endif // LOG_RING_H
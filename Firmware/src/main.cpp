@@ -1,18 +1,69 @@
+// Role images: env:beacon builds with -D PAW_STATION=0 and leaves out the
+// station and its network stack, env:station with -D PAW_BEACON=0. The
+// default image has both and picks the role at boot.
+#ifndef PAW_BEACON
+#define PAW_BEACON 1
+#endif
+#ifndef PAW_STATION
+#define PAW_STATION 1
+#endif
+#if !PAW_BEACON && !PAW_STATION
+#error "PAW_BEACON=0 and PAW_STATION=0 leave no role to run"
+#endif
+#if !PAW_STATION
+#undef PAW_PROFILE
+#define PAW_PROFILE 0  // Only the station reports it (/api/profile)
+#endif
+
 #include <Arduino.h>
 #include <TinyGPSPlus.h>
 #include <SPI.h>
 #include <RadioLib.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_ST7735.h>
+#include <Preferences.h>
+#if PAW_STATION
 #include <WiFi.h>
 #include <WiFiManager.h>
 #include <ESPAsyncWebServer.h>
-#include <Preferences.h>
 #include <LittleFS.h>
 #include <ESPmDNS.h>
 #include <HTTPClient.h>
+#include <WebSocketsClient.h>
 #include <ArduinoJson.h>
-#include <map>
+#endif
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <sys/time.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <driver/gpio.h>
+#include <esp_adc_cal.h>
+#include "protocol.h"
+#include "backfill.h"
+#include "spsc_ring.h"
+#include "region.h"
+#include "airtime.h"
+#include "snapshot.h"
+#include "beacon_registry.h"
+#include "gps_config.h"
+#include "gps_fix.h"
+#include "power_model.h"
+#include "battery_monitor.h"
+#include "profiler.h"
+#include "log_ring.h"
+#include "hal.h"
+#include "beacon_core.h"
+#if PAW_STATION
+#include "metrics.h"
+#include "station_core.h"
+#include "history_store.h"
+#include "trace_format.h"
+#include "web_json.h"
+#include "uplink_core.h"
+#include "bench_suite.h"
+#endif
 
 // -----------------------------------------------------------------------------
 // Device role selection
@@ -23,7 +74,13 @@ enum DeviceRole {
   ROLE_PUP_STATION = 1
 };
 
+#if PAW_BEACON && PAW_STATION
 DeviceRole currentRole = ROLE_PUP_BEACON;
+#elif PAW_BEACON
+const DeviceRole currentRole = ROLE_PUP_BEACON;
+#else
+const DeviceRole currentRole = ROLE_PUP_STATION;
+#endif
 
 // Simple role selection on boot using a button (or BOOT button)
 // HIGH = PupStation, LOW = PupBeacon
@@ -63,7 +120,9 @@ const float ADC_MULTIPLIER = 4.9 * 1.045;  // Voltage divider ratio
 Adafruit_ST7735 tft = Adafruit_ST7735(TFT_CS, TFT_DC, TFT_MOSI, TFT_SCLK, TFT_RST);
 
 // LoRa parameters (must match on both sides)
-const float LORA_FREQUENCY = 915.0; // MHz - Adjust to your region (e.g., 868.0 in EU)
+const float LORA_FREQUENCY = LORA_REGION.frequency; // MHz - select the region in platformio.ini (see region.h)
+const uint8_t LORA_SYNC_WORD = 0x12;  // Private network
+const int8_t LORA_TX_POWER_DBM = 22;
 
 // LoRa pin definitions for Heltec Wireless Tracker V1.1 (SX1262)
 const int LORA_SCK = 9;
@@ -79,41 +138,249 @@ SX1262 radio = new Module(LORA_CS, LORA_DIO1, LORA_RST, LORA_BUSY);
 
 // Flag for packet reception
 volatile bool receivedFlag = false;
+volatile uint32_t rxDoneMicros = 0; // When DIO1 last fired (start of the reply slot)
+
+// WiFi and lwIP run on the protocol core; radio, GPS and loop() on the application core
+const BaseType_t PROTOCOL_CORE = 0;
+const BaseType_t APP_CORE = 1;
+
+TaskHandle_t radioTaskHandle = NULL;  // Woken by DIO1 (station)
+
+#if PAW_STATION
+// PupStation receive path: DIO1 wakes radioTask, which copies each frame out of
+// the SX1262 immediately (the next packet overwrites its buffer) and queues it
+// here; loopPupStation() decodes at its own pace.
+struct RawFrame {
+  uint32_t rxDoneUs;    // micros() at RxDone, start of the reply slot
+  uint32_t rxMillis;    // millis() when the frame was read
+  float rssi;
+  float snr;
+  uint8_t len;
+  uint8_t data[sizeof(BackfillMessage)]; // Largest frame we accept
+};
+
+const uint32_t RX_QUEUE_DEPTH = 16;               // Frames buffered between radioTask and the loop
+const UBaseType_t RADIO_TASK_PRIORITY = 5;        // Above loop() and the web server
+const uint32_t RADIO_TASK_STACK = 4096;
+SpscRing<RawFrame, RX_QUEUE_DEPTH> rxQueue;
 
-// ISR for packet reception
-void setFlag(void) {
+// Receive path counters (radioTask writes the volatile ones)
+volatile uint32_t rxFramesQueued = 0;
+volatile uint32_t rxQueueOverruns = 0;  // Frames dropped because rxQueue was full
+volatile uint32_t rxReadErrors = 0;     // CRC or SPI read failures
+volatile uint32_t rxQueuePeak = 0;      // Deepest rxQueue has been
+uint32_t rxFramesProcessed = 0;         // Decoded by loopPupStation()
+float rxFramesPerSecond = 0.0;
+#endif // PAW_STATION
+
+// Listen-before-talk counters (see loraTransmit)
+struct LbtStats {
+  uint32_t cadChecks = 0;
+  uint32_t cadBusy = 0;       // CAD found a LoRa preamble on the channel
+  uint32_t backoffMs = 0;     // Total time spent backing off
+  uint32_t sentBusy = 0;      // Sent anyway after the last attempt (region allows it)
+  uint32_t dropped = 0;       // Not sent because the channel stayed busy
+} lbtStats;
+
+// Duty-cycle accounting, one ledger per sub-band of the region (see airtime.h)
+AirtimeLedger airtimeLedgers[MAX_SUB_BANDS];
+const int8_t TX_SUB_BAND = findSubBand(LORA_REGION, LORA_FREQUENCY);
+uint32_t airtimeDeferred = 0;   // Frames not sent because the budget was used up
+
+// ISR for packet reception - no SPI here, just timestamp and wake the reader
+void IRAM_ATTR setFlag(void) {
   receivedFlag = true;
+  rxDoneMicros = micros();
+  if (radioTaskHandle) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(radioTaskHandle, &woken);
+    if (woken) {
+      portYIELD_FROM_ISR();
+    }
+  }
 }
 
 // Power management
-// For PupBeacon, we'll mostly sleep between position reports.
-const uint32_t BEACON_SEND_INTERVAL_MS = 1000;  // How often to send GPS fix (1 second for status updates)
-const uint32_t BEACON_AWAKE_WINDOW_MS = 1500;    // How long to stay awake
-
-// Simple message types
-struct __attribute__((packed)) BeaconMessage {
-  uint8_t msgType;   // 0x01 = GPS beacon, 0x02 = control ack, etc.
-  char beaconId[9];  // Unique beacon identifier (ESP32 chip ID in hex, null-terminated)
-  float latitude;
-  float longitude;
-  float hdop;
-  uint8_t sats;
-  float batteryVoltage;
-  uint8_t ledOn;
-  uint8_t buzzerOn;
-  uint8_t lastControlReceived; // 0=none, 1=LED, 2=Buzzer, 3=Both
-  float speed;       // Speed in km/h
-  float altitude;    // Altitude in meters
-  uint32_t uptime;   // Beacon uptime in seconds
+// Between frames the beacon light-sleeps: RAM, radio configuration and GPS stay
+// as they are, and the timer or the radio's DIO1 wakes it. Lying still with
+// nothing pending, it deep-sleeps through a longer interval instead, keeping
+// what it needs in RTC memory (BeaconSleepState).
+#ifndef PAW_BEACON_SLEEP
+#define PAW_BEACON_SLEEP 1  // -D PAW_BEACON_SLEEP=0 keeps the beacon awake, e.g. for USB serial
+#endif
+const uint32_t BEACON_STATIONARY_INTERVAL_MS = 30000; // Deep-sleep cycle while lying still
+const uint32_t BEACON_AWAKE_WINDOW_MS = 6000;   // After deep sleep, longest wait for a fresh fix
+const uint32_t LIGHT_SLEEP_MIN_MS = 20;         // Shorter gaps are spent awake
+const uint32_t GPS_WAKE_LEAD_MS = 40;           // Awake this long before an NMEA burst is due
+const uint32_t GPS_BURST_GRACE_MS = 200;        // Stay up this long for a late burst
+const uint32_t DEEP_SLEEP_WAKE_LEAD_MS = 400;   // Boot time ahead of the GPS burst a deep sleep targets
+
+// Beacon state that has to survive deep sleep. Plain data for the same reason
+// as FixBacklog; begin() keeps it only when waking from deep sleep.
+struct BeaconSleepState {
+  static const uint32_t MAGIC = 0x5057534C; // "PWSL"
+
+  uint32_t magic;
+  uint32_t uptimeBaseMs;      // Uptime before this boot, deep sleeps included
+  int64_t sleepStartUs;       // System time at deep sleep entry (kept by the RTC)
+  uint32_t deepSleeps;
+  uint32_t cycleStartMs;      // Uptime of the previous frame
+  uint32_t cycleSleptMs;      // Slept since then
+  uint32_t gpsBaud;
+  bool gpsConfigured;
+  uint8_t gpsProfile;
+  uint32_t lastMovingMs;      // MotionDetector, in uptime
+  bool ledOn;
+  bool buzzerOn;
+  uint8_t lastControlCmd;
+  bool stationIdle;
+
+  // True if state was carried over from before a deep sleep
+  bool begin(bool wokeFromDeepSleep) {
+    if (wokeFromDeepSleep && magic == MAGIC) return true;
+    memset(this, 0, sizeof(*this));
+    magic = MAGIC;
+    return false;
+  }
 };
 
-struct __attribute__((packed)) ControlMessage {
-  uint8_t msgType;   // 0x10 = control from station
-  char beaconId[9];  // Target beacon ID (hex, null-terminated)
-  uint8_t ledOn;     // 0 or 1
-  uint8_t buzzerOn;  // 0 or 1
+RTC_DATA_ATTR BeaconSleepState sleepState;
+RTC_DATA_ATTR BatteryLifeModel batteryModel;
+bool resumedFromDeepSleep = false;  // This boot is a beacon deep-sleep wake
+
+// Beacon uptime across deep sleeps (plain millis() on the station)
+uint32_t uptimeMs() {
+  return sleepState.uptimeBaseMs + millis();
+}
+
+// -----------------------------------------------------------------------------
+// Boot cache (both roles)
+// -----------------------------------------------------------------------------
+
+// What the last full boot found: the role, and the baud the beacon's GPS
+// answered at. A reset in the field (watchdog, panic, brown-out, restart)
+// boots straight into the cached role and checks the GPS at the cached baud
+// only, skipping the USB wait, the role prompt and the baud scan. Power-on and
+// the reset button still take the full path, since that is where the role is
+// chosen, and so does any boot where the fast check fails.
+//
+// Kept in NVS, which survives power loss, and mirrored in RTC memory, which
+// survives every reset but power-on and is read first. radioSignature ties
+// the cache to the radio settings it was saved under; a firmware with other
+// settings starts over with a full boot.
+struct BootCache {
+  static const uint32_t MAGIC = 0x50574254; // "PWBT"
+
+  uint32_t magic;
+  uint8_t role;             // DeviceRole
+  uint32_t gpsBaud;         // 0 if no GPS answered
+  uint32_t radioSignature;  // radioConfigSignature() when saved
+  uint32_t check;           // bootCacheCheck() over the fields above
 };
 
+const char* BOOT_CACHE_NAMESPACE = "pawboot";
+
+RTC_NOINIT_ATTR BootCache rtcBootCache;
+BootCache bootCache;              // Valid when magic is set
+bool fastBoot = false;            // This boot took the fast path
+esp_reset_reason_t resetReason = ESP_RST_UNKNOWN;
+uint32_t setupDoneMs = 0;         // millis() when setup() finished
+uint32_t firstFrameMs = 0;        // millis() when the beacon built its first frame this boot
+
+static uint32_t bootHash(uint32_t h, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ p[i]) * 16777619u;  // FNV-1a
+  }
+  return h;
+}
+
+uint32_t radioConfigSignature() {
+  uint32_t h = 2166136261u;
+  h = bootHash(h, &LORA_FREQUENCY, sizeof(LORA_FREQUENCY));
+  h = bootHash(h, &LORA_MODULATION.spreadingFactor, sizeof(LORA_MODULATION.spreadingFactor));
+  h = bootHash(h, &LORA_MODULATION.bandwidthKHz, sizeof(LORA_MODULATION.bandwidthKHz));
+  h = bootHash(h, &LORA_MODULATION.codingRate, sizeof(LORA_MODULATION.codingRate));
+  h = bootHash(h, &LORA_MODULATION.preambleLength, sizeof(LORA_MODULATION.preambleLength));
+  h = bootHash(h, &LORA_SYNC_WORD, sizeof(LORA_SYNC_WORD));
+  h = bootHash(h, &LORA_TX_POWER_DBM, sizeof(LORA_TX_POWER_DBM));
+  return h;
+}
+
+static uint32_t bootCacheCheck(const BootCache& c) {
+  uint32_t h = 2166136261u;
+  h = bootHash(h, &c.magic, sizeof(c.magic));
+  h = bootHash(h, &c.role, sizeof(c.role));
+  h = bootHash(h, &c.gpsBaud, sizeof(c.gpsBaud));
+  h = bootHash(h, &c.radioSignature, sizeof(c.radioSignature));
+  return h;
+}
+
+static bool bootCacheValid(const BootCache& c) {
+  return c.magic == BootCache::MAGIC && c.check == bootCacheCheck(c) &&
+         c.role <= ROLE_PUP_STATION && c.radioSignature == radioConfigSignature();
+}
+
+// Resets that leave the role as the user chose it at the last power-on
+static bool isFieldReset(esp_reset_reason_t reason) {
+  switch (reason) {
+    case ESP_RST_SW:
+    case ESP_RST_PANIC:
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+    case ESP_RST_BROWNOUT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// RTC copy first, NVS after a power loss; bootCache is cleared if neither is valid
+bool loadBootCache() {
+  if (bootCacheValid(rtcBootCache)) {
+    bootCache = rtcBootCache;
+    return true;
+  }
+  Preferences prefs;
+  size_t len = 0;
+  if (prefs.begin(BOOT_CACHE_NAMESPACE, true)) {
+    len = prefs.getBytes("cache", &bootCache, sizeof(bootCache));
+    prefs.end();
+  }
+  if (len == sizeof(bootCache) && bootCacheValid(bootCache)) {
+    rtcBootCache = bootCache;
+    return true;
+  }
+  memset(&bootCache, 0, sizeof(bootCache));
+  return false;
+}
+
+// After a full boot. NVS is written only when something changed.
+void saveBootCache(DeviceRole role, uint32_t gpsBaud) {
+  BootCache c;
+  memset(&c, 0, sizeof(c));
+  c.magic = BootCache::MAGIC;
+  c.role = (uint8_t)role;
+  c.gpsBaud = gpsBaud;
+  c.radioSignature = radioConfigSignature();
+  c.check = bootCacheCheck(c);
+  rtcBootCache = c;
+  if (memcmp(&c, &bootCache, sizeof(c)) == 0) return;
+  bootCache = c;
+  
+  Preferences prefs;
+  if (prefs.begin(BOOT_CACHE_NAMESPACE, false)) {
+    prefs.putBytes("cache", &c, sizeof(c));
+    prefs.end();
+    LOG_INFO(LOG_SYSTEM, "Boot cache saved: role %u, GPS %lu baud", c.role, (unsigned long)gpsBaud);
+  }
+}
+
+// Message formats live in protocol.h
+
+// Store-and-forward (see backfill.h)
+#if PAW_STATION
 // -----------------------------------------------------------------------------
 // WiFi and Web Server (PupStation only)
 // -----------------------------------------------------------------------------
@@ -130,67 +397,156 @@ bool centralServerEnabled = false;
 uint32_t lastServerSync = 0;
 const uint32_t SERVER_SYNC_INTERVAL = 5000; // Send data every 5 seconds
 
-// Latest beacon data (global for web server)
-struct LatestBeaconData {
-  String beaconId = "";
-  float latitude = 0.0;
-  float longitude = 0.0;
-  float hdop = 0.0;
-  uint8_t sats = 0;
-  float batteryVoltage = 0.0;
-  bool ledOn = false;
-  bool buzzerOn = false;
-  uint8_t lastControlReceived = 0;
-  float speed = 0.0;
-  float altitude = 0.0;
-  uint32_t uptime = 0;
-  uint32_t lastUpdate = 0;
-  float rssi = 0.0;
-  float snr = 0.0;
-  bool hasData = false;
+// Every beacon heard or named so far (loop() only). Entries are never removed.
+// LatestBeaconData and BeaconTable are in station_core.h.
+BeaconTable beacons;
+LatestBeaconData* primaryBeacon = nullptr; // First beacon heard, shown on the display
+
+// Station GPS location (global for web server), StationLocation in station_core.h
+StationLocation stationLocation;
+
+// Station state published by loop() for the web handlers and the storage,
+// network and UI tasks, so none of them read globals loop() is changing
+struct StationSnapshot {
+  StationLocation station;
+  float stationBattery = 0.0;   // From the battery monitor
+  uint32_t gpsTime = 0;         // Unix time from the station GPS, 0 if unknown
+  LatestBeaconData primary;
+};
+
+Snapshot<StationSnapshot> stationSnapshot;
+
+// Copy of `beacons` published by loop() after each change. Kept apart from
+// stationSnapshot so the once-a-second GPS/battery publish does not copy it.
+// About 7 KB: readers copy it to the heap, not their stack.
+Snapshot<BeaconTable> beaconTable;
+
+// Station task pipeline: radioTask -> rxQueue -> loop() (decode, state) ->
+// storageQueue -> storageTask. networkTask, uiTask and the web handlers read
+// stationSnapshot. WiFi and lwIP run on the protocol core, so the tasks that
+// wait on them go there; radio and loop() keep the application core.
+const UBaseType_t STORAGE_TASK_PRIORITY = 2;
+const UBaseType_t NETWORK_TASK_PRIORITY = 1;
+const UBaseType_t UI_TASK_PRIORITY = 1;
+const uint32_t STORAGE_TASK_STACK = 6144;
+const uint32_t NETWORK_TASK_STACK = 8192;  // HTTPClient + ArduinoJson
+const uint32_t UI_TASK_STACK = 4096;
+const uint32_t UI_REFRESH_MS = 1000;
+TaskHandle_t storageTaskHandle = NULL;
+TaskHandle_t networkTaskHandle = NULL;
+TaskHandle_t uiTaskHandle = NULL;
+TaskHandle_t stationLoopHandle = NULL;
+
+// Station metrics, scraped from GET /api/metrics (see metrics.h). Web handler
+// latencies are added per route as the routes are registered.
+MetricCounter metricFramesReceived("paw_lora_frames_received_total", "LoRa frames read from the radio");
+MetricCounter metricFramesDecoded("paw_lora_frames_decoded_total", "Beacon and backfill frames accepted");
+MetricCounter metricFramesInvalid("paw_lora_frames_invalid_total", "Frames dropped as short, unknown or out of range");
+MetricCounter metricReadErrors("paw_lora_read_errors_total", "Radio reads that failed (CRC or SPI)", &rxReadErrors);
+MetricCounter metricQueueOverruns("paw_lora_queue_overruns_total", "Frames dropped because rxQueue was full", &rxQueueOverruns);
+MetricHistogram metricHistoryAppend("paw_history_append_seconds", "Time to append one fix to history.csv",
+                                    METRIC_LATENCY_BUCKETS_US, METRIC_LATENCY_BUCKETS);
+MetricCounter metricHistoryBytes("paw_history_bytes_written_total", "Bytes written to history.csv, rotations and merges included");
+MetricCounter metricUplinkOk("paw_uplink_batches_total", "Uplink batches by result", "result=\"ok\"");
+MetricCounter metricUplinkFailed("paw_uplink_batches_total", "Uplink batches by result", "result=\"error\"");
+MetricHistogram metricUplinkTime("paw_uplink_batch_seconds", "Time to deliver or fail one uplink batch",
+                                 METRIC_LATENCY_BUCKETS_US, METRIC_LATENCY_BUCKETS);
+MetricGauge metricHeapFree("paw_heap_free_bytes", "Free heap");
+MetricGauge metricHeapMinFree("paw_heap_min_free_bytes", "Lowest free heap since boot");
+MetricGauge metricHeapLargest("paw_heap_largest_free_block_bytes", "Largest heap block that can be allocated");
+MetricHistogram metricLoopTime("paw_loop_iteration_seconds", "loop() work per iteration, idle delay excluded",
+                               METRIC_LOOP_BUCKETS_US, METRIC_LOOP_BUCKETS);
+
+// Profiled sections, GET /api/profile (see profiler.h)
+PROFILE_ZONE_DEFINE(profileGpsDrain, "gpsDrain");
+PROFILE_ZONE_DEFINE(profileRadioRx, "radioRx");
+PROFILE_ZONE_DEFINE(profileBeaconFrame, "handleIncomingBeacon");
+PROFILE_ZONE_DEFINE(profileDisplay, "display");
+PROFILE_ZONE_DEFINE(profileLogStats, "logStats");
+PROFILE_ZONE_DEFINE(profileServerSync, "serverSync");
+uint32_t profileOverhead = 0;     // Cycles per profiled section, measured at boot
+uint32_t profileSinceMs = 0;      // Last reset
+const float PROFILE_OVERHEAD_BUDGET_PERCENT = 1.0f;  // Of one core; recording stops above it
+const uint32_t PROFILE_CHECK_MIN_MS = 10000;         // Window before the budget is checked
+
+// Control commands for beacon actuators
+// Each beacon has its own outbound slot; a command is only transmitted in the
+// receive window that follows a packet from its target beacon, and is confirmed
+// by the LED/buzzer state echoed in that beacon's next BeaconMessage.
+enum ControlCommandState : uint8_t {
+  CMD_FREE = 0,
+  CMD_QUEUED,      // Waiting for the target beacon's next receive window
+  CMD_SENT,        // Transmitted, waiting for the state echo
+  CMD_ACKED,       // Beacon echoed the requested state
+  CMD_FAILED,      // No echo after CONTROL_MAX_ATTEMPTS windows
+  CMD_SUPERSEDED,  // Replaced by a newer command for the same beacon
+  CMD_EXPIRED      // Target beacon not heard from in time
 };
 
-// Support for multiple beacons
-std::map<String, LatestBeaconData> beacons;
-LatestBeaconData latestBeacon; // Keep for backward compatibility
-
-// Station GPS location (global for web server)
-struct StationLocation {
-  float latitude = 0.0;
-  float longitude = 0.0;
-  float hdop = 0.0;
-  uint8_t sats = 0;
-  float altitude = 0.0;
-  bool hasValidFix = false;
-  uint32_t lastUpdate = 0;
-} stationLocation;
-
-// Control state for beacon actuators
-struct BeaconControlState {
-  String targetBeaconId = ""; // Which beacon to control (empty = first/any)
+struct ControlCommand {
+  uint16_t id = 0;
+  uint32_t beaconId = 0;         // parseBeaconId(); text only in the web/JSON layer
   bool ledOn = false;
   bool buzzerOn = false;
-  bool pendingControl = false; // Flag to send control on next beacon reception
-} beaconControl;
+  ControlCommandState state = CMD_FREE;
+  uint8_t attempts = 0;
+  uint32_t createdAt = 0;
+  uint32_t updatedAt = 0;
+  uint32_t serverCommandId = 0;  // Set when the central server issued it
+  bool reported = false;         // Final state sent back to the server
+};
+
+const uint8_t CONTROL_COMMAND_SLOTS = 16;          // Active + recently finished commands
+const uint8_t CONTROL_MAX_ATTEMPTS = 3;            // Receive windows tried before giving up
+const uint32_t CONTROL_COMMAND_TIMEOUT_MS = 120000; // Drop commands for beacons gone silent
+ControlCommand controlCommands[CONTROL_COMMAND_SLOTS];
+uint16_t nextControlCommandId = 1;
+SemaphoreHandle_t controlMutex = NULL; // controlCommands is shared by radioTask and the web/server handlers
+
+// Frame seqs heard per beacon, echoed back in acks (radioTask only)
+BeaconRegistry<SeqWindow, MAX_BEACONS> rxSeqWindows;
+
+// Frame seqs per beacon already queued for the history, so backfill does not
+// store them again (loop() only)
+BeaconRegistry<StoredSeqs, MAX_BEACONS> storedSeqs;
 
 // Beacon name configuration
 const char* BEACON_CONFIG_FILE = "/config/beacons.json";
-std::map<String, String> beaconNames;
 uint32_t beaconDisconnectTimeout = 60000; // Default: 60 seconds in milliseconds
 
-// Get beacon name (returns default if not configured)
-String getBeaconName(const String& beaconId) {
-  auto it = beaconNames.find(beaconId);
-  if (it != beaconNames.end()) {
-    return it->second;
+// Names live in the beacons table, which belongs to loop(). The web UI queues
+// renames for it; storageTask saves the published table once changes settle.
+struct BeaconRename {
+  char beaconId[9];
+  char name[BEACON_NAME_LEN];
+};
+const uint8_t BEACON_RENAME_QUEUE_DEPTH = 4;
+const uint32_t BEACON_CONFIG_SAVE_DELAY_MS = 10000; // Coalesce discoveries and renames
+QueueHandle_t beaconRenameQueue = NULL;
+bool beaconNamesChanged = false;          // loop(): not yet published
+volatile bool beaconConfigDirty = false;  // Published, not yet saved
+
+// Entry for a beacon ID, created with its default name on first use.
+// nullptr if the ID is malformed or the table is full.
+LatestBeaconData* registerBeacon(const char* beaconId) {
+  uint32_t id;
+  if (!parseBeaconId(beaconId, id)) return nullptr;
+  
+  bool added;
+  LatestBeaconData* beacon = findOrAddBeacon(beacons, beaconId, added);
+  if (!beacon) {
+    LOG_WARN(LOG_BEACON, "Beacon table full, ignoring %s", beaconId);
+    return nullptr;
   }
-  // Generate default name from beacon ID
-  return "Beacon-" + beaconId;
+  if (added) {
+    beaconNamesChanged = true;
+    LOG_INFO(LOG_BEACON, "New beacon %s (%u/%u)", beacon->beaconId, beacons.size(), beacons.capacity());
+  }
+  return beacon;
 }
 
-// Load beacon names from file
+// Load beacon names from file (setup, before loop() runs)
 void loadBeaconConfig() {
-  beaconNames.clear();
   beaconDisconnectTimeout = 60000; // Reset to default
   
   File file = LittleFS.open(BEACON_CONFIG_FILE, "r");
@@ -246,15 +602,20 @@ void loadBeaconConfig() {
     if (nameEnd < 0) break;
     
     String name = content.substring(nameStart, nameEnd);
-    beaconNames[id] = name;
+    LatestBeaconData* beacon = registerBeacon(id.c_str());
+    if (beacon) {
+      strncpy(beacon->name, name.c_str(), sizeof(beacon->name) - 1);
+      beacon->name[sizeof(beacon->name) - 1] = '\0';
+    }
     
     Serial.printf("Loaded beacon config: ID=%s, Name=%s\n", id.c_str(), name.c_str());
     pos = nameEnd;
   }
+  beaconNamesChanged = false; // Nothing new to save
 }
 
-// Save beacon names to file
-void saveBeaconConfig() {
+// Save beacon names to file (storageTask, from the published table)
+void saveBeaconConfig(const BeaconTable &table) {
   // Create directory if needed
   if (!LittleFS.exists("/config")) {
     LittleFS.mkdir("/config");
@@ -268,11 +629,9 @@ void saveBeaconConfig() {
   
   file.printf("{\"disconnectTimeout\":%d,", beaconDisconnectTimeout / 1000); // Save as seconds
   file.print("\"beacons\":[");
-  bool first = true;
-  for (const auto& pair : beaconNames) {
-    if (!first) file.print(",");
-    file.printf("{\"id\":\"%s\",\"name\":\"%s\"}", pair.first.c_str(), pair.second.c_str());
-    first = false;
+  for (uint8_t i = 0; i < table.size(); i++) {
+    if (i > 0) file.print(",");
+    file.printf("{\"id\":\"%s\",\"name\":\"%s\"}", table.at(i).beaconId, table.at(i).name);
   }
   file.println("]}");
   file.close();
@@ -281,298 +640,1343 @@ void saveBeaconConfig() {
 }
 
 // -----------------------------------------------------------------------------
-// Statistics Tracking
+// Control Command Queue (PupStation only)
 // -----------------------------------------------------------------------------
 
-const char* STATS_FILE = "/stats.csv";
-const uint32_t STATS_LOG_INTERVAL = 5000; // TODO: Change to 60000 (1 minute) after testing
-const uint32_t MAX_STATS_FILE_SIZE = 1024; // Keep file under 1KB
-uint32_t lastStatsLog = 0;
-uint32_t bootTime = 0;
-uint32_t rebootCount = 0;
+const char* controlStateName(ControlCommandState state) {
+  switch (state) {
+    case CMD_QUEUED: return "queued";
+    case CMD_SENT: return "sent";
+    case CMD_ACKED: return "acked";
+    case CMD_FAILED: return "failed";
+    case CMD_SUPERSEDED: return "superseded";
+    case CMD_EXPIRED: return "expired";
+    default: return "free";
+  }
+}
 
-struct StatsEntry {
-  uint32_t timestamp;
-  uint32_t stationUptime;
-  float stationBattery;
-  uint32_t beaconUptime;
-  float beaconBattery;
-};
+// Hold while reading or changing controlCommands; never across a radio transmit
+void lockControl() {
+  xSemaphoreTake(controlMutex, portMAX_DELAY);
+}
 
-// Forward declaration
-float readBatteryVoltage();
+void unlockControl() {
+  xSemaphoreGive(controlMutex);
+}
 
-// Log statistics to file
-void logStats() {
-  // Only log if we have valid GPS time
-  if (!gps.time.isValid() || !gps.date.isValid()) {
-    Serial.println("Skipping stats log - no GPS time available");
-    return;
+static bool isControlActive(const ControlCommand &cmd) {
+  return cmd.state == CMD_QUEUED || cmd.state == CMD_SENT;
+}
+
+// Find the command currently waiting to be delivered to a beacon
+ControlCommand* findActiveControl(uint32_t beaconId) {
+  for (uint8_t i = 0; i < CONTROL_COMMAND_SLOTS; i++) {
+    if (isControlActive(controlCommands[i]) && controlCommands[i].beaconId == beaconId) {
+      return &controlCommands[i];
+    }
   }
-  
+  return nullptr;
+}
+
+ControlCommand* findControlById(uint16_t id) {
+  for (uint8_t i = 0; i < CONTROL_COMMAND_SLOTS; i++) {
+    if (controlCommands[i].state != CMD_FREE && controlCommands[i].id == id) {
+      return &controlCommands[i];
+    }
+  }
+  return nullptr;
+}
+
+// Heap copy of the published beacon table (safe from any task)
+std::unique_ptr<BeaconTable> readBeaconTable() {
+  std::unique_ptr<BeaconTable> table(new BeaconTable);
+  beaconTable.read(*table);
+  return table;
+}
+
+bool findPublishedBeacon(uint32_t beaconId, LatestBeaconData &out) {
+  std::unique_ptr<BeaconTable> table = readBeaconTable();
+  const LatestBeaconData* beacon = table->find(beaconId);
+  if (!beacon) return false;
+  out = *beacon;
+  return true;
+}
+
+// Actuator state the beacon last reported. Copies the published table, so
+// call it before lockControl(): radioTask takes that lock in reply windows.
+void getReportedControlState(uint32_t beaconId, bool &ledOn, bool &buzzerOn) {
+  LatestBeaconData beacon;
+  if (findPublishedBeacon(beaconId, beacon)) {
+    ledOn = beacon.ledOn;
+    buzzerOn = beacon.buzzerOn;
+  } else {
+    ledOn = false;
+    buzzerOn = false;
+  }
+}
+
+// State the beacon should end up in: its pending command if any, otherwise
+// the reported state already in ledOn/buzzerOn (controlMutex held)
+void getDesiredControlState(uint32_t beaconId, bool &ledOn, bool &buzzerOn) {
+  ControlCommand* active = findActiveControl(beaconId);
+  if (active) {
+    ledOn = active->ledOn;
+    buzzerOn = active->buzzerOn;
+  }
+}
+
+// Mark commands whose beacon has not opened a window in time as expired
+void expireControlCommands(uint32_t now) {
+  for (uint8_t i = 0; i < CONTROL_COMMAND_SLOTS; i++) {
+    ControlCommand &cmd = controlCommands[i];
+    if (isControlActive(cmd) && now - cmd.updatedAt > CONTROL_COMMAND_TIMEOUT_MS) {
+      cmd.state = CMD_EXPIRED;
+      cmd.updatedAt = now;
+      LOG_WARN(LOG_RADIO, "Control #%u for %08X expired", cmd.id, cmd.beaconId);
+    }
+  }
+}
+
+// Queue a LED/buzzer state for one beacon. Commands carry the full actuator
+// state, so a newer command replaces any older one still pending for the same
+// beacon. Returns nullptr if every slot holds an active command.
+ControlCommand* enqueueControl(uint32_t beaconId, bool ledOn, bool buzzerOn) {
   uint32_t now = millis();
-  uint32_t stationUptime = (now - bootTime) / 1000; // uptime in seconds
-  float stationBattery = readBatteryVoltage();
-  
-  // Calculate beacon uptime (time since last seen, or 0 if never seen)
-  uint32_t beaconUptime = 0;
-  float beaconBattery = 0.0;
-  if (latestBeacon.hasData) {
-    beaconUptime = (now - latestBeacon.lastUpdate) / 1000; // seconds since last beacon
-    beaconBattery = latestBeacon.batteryVoltage;
-  }
-  
-  // Create Unix timestamp from GPS date/time
-  // Note: TinyGPS++ provides UTC time
-  struct tm timeinfo;
-  timeinfo.tm_year = gps.date.year() - 1900;
-  timeinfo.tm_mon = gps.date.month() - 1;
-  timeinfo.tm_mday = gps.date.day();
-  timeinfo.tm_hour = gps.time.hour();
-  timeinfo.tm_min = gps.time.minute();
-  timeinfo.tm_sec = gps.time.second();
-  timeinfo.tm_isdst = 0;
-  time_t timestamp = mktime(&timeinfo);
+  expireControlCommands(now);
   
-  // Check current file size before writing
-  File file = LittleFS.open(STATS_FILE, FILE_READ);
-  size_t currentSize = 0;
-  if (file) {
-    currentSize = file.size();
-    file.close();
+  ControlCommand* previous = findActiveControl(beaconId);
+  if (previous) {
+    previous->state = CMD_SUPERSEDED;
+    previous->updatedAt = now;
   }
   
-  // If file is too large, rotate (remove oldest entries)
-  if (currentSize >= MAX_STATS_FILE_SIZE) {
-    file = LittleFS.open(STATS_FILE, FILE_READ);
-    if (file) {
-      String header = file.readStringUntil('\n');
-      
-      // Calculate how many bytes to skip (delete oldest 25%)
-      size_t bytesToSkip = currentSize / 4;
-      size_t bytesSkipped = 0;
-      
-      // Skip old data by reading and discarding lines
-      while (file.available() && bytesSkipped < bytesToSkip) {
-        String line = file.readStringUntil('\n');
-        bytesSkipped += line.length() + 1; // +1 for newline
-      }
-      
-      // Read remaining data to keep
-      String keepData = "";
-      while (file.available()) {
-        keepData += file.readStringUntil('\n') + "\n";
-      }
-      file.close();
-      
-      // Rewrite file with header and kept data
-      file = LittleFS.open(STATS_FILE, FILE_WRITE);
-      if (file) {
-        file.println(header);
-        file.print(keepData);
-        file.close();
-        Serial.println("Stats file rotated (FIFO)");
-      }
+  // Prefer a free slot, otherwise recycle the oldest finished command
+  ControlCommand* slot = nullptr;
+  for (uint8_t i = 0; i < CONTROL_COMMAND_SLOTS; i++) {
+    ControlCommand &cmd = controlCommands[i];
+    if (cmd.state == CMD_FREE) {
+      slot = &cmd;
+      break;
     }
-  }
-  
-  // Check if file exists, create with header if not
-  if (!LittleFS.exists(STATS_FILE)) {
-    file = LittleFS.open(STATS_FILE, FILE_WRITE);
-    if (file) {
-      file.println("T,SUT,SB,BUT,BB");
-      file.close();
+    if (!isControlActive(cmd) && (!slot || cmd.updatedAt < slot->updatedAt)) {
+      slot = &cmd;
     }
   }
-  
-  // Open file in append mode
-  file = LittleFS.open(STATS_FILE, FILE_APPEND);
-  if (!file) {
-    Serial.println("Failed to open stats file for writing");
-    return;
+  if (!slot) {
+    LOG_WARN(LOG_RADIO, "Control queue full, command rejected");
+    return nullptr;
   }
   
-  // Write data (compact format)
-  file.print(timestamp);
-  file.print(",");
-  file.print(stationUptime);
-  file.print(",");
-  file.print(stationBattery, 2);
-  file.print(",");
-  file.print(beaconUptime);
-  file.print(",");
-  file.println(beaconBattery, 2);
-  
-  file.close();
+  slot->id = nextControlCommandId++;
+  if (nextControlCommandId == 0) nextControlCommandId = 1; // 0 is never a valid ID
+  slot->beaconId = beaconId;
+  slot->ledOn = ledOn;
+  slot->buzzerOn = buzzerOn;
+  slot->state = CMD_QUEUED;
+  slot->attempts = 0;
+  slot->createdAt = now;
+  slot->updatedAt = now;
+  slot->serverCommandId = 0;
+  slot->reported = false;
+  
+  LOG_INFO(LOG_RADIO, "Control #%u queued for %08X (LED %u, buzzer %u)",
+           slot->id, beaconId, ledOn, buzzerOn);
+  return slot;
 }
 
-// Initialize stats tracking
-void initStats() {
-  bootTime = millis();
-  
-  // Load reboot count from preferences
-  preferences.begin("pawtracker", false);
-  rebootCount = preferences.getUInt("rebootCount", 0);
-  rebootCount++;
-  preferences.putUInt("rebootCount", rebootCount);
-  preferences.end();
-  
-  Serial.print("Boot #");
-  Serial.println(rebootCount);
-  
-  // Log initial entry
-  lastStatsLog = millis();
-  logStats();
+String controlCommandToJson(const ControlCommand &cmd) {
+  char beaconId[9];
+  formatBeaconId(cmd.beaconId, beaconId);
+  String json = "{";
+  json += "\"id\":" + String(cmd.id) + ",";
+  json += "\"beaconId\":\"" + String(beaconId) + "\",";
+  json += "\"ledOn\":" + String(cmd.ledOn ? "true" : "false") + ",";
+  json += "\"buzzerOn\":" + String(cmd.buzzerOn ? "true" : "false") + ",";
+  json += "\"state\":\"" + String(controlStateName(cmd.state)) + "\",";
+  json += "\"attempts\":" + String(cmd.attempts) + ",";
+  json += "\"createdAt\":" + String(cmd.createdAt) + ",";
+  json += "\"updatedAt\":" + String(cmd.updatedAt);
+  json += "}";
+  return json;
 }
+#endif // PAW_STATION
 
 // -----------------------------------------------------------------------------
-// History Tracking
+// Hardware abstraction (both roles)
 // -----------------------------------------------------------------------------
 
-const char* HISTORY_FILE = "/history.csv";
-const uint32_t MAX_HISTORY_FILE_SIZE = 50 * 1024; // 50KB max (about 1000-1500 entries)
-const uint32_t HISTORY_RETENTION_DAYS = 30; // Keep 30 days of history
+// ESP32 side of hal.h. The shared modules (station_core.h, beacon_core.h,
+// history_store.h) and the code paths they serve go through `hal`; the native
+// build swaps in hal_native.h.
+float batteryVoltage();
 
-struct HistoryEntry {
-  uint32_t timestamp;    // Unix timestamp from GPS
-  float latitude;
-  float longitude;
-  float speed;           // km/h
-  float altitude;        // meters
-  float battery;         // beacon battery voltage
-  float rssi;            // signal strength
-  float snr;             // signal quality
+class Esp32Clock : public HalClock {
+public:
+  uint32_t millis() override { return ::millis(); }
+  uint32_t micros() override { return ::micros(); }
+  void delayMs(uint32_t ms) override { ::delay(ms); }
 };
 
-// Log beacon position to history file
-void logBeaconHistory(const BeaconMessage &msg, float rssi, float snr) {
-  // Only log if we have valid GPS time
-  if (!gps.time.isValid() || !gps.date.isValid()) {
-    Serial.println("Skipping history log - no GPS time available");
-    return;
+// SX1262 as set up by initLoRa()
+class Esp32Radio : public HalRadio {
+public:
+  int transmit(const uint8_t* data, size_t len) override {
+    return radio.transmit(const_cast<uint8_t*>(data), len);
   }
   
-  // Create Unix timestamp from GPS date/time
-  struct tm timeinfo;
-  timeinfo.tm_year = gps.date.year() - 1900;
-  timeinfo.tm_mon = gps.date.month() - 1;
-  timeinfo.tm_mday = gps.date.day();
-  timeinfo.tm_hour = gps.time.hour();
-  timeinfo.tm_min = gps.time.minute();
-  timeinfo.tm_sec = gps.time.second();
-  timeinfo.tm_isdst = 0;
-  time_t timestamp = mktime(&timeinfo);
+  int receive(uint8_t* data, size_t size, float& rssi, float& snr) override {
+    size_t len = min(radio.getPacketLength(), size);
+    int state = radio.readData(data, len);
+    if (state != RADIOLIB_ERR_NONE) return state;
+    rssi = radio.getRSSI();
+    snr = radio.getSNR();
+    return (int)len;
+  }
   
-  // Check current file size before writing
-  File file = LittleFS.open(HISTORY_FILE, FILE_READ);
-  size_t currentSize = 0;
-  if (file) {
-    currentSize = file.size();
-    file.close();
+  void startReceive() override { radio.startReceive(); }
+};
+
+class Esp32Gnss : public HalGnss {
+public:
+  size_t read(uint8_t* data, size_t size) override { return GPSSerial.read(data, size); }
+  size_t write(const uint8_t* data, size_t len) override { return GPSSerial.write(data, len); }
+};
+
+#if PAW_STATION
+class Esp32File : public HalFile {
+public:
+  explicit Esp32File(File file) : file(file) {}
+  ~Esp32File() override { file.close(); }
+  
+  size_t write(const char* data, size_t len) override {
+    return file.write((const uint8_t*)data, len);
   }
   
-  // If file is too large, rotate (remove oldest entries)
-  if (currentSize >= MAX_HISTORY_FILE_SIZE) {
-    file = LittleFS.open(HISTORY_FILE, FILE_READ);
-    if (file) {
-      String header = file.readStringUntil('\n');
-      
-      // Calculate how many bytes to skip (delete oldest 25%)
-      size_t bytesToSkip = currentSize / 4;
-      size_t bytesSkipped = 0;
-      
-      // Skip old data by reading and discarding lines
-      while (file.available() && bytesSkipped < bytesToSkip) {
-        String line = file.readStringUntil('\n');
-        bytesSkipped += line.length() + 1; // +1 for newline
-      }
-      
-      // Read remaining data to keep
-      String keepData = "";
-      while (file.available()) {
-        keepData += file.readStringUntil('\n') + "\n";
-      }
-      file.close();
-      
-      // Rewrite file with header and kept data
-      file = LittleFS.open(HISTORY_FILE, FILE_WRITE);
-      if (file) {
-        file.println(header);
-        file.print(keepData);
-        file.close();
-        Serial.println("History file rotated (FIFO)");
-      }
-    }
+  size_t read(char* data, size_t len) override {
+    return file.read((uint8_t*)data, len);
   }
   
-  // Check if file exists, create with header if not
-  if (!LittleFS.exists(HISTORY_FILE)) {
-    file = LittleFS.open(HISTORY_FILE, FILE_WRITE);
-    if (file) {
-      file.println("timestamp,beaconId,latitude,longitude,speed,altitude,battery,rssi,snr");
-      file.close();
-      Serial.println("History file created");
+  // Byte by byte: Stream::readBytesUntil() waits out its timeout on a last
+  // line without a newline
+  int readLine(char* line, size_t size) override {
+    int c = file.read();
+    if (c < 0) return -1;
+    size_t n = 0;
+    while (c >= 0 && c != '\n') {
+      if (n + 1 < size) line[n++] = (char)c;
+      c = file.read();
     }
+    if (n > 0 && line[n - 1] == '\r') n--;
+    line[n] = '\0';
+    return (int)n;
   }
   
-  // Open file in append mode
-  file = LittleFS.open(HISTORY_FILE, FILE_APPEND);
+  bool seek(size_t pos) override { return file.seek(pos); }
+  size_t size() override { return file.size(); }
+  
+private:
+  File file;
+};
+
+class Esp32FileSystem : public HalFileSystem {
+public:
+  std::unique_ptr<HalFile> open(const char* path, HalFileMode mode) override {
+    const char* fsMode = mode == HAL_FILE_READ ? FILE_READ : mode == HAL_FILE_WRITE ? FILE_WRITE : FILE_APPEND;
+    File file = LittleFS.open(path, fsMode);
+    if (!file) return nullptr;
+    return std::unique_ptr<HalFile>(new Esp32File(file));
+  }
+  
+  bool exists(const char* path) override { return LittleFS.exists(path); }
+  bool remove(const char* path) override { return LittleFS.remove(path); }
+  bool rename(const char* from, const char* to) override { return LittleFS.rename(from, to); }
+};
+#else
+// The beacon image has no filesystem (LittleFS is mounted by the station only)
+class Esp32FileSystem : public HalFileSystem {
+public:
+  std::unique_ptr<HalFile> open(const char*, HalFileMode) override { return nullptr; }
+  bool exists(const char*) override { return false; }
+  bool remove(const char*) override { return false; }
+  bool rename(const char*, const char*) override { return false; }
+};
+#endif
+
+class Esp32Display : public HalDisplay {
+public:
+  void clear() override { tft.fillScreen(ST77XX_BLACK); }
+  
+  void drawText(int16_t x, int16_t y, const char* text, uint16_t color, uint8_t size) override {
+    tft.setCursor(x, y);
+    tft.setTextColor(color, ST77XX_BLACK);
+    tft.setTextSize(size);
+    tft.print(text);
+  }
+  
+  void setBacklight(bool on) override { digitalWrite(TFT_BL, on ? HIGH : LOW); }
+};
+
+class Esp32Battery : public HalBattery {
+public:
+  float volts() override { return batteryVoltage(); }
+};
+
+Esp32Clock esp32Clock;
+Esp32Radio esp32Radio;
+Esp32Gnss esp32Gnss;
+Esp32FileSystem esp32Fs;
+Esp32Display esp32Display;
+Esp32Battery esp32Battery;
+Hal hal = {esp32Clock, esp32Radio, esp32Gnss, esp32Fs, esp32Display, esp32Battery};
+
+#if PAW_STATION
+// -----------------------------------------------------------------------------
+// Capture (PupStation only)
+// -----------------------------------------------------------------------------
+
+// Records what the station hears - raw NMEA from gpsTask, frames from
+// radioTask and what processFrame() made of them - into CAPTURE_FILE for the
+// replay tool (trace_format.h). Producers copy records into a RAM ring and
+// never touch flash; storageTask drains the ring to the file. Records that do
+// not fit in the ring are dropped and counted.
+const char* CAPTURE_FILE = "/capture.bin";
+const size_t CAPTURE_BUFFER_SIZE = 8192;
+const uint32_t CAPTURE_MAX_BYTES = 512 * 1024;  // Stops by itself at this size
+const size_t CAPTURE_CHUNK = 512;               // Bytes per file write
+const uint32_t CAPTURE_DRAIN_MS = 250;          // storageTask wakes this often while capturing
+
+enum CaptureRequest : uint8_t {
+  CAPTURE_REQ_NONE,
+  CAPTURE_REQ_START,
+  CAPTURE_REQ_STOP
+};
+
+static uint8_t* captureBuffer = NULL;  // Allocated on the first start
+static uint32_t captureHead = 0;       // Bytes ever written into the ring
+static uint32_t captureTail = 0;       // Bytes ever drained
+static portMUX_TYPE captureMux = portMUX_INITIALIZER_UNLOCKED;
+volatile bool captureActive = false;
+volatile CaptureRequest captureRequest = CAPTURE_REQ_NONE;
+uint32_t captureStartMs = 0;
+uint32_t captureBytes = 0;     // In CAPTURE_FILE
+uint32_t captureRecords = 0;
+uint32_t captureDropped = 0;   // Ring full - storageTask fell behind
+uint32_t captureDigest = TRACE_DIGEST_SEED;  // Rows of the frame in processFrame() (loop only)
+uint8_t captureRows = 0;
+
+static void captureCopyIn(const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    captureBuffer[(captureHead + i) % CAPTURE_BUFFER_SIZE] = p[i];
+  }
+  captureHead += len;
+}
+
+// Append one record (header, a, then b) to the ring; any task
+bool captureRecord(TraceRecordType type, uint32_t ms, const void* a, size_t aLen,
+                   const void* b = NULL, size_t bLen = 0) {
+  TraceRecordHeader h;
+  h.type = type;
+  h.len = aLen + bLen;
+  h.ms = ms;
+  bool stored = false;
+  portENTER_CRITICAL(&captureMux);
+  if (captureActive) {
+    if (CAPTURE_BUFFER_SIZE - (captureHead - captureTail) >= sizeof(h) + aLen + bLen) {
+      captureCopyIn(&h, sizeof(h));
+      captureCopyIn(a, aLen);
+      if (bLen) captureCopyIn(b, bLen);
+      captureRecords++;
+      stored = true;
+    } else {
+      captureDropped++;
+    }
+  }
+  portEXIT_CRITICAL(&captureMux);
+  return stored;
+}
+
+uint32_t captureMillis() {
+  return millis() - captureStartMs;
+}
+
+// Copy up to size bytes out of the ring
+static size_t captureCopyOut(uint8_t* data, size_t size) {
+  portENTER_CRITICAL(&captureMux);
+  size_t n = captureHead - captureTail;
+  if (n > size) n = size;
+  for (size_t i = 0; i < n; i++) {
+    data[i] = captureBuffer[(captureTail + i) % CAPTURE_BUFFER_SIZE];
+  }
+  captureTail += n;
+  portEXIT_CRITICAL(&captureMux);
+  return n;
+}
+
+static void startCapture() {
+  if (!captureBuffer) {
+    captureBuffer = (uint8_t*)malloc(CAPTURE_BUFFER_SIZE);
+    if (!captureBuffer) {
+      LOG_ERROR(LOG_STORAGE, "Capture: no memory for the buffer");
+      return;
+    }
+  }
+  std::unique_ptr<HalFile> file = hal.fs.open(CAPTURE_FILE, HAL_FILE_WRITE);
   if (!file) {
-    Serial.println("Failed to open history file for writing");
+    LOG_ERROR(LOG_STORAGE, "Capture: cannot create the file");
+    return;
+  }
+  TraceFileHeader header = {TRACE_MAGIC, TRACE_VERSION, {0, 0, 0}};
+  captureBytes = file->write((const char*)&header, sizeof(header));
+  
+  portENTER_CRITICAL(&captureMux);
+  captureHead = 0;
+  captureTail = 0;
+  captureRecords = 0;
+  captureDropped = 0;
+  captureStartMs = millis();
+  captureActive = true;
+  portEXIT_CRITICAL(&captureMux);
+  LOG_INFO(LOG_STORAGE, "Capture started");
+}
+
+static void drainCapture() {
+  uint8_t chunk[CAPTURE_CHUNK];
+  size_t n = captureCopyOut(chunk, sizeof(chunk));
+  if (n == 0) return;
+  std::unique_ptr<HalFile> file = hal.fs.open(CAPTURE_FILE, HAL_FILE_APPEND);
+  if (!file) return;
+  do {
+    captureBytes += file->write((const char*)chunk, n);
+  } while ((n = captureCopyOut(chunk, sizeof(chunk))) > 0);
+}
+
+// Start/stop requests from the web handlers and the drain (storageTask)
+void serviceCapture() {
+  CaptureRequest request = captureRequest;
+  captureRequest = CAPTURE_REQ_NONE;
+  if (request == CAPTURE_REQ_START && !captureActive) {
+    startCapture();
+  }
+  bool stop = captureActive &&
+              (request == CAPTURE_REQ_STOP || captureBytes + CAPTURE_BUFFER_SIZE >= CAPTURE_MAX_BYTES);
+  if (stop) {
+    portENTER_CRITICAL(&captureMux);
+    captureActive = false;
+    portEXIT_CRITICAL(&captureMux);
+  }
+  if (captureBuffer) {
+    drainCapture();
+  }
+  if (stop) {
+    LOG_INFO(LOG_STORAGE, "Capture stopped: %lu records, %lu bytes, %lu dropped",
+             (unsigned long)captureRecords, (unsigned long)captureBytes, (unsigned long)captureDropped);
+  }
+}
+
+#endif // PAW_STATION
+
+// -----------------------------------------------------------------------------
+// GPS reader (both roles)
+// -----------------------------------------------------------------------------
+
+// gpsTask owns GPSSerial and `gps`. The UART driver wakes it when a burst of
+// NMEA ends or its RX FIFO fills; the task reads everything buffered in one go,
+// feeds the parser and publishes the latest fix. Everything else reads gpsFix.
+const size_t GPS_RX_BUFFER_SIZE = 2048;     // UART driver buffer, > 1 s of NMEA
+const size_t GPS_READ_CHUNK = 256;
+const uint32_t GPS_TASK_STACK = 4096;
+const UBaseType_t GPS_TASK_PRIORITY = 3;    // Above loop(), below radioTask
+const uint32_t GPS_IDLE_POLL_MS = 1000;     // Read anyway if no UART event comes
+const uint32_t GPS_FIX_GRACE_MS = 1000;     // Fix counts as current up to one output period plus this
+
+Snapshot<GpsFix> gpsFix;
+
+struct GpsStats {
+  uint32_t chars = 0;
+  uint32_t sentences = 0;      // Passed checksum
+  uint32_t failedChecksum = 0;
+  uint32_t rxOverruns = 0;     // UART FIFO or driver buffer overflowed
+  float sentencesPerSecond = 0;
+  bool configured = false;     // Receiver output confirmed trimmed to RMC/GGA
+  uint8_t profile = GPS_PROFILE_MOVING;
+  uint32_t profileSwitches = 0;
+  uint32_t configFailures = 0; // Commands whose effect never showed in the stream
+} gpsStats;
+
+TaskHandle_t gpsTaskHandle = NULL;
+
+uint32_t gpsFixAgeMs(const GpsFix &fix) {
+  return millis() - fix.fixMillis;
+}
+
+bool gpsFixFresh(const GpsFix &fix) {
+  return fix.valid && gpsFixAgeMs(fix) <= fix.periodMs + GPS_FIX_GRACE_MS;
+}
+
+// Unix timestamp from GPS date/time, 0 if GPS time is not valid yet
+// Note: TinyGPS++ provides UTC time
+uint32_t gpsUnixTime() {
+  return gpsFixUnixTime(gpsFix.read(), millis());
+}
+
+// The driver buffer can only be sized before begin()
+void beginGpsSerial(uint32_t baud) {
+  GPSSerial.setRxBufferSize(GPS_RX_BUFFER_SIZE);
+  GPSSerial.begin(baud, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);
+}
+
+// Receiver configuration (Unicore UC6580 on the Wireless Tracker, see gps_config.h)
+// $CFGMSG,<class>,<id>,<period s> sets one sentence's output period, 0 = off.
+// Class 0 is standard NMEA, class 6 the receiver's $GxTXT notices.
+const uint8_t GPS_MSG_GGA = 0;
+const uint8_t GPS_MSG_RMC = 4;
+const uint8_t GPS_MSGS_OFF[] = {1, 2, 3, 5, 6, 7};  // GLL, GSA, GSV, VTG, ZDA, GST
+const uint32_t GPS_COMMAND_GAP_MS = 250;    // Receiver drops commands sent back to back
+const uint32_t GPS_CONFIG_FLUSH_MS = 1100;  // Sentences already queued in the receiver still carry the old set
+const uint32_t GPS_CONFIG_VERIFY_MS = 2500; // Stream watched after the boot config
+const uint8_t GPS_CONFIG_ATTEMPTS = 3;
+const uint32_t GPS_FAST_PROBE_MS = 1500;    // Fast boot: longest wait for a sentence at the cached baud
+const uint32_t GPS_FAST_PROBE_QUIET_MS = 50; // ...then until the burst ends
+volatile bool gpsConfigPending = false;     // gpsTask sends the boot config (serviceGpsConfig)
+uint8_t gpsRateCommandsLeft = 0;            // RMC/GGA period commands serviceGpsProfile still has to send (gpsTask)
+
+#if PAW_BEACON
+static bool writeGpsCommand(const char* body) {
+  char line[32];
+  size_t n = formatNmeaCommand(line, sizeof(line), body);
+  if (n == 0) return false;
+  hal.gnss.write((const uint8_t*)line, n);
+  return true;
+}
+
+static void sendGpsCommand(const char* body) {
+  if (writeGpsCommand(body)) {
+    delay(GPS_COMMAND_GAP_MS);
+  }
+}
+
+// Command i of the boot config, false past the last one: every sentence
+// TinyGPS++ does not use off, RMC/GGA at the moving profile's period
+static bool gpsConfigCommand(uint8_t i, char* body, size_t size) {
+  const uint8_t offCount = sizeof(GPS_MSGS_OFF);
+  if (i < offCount) {
+    snprintf(body, size, "CFGMSG,0,%u,0", GPS_MSGS_OFF[i]);
+  } else if (i < offCount + 2) {
+    snprintf(body, size, "CFGMSG,6,%u,0", (unsigned)(i - offCount));
+  } else if (i < offCount + 4) {
+    snprintf(body, size, "CFGMSG,0,%u,%u", i == offCount + 2 ? GPS_MSG_RMC : GPS_MSG_GGA,
+             GPS_PROFILES[GPS_PROFILE_MOVING].outputPeriodS);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// The stream shows the boot config took
+static bool gpsConfigSeen(const NmeaCensus& census) {
+  return census.count(NMEA_OTHER) == 0 && census.count(NMEA_RMC) > 0 && census.count(NMEA_GGA) > 0;
+}
+
+// Read the UART for ms, feeding the parser and, if given, the census
+static void pumpGpsSerial(uint32_t ms, NmeaCensus* census) {
+  uint32_t start = millis();
+  while (millis() - start < ms) {
+    while (GPSSerial.available() > 0) {
+      char c = GPSSerial.read();
+      gps.encode(c);
+      if (census) census->feed(c);
+    }
+    delay(10);
+  }
+}
+
+// Turn off every sentence TinyGPS++ does not use and set RMC/GGA to the moving
+// profile, then watch the stream until it shows both. Blocking: called from
+// setup before gpsTask owns the UART.
+bool configureGpsReceiver() {
+  NmeaCensus census;
+  char body[24];
+  
+  for (uint8_t attempt = 1; attempt <= GPS_CONFIG_ATTEMPTS; attempt++) {
+    for (uint8_t i = 0; gpsConfigCommand(i, body, sizeof(body)); i++) {
+      sendGpsCommand(body);
+    }
+    
+    pumpGpsSerial(GPS_CONFIG_FLUSH_MS, nullptr);
+    census.reset();
+    pumpGpsSerial(GPS_CONFIG_VERIFY_MS, &census);
+    
+    Serial.printf("GPS config attempt %u: %u RMC, %u GGA, %u other sentences\n", attempt,
+                  census.count(NMEA_RMC), census.count(NMEA_GGA), census.count(NMEA_OTHER));
+    if (gpsConfigSeen(census)) {
+      gpsStats.configured = true;
+      return true;
+    }
+  }
+  gpsStats.configFailures++;
+  return false;
+}
+
+// Motion profile (beacon), in uptimeMs() so it carries over deep sleep. Set
+// before startGpsTask(), then gpsTask's.
+MotionDetector gpsMotion;
+GpsMotionProfile gpsAppliedProfile = GPS_PROFILE_MOVING;
+
+// Beacon only: follow the motion profile, and check each rate change in the
+// stream. The RMC and GGA period commands go out one per wake,
+// GPS_COMMAND_GAP_MS apart, so gpsTask keeps draining the UART meanwhile. A
+// change counts once the RMC count over three periods is within a factor of
+// two of what the new period gives; otherwise it is resent.
+static void serviceGpsProfile(GpsFix &fix, NmeaCensus &census) {
+  MotionDetector &motion = gpsMotion;
+  GpsMotionProfile &applied = gpsAppliedProfile;
+  static bool verifying = false;
+  static uint8_t attempts = 0;
+  static uint32_t verifyStart = 0;
+  static uint32_t commandMs = 0;
+  static uint32_t lastFixCount = 0;
+  uint32_t now = millis();
+  
+  if (fix.fixCount != lastFixCount) {
+    lastFixCount = fix.fixCount;
+    motion.update(fix.speedKmph, uptimeMs());
+  }
+  
+  if (motion.current() != applied) {
+    uint32_t oldPeriodMs = GPS_PROFILES[applied].outputPeriodS * 1000;
+    applied = motion.current();
+    LOG_INFO(LOG_GPS, "GPS profile: %s", GPS_PROFILES[applied].name);
+    gpsStats.profile = applied;
+    gpsStats.profileSwitches++;
+    // Until the stream confirms it, the receiver may still use either period
+    fix.periodMs = max(oldPeriodMs, (uint32_t)GPS_PROFILES[applied].outputPeriodS * 1000);
+    gpsRateCommandsLeft = 2;
+    attempts = 1;
+    verifying = true;
+  }
+  
+  if (gpsRateCommandsLeft > 0) {
+    if (now - commandMs < GPS_COMMAND_GAP_MS) return;
+    char body[24];
+    snprintf(body, sizeof(body), "CFGMSG,0,%u,%u", gpsRateCommandsLeft == 2 ? GPS_MSG_RMC : GPS_MSG_GGA,
+             GPS_PROFILES[applied].outputPeriodS);
+    writeGpsCommand(body);
+    commandMs = now;
+    if (--gpsRateCommandsLeft == 0) {
+      census.reset();
+      verifyStart = now;
+    }
     return;
   }
   
-  // Write data (compact format with full precision for GPS coordinates)
-  file.print(timestamp);
-  file.print(",");
-  file.print(msg.beaconId);
-  file.print(",");
-  // Use single 0 for zero coordinates to save space
-  if (msg.latitude == 0.0) {
-    file.print("0");
+  uint32_t periodMs = GPS_PROFILES[applied].outputPeriodS * 1000;
+  if (!verifying || now - verifyStart < 3 * periodMs + 500) return;
+  
+  uint32_t expected = (now - verifyStart) / periodMs;
+  uint32_t rmc = census.count(NMEA_RMC);
+  if (rmc * 2 >= expected && rmc <= expected * 2) {
+    fix.periodMs = periodMs;
+    verifying = false;
+  } else if (attempts < GPS_CONFIG_ATTEMPTS) {
+    gpsRateCommandsLeft = 2;
+    attempts++;
   } else {
-    file.print(msg.latitude, 6);   // 6 decimal places for GPS (~11cm precision)
+    LOG_WARN(LOG_GPS, "GPS profile %s not confirmed (%u RMC)", GPS_PROFILES[applied].name, (unsigned)rmc);
+    gpsStats.configFailures++;
+    verifying = false;
   }
-  file.print(",");
-  if (msg.longitude == 0.0) {
-    file.print("0");
+}
+
+// Fast boot (beacon): the receiver came back with its default sentences, so
+// gpsTask sends the boot config instead of setup, one command per wake, and
+// the first frame does not wait for it. Checked against the stream as in
+// configureGpsReceiver().
+static void serviceGpsConfig(NmeaCensus &census) {
+  static uint8_t attempt = 0;
+  static uint8_t command = 0;
+  static bool sent = false;       // All commands of this attempt are out
+  static uint32_t stepMs = 0;
+  uint32_t now = millis();
+  char body[24];
+  
+  if (!sent) {
+    if (command > 0 && now - stepMs < GPS_COMMAND_GAP_MS) return;
+    if (gpsConfigCommand(command, body, sizeof(body))) {
+      writeGpsCommand(body);
+      command++;
+    } else {
+      sent = true;
+      attempt++;
+    }
+    stepMs = now;
+    return;
+  }
+  if (now - stepMs < GPS_CONFIG_FLUSH_MS) {
+    census.reset();
+    return;
+  }
+  if (now - stepMs < GPS_CONFIG_FLUSH_MS + GPS_CONFIG_VERIFY_MS) return;
+  
+  if (gpsConfigSeen(census)) {
+    gpsStats.configured = true;
+    gpsConfigPending = false;
+    LOG_INFO(LOG_GPS, "GPS configured in the background, attempt %u", attempt);
+  } else if (attempt < GPS_CONFIG_ATTEMPTS) {
+    command = 0;
+    sent = false;
   } else {
-    file.print(msg.longitude, 6);
+    gpsStats.configFailures++;
+    gpsConfigPending = false;
+    LOG_WARN(LOG_GPS, "GPS did not take the sentence config, parsing full output");
   }
+}
+#endif // PAW_BEACON
+
+// Called from the UART driver's event task
+static void onGpsRxError(hardwareSerial_error_t error) {
+  if (error == UART_FIFO_OVF_ERROR || error == UART_BUFFER_FULL_ERROR) {
+    gpsStats.rxOverruns++;
+  }
+}
+
+void gpsTask(void *param) {
+  uint8_t chunk[GPS_READ_CHUNK];
+  GpsFix fix;
+  NmeaCensus census;
+  uint32_t rateStart = millis();
+  uint32_t rateSentences = 0;
+#if PAW_BEACON
+  bool adaptiveRate = param != NULL;
+  if (adaptiveRate) {
+    fix.periodMs = GPS_PROFILES[gpsAppliedProfile].outputPeriodS * 1000;
+  }
+#else
+  (void)param;
+#endif
+  
+  for (;;) {
+    bool commandsPending = gpsConfigPending || gpsRateCommandsLeft > 0;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(commandsPending ? GPS_COMMAND_GAP_MS : GPS_IDLE_POLL_MS));
+    
+    size_t n;
+    bool burst = false;
+    {
+      PROFILE_ZONE(profileGpsDrain);
+      while ((n = hal.gnss.read(chunk, sizeof(chunk))) > 0) {
+        burst = true;
+#if PAW_STATION
+        if (captureActive) captureRecord(TRACE_NMEA, captureMillis(), chunk, n);
+#endif
+        for (size_t i = 0; i < n; i++) {
+          gps.encode((char)chunk[i]);
+          census.feed((char)chunk[i]);
+        }
+      }
+    }
+    bool changed = updateGpsFix(gps, fix, millis());
+    if (burst) {
+      fix.burstMillis = millis();
+      changed = true;
+    }
+#if PAW_BEACON
+    if (adaptiveRate) {
+      uint32_t periodMs = fix.periodMs;
+      if (gpsConfigPending) {
+        serviceGpsConfig(census);
+      } else {
+        serviceGpsProfile(fix, census);
+      }
+      changed |= fix.periodMs != periodMs;
+    }
+#endif
+    if (changed) {
+      gpsFix.publish(fix);
+    }
+    
+    gpsStats.chars = gps.charsProcessed();
+    gpsStats.sentences = gps.passedChecksum();
+    gpsStats.failedChecksum = gps.failedChecksum();
+    uint32_t now = millis();
+    if (now - rateStart >= 1000) {
+      gpsStats.sentencesPerSecond = (gpsStats.sentences - rateSentences) * 1000.0 / (now - rateStart);
+      rateSentences = gpsStats.sentences;
+      rateStart = now;
+    }
+  }
+}
+
+// Hand GPSSerial to gpsTask. Call once the UART runs at the GPS baud rate;
+// nothing else may read GPSSerial or `gps` after this. adaptiveRate switches
+// the output rate with the motion profile (beacon).
+void startGpsTask(bool adaptiveRate) {
+  xTaskCreatePinnedToCore(gpsTask, "gps", GPS_TASK_STACK, (void*)adaptiveRate,
+                          GPS_TASK_PRIORITY, &gpsTaskHandle, APP_CORE);
+  GPSSerial.onReceiveError(onGpsRxError);
+  GPSSerial.onReceive([]() {
+    if (gpsTaskHandle) xTaskNotifyGive(gpsTaskHandle);
+  });
+}
+
+// -----------------------------------------------------------------------------
+// Logging (both roles)
+// -----------------------------------------------------------------------------
+
+// Hot paths log with LOG_* (log_ring.h): a fixed-size record into logRing,
+// no formatting and no Serial. logTask formats and drains the ring to Serial
+// at low priority, so a burst of frames never waits on the USB port, and
+// /api/logs serves the same ring.
+const uint32_t LOG_RING_RECORDS = 128;     // 64 bytes each
+const uint32_t LOG_DRAIN_MS = 50;
+const uint32_t LOG_TASK_STACK = 3072;
+const UBaseType_t LOG_TASK_PRIORITY = 1;
+const uint32_t LOG_API_MAX_RECORDS = 64;   // Per /api/logs response
+const uint32_t LOG_FLUSH_TIMEOUT_MS = 200;
+
+static LogRing<LOG_RING_RECORDS> logRing;
+static portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t logDrainedSeq = 0;  // Last record written to Serial
+TaskHandle_t logTaskHandle = NULL;
+
+uint32_t logMillis() {
+  return millis();
+}
+
+void logCommit(LogRecord& r) {
+  portENTER_CRITICAL(&logMux);
+  logRing.append(r);
+  portEXIT_CRITICAL(&logMux);
+}
+
+// Copy record seq out of the ring. Returns false if it is not there; oldest
+// is then the first seq that still is.
+static bool readLogRecord(uint32_t seq, LogRecord& r, uint32_t& oldest) {
+  portENTER_CRITICAL(&logMux);
+  bool found = logRing.get(seq, r);
+  oldest = logRing.oldest();
+  portEXIT_CRITICAL(&logMux);
+  return found;
+}
+
+static void logBounds(uint32_t& oldest, uint32_t& last) {
+  portENTER_CRITICAL(&logMux);
+  oldest = logRing.oldest();
+  last = logRing.last();
+  portEXIT_CRITICAL(&logMux);
+}
+
+static void drainLog() {
+  char message[160];
+  LogRecord r;
+  uint32_t oldest;
+  for (;;) {
+    uint32_t seq = logDrainedSeq + 1;
+    if (!readLogRecord(seq, r, oldest)) {
+      if (seq >= oldest) return; // Caught up
+      Serial.printf("[log] %lu records overwritten before output\n", (unsigned long)(oldest - seq));
+      logDrainedSeq = oldest - 1;
+      continue;
+    }
+    formatLogRecord(r, message, sizeof(message));
+    Serial.printf("[%lu %c %s] %s\n", (unsigned long)r.timeMs, logLevelChar(r.level),
+                  logModuleName(r.module), message);
+    logDrainedSeq = seq;
+  }
+}
+
+void logTask(void *param) {
+  for (;;) {
+    drainLog();
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+  }
+}
+
+// Wait (up to timeoutMs) until logTask has written everything logged so far,
+// e.g. before deep sleep drops whatever is still in RAM
+void flushLog(uint32_t timeoutMs) {
+  uint32_t oldest, target;
+  logBounds(oldest, target);
+  uint32_t start = millis();
+  while (logDrainedSeq < target && millis() - start < timeoutMs) {
+    delay(5);
+  }
+  Serial.flush();
+}
+
+void startLogTask() {
+  xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK, NULL,
+                          LOG_TASK_PRIORITY, &logTaskHandle, PROTOCOL_CORE);
+}
+
+// JSON string body: quotes, backslashes and control characters escaped
+static String jsonEscape(const char* s) {
+  String out;
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      out += '\\';
+      out += *s;
+    } else if ((uint8_t)*s < 0x20) {
+      out += ' ';
+    } else {
+      out += *s;
+    }
+  }
+  return out;
+}
+
+// Records after `since` for /api/logs, at most LOG_API_MAX_RECORDS. `next` is
+// the since for the following request; a gap in seq means records were
+// overwritten in between.
+String logsJson(uint32_t since) {
+  char message[160];
+  LogRecord r;
+  uint32_t oldest, last;
+  logBounds(oldest, last);
+  if (since > last) since = 0; // Station rebooted since the client's last request
+  uint32_t seq = max(since + 1, oldest);
+  
+  String json = "{\"records\":[";
+  uint32_t sent = 0;
+  uint32_t next = since;
+  for (; seq <= last && sent < LOG_API_MAX_RECORDS; seq++) {
+    if (!readLogRecord(seq, r, oldest)) continue; // Overwritten meanwhile
+    formatLogRecord(r, message, sizeof(message));
+    if (sent++) json += ",";
+    json += "{\"seq\":" + String(r.seq) + ",";
+    json += "\"ms\":" + String(r.timeMs) + ",";
+    json += "\"level\":\"" + String(logLevelChar(r.level)) + "\",";
+    json += "\"module\":\"" + String(logModuleName(r.module)) + "\",";
+    json += "\"msg\":\"" + jsonEscape(message) + "\"}";
+    next = seq;
+  }
+  json += "],";
+  json += "\"next\":" + String(next) + ",";
+  json += "\"last\":" + String(last) + ",";
+  json += "\"level\":" + String(PAW_LOG_LEVEL);
+  json += "}";
+  return json;
+}
+
+// -----------------------------------------------------------------------------
+// Battery monitor (both roles)
+// -----------------------------------------------------------------------------
+
+// batteryTask owns the ADC and the divider switch. Every BATTERY_SAMPLE_MS it
+// takes an oversampled, eFuse-calibrated reading, runs it through the filter
+// and publishes the result; everyone else reads the cached `battery` snapshot.
+const uint32_t BATTERY_SAMPLE_MS = 5000;
+const uint8_t BATTERY_OVERSAMPLE = 16;
+const uint32_t BATTERY_DIVIDER_SETTLE_MS = 10;  // After ADC_CTRL goes high
+const uint32_t BATTERY_TASK_STACK = 3072;
+const UBaseType_t BATTERY_TASK_PRIORITY = 1;
+
+struct BatteryReading {
+  float volts = 0;            // Filtered
+  uint8_t socPercent = 0;     // From the LiPo curve in power_model.h
+  float mvPerHour = 0;        // Discharge rate, negative while charging
+  bool rateValid = false;     // Needs 10 minutes of samples
+  uint32_t samples = 0;
+  uint32_t sampleMillis = 0;
+};
+
+Snapshot<BatteryReading> battery;
+RTC_DATA_ATTR BatteryFilter batteryFilter;  // Keeps the discharge rate across deep sleep
+TaskHandle_t batteryTaskHandle = NULL;
+static esp_adc_cal_characteristics_t batteryAdcChars;
+
+// Latest filtered battery voltage; never touches the ADC
+float batteryVoltage() {
+  return battery.read().volts;
+}
+
+static float sampleBatteryVolts() {
+  digitalWrite(ADC_CTRL, HIGH);
+  vTaskDelay(pdMS_TO_TICKS(BATTERY_DIVIDER_SETTLE_MS));
+  
+  uint32_t raw = 0;
+  for (uint8_t i = 0; i < BATTERY_OVERSAMPLE; i++) {
+    raw += analogRead(BATTERY_PIN);
+  }
+  
+  // Disable the divider to save power
+  digitalWrite(ADC_CTRL, LOW);
+  
+  uint32_t pinMv = esp_adc_cal_raw_to_voltage(raw / BATTERY_OVERSAMPLE, &batteryAdcChars);
+  return pinMv / 1000.0f * ADC_MULTIPLIER;
+}
+
+static void publishBattery() {
+  BatteryReading reading;
+  reading.volts = batteryFilter.volts;
+  reading.socPercent = (uint8_t)lroundf(lipoChargeFraction(batteryFilter.volts) * 100.0f);
+  reading.mvPerHour = batteryFilter.mvPerHour;
+  reading.rateValid = batteryFilter.rateValid;
+  reading.samples = batteryFilter.samples;
+  reading.sampleMillis = millis();
+  battery.publish(reading);
+}
+
+static void updateBattery() {
+  batteryFilter.add(sampleBatteryVolts(), uptimeMs());
+  publishBattery();
+}
+
+void batteryTask(void *param) {
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(BATTERY_SAMPLE_MS));
+    updateBattery();
+  }
+}
+
+// Calibrate the ADC and start sampling. A deep-sleep wake reuses the filtered
+// value from RTC memory; otherwise one sample is taken here so the first
+// reading is never empty.
+void startBatteryMonitor(bool resuming) {
+  pinMode(ADC_CTRL, OUTPUT);
+  digitalWrite(ADC_CTRL, LOW);
+  analogSetPinAttenuation(BATTERY_PIN, ADC_11db);
+  esp_adc_cal_value_t source = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12,
+                                                        1100, &batteryAdcChars);
+  if (!resuming) {
+    Serial.print("Battery ADC calibration: ");
+    Serial.println(source == ESP_ADC_CAL_VAL_EFUSE_TP ? "eFuse two-point" :
+                   source == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse Vref" : "default Vref");
+  }
+  
+  batteryFilter.begin(resuming);
+  if (batteryFilter.samples == 0) {
+    updateBattery();
+  } else {
+    publishBattery();
+  }
+  xTaskCreatePinnedToCore(batteryTask, "battery", BATTERY_TASK_STACK, NULL,
+                          BATTERY_TASK_PRIORITY, &batteryTaskHandle, APP_CORE);
+}
+
+#if PAW_STATION
+// -----------------------------------------------------------------------------
+// Statistics Tracking
+// -----------------------------------------------------------------------------
+
+const char* STATS_FILE = "/stats.csv";
+const uint32_t STATS_LOG_INTERVAL = 5000; // TODO: Change to 60000 (1 minute) after testing
+const uint32_t MAX_STATS_FILE_SIZE = 1024; // Keep file under 1KB
+uint32_t lastStatsLog = 0;   // storageTask only, once initStats() has run
+uint32_t bootTime = 0;
+uint32_t rebootCount = 0;
+
+struct StatsEntry {
+  uint32_t timestamp;
+  uint32_t stationUptime;
+  float stationBattery;
+  uint32_t beaconUptime;
+  float beaconBattery;
+};
+
+// Log statistics to file
+void logStats() {
+  StationSnapshot snap = stationSnapshot.read();
+  
+  // Only log if we have valid GPS time
+  if (snap.gpsTime == 0) {
+    LOG_DEBUG(LOG_STORAGE, "Skipping stats log - no GPS time available");
+    return;
+  }
+  
+  uint32_t now = millis();
+  uint32_t stationUptime = (now - bootTime) / 1000; // uptime in seconds
+  float stationBattery = snap.stationBattery;
+  
+  // Calculate beacon uptime (time since last seen, or 0 if never seen)
+  uint32_t beaconUptime = 0;
+  float beaconBattery = 0.0;
+  if (snap.primary.hasData) {
+    beaconUptime = (now - snap.primary.lastUpdate) / 1000; // seconds since last beacon
+    beaconBattery = snap.primary.batteryVoltage;
+  }
+  
+  time_t timestamp = snap.gpsTime;
+  
+  // Check current file size before writing
+  File file = LittleFS.open(STATS_FILE, FILE_READ);
+  size_t currentSize = 0;
+  if (file) {
+    currentSize = file.size();
+    file.close();
+  }
+  
+  // If file is too large, rotate (remove oldest entries)
+  if (currentSize >= MAX_STATS_FILE_SIZE) {
+    file = LittleFS.open(STATS_FILE, FILE_READ);
+    if (file) {
+      String header = file.readStringUntil('\n');
+      
+      // Calculate how many bytes to skip (delete oldest 25%)
+      size_t bytesToSkip = currentSize / 4;
+      size_t bytesSkipped = 0;
+      
+      // Skip old data by reading and discarding lines
+      while (file.available() && bytesSkipped < bytesToSkip) {
+        String line = file.readStringUntil('\n');
+        bytesSkipped += line.length() + 1; // +1 for newline
+      }
+      
+      // Read remaining data to keep
+      String keepData = "";
+      while (file.available()) {
+        keepData += file.readStringUntil('\n') + "\n";
+      }
+      file.close();
+      
+      // Rewrite file with header and kept data
+      file = LittleFS.open(STATS_FILE, FILE_WRITE);
+      if (file) {
+        file.println(header);
+        file.print(keepData);
+        file.close();
+        Serial.println("Stats file rotated (FIFO)");
+      }
+    }
+  }
+  
+  // Check if file exists, create with header if not
+  if (!LittleFS.exists(STATS_FILE)) {
+    file = LittleFS.open(STATS_FILE, FILE_WRITE);
+    if (file) {
+      file.println("T,SUT,SB,BUT,BB");
+      file.close();
+    }
+  }
+  
+  // Open file in append mode
+  file = LittleFS.open(STATS_FILE, FILE_APPEND);
+  if (!file) {
+    Serial.println("Failed to open stats file for writing");
+    return;
+  }
+  
+  // Write data (compact format)
+  file.print(timestamp);
   file.print(",");
-  file.print(msg.speed, 1);
-  file.print(",");
-  file.print(msg.altitude, 1);
+  file.print(stationUptime);
   file.print(",");
-  file.print(msg.batteryVoltage, 2);
+  file.print(stationBattery, 2);
   file.print(",");
-  file.print(rssi, 1);
+  file.print(beaconUptime);
   file.print(",");
-  file.println(snr, 1);
+  file.println(beaconBattery, 2);
   
   file.close();
+}
+
+// Initialize stats tracking
+void initStats() {
+  bootTime = millis();
+  
+  // Load reboot count from preferences
+  preferences.begin("pawtracker", false);
+  rebootCount = preferences.getUInt("rebootCount", 0);
+  rebootCount++;
+  preferences.putUInt("rebootCount", rebootCount);
+  preferences.end();
+  
+  Serial.print("Boot #");
+  Serial.println(rebootCount);
   
-  // Serial.println("Beacon position logged to history");
+  // Log initial entry
+  lastStatsLog = millis();
+  logStats();
 }
 
+// -----------------------------------------------------------------------------
+// History Tracking
+// -----------------------------------------------------------------------------
+
+// history.csv itself is written by history_store.h
+const uint32_t HISTORY_RETENTION_DAYS = 30; // Keep 30 days of history
+
+struct HistoryEntry {
+  uint32_t timestamp;    // Unix timestamp from GPS
+  float latitude;
+  float longitude;
+  float speed;           // km/h
+  float altitude;        // meters
+  float battery;         // beacon battery voltage
+  float rssi;            // signal strength
+  float snr;             // signal quality
+};
+
+// History rows (HistoryRecord, station_core.h) are queued by loop() and
+// written by storageTask. Live fixes are appended; fixes recovered through
+// store-and-forward are merged in batches since they land before records that
+// are already on flash. The web server queues its clear requests the same
+// way, so only storageTask touches these files.
+enum StorageJobType : uint8_t {
+  STORE_HISTORY,       // Live fix, appended to the history file
+  STORE_BACKFILL,      // Backfilled fix, merged in timestamp order
+  STORE_CLEAR_HISTORY, // Delete the history file (no record)
+  STORE_CLEAR_STATS    // Delete the stats log and start it again (no record)
+};
+
+struct StorageJob {
+  StorageJobType type;
+  HistoryRecord record;
+};
+
+const UBaseType_t STORAGE_QUEUE_DEPTH = 32;
+QueueHandle_t storageQueue = NULL;
+uint32_t storageJobsDropped = 0;  // Queue full - storageTask fell behind
+uint32_t storageQueuePeak = 0;
+
+// Hand a record to storageTask; never blocks the caller. False if the queue
+// was full and the record dropped.
+bool queueStorageJob(StorageJobType type, const HistoryRecord &record) {
+  if (captureActive) {
+    captureDigest = traceDigestRecord(captureDigest, record);
+    captureRows++;
+  }
+  StorageJob job;
+  job.type = type;
+  job.record = record;
+  if (xQueueSend(storageQueue, &job, 0) != pdTRUE) {
+    storageJobsDropped++;
+    return false;
+  }
+  uint32_t depth = uxQueueMessagesWaiting(storageQueue);
+  if (depth > storageQueuePeak) storageQueuePeak = depth;
+  return true;
+}
+
+// Clear request from the web server; false if the queue is full
+bool queueStorageClear(StorageJobType type) {
+  StorageJob job = {};
+  job.type = type;
+  return xQueueSend(storageQueue, &job, 0) == pdTRUE;
+}
+
+// Append a beacon position to the history file (storageTask)
+void appendHistory(const HistoryRecord &r) {
+  metricHistoryBytes.inc(appendHistoryRecord(hal.fs, r));
+}
+
+std::vector<HistoryRecord> pendingBackfill;  // storageTask only
+uint32_t lastBackfillRx = 0;
+
+// Rewrite the history file with pending backfill inserted in timestamp order
+void mergeBackfillIntoHistory() {
+  if (pendingBackfill.empty()) {
+    return;
+  }
+  size_t merged;
+  metricHistoryBytes.inc(mergeHistoryRecords(hal.fs, pendingBackfill, merged));
+  LOG_INFO(LOG_STORAGE, "Merged %u backfilled fixes into history", (unsigned)merged);
+}
+
+// What GET /api/stats shows of the data files. storageTask, which owns the
+// files, scans them and publishes this, so the web server never reads a file
+// while it is being rotated or rewritten.
+const uint8_t STATS_HISTORY_POINTS = 100;              // History tail for the battery chart
+const uint32_t STORAGE_SUMMARY_INTERVAL_MS = 5000;     // Shortest time between rescans
+const uint32_t STORAGE_SUMMARY_IDLE_MS = 60000;        // No rescans once nobody has asked for this long
+
+struct StorageSummary {
+  uint32_t statsFileSize;
+  uint32_t historyFileSize;
+  uint32_t configFileSize;
+  // Aggregates of the stats log
+  float stationAvgBattery, stationMinBattery, stationMaxBattery;
+  float beaconAvgBattery, beaconMinBattery, beaconMaxBattery;
+  uint32_t totalUptime;
+  uint32_t dataPoints;
+  // Newest history rows, oldest first
+  uint8_t historyCount;
+  StatsHistoryPoint history[STATS_HISTORY_POINTS];
+};
+
+Snapshot<StorageSummary> storageSummary;
+volatile uint32_t storageSummaryWantedAt = 0;  // millis() of the last GET /api/stats
+bool storageSummaryDirty = true;               // storageTask only: a file changed since the last scan
+
+static uint32_t storageFileSize(const char* path) {
+  std::unique_ptr<HalFile> file = hal.fs.open(path, HAL_FILE_READ);
+  return file ? file->size() : 0;
+}
+
+// Rows: timestamp,stationUptime,stationBattery,beaconUptime,beaconBattery
+static void scanStatsFile(StorageSummary& summary) {
+  summary.stationMinBattery = summary.beaconMinBattery = 5.0f;
+  std::unique_ptr<HalFile> file = hal.fs.open(STATS_FILE, HAL_FILE_READ);
+  char line[64];
+  if (!file || file->readLine(line, sizeof(line)) < 0) return;  // Header
+  while (file->readLine(line, sizeof(line)) >= 0) {
+    unsigned long timestamp, stationUptime, beaconUptime;
+    float stationBattery, beaconBattery;
+    if (sscanf(line, "%lu,%lu,%f,%lu,%f", &timestamp, &stationUptime, &stationBattery,
+               &beaconUptime, &beaconBattery) != 5) {
+      continue;
+    }
+    summary.totalUptime = max(summary.totalUptime, (uint32_t)stationUptime);
+    summary.stationAvgBattery += stationBattery;
+    summary.beaconAvgBattery += beaconBattery;
+    summary.stationMinBattery = min(summary.stationMinBattery, stationBattery);
+    summary.stationMaxBattery = max(summary.stationMaxBattery, stationBattery);
+    if (beaconBattery > 0) {
+      summary.beaconMinBattery = min(summary.beaconMinBattery, beaconBattery);
+      summary.beaconMaxBattery = max(summary.beaconMaxBattery, beaconBattery);
+    }
+    summary.dataPoints++;
+  }
+  if (summary.dataPoints > 0) {
+    summary.stationAvgBattery /= summary.dataPoints;
+    summary.beaconAvgBattery /= summary.dataPoints;
+  }
+}
+
+// The last STATS_HISTORY_POINTS rows: summary.history is filled as a ring,
+// then rotated so the oldest comes first
+static void scanHistoryTail(StorageSummary& summary) {
+  std::unique_ptr<HalFile> file = hal.fs.open(HISTORY_FILE, HAL_FILE_READ);
+  char line[HISTORY_LINE_MAX];
+  if (!file || file->readLine(line, sizeof(line)) < 0) return;  // Header
+  uint32_t rows = 0;
+  while (file->readLine(line, sizeof(line)) >= 0) {
+    if (parseStatsHistoryPoint(line, summary.history[rows % STATS_HISTORY_POINTS])) rows++;
+  }
+  if (rows > STATS_HISTORY_POINTS) {
+    StatsHistoryPoint* history = summary.history;
+    std::rotate(history, history + rows % STATS_HISTORY_POINTS, history + STATS_HISTORY_POINTS);
+  }
+  summary.historyCount = min(rows, (uint32_t)STATS_HISTORY_POINTS);
+}
+
+// Rescan the files and publish (storageTask)
+void publishStorageSummary() {
+  std::unique_ptr<StorageSummary> summary(new StorageSummary());
+  summary->statsFileSize = storageFileSize(STATS_FILE);
+  summary->historyFileSize = storageFileSize(HISTORY_FILE);
+  summary->configFileSize = storageFileSize(BEACON_CONFIG_FILE);
+  scanStatsFile(*summary);
+  scanHistoryTail(*summary);
+  storageSummary.publish(*summary);
+  storageSummaryDirty = false;
+}
+
+#endif // PAW_STATION
+
 // -----------------------------------------------------------------------------
 // Utility
 // -----------------------------------------------------------------------------
 
-float readBatteryVoltage() {
-  // Enable ADC voltage divider
-  pinMode(ADC_CTRL, OUTPUT);
-  digitalWrite(ADC_CTRL, HIGH);
-  delay(10);
-  
-  // Read voltage
-  int rawValue = analogRead(BATTERY_PIN);
-  float voltage = (rawValue / 4095.0) * 3.3 * ADC_MULTIPLIER;
-  
-  // Disable ADC to save power
-  digitalWrite(ADC_CTRL, LOW);
-  
-  return voltage;
+// Airtime we allow ourselves per window in a sub-band
+uint32_t airtimeBudgetUs(uint8_t subBand) {
+  return dutyCycleBudgetUs(LORA_REGION.subBands[subBand].dutyCyclePermille, AIRTIME_BUDGET_PERCENT);
+}
+
+// Shortest average spacing between frames of this size that stays in budget
+uint32_t minTxIntervalMs(size_t len) {
+  if (TX_SUB_BAND < 0) return 0;
+  uint32_t permille = LORA_REGION.subBands[TX_SUB_BAND].dutyCyclePermille;
+  return (uint64_t)loraTimeOnAirUs(LORA_MODULATION, len) * 100 / (permille * AIRTIME_BUDGET_PERCENT);
 }
 
 static void initLoRa() {
@@ -599,27 +2003,37 @@ static void initLoRa() {
   }
   
   // Configure LoRa settings
-  state = radio.setSpreadingFactor(7);
-  Serial.print("  SF7: "); Serial.println(state);
+  state = radio.setSpreadingFactor(LORA_MODULATION.spreadingFactor);
+  Serial.print("  SF: "); Serial.println(state);
   
-  state = radio.setBandwidth(125.0);
-  Serial.print("  BW125: "); Serial.println(state);
+  state = radio.setBandwidth(LORA_MODULATION.bandwidthKHz);
+  Serial.print("  BW: "); Serial.println(state);
   
-  state = radio.setCodingRate(5);
-  Serial.print("  CR5: "); Serial.println(state);
+  state = radio.setCodingRate(LORA_MODULATION.codingRate);
+  Serial.print("  CR: "); Serial.println(state);
   
-  state = radio.setSyncWord(0x12);
+  state = radio.setSyncWord(LORA_SYNC_WORD);
   Serial.print("  SyncWord: "); Serial.println(state);
   
-  state = radio.setOutputPower(22);
+  state = radio.setOutputPower(LORA_TX_POWER_DBM);
   Serial.print("  Power: "); Serial.println(state);
   
   // Set preamble length for better detection
-  state = radio.setPreambleLength(8);
+  state = radio.setPreambleLength(LORA_MODULATION.preambleLength);
   Serial.print("  Preamble: "); Serial.println(state);
   
   Serial.println("LoRa configuration complete");
   
+  if (TX_SUB_BAND < 0) {
+    Serial.printf("WARNING: %.1f MHz is outside the %s sub-bands, no duty-cycle accounting\n",
+                  LORA_FREQUENCY, LORA_REGION.name);
+  } else {
+    Serial.printf("Region %s, sub-band %s, duty cycle %.1f%%, frame every %lu ms max\n",
+                  LORA_REGION.name, LORA_REGION.subBands[TX_SUB_BAND].name,
+                  LORA_REGION.subBands[TX_SUB_BAND].dutyCyclePermille / 10.0,
+                  (unsigned long)minTxIntervalMs(sizeof(BeaconMessage)));
+  }
+  
   // Set up interrupt for packet reception
   radio.setDio1Action(setFlag);
   
@@ -629,13 +2043,74 @@ static void initLoRa() {
   Serial.println(state);
 }
 
-static void initDisplay(const String &title) {
+const int LORA_ERR_DUTY_CYCLE = -1100; // loraTransmit: not sent, airtime budget used up
+
+// Shared transmit for both roles, with CAD listen-before-talk. While the channel
+// is busy, back off for a random time in a window that doubles every attempt
+// (capped by the region). canDefer=false is for frames bound to a time slot:
+// a single CAD, no backoff. Returns RADIOLIB_LORA_DETECTED if the frame was
+// not sent because the channel stayed busy, LORA_ERR_DUTY_CYCLE if the frame
+// would exceed the sub-band's airtime budget.
+int loraTransmit(uint8_t *data, size_t len, bool canDefer = true) {
+  uint32_t airUs = loraTimeOnAirUs(LORA_MODULATION, len);
+  if (TX_SUB_BAND >= 0 &&
+      !airtimeLedgers[TX_SUB_BAND].allows(millis(), airUs, airtimeBudgetUs(TX_SUB_BAND))) {
+    airtimeDeferred++;
+    LOG_WARN(LOG_RADIO, "Airtime budget used up, frame deferred");
+    return LORA_ERR_DUTY_CYCLE;
+  }
+  
+  uint8_t maxAttempts = canDefer ? LORA_REGION.cadMaxAttempts : 1;
+  bool busy = true;
+  
+  for (uint8_t attempt = 0; attempt < maxAttempts; attempt++) {
+    int cad = radio.scanChannel();
+    lbtStats.cadChecks++;
+    if (cad != RADIOLIB_LORA_DETECTED) {
+      busy = false; // Free, or CAD failed - never block the radio on a CAD error
+      break;
+    }
+    lbtStats.cadBusy++;
+    
+    if (attempt + 1 < maxAttempts) {
+      uint32_t window = min((uint32_t)LORA_REGION.backoffBaseMs << attempt, (uint32_t)LORA_REGION.backoffMaxMs);
+      uint32_t backoff = random(1, window + 1);
+      lbtStats.backoffMs += backoff;
+      delay(backoff);
+    }
+  }
+  
+  int state;
+  if (busy && (LORA_REGION.dropWhenBusy || !canDefer)) {
+    lbtStats.dropped++;
+    LOG_WARN(LOG_RADIO, "Channel busy, frame not sent");
+    state = RADIOLIB_LORA_DETECTED;
+  } else {
+    if (busy) lbtStats.sentBusy++;
+    state = radio.transmit(data, len);
+    if (state == RADIOLIB_ERR_NONE && TX_SUB_BAND >= 0) {
+      airtimeLedgers[TX_SUB_BAND].record(millis(), airUs);
+    }
+  }
+  
+  // CadDone and TxDone also fire DIO1 - drop them so they are not read as packets
+  receivedFlag = false;
+  if (radioTaskHandle) {
+    ulTaskNotifyTake(pdTRUE, 0);
+  }
+  return state;
+}
+
+const uint32_t VEXT_SETTLE_MS = 500;       // Display and GPS supply
+const uint32_t VEXT_FAST_SETTLE_MS = 120;  // Fast boot: the ST7735's power-on reset time
+
+static void initDisplay(const String &title, uint32_t settleMs = VEXT_SETTLE_MS) {
   Serial.println("Initializing display...");
   
   // Enable power to display and GPS (CRITICAL for GPS to work!)
   pinMode(VEXT_ENABLE, OUTPUT);
   digitalWrite(VEXT_ENABLE, HIGH);
-  delay(500);  // Longer delay for power stabilization
+  delay(settleMs);  // Power stabilization
   Serial.println("VEXT power ON");
   
   // TFT uses its own pins - don't initialize SPI here
@@ -687,21 +2162,253 @@ static void setActuators(bool ledOn, bool buzzerOn) {
 }
 
 
+#if PAW_BEACON
 // -----------------------------------------------------------------------------
 // PupBeacon behavior (dog-worn unit)
 // -----------------------------------------------------------------------------
 
+// Fixes not yet acknowledged by the station (RTC memory, survives deep sleep)
+RTC_DATA_ATTR FixBacklog fixBacklog;
+
+static char myBeaconId[9];          // ESP32 chip ID in hex
+static uint32_t lastRxTime = 0;     // Last frame received from the station
+static uint8_t lastControlCmd = 0;  // Track last control command received
+static bool stationIdle = false;    // Last reply said no control is pending for us
+static bool beaconDisplayReady = false; // Left dark after a deep-sleep wake
+static bool beaconLabelsDrawn = false;
+
+// -----------------------------------------------------------------------------
+// Beacon sleep (see "Power management")
+
+static uint32_t awakeSinceMs = 0;   // Start of the awake time not booked yet
+static bool radioSleeping = false;
+
+static int64_t systemTimeUs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void bookAwake() {
+  uint32_t now = millis();
+  batteryModel.add(POWER_AWAKE, now - awakeSinceMs);
+  awakeSinceMs = now;
+}
+
+// Light-sleep for up to ms; millis() keeps counting through it. With
+// wakeOnRadio, DIO1 (RxDone or Timeout) ends it early.
+static void beaconLightSleep(uint32_t ms, bool wakeOnRadio) {
+  bookAwake();
+  esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000ULL);
+  if (wakeOnRadio) {
+    gpio_wakeup_enable((gpio_num_t)LORA_DIO1, GPIO_INTR_HIGH_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+  }
+  
+  uint32_t start = millis();
+  esp_light_sleep_start();
+  uint32_t slept = millis() - start;
+  
+  if (wakeOnRadio) {
+    // The wakeup took over the pin's interrupt type; give DIO1 its edge back
+    gpio_wakeup_disable((gpio_num_t)LORA_DIO1);
+    gpio_set_intr_type((gpio_num_t)LORA_DIO1, GPIO_INTR_POSEDGE);
+    if (digitalRead(LORA_DIO1) == HIGH) {
+      receivedFlag = true;  // The edge came while asleep
+    }
+  }
+  batteryModel.add(POWER_LIGHT_SLEEP, slept);
+  sleepState.cycleSleptMs += slept;
+  awakeSinceMs = millis();
+}
+
+// ms until the beacon has to be awake for the next NMEA burst, 0 if it is due
+// now, UINT32_MAX if the GPS has not sent anything yet
+static uint32_t msUntilGpsBurst(uint32_t now) {
+  GpsFix fix;
+  gpsFix.read(fix);
+  if (fix.burstMillis == 0) return UINT32_MAX;
+  
+  uint32_t nextBurst = fix.burstMillis + fix.periodMs;
+  int32_t late = (int32_t)(now - (nextBurst + GPS_BURST_GRACE_MS));
+  if (late > 0) {
+    nextBurst += (late / fix.periodMs + 1) * fix.periodMs; // Missed ones: keep the phase
+  }
+  int32_t ms = (int32_t)(nextBurst - GPS_WAKE_LEAD_MS - now);
+  return ms > 0 ? ms : 0;
+}
+
+// Wait for deadline (millis) or, with wakeOnRadio, DIO1 - asleep where
+// possible, but awake for every NMEA burst since the UART receives nothing
+// while the CPU sleeps. Returns early; the caller re-checks its condition.
+static void beaconWait(uint32_t deadline, bool wakeOnRadio) {
+  if (wakeOnRadio && receivedFlag) return;
+  uint32_t now = millis();
+  int32_t ms = (int32_t)(deadline - now);
+  if (ms <= 0) return;
+  
+  uint32_t toBurst = msUntilGpsBurst(now);
+  if (toBurst < (uint32_t)ms) ms = toBurst;
+  if (!PAW_BEACON_SLEEP || ms < (int32_t)LIGHT_SLEEP_MIN_MS) {
+    delay(wakeOnRadio ? 1 : min(max(ms, (int32_t)1), (int32_t)100));
+    return;
+  }
+  beaconLightSleep(ms, wakeOnRadio);
+}
+
+// Lying still with nothing pending either way. While the station answers, it
+// must also have said it is idle and have every fix, so backfill is not held up.
+static bool beaconCanDeepSleep() {
+  if (!PAW_BEACON_SLEEP) return false;
+  if (gpsStats.profile != GPS_PROFILE_STATIONARY) return false;
+  if (currentLedState || currentBuzzerState) return false;
+  bool inRange = lastRxTime != 0 && millis() - lastRxTime <= BACKFILL_LINK_TIMEOUT_MS;
+  return !inRange || (stationIdle && fixBacklog.missedCount() == 0);
+}
+
+// Deep sleep until the next stationary-interval frame after cycleStart
+// (millis), ending just before a GPS burst so the first fix after boot is
+// fresh. Does not return: the beacon boots again through setup().
+static void beaconDeepSleep(uint32_t cycleStart) {
+  uint32_t target = cycleStart + BEACON_STATIONARY_INTERVAL_MS;
+  GpsFix fix;
+  gpsFix.read(fix);
+  if (fix.burstMillis != 0 && (int32_t)(target - fix.burstMillis) > 0) {
+    uint32_t periods = (target - fix.burstMillis + fix.periodMs - 1) / fix.periodMs;
+    target = fix.burstMillis + periods * fix.periodMs;
+  }
+  int32_t ms = (int32_t)(target - DEEP_SLEEP_WAKE_LEAD_MS - millis());
+  if (ms < (int32_t)LIGHT_SLEEP_MIN_MS) ms = LIGHT_SLEEP_MIN_MS;
+  
+  LOG_INFO(LOG_POWER, "Deep sleep for %ld ms", (long)ms);
+  flushLog(LOG_FLUSH_TIMEOUT_MS);
+  bookAwake();
+  radio.sleep();
+  
+  // GPS stays powered so it hot-starts, actuators stay as they are, backlight off
+  digitalWrite(TFT_BL, LOW);
+  gpio_hold_en((gpio_num_t)VEXT_ENABLE);
+  gpio_hold_en((gpio_num_t)TFT_BL);
+  if (LED_PIN >= 0) gpio_hold_en((gpio_num_t)LED_PIN);
+  if (BUZZER_PIN >= 0) gpio_hold_en((gpio_num_t)BUZZER_PIN);
+  gpio_deep_sleep_hold_en();
+  
+  sleepState.uptimeBaseMs = uptimeMs();
+  sleepState.sleepStartUs = systemTimeUs();
+  sleepState.gpsProfile = gpsAppliedProfile;
+  sleepState.lastMovingMs = gpsMotion.lastMoving();
+  sleepState.gpsConfigured = gpsStats.configured;
+  sleepState.ledOn = currentLedState;
+  sleepState.buzzerOn = currentBuzzerState;
+  sleepState.lastControlCmd = lastControlCmd;
+  sleepState.stationIdle = stationIdle;
+  
+  esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000ULL);
+  esp_deep_sleep_start();
+}
+
+// Book the deep sleep that just ended and take back the pins held through it
+static void resumeFromDeepSleep() {
+  uint32_t sleptMs = (uint32_t)((systemTimeUs() - sleepState.sleepStartUs) / 1000) - millis();
+  sleepState.uptimeBaseMs += sleptMs;
+  sleepState.cycleSleptMs += sleptMs;
+  sleepState.deepSleeps++;
+  batteryModel.add(POWER_DEEP_SLEEP, sleptMs);
+  
+  pinMode(VEXT_ENABLE, OUTPUT);
+  digitalWrite(VEXT_ENABLE, HIGH);
+  pinMode(TFT_BL, OUTPUT);
+  digitalWrite(TFT_BL, LOW);
+  gpio_hold_dis((gpio_num_t)VEXT_ENABLE);
+  gpio_hold_dis((gpio_num_t)TFT_BL);
+  
+  lastControlCmd = sleepState.lastControlCmd;
+  stationIdle = sleepState.stationIdle;
+  gpsMotion.restore((GpsMotionProfile)sleepState.gpsProfile, sleepState.lastMovingMs);
+  gpsAppliedProfile = (GpsMotionProfile)sleepState.gpsProfile;
+  gpsStats.profile = sleepState.gpsProfile;
+  gpsStats.configured = sleepState.gpsConfigured;
+  
+  Serial.printf("Woke from deep sleep #%lu after %lu ms\n",
+                (unsigned long)sleepState.deepSleeps, (unsigned long)sleptMs);
+}
+
+// Fast boot: wait for one sentence with a valid checksum at the cached baud,
+// then read to the end of that burst so the census shows what the receiver
+// sends. Leaves the UART open if it answered.
+static bool probeGpsBaud(uint32_t baud, NmeaCensus &census) {
+  beginGpsSerial(baud);
+  uint32_t start = millis();
+  uint32_t lastCharMs = start;
+  uint32_t passedBefore = gps.passedChecksum();
+  
+  while (millis() - start < GPS_FAST_PROBE_MS) {
+    while (GPSSerial.available() > 0) {
+      char c = GPSSerial.read();
+      gps.encode(c);
+      census.feed(c);
+      lastCharMs = millis();
+    }
+    if (gps.passedChecksum() > passedBefore && millis() - lastCharMs >= GPS_FAST_PROBE_QUIET_MS) {
+      return true;
+    }
+    delay(5);
+  }
+  if (gps.passedChecksum() > passedBefore) return true;
+  GPSSerial.end();
+  return false;
+}
+
 void setupPupBeacon() {
   Serial.println("\n=== PawTracker PupBeacon ===");
   
-  initDisplay("PupBeacon");
+  snprintf(myBeaconId, sizeof(myBeaconId), "%08X", (uint32_t)ESP.getEfuseMac()); // Use ESP32 chip ID as unique beacon ID
+  fixBacklog.begin();
+  Serial.printf("Backlog: %u fixes pending, next seq %u\n", fixBacklog.pending, fixBacklog.nextSeq);
+  
+  if (resumedFromDeepSleep) {
+    resumeFromDeepSleep();
+  } else {
+    initDisplay("PupBeacon", fastBoot ? VEXT_FAST_SETTLE_MS : VEXT_SETTLE_MS);
+    beaconDisplayReady = true;
+  }
   initLoRa();
   
   Serial.println("Initializing GPS and actuators...");
 
   if (LED_PIN >= 0) pinMode(LED_PIN, OUTPUT);
   if (BUZZER_PIN >= 0) pinMode(BUZZER_PIN, OUTPUT);
-  setActuators(false, false);
+  setActuators(sleepState.ledOn, sleepState.buzzerOn); // Both off unless resuming
+  if (LED_PIN >= 0) gpio_hold_dis((gpio_num_t)LED_PIN);
+  if (BUZZER_PIN >= 0) gpio_hold_dis((gpio_num_t)BUZZER_PIN);
+  gpio_deep_sleep_hold_dis();
+
+  // The receiver stayed powered through deep sleep: same baud, same config
+  if (resumedFromDeepSleep && sleepState.gpsBaud != 0) {
+    beginGpsSerial(sleepState.gpsBaud);
+    startGpsTask(true);
+    Serial.println("PupBeacon setup complete!");
+    return;
+  }
+  
+  // Fast boot: the receiver should still answer at the cached baud, but it
+  // lost its sentence config if VEXT dropped with the reset
+  if (fastBoot) {
+    NmeaCensus census;
+    if (bootCache.gpsBaud != 0 && probeGpsBaud(bootCache.gpsBaud, census)) {
+      sleepState.gpsBaud = bootCache.gpsBaud;
+      gpsStats.configured = gpsConfigSeen(census);
+      gpsConfigPending = !gpsStats.configured;
+      Serial.printf("GPS at cached %lu baud, %s\n", (unsigned long)bootCache.gpsBaud,
+                    gpsStats.configured ? "config kept" : "configuring in the background");
+      startGpsTask(true);
+      Serial.println("PupBeacon setup complete!");
+      tft.fillScreen(ST77XX_BLACK);
+      return;
+    }
+    Serial.println("No GPS at the cached baud rate, detecting");
+    fastBoot = false;
+  }
 
   // Try to detect GPS baud rate
   uint32_t baudRates[] = {115200, 9600, 38400, 57600};
@@ -712,7 +2419,7 @@ void setupPupBeacon() {
     Serial.print(baudRates[i]);
     Serial.println(" baud...");
     
-    GPSSerial.begin(baudRates[i], SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);
+    beginGpsSerial(baudRates[i]);
     delay(500);
     
     // Read GPS for 2 seconds and check if we get valid NMEA sentences
@@ -744,362 +2451,825 @@ void setupPupBeacon() {
       Serial.print(baudRates[i]);
       Serial.println(" baud with valid NMEA data!");
       gpsDetected = true;
+      sleepState.gpsBaud = baudRates[i];
       break;
     }
     
     GPSSerial.end();
   }
   
-  if (!gpsDetected) {
-    Serial.println("WARNING: GPS not detected at any baud rate!");
-    Serial.println("Defaulting to 115200 baud");
-    GPSSerial.begin(115200, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);
+  if (!gpsDetected) {
+    Serial.println("WARNING: GPS not detected at any baud rate!");
+    Serial.println("Defaulting to 115200 baud");
+    beginGpsSerial(115200);
+    sleepState.gpsBaud = 115200;
+  }
+  
+  // Only RMC/GGA from here on, at the motion profile's rate
+  if (gpsDetected && !configureGpsReceiver()) {
+    Serial.println("WARNING: GPS did not take the sentence config, parsing full output");
+  }
+  startGpsTask(true);
+  saveBootCache(ROLE_PUP_BEACON, gpsDetected ? sleepState.gpsBaud : 0);
+  
+  Serial.println("PupBeacon setup complete!");
+
+  tft.fillScreen(ST77XX_BLACK);
+}
+
+// Latest fix from gpsTask, if recent enough to send. Never waits.
+bool readGpsFix(GpsFix &fix) {
+  gpsFix.read(fix);
+  if (gpsFixFresh(fix)) {
+    LOG_DEBUG(LOG_GPS, "GPS fix, %u satellites", fix.sats);
+    return true;
+  }
+  
+  LOG_INFO(LOG_GPS, "No GPS fix: %u satellites, %.1f sentences/s, %lu failed, %lu RX overruns",
+           fix.sats, gpsStats.sentencesPerSecond, (unsigned long)gpsStats.failedChecksum,
+           (unsigned long)gpsStats.rxOverruns);
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// Beacon cycle
+//
+// One cycle is a chain of radio events rather than blocking calls:
+//   IDLE -> [WAIT_FIX] -> CAD -> [BACKOFF -> CAD]... -> TX -> [RX] -> IDLE
+// repeated for a backfill frame when one is due. Every state either has work
+// now or waits for DIO1 (CadDone, TxDone, RxDone/Timeout) or a deadline, and
+// the beacon light-sleeps while it waits. The fix is whatever gpsTask last
+// published, so GPS acquisition overlaps the radio work instead of preceding it.
+
+enum BeaconState : uint8_t {
+  BEACON_IDLE,       // Waiting for the next frame
+  BEACON_WAIT_FIX,   // First frame after deep sleep waits for a fresh fix
+  BEACON_CAD,        // Channel activity detection running
+  BEACON_BACKOFF,    // Channel busy, waiting to check again
+  BEACON_TX,         // Frame on air
+  BEACON_RX          // Reply window open
+};
+
+const uint32_t CAD_TIMEOUT_MS = 50;      // CadDone should come within a few symbols
+const uint32_t TX_TIMEOUT_MARGIN_MS = 100;
+
+// Frame being sent: a BeaconMessage or a BackfillMessage
+struct BeaconTx {
+  uint8_t data[sizeof(BackfillMessage)];
+  size_t len;
+  bool listen;       // Open the reply window after it
+  bool backfill;
+  uint8_t cadAttempt;
+  uint32_t airUs;
+};
+
+static BeaconState beaconState = BEACON_IDLE;
+static BeaconTx beaconTx;
+static uint32_t beaconDeadline = 0;  // millis() the current state waits until
+static uint32_t rxWindowStart = 0;
+static uint32_t lastSend = 0;
+static bool firstFrame = true;
+static uint32_t randomOffset = 0;
+
+// Update display periodically. Only called in BEACON_IDLE, so SPI traffic to
+// the TFT never holds up a radio event.
+static void refreshBeaconDisplay(uint32_t now) {
+  static uint32_t lastDisplayUpdate = 0;
+  static bool lastGpsValid = false;
+  static uint8_t lastSats = 0;
+  static float lastVoltage = 0;
+  static uint32_t lastElapsed = 0;
+  
+  if (!beaconDisplayReady || now - lastDisplayUpdate <= 1000) return;
+  lastDisplayUpdate = now;
+  bool redraw = !beaconLabelsDrawn;
+  
+  GpsFix fix;
+  gpsFix.read(fix);
+  bool gpsValid = gpsFixFresh(fix);
+  uint8_t sats = fix.sats;
+  float voltage = batteryVoltage();
+  uint32_t elapsed = (lastRxTime == 0) ? 0 : (now - lastRxTime) / 1000;
+  
+  // Only redraw if values changed
+  if (redraw || gpsValid != lastGpsValid || sats != lastSats) {
+    tft.fillRect(32, 14, 128, 8, ST77XX_BLACK);
+    tft.setTextSize(1);
+    tft.setCursor(32, 14);
+    if (gpsValid) {
+      tft.setTextColor(ST77XX_GREEN);
+      tft.print("FIX ");
+      tft.setTextColor(ST77XX_WHITE);
+      tft.print(sats);
+      // tft.print("sat");
+    } else {
+      tft.setTextColor(ST77XX_RED);
+      tft.print("NO FIX ");
+      tft.setTextColor(ST77XX_YELLOW);
+      tft.print(sats);
+      // tft.print("sat");
+    }
+    lastGpsValid = gpsValid;
+    lastSats = sats;
+  }
+  
+  // Only redraw battery if changed significantly
+  if (redraw || abs(voltage - lastVoltage) > 0.05) {
+    tft.fillRect(38, 28, 120, 8, ST77XX_BLACK);
+    tft.setCursor(38, 28);
+    tft.setTextColor(voltage > 3.7 ? ST77XX_GREEN : ST77XX_YELLOW);
+    tft.print(voltage, 2);
+    tft.print("V");
+    lastVoltage = voltage;
+  }
+  
+  // Only redraw RX time if changed
+  if (redraw || elapsed != lastElapsed || (lastRxTime == 0 && elapsed == 0)) {
+    tft.fillRect(62, 42, 96, 8, ST77XX_BLACK);
+    tft.setCursor(62, 42);
+    if (lastRxTime == 0) {
+      tft.setTextColor(ST77XX_YELLOW);
+      tft.print("--");
+    } else {
+      if (elapsed > 60) {
+        tft.setTextColor(ST77XX_RED);
+        tft.print(elapsed / 60);
+        tft.print("m");
+      } else {
+        tft.setTextColor(ST77XX_GREEN);
+        tft.print(elapsed);
+        tft.print("s   ");
+      }
+    }
+    lastElapsed = elapsed;
+  }
+  
+  // Draw labels only once per display init
+  if (!beaconLabelsDrawn) {
+    tft.setTextSize(1);
+    tft.setTextColor(ST77XX_CYAN);
+    tft.setCursor(2, 14);
+    tft.print("GPS: ");
+    tft.setCursor(2, 28);
+    tft.print("Batt: ");
+    tft.setCursor(2, 42);
+    tft.print("Last RX: ");
+    beaconLabelsDrawn = true;
+  }
+}
+
+// Build the position frame for this cycle into beaconTx, from the latest fix
+static void beginBeaconFrame() {
+  GpsFix fix;
+  bool gotFix = readGpsFix(fix);
+
+  BeaconMessage msg{};
+  msg.msgType = MSG_BEACON;
+  memcpy(msg.beaconId, myBeaconId, sizeof(msg.beaconId));
+  msg.latitude = gotFix ? fix.latitude : 0.0;
+  msg.longitude = gotFix ? fix.longitude : 0.0;
+  msg.hdop = gotFix ? fix.hdop : 0.0f;
+  msg.sats = fix.sats;
+  msg.batteryVoltage = batteryVoltage();
+  msg.ledOn = currentLedState ? 1 : 0;
+  msg.buzzerOn = currentBuzzerState ? 1 : 0;
+  msg.lastControlReceived = lastControlCmd;
+  msg.speed = gotFix ? fix.speedKmph : 0.0f;
+  msg.altitude = gotFix ? fix.altitude : 0.0f;
+  msg.uptime = uptimeMs() / 1000; // Uptime in seconds, deep sleeps included
+  msg.seq = fixBacklog.takeSeq();
+  
+  // Awake share of the cycle since the previous frame, and the life it gives
+  bookAwake();
+  uint32_t cycleMs = uptimeMs() - sleepState.cycleStartMs;
+  uint32_t awakeMs = cycleMs > sleepState.cycleSleptMs ? cycleMs - sleepState.cycleSleptMs : 0;
+  sleepState.cycleStartMs = uptimeMs();
+  sleepState.cycleSleptMs = 0;
+  msg.awakeMs = (uint16_t)min(awakeMs, (uint32_t)0xFFFF);
+  msg.batteryLifeH = batteryModel.hoursLeft(msg.batteryVoltage);
+  
+  msg.flags = beaconFrameFlags(fixBacklog, msg.seq, stationIdle);
+  if (fastBoot) msg.flags |= BEACON_FLAG_FAST_BOOT;
+  
+  // Time to first transmit of this boot, repeated in every frame
+  if (firstFrameMs == 0) {
+    firstFrameMs = millis();
+    LOG_INFO(LOG_BEACON, "First frame %lu ms after %s", (unsigned long)firstFrameMs,
+             resumedFromDeepSleep ? "wake" : (fastBoot ? "fast boot" : "boot"));
+  }
+  msg.bootMs = (uint16_t)min(firstFrameMs, (uint32_t)0xFFFF);
+  bool listen = (msg.flags & BEACON_FLAG_LISTENING) != 0;
+  
+  // Keep the fix until the station acknowledges it
+  uint32_t fixTime = gotFix ? gpsUnixTime() : 0;
+  if (fixTime != 0) {
+    fixBacklog.add(makeBacklogFix(fixTime, fix.latitude, fix.longitude, msg.altitude, msg.speed, msg.seq));
+  }
+  LOG_DEBUG(LOG_BEACON, "Sending beacon, size: %u bytes (awake %u ms, battery %u h)",
+            (unsigned)sizeof(msg), msg.awakeMs, msg.batteryLifeH);
+  memcpy(beaconTx.data, &msg, sizeof(msg));
+  beaconTx.len = sizeof(msg);
+  beaconTx.listen = listen;
+  beaconTx.backfill = false;
+}
+
+// Resend fixes the station missed while we were out of range, when
+// backfillDue() says so. Returns false if no backfill frame is due.
+static bool beginBackfillFrame() {
+  static uint32_t lastBackfill = 0;
+  uint32_t now = millis();
+  
+  if (!backfillDue(fixBacklog, now, lastRxTime, lastBackfill)) return false;
+  lastBackfill = now;
+  
+  BackfillMessage bf;
+  size_t len = buildBackfillFrame(fixBacklog, myBeaconId, bf);
+  uint8_t count = bf.count;
+  
+  LOG_INFO(LOG_BEACON, "Sending backfill: %u fixes (%u bytes), %u still missed",
+           count, (unsigned)len, fixBacklog.missedCount() - count);
+  memcpy(beaconTx.data, &bf, len);
+  beaconTx.len = len;
+  beaconTx.listen = true;
+  beaconTx.backfill = true;
+  return true;
+}
+
+// Put beaconTx on the air; TxDone on DIO1 ends BEACON_TX
+static bool startBeaconTransmit() {
+  receivedFlag = false;
+  int state = radio.startTransmit(beaconTx.data, beaconTx.len);
+  if (state != RADIOLIB_ERR_NONE) {
+    LOG_WARN(LOG_RADIO, "Send failed, code: %d", state);
+    return false;
+  }
+  beaconState = BEACON_TX;
+  beaconDeadline = millis() + beaconTx.airUs / 1000 + TX_TIMEOUT_MARGIN_MS;
+  return true;
+}
+
+// Listen-before-talk as in loraTransmit, one CAD per call; CadDone on DIO1
+// ends BEACON_CAD
+static bool startBeaconCad() {
+  receivedFlag = false;
+  int state = radio.startChannelScan();
+  lbtStats.cadChecks++;
+  if (state != RADIOLIB_ERR_NONE) {
+    return startBeaconTransmit(); // Never block the radio on a CAD error
+  }
+  beaconState = BEACON_CAD;
+  beaconDeadline = millis() + CAD_TIMEOUT_MS;
+  return true;
+}
+
+// Start sending beaconTx. Returns false if nothing went on air, which ends the frame.
+static bool startBeaconTx() {
+  beaconTx.airUs = loraTimeOnAirUs(LORA_MODULATION, beaconTx.len);
+  beaconTx.cadAttempt = 0;
+  if (TX_SUB_BAND >= 0 &&
+      !airtimeLedgers[TX_SUB_BAND].allows(millis(), beaconTx.airUs, airtimeBudgetUs(TX_SUB_BAND))) {
+    airtimeDeferred++;
+    LOG_WARN(LOG_RADIO, "Airtime budget used up, frame deferred");
+    return false;
+  }
+  return startBeaconCad();
+}
+
+// Open the RX window over the station's reply slot. DIO1 (RxDone or Timeout)
+// ends it; the deadline only guards against a missed interrupt.
+static bool startReplyWindow() {
+  uint32_t replyAirtimeUs = radio.getTimeOnAir(sizeof(ControlMessage));
+  uint32_t windowUs = REPLY_OFFSET_US + replyAirtimeUs + REPLY_TOLERANCE_US;
+  
+  receivedFlag = false;
+  int rxState = radio.startReceive(radio.calculateRxTimeout(windowUs),
+                                   RADIOLIB_SX126X_IRQ_RX_DEFAULT,
+                                   RADIOLIB_SX126X_IRQ_RX_DONE | RADIOLIB_SX126X_IRQ_TIMEOUT);
+  if (rxState != RADIOLIB_ERR_NONE) {
+    LOG_WARN(LOG_RADIO, "startReceive failed, code: %d", rxState);
+    return false;
+  }
+  
+  // A reply whose header arrived at the end of the window still needs its airtime
+  rxWindowStart = millis();
+  beaconDeadline = rxWindowStart + (windowUs + replyAirtimeUs) / 1000 + 5;
+  beaconState = BEACON_RX;
+  return true;
+}
+
+// Read a control/ack frame addressed to this beacon after RxDone
+static void handleStationReply() {
+  ControlMessage ctrl{};
+  int state = radio.readData((uint8_t *)&ctrl, sizeof(ctrl));
+  if (state != RADIOLIB_ERR_NONE) {
+    if (state != RADIOLIB_ERR_RX_TIMEOUT) {
+      LOG_WARN(LOG_RADIO, "Read error: %d", state);
+    }
+    return;
+  }
+  
+  LOG_DEBUG(LOG_RADIO, "Reply received after %lu ms, msgType: 0x%02x",
+            (unsigned long)(millis() - rxWindowStart), ctrl.msgType);
+  
+  if (!applyStationReply(fixBacklog, ctrl, myBeaconId, stationIdle)) {
+    return;
+  }
+  lastRxTime = millis();
+  
+  if (ctrl.msgType == MSG_CONTROL) {
+    setActuators(ctrl.ledOn != 0, ctrl.buzzerOn != 0);
+    
+    // Track what was received: 1=LED, 2=Buzzer, 3=Both
+    lastControlCmd = 0;
+    if (ctrl.ledOn) lastControlCmd |= 0x01;
+    if (ctrl.buzzerOn) lastControlCmd |= 0x02;
+    
+    LOG_INFO(LOG_BEACON, "Command received: LED %s, buzzer %s",
+             ctrl.ledOn ? "ON" : "OFF", ctrl.buzzerOn ? "ON" : "OFF");
+  }
+}
+
+// Lying still: deep sleep until the next stationary-interval frame.
+// Otherwise light-sleep between frames, with the display back on.
+static void endBeaconCycle() {
+  beaconState = BEACON_IDLE;
+  if (beaconCanDeepSleep()) {
+    beaconDeepSleep(lastSend);
+  } else if (!beaconDisplayReady) {
+    initDisplay("PupBeacon");
+    tft.fillScreen(ST77XX_BLACK);
+    beaconDisplayReady = true;
+    beaconLabelsDrawn = false;
+  }
+}
+
+// Frame done, sent or not: drain fixes missed while out of range, then end the cycle
+static void finishBeaconFrame() {
+  beaconState = BEACON_IDLE;
+  if (!beaconTx.backfill && beginBackfillFrame() && startBeaconTx()) return;
+  endBeaconCycle();
+}
+
+static void startBeaconCycle(uint32_t now) {
+  firstFrame = false;
+  lastSend = now;
+  randomOffset = random(0, BEACON_SEND_JITTER_MS); // New random offset for next cycle
+  beginBeaconFrame();
+  if (!startBeaconTx()) {
+    finishBeaconFrame();
+  }
+}
+
+// Advance the cycle by one event, or wait (asleep if possible) for the next one
+static void stepBeaconCycle(uint32_t now) {
+  bool waiting = (int32_t)(now - beaconDeadline) < 0;
+  
+  switch (beaconState) {
+    case BEACON_IDLE: {
+      // Thin the update rate to what the regional duty cycle allows
+      uint32_t sendInterval = max(BEACON_SEND_INTERVAL_MS, minTxIntervalMs(sizeof(BeaconMessage)));
+      uint32_t due = lastSend + sendInterval + randomOffset;
+      
+      // Don't wait on the first frame
+      if (!firstFrame && (int32_t)(now - due) < 0) {
+        if (PAW_BEACON_SLEEP && !radioSleeping && due - now >= LIGHT_SLEEP_MIN_MS) {
+          radio.sleep();  // Warm sleep: keeps its configuration
+          radioSleeping = true;
+        }
+        beaconWait(due, false);
+        return;
+      }
+      if (radioSleeping) {
+        radio.standby();
+        radioSleeping = false;
+      }
+      
+      // After a deep sleep, hold the first frame until the GPS has delivered a fix
+      if (firstFrame && resumedFromDeepSleep) {
+        beaconState = BEACON_WAIT_FIX;
+        beaconDeadline = now + BEACON_AWAKE_WINDOW_MS;
+        return;
+      }
+      startBeaconCycle(now);
+      return;
+    }
+    
+    case BEACON_WAIT_FIX: {
+      GpsFix fix;
+      gpsFix.read(fix);
+      if (!gpsFixFresh(fix) && waiting) {
+        if (msUntilGpsBurst(now) == UINT32_MAX) {
+          delay(10);  // Nothing from the GPS yet: stay up for its first burst
+        } else {
+          beaconWait(beaconDeadline, false);
+        }
+        return;
+      }
+      startBeaconCycle(now);
+      return;
+    }
+    
+    case BEACON_CAD: {
+      if (!receivedFlag && waiting) {
+        beaconWait(beaconDeadline, true);
+        return;
+      }
+      // No CadDone in time counts as free, as a CAD error does in loraTransmit
+      int cad = receivedFlag ? radio.getChannelScanResult() : RADIOLIB_CHANNEL_FREE;
+      receivedFlag = false;
+      if (cad != RADIOLIB_LORA_DETECTED) {
+        if (!startBeaconTransmit()) finishBeaconFrame();
+        return;
+      }
+      lbtStats.cadBusy++;
+      
+      uint8_t attempt = beaconTx.cadAttempt++;
+      if (beaconTx.cadAttempt < LORA_REGION.cadMaxAttempts) {
+        uint32_t window = min((uint32_t)LORA_REGION.backoffBaseMs << attempt, (uint32_t)LORA_REGION.backoffMaxMs);
+        uint32_t backoff = random(1, window + 1);
+        lbtStats.backoffMs += backoff;
+        beaconState = BEACON_BACKOFF;
+        beaconDeadline = now + backoff;
+        return;
+      }
+      if (LORA_REGION.dropWhenBusy) {
+        lbtStats.dropped++;
+        LOG_WARN(LOG_RADIO, "Channel busy, frame not sent");
+        finishBeaconFrame();
+        return;
+      }
+      lbtStats.sentBusy++;
+      if (!startBeaconTransmit()) finishBeaconFrame();
+      return;
+    }
+    
+    case BEACON_BACKOFF:
+      if (waiting) {
+        beaconWait(beaconDeadline, false);
+        return;
+      }
+      if (!startBeaconCad()) finishBeaconFrame();
+      return;
+    
+    case BEACON_TX: {
+      if (!receivedFlag && waiting) {
+        beaconWait(beaconDeadline, true);
+        return;
+      }
+      bool sent = receivedFlag;
+      receivedFlag = false;
+      radio.finishTransmit();
+      if (!sent) {
+        LOG_WARN(LOG_RADIO, "Send failed: no TxDone");
+        finishBeaconFrame();
+        return;
+      }
+      if (TX_SUB_BAND >= 0) {
+        airtimeLedgers[TX_SUB_BAND].record(millis(), beaconTx.airUs);
+      }
+      batteryModel.add(POWER_TX, beaconTx.airUs / 1000);
+      
+      if (!beaconTx.backfill) {
+        LOG_INFO(LOG_BEACON, "Beacon sent");
+        if (TX_SUB_BAND >= 0) {
+          LOG_DEBUG(LOG_RADIO, "Airtime: %lu of %lu ms this hour",
+                    (unsigned long)(airtimeLedgers[TX_SUB_BAND].usedUs(millis()) / 1000),
+                    (unsigned long)(airtimeBudgetUs(TX_SUB_BAND) / 1000));
+        }
+      }
+      
+      // Listen for control packets in the reply slot
+      if (beaconTx.listen && startReplyWindow()) return;
+      finishBeaconFrame();
+      return;
+    }
+    
+    case BEACON_RX:
+      if (!receivedFlag && waiting) {
+        beaconWait(beaconDeadline, true);
+        return;
+      }
+      batteryModel.add(POWER_RX, millis() - rxWindowStart);
+      if (receivedFlag) {
+        receivedFlag = false;
+        handleStationReply();
+      } else {
+        radio.standby();
+        LOG_WARN(LOG_RADIO, "No reply (DIO1 timeout missed)");
+      }
+      finishBeaconFrame();
+      return;
+  }
+}
+
+void loopPupBeacon() {
+  uint32_t now = millis();
+  if (beaconState == BEACON_IDLE) {
+    refreshBeaconDisplay(now);
+  }
+  stepBeaconCycle(now);
+}
+
+#endif // PAW_BEACON
+
+#if PAW_STATION
+// -----------------------------------------------------------------------------
+// Central Server Communication (PupStation only)
+// -----------------------------------------------------------------------------
+
+void registerDeviceWithServer();
+
+// Queue a command from the central server (pushed or polled). Returns our
+// command for it, nullptr if it had no target or the queue was full.
+ControlCommand* applyServerControl(JsonDocument &doc, const char* via) {
+  bool ledOn = doc["ledOn"] | false;
+  bool buzzerOn = doc["buzzerOn"] | false;
+  uint32_t serverCommandId = doc["commandId"] | 0;
+  
+  String target = doc["trackerId"] | "";
+  if (target.isEmpty()) target = stationSnapshot.read().primary.beaconId;
+  
+  LOG_INFO(LOG_UPLINK, "Server control (%s) for %s: LED %u, buzzer %u",
+           via, target.c_str(), ledOn, buzzerOn);
+  uint32_t beaconId;
+  if (!parseBeaconId(target.c_str(), beaconId)) {
+    return nullptr;
+  }
+  
+  lockControl();
+  ControlCommand* cmd = enqueueControl(beaconId, ledOn, buzzerOn);
+  if (cmd) {
+    cmd->serverCommandId = serverCommandId;
   }
-  
-  Serial.println("PupBeacon setup complete!");
-
-  tft.fillScreen(ST77XX_BLACK);
+  unlockControl();
+  return cmd;
 }
 
-bool readGpsFix(float &lat, float &lng, float &hdop, uint8_t &sats, uint32_t timeoutMs) {
-  uint32_t start = millis();
-  int charsProcessed = 0;
-  
-  while (millis() - start < timeoutMs) {
-    while (GPSSerial.available() > 0) {
-      char c = GPSSerial.read();
-      charsProcessed++;
-      gps.encode(c);
-    }
-    if (gps.location.isUpdated() && gps.location.isValid()) {
-      lat = gps.location.lat();
-      lng = gps.location.lng();
-      hdop = gps.hdop.hdop();
-      sats = gps.satellites.value();
-      Serial.print("GPS fix obtained: ");
-      Serial.print(sats);
-      Serial.println(" satellites");
-      return true;
-    }
-    delay(10);
+// Outbound WebSocket to the server's /ws endpoint. Dashboard commands arrive
+// over it as soon as they are issued, and uplink batches ride the same
+// connection. While it is down, networkTask falls back to HTTP for both.
+const uint32_t SERVER_SOCKET_BACKOFF_MIN_MS = 1000;
+const uint32_t SERVER_SOCKET_BACKOFF_MAX_MS = 60000;
+const uint32_t SERVER_SOCKET_PING_MS = 15000;
+const uint32_t SERVER_SOCKET_PONG_TIMEOUT_MS = 5000;
+const uint8_t SERVER_SOCKET_MISSED_PONGS = 2;      // Then the link is dropped and redialled
+const uint32_t NETWORK_TASK_TICK_MS = 20;          // Socket service interval
+
+struct ServerLinkStats {
+  bool connected = false;
+  uint32_t connects = 0;
+  uint32_t disconnects = 0;
+  uint32_t controlsPushed = 0;
+  uint32_t lastControlMs = 0;   // Push received -> beacon acked, last command
+  uint32_t lastControlEndToEndMs = 0; // Dashboard press -> beacon ack report, by the server's clock
+} serverLinkStats;
+
+// networkTask only
+WebSocketsClient serverSocket;
+String serverSocketUrl = "";            // centralServerUrl the socket was started for
+uint32_t serverSocketBackoffMs = SERVER_SOCKET_BACKOFF_MIN_MS;
+uint32_t serverSocketBackoffAt = 0;     // When the backoff was last raised
+
+// Split "http[s]://host[:port][/...]" for the WebSocket client
+bool parseServerUrl(const String &url, String &host, uint16_t &port, bool &secure) {
+  int hostStart = url.indexOf("://");
+  if (hostStart < 0) return false;
+  secure = url.startsWith("https");
+  hostStart += 3;
+  
+  int hostEnd = url.indexOf('/', hostStart);
+  if (hostEnd < 0) hostEnd = url.length();
+  String authority = url.substring(hostStart, hostEnd);
+  
+  int colon = authority.indexOf(':');
+  if (colon >= 0) {
+    host = authority.substring(0, colon);
+    port = authority.substring(colon + 1).toInt();
+  } else {
+    host = authority;
+    port = secure ? 443 : 80;
   }
-  
-  Serial.print("No GPS fix. Satellites visible: ");
-  Serial.print(gps.satellites.value());
-  Serial.print(", Valid sentences: ");
-  Serial.print(gps.passedChecksum());
-  Serial.print(", Failed: ");
-  Serial.println(gps.failedChecksum());
-  return false;
+  return !host.isEmpty() && port != 0;
 }
 
-void loopPupBeacon() {
-  static uint32_t lastSend = 0;
-  static uint32_t lastRxTime = 0;
-  static bool firstRun = true;
-  static uint32_t randomOffset = random(0, 2000); // Random 0-2 second offset
-  static uint8_t lastControlCmd = 0; // Track last control command received
-  uint32_t now = millis();
+// Every fix the station hears is uploaded, not just the primary beacon's
+// latest one. loop() queues fixes; networkTask sends them in batches
+// (UplinkSender, uplink_core.h) over the push channel or one kept-alive HTTP
+// connection. While the server cannot be reached, fixes are spooled to a
+// bounded backlog on LittleFS and sent oldest-first once it can.
+const uint8_t UPLINK_QUEUE_DEPTH = 128;
+const uint16_t UPLINK_HTTP_TIMEOUT_MS = 5000;
 
-  // GPS debugging - print stats every 5 seconds
-  // Disabled for now
-  /*
-  static uint32_t lastGpsDebug = 0;
-  if (now - lastGpsDebug > 5000) {
-    lastGpsDebug = now;
-    Serial.println("\n--- GPS Debug Info ---");
-    Serial.print("Characters received: ");
-    Serial.println(gps.charsProcessed());
-    Serial.print("Sentences passed: ");
-    Serial.println(gps.passedChecksum());
-    Serial.print("Sentences failed: ");
-    Serial.println(gps.failedChecksum());
-    Serial.print("Satellites: ");
-    Serial.println(gps.satellites.value());
-    Serial.print("Satellites valid: ");
-    Serial.println(gps.satellites.isValid() ? "YES" : "NO");
-    Serial.print("Location valid: ");
-    Serial.println(gps.location.isValid() ? "YES" : "NO");
-    Serial.print("Location age: ");
-    Serial.println(gps.location.age());
-    Serial.print("HDOP: ");
-    Serial.print(gps.hdop.hdop());
-    Serial.print(" (valid: ");
-    Serial.print(gps.hdop.isValid() ? "YES" : "NO");
-    Serial.println(")");
-    Serial.print("Date valid: ");
-    Serial.println(gps.date.isValid() ? "YES" : "NO");
-    Serial.print("Time valid: ");
-    Serial.println(gps.time.isValid() ? "YES" : "NO");
-    
-    if (gps.location.isValid()) {
-      Serial.print("Lat: ");
-      Serial.print(gps.location.lat(), 6);
-      Serial.print(", Lon: ");
-      Serial.println(gps.location.lng(), 6);
-    } else {
-      Serial.println("GPS Status: Receiving NMEA but NO satellite signals!");
-      Serial.println("Possible causes:");
-      Serial.println("  - Device is indoors (GPS needs sky view)");
-      Serial.println("  - Antenna blocked or damaged");
-      Serial.println("  - Cold start (can take 30+ seconds outside)");
+QueueHandle_t uplinkQueue = NULL;
+HTTPClient serverHttp;                  // networkTask only, kept alive between requests
+
+// UplinkSender's view of the station (networkTask)
+class StationUplinkLink : public UplinkLink {
+public:
+  uint8_t takeQueued(UplinkFix* fixes, uint8_t max) override {
+    uint8_t count = 0;
+    while (count < max && xQueueReceive(uplinkQueue, &fixes[count], 0) == pdTRUE) {
+      count++;
     }
-    Serial.println("---------------------\n");
+    return count;
   }
-  */
-
-  // Update display periodically
-  static uint32_t lastDisplayUpdate = 0;
-  static bool lastGpsValid = false;
-  static uint8_t lastSats = 0;
-  static float lastVoltage = 0;
-  static uint32_t lastElapsed = 0;
   
-  if (now - lastDisplayUpdate > 1000) {
-    lastDisplayUpdate = now;
-    
-    bool gpsValid = gps.location.isValid();
-    uint8_t sats = gps.satellites.value();
-    float voltage = readBatteryVoltage();
-    uint32_t elapsed = (lastRxTime == 0) ? 0 : (now - lastRxTime) / 1000;
-    
-    // Only redraw if values changed
-    if (gpsValid != lastGpsValid || sats != lastSats) {
-      tft.fillRect(32, 14, 128, 8, ST77XX_BLACK);
-      tft.setTextSize(1);
-      tft.setCursor(32, 14);
-      if (gpsValid) {
-        tft.setTextColor(ST77XX_GREEN);
-        tft.print("FIX ");
-        tft.setTextColor(ST77XX_WHITE);
-        tft.print(sats);
-        // tft.print("sat");
-      } else {
-        tft.setTextColor(ST77XX_RED);
-        tft.print("NO FIX ");
-        tft.setTextColor(ST77XX_YELLOW);
-        tft.print(sats);
-        // tft.print("sat");
-      }
-      lastGpsValid = gpsValid;
-      lastSats = sats;
-    }
-    
-    // Only redraw battery if changed significantly
-    if (abs(voltage - lastVoltage) > 0.05) {
-      tft.fillRect(38, 28, 120, 8, ST77XX_BLACK);
-      tft.setCursor(38, 28);
-      tft.setTextColor(voltage > 3.7 ? ST77XX_GREEN : ST77XX_YELLOW);
-      tft.print(voltage, 2);
-      tft.print("V");
-      lastVoltage = voltage;
-    }
+  StationLocation stationLocation() override {
+    return stationSnapshot.read().station;
+  }
+  
+  bool socketConnected() override {
+    return serverLinkStats.connected;
+  }
+  
+  bool sendSocket(const String& json) override {
+    return serverSocket.sendTXT(json.c_str());
+  }
+  
+  int post(const String& json) override {
+    serverHttp.begin(centralServerUrl + "/api/device/beacons");
+    serverHttp.addHeader("Content-Type", "application/json");
+    int httpCode = serverHttp.POST(json);
+    serverHttp.end();
     
-    // Only redraw RX time if changed
-    if (elapsed != lastElapsed || (lastRxTime == 0 && elapsed == 0)) {
-      tft.fillRect(62, 42, 96, 8, ST77XX_BLACK);
-      tft.setCursor(62, 42);
-      if (lastRxTime == 0) {
-        tft.setTextColor(ST77XX_YELLOW);
-        tft.print("--");
-      } else {
-        if (elapsed > 60) {
-          tft.setTextColor(ST77XX_RED);
-          tft.print(elapsed / 60);
-          tft.print("m");
-        } else {
-          tft.setTextColor(ST77XX_GREEN);
-          tft.print(elapsed);
-          tft.print("s   ");
-        }
+    if (httpCode > 0 && httpCode != HTTP_CODE_OK) {
+      LOG_WARN(LOG_UPLINK, "Server responded with code %d", httpCode);
+      if (httpCode == HTTP_CODE_NOT_FOUND) {
+        registerDeviceWithServer(); // Server restarted and forgot us
       }
-      lastElapsed = elapsed;
-    }
-    
-    // Draw labels only once (on first run)
-    static bool labelsDrawn = false;
-    if (!labelsDrawn) {
-      tft.setTextSize(1);
-      tft.setTextColor(ST77XX_CYAN);
-      tft.setCursor(2, 14);
-      tft.print("GPS: ");
-      tft.setCursor(2, 28);
-      tft.print("Batt: ");
-      tft.setCursor(2, 42);
-      tft.print("Last RX: ");
-      labelsDrawn = true;
+    } else if (httpCode <= 0) {
+      LOG_WARN(LOG_UPLINK, "Uplink failed, HTTP client error %d", httpCode);
     }
+    return httpCode;
   }
-
-  // Don't sleep on first run, and check if enough time has passed
-  if (!firstRun && (now - lastSend < BEACON_SEND_INTERVAL_MS + randomOffset)) {
-    // Update GPS data while waiting
-    while (GPSSerial.available() > 0) {
-      gps.encode(GPSSerial.read());
-    }
-    delay(100);
-    return;
+  
+  void batchDone(bool delivered, uint32_t elapsedUs) override {
+    metricUplinkTime.observe(elapsedUs);
+    (delivered ? metricUplinkOk : metricUplinkFailed).inc();
   }
-
-  firstRun = false;
-  lastSend = now;
-  randomOffset = random(0, 2000); // New random offset for next cycle
-
-  // Wake: quickly get GPS fix, send via LoRa, then potentially receive control
-  float lat = 0, lng = 0;
-  float hdop = 0;
-  uint8_t sats = 0;
-
-  bool gotFix = readGpsFix(lat, lng, hdop, sats, BEACON_AWAKE_WINDOW_MS);
-
-  BeaconMessage msg{};
-  msg.msgType = 0x01;
-  snprintf(msg.beaconId, sizeof(msg.beaconId), "%08X", (uint32_t)ESP.getEfuseMac()); // Use ESP32 chip ID as unique beacon ID
-  msg.latitude = gotFix ? lat : 0.0;
-  msg.longitude = gotFix ? lng : 0.0;
-  msg.hdop = gotFix ? hdop : 0.0f;
-  msg.sats = sats;
-  msg.batteryVoltage = readBatteryVoltage();
-  msg.ledOn = currentLedState ? 1 : 0;
-  msg.buzzerOn = currentBuzzerState ? 1 : 0;
-  msg.lastControlReceived = lastControlCmd;
-  msg.speed = (gotFix && gps.speed.isValid()) ? gps.speed.kmph() : 0.0f;
-  msg.altitude = (gotFix && gps.altitude.isValid()) ? gps.altitude.meters() : 0.0f;
-  msg.uptime = (millis() - bootTime) / 1000; // Uptime in seconds
-
-  // Send via LoRa
-  Serial.print("Sending beacon, size: ");
-  Serial.print(sizeof(msg));
-  Serial.println(" bytes");
   
-  int state = radio.transmit((uint8_t *)&msg, sizeof(msg));
-  if (state == RADIOLIB_ERR_NONE) {
-    Serial.println("Beacon sent successfully");
-  } else {
-    Serial.print("Send failed, code: ");
-    Serial.println(state);
+  void backlogDropped(uint32_t fixes) override {
+    LOG_WARN(LOG_UPLINK, "Backlog full, dropped its oldest segment (%lu fixes)", (unsigned long)fixes);
   }
+} uplinkLink;
 
-  // Small delay to let radio settle after transmit
-  delay(50);
-  
-  // Listen for control packets after sending
-  int rxState = radio.startReceive();
-  Serial.print("Listening for control (startReceive code: ");
-  Serial.print(rxState);
-  Serial.println(")...");
-  
-  uint32_t listenStart = millis();
-  char myBeaconId[9];
-  snprintf(myBeaconId, sizeof(myBeaconId), "%08X", (uint32_t)ESP.getEfuseMac());
-  while (millis() - listenStart < 500) {
-    ControlMessage ctrl{};
-    int state = radio.readData((uint8_t *)&ctrl, sizeof(ctrl));
-    
-    if (state == RADIOLIB_ERR_NONE) {
-      Serial.print("Control received! msgType: 0x");
-      Serial.println(ctrl.msgType, HEX);
-      // Check if message is for us (beaconId empty means broadcast to all)
-      if (ctrl.msgType == 0x10 && (strlen(ctrl.beaconId) == 0 || strcmp(ctrl.beaconId, myBeaconId) == 0)) {
-        setActuators(ctrl.ledOn != 0, ctrl.buzzerOn != 0);
-        lastRxTime = millis();
-        
-        // Track what was received: 1=LED, 2=Buzzer, 3=Both
-        lastControlCmd = 0;
-        if (ctrl.ledOn) lastControlCmd |= 0x01;
-        if (ctrl.buzzerOn) lastControlCmd |= 0x02;
+UplinkSender uplink(hal.fs, hal.clock, uplinkLink);
+
+void onServerSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
+  switch (type) {
+    case WStype_CONNECTED:
+      serverLinkStats.connected = true;
+      serverLinkStats.connects++;
+      serverSocketBackoffMs = SERVER_SOCKET_BACKOFF_MIN_MS;
+      serverSocket.setReconnectInterval(serverSocketBackoffMs);
+      Serial.println("Server push channel connected");
+      break;
+      
+    case WStype_DISCONNECTED:
+      if (serverLinkStats.connected) {
+        serverLinkStats.disconnects++;
+        serverSocketBackoffAt = millis();
+        Serial.println("Server push channel lost");
+      }
+      serverLinkStats.connected = false;
+      break;
+      
+    case WStype_TEXT: {
+      JsonDocument doc;
+      if (deserializeJson(doc, payload, length)) {
+        break;
+      }
+      String msgType = doc["type"] | "";
+      
+      if (msgType == "control") {
+        serverLinkStats.controlsPushed++;
+        ControlCommand* cmd = applyServerControl(doc, "push");
         
-        Serial.print("Command received: ");
-        if (ctrl.ledOn && ctrl.buzzerOn) Serial.println("LED+Buzzer ON");
-        else if (ctrl.ledOn) Serial.println("LED ON");
-        else if (ctrl.buzzerOn) Serial.println("Buzzer ON");
-        else Serial.println("All OFF");
+        // Lets the server time delivery
+        JsonDocument reply;
+        reply["type"] = "control_received";
+        reply["commandId"] = doc["commandId"];
+        reply["queued"] = cmd != nullptr;
+        String json;
+        serializeJson(reply, json);
+        serverSocket.sendTXT(json);
+      } else if (msgType == "ack") {
+        uplink.ackReceived(doc["seq"] | 0);
+      } else if (msgType == "control_result") {
+        serverLinkStats.lastControlEndToEndMs = doc["completedMs"] | 0;
       }
-      break; // Exit listen loop after receiving
-    } else if (state != RADIOLIB_ERR_RX_TIMEOUT) {
-      Serial.print("Read error: ");
-      Serial.println(state);
+      break;
     }
-    delay(10);
+      
+    default:
+      break;
   }
-
-  // After short active window go back to deep sleep
-  // esp_sleep_enable_timer_wakeup((uint64_t)BEACON_SEND_INTERVAL_MS * 1000ULL);
-  // esp_deep_sleep_start();
 }
 
-// -----------------------------------------------------------------------------
-// Central Server Communication (PupStation only)
-// -----------------------------------------------------------------------------
-
-void sendBeaconDataToServer() {
-  if (!centralServerEnabled || centralServerUrl.isEmpty()) {
+void startServerSocket() {
+  String host;
+  uint16_t port;
+  bool secure;
+  serverSocketUrl = centralServerUrl;
+  if (!parseServerUrl(centralServerUrl, host, port, secure)) {
+    Serial.println("Server URL not usable for the push channel, polling instead");
     return;
   }
-
-  if (!WiFi.isConnected()) {
-    Serial.println("WiFi not connected, skipping server sync");
-    return;
+  
+  String path = "/ws?deviceId=" + deviceId;
+  if (secure) {
+    serverSocket.beginSSL(host.c_str(), port, path.c_str());
+  } else {
+    serverSocket.begin(host.c_str(), port, path.c_str());
   }
+  serverSocket.onEvent(onServerSocketEvent);
+  serverSocket.enableHeartbeat(SERVER_SOCKET_PING_MS, SERVER_SOCKET_PONG_TIMEOUT_MS, SERVER_SOCKET_MISSED_PONGS);
+  serverSocketBackoffMs = SERVER_SOCKET_BACKOFF_MIN_MS;
+  serverSocketBackoffAt = millis();
+  serverSocket.setReconnectInterval(serverSocketBackoffMs);
+}
 
-  if (!latestBeacon.hasData) {
-    Serial.println("No beacon data to send");
-    return;
+// Keep the socket up. The client redials on its own; while it keeps failing,
+// the interval doubles (with jitter) up to SERVER_SOCKET_BACKOFF_MAX_MS.
+void serviceServerSocket() {
+  if (serverSocketUrl != centralServerUrl) {
+    serverSocket.disconnect();
+    startServerSocket();
   }
-
-  HTTPClient http;
-  String url = centralServerUrl + "/api/device/beacon";
+  serverSocket.loop();
   
-  http.begin(url);
-  http.addHeader("Content-Type", "application/json");
-
-  // Create JSON payload
-  JsonDocument doc;
-  doc["deviceId"] = deviceId;
-  
-  JsonObject beaconData = doc["beaconData"].to<JsonObject>();
-  beaconData["trackerId"] = latestBeacon.beaconId;
-  beaconData["latitude"] = latestBeacon.latitude;
-  beaconData["longitude"] = latestBeacon.longitude;
-  beaconData["hdop"] = latestBeacon.hdop;
-  beaconData["sats"] = latestBeacon.sats;
-  beaconData["batteryVoltage"] = latestBeacon.batteryVoltage;
-  beaconData["rssi"] = latestBeacon.rssi;
-  beaconData["snr"] = latestBeacon.snr;
-  beaconData["ledOn"] = latestBeacon.ledOn;
-  beaconData["buzzerOn"] = latestBeacon.buzzerOn;
-  beaconData["speed"] = latestBeacon.speed;
-  beaconData["altitude"] = latestBeacon.altitude;
-  
-  // Add station location if available
-  if (stationLocation.hasValidFix) {
-    JsonObject stationLoc = doc["stationLocation"].to<JsonObject>();
-    stationLoc["latitude"] = stationLocation.latitude;
-    stationLoc["longitude"] = stationLocation.longitude;
-    stationLoc["hdop"] = stationLocation.hdop;
-    stationLoc["sats"] = stationLocation.sats;
-    stationLoc["altitude"] = stationLocation.altitude;
-    stationLoc["hasValidFix"] = stationLocation.hasValidFix;
+  uint32_t now = millis();
+  if (!serverLinkStats.connected && now - serverSocketBackoffAt >= serverSocketBackoffMs) {
+    serverSocketBackoffAt = now;
+    serverSocketBackoffMs = min(serverSocketBackoffMs * 2, SERVER_SOCKET_BACKOFF_MAX_MS);
+    serverSocket.setReconnectInterval(serverSocketBackoffMs + random(serverSocketBackoffMs / 4));
   }
+}
 
-  String jsonString;
-  serializeJson(doc, jsonString);
-
-  int httpCode = http.POST(jsonString);
-
-  if (httpCode > 0) {
-    if (httpCode == HTTP_CODE_OK) {
-      Serial.println("Beacon data sent to server successfully");
-    } else {
-      Serial.printf("Server responded with code: %d\n", httpCode);
+// Tell the server how its commands ended, for its latency figures
+void reportControlResults() {
+  if (!serverLinkStats.connected) {
+    return;
+  }
+  
+  for (uint8_t i = 0; i < CONTROL_COMMAND_SLOTS; i++) {
+    lockControl();
+    ControlCommand &cmd = controlCommands[i];
+    bool due = cmd.serverCommandId != 0 && !cmd.reported &&
+               cmd.state != CMD_FREE && !isControlActive(cmd);
+    JsonDocument doc;
+    if (due) {
+      cmd.reported = true;
+      doc["type"] = "control_done";
+      doc["commandId"] = cmd.serverCommandId;
+      doc["state"] = controlStateName(cmd.state);
+      doc["attempts"] = cmd.attempts;
+      doc["stationMs"] = cmd.updatedAt - cmd.createdAt;
+      if (cmd.state == CMD_ACKED) {
+        serverLinkStats.lastControlMs = cmd.updatedAt - cmd.createdAt;
+      }
+    }
+    unlockControl();
+    
+    if (due) {
+      String json;
+      serializeJson(doc, json);
+      serverSocket.sendTXT(json);
     }
-  } else {
-    Serial.printf("Failed to send data to server: %s\n", http.errorToString(httpCode).c_str());
   }
+}
 
-  http.end();
+// Called by loop() for every beacon frame
+void queueUplinkFix(const LatestBeaconData &beacon, uint32_t timestamp) {
+  if (!centralServerEnabled || uplinkQueue == NULL) {
+    return;
+  }
+  
+  UplinkFix fix;
+  fix.timestamp = timestamp;
+  memcpy(fix.beaconId, beacon.beaconId, sizeof(fix.beaconId));
+  fix.latitude = beacon.latitude;
+  fix.longitude = beacon.longitude;
+  fix.hdop = beacon.hdop;
+  fix.sats = beacon.sats;
+  fix.batteryVoltage = beacon.batteryVoltage;
+  fix.rssi = beacon.rssi;
+  fix.snr = beacon.snr;
+  fix.speed = beacon.speed;
+  fix.altitude = beacon.altitude;
+  fix.ledOn = beacon.ledOn;
+  fix.buzzerOn = beacon.buzzerOn;
+  
+  if (xQueueSend(uplinkQueue, &fix, 0) != pdTRUE) {
+    uplink.stats.dropped++;
+    return;
+  }
+  uplink.stats.queued++;
+  uint32_t depth = uxQueueMessagesWaiting(uplinkQueue);
+  if (depth > uplink.stats.queuePeak) uplink.stats.queuePeak = depth;
 }
 
+// Fallback while the push channel is down
 void checkServerForControlCommands() {
   if (!centralServerEnabled || centralServerUrl.isEmpty() || deviceId.isEmpty()) {
     return;
@@ -1109,39 +3279,26 @@ void checkServerForControlCommands() {
     return;
   }
 
-  HTTPClient http;
   String url = centralServerUrl + "/api/device/" + deviceId + "/control";
   
-  http.begin(url);
-  int httpCode = http.GET();
+  serverHttp.begin(url);
+  int httpCode = serverHttp.GET();
 
   if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
+    String payload = serverHttp.getString();
     
     JsonDocument doc;
     DeserializationError error = deserializeJson(doc, payload);
     
-    if (!error) {
-      bool hasCommand = doc["hasCommand"] | false;
-      
-      if (hasCommand) {
-        bool ledOn = doc["ledOn"] | false;
-        bool buzzerOn = doc["buzzerOn"] | false;
-        
-        Serial.printf("Server control command received: LED=%d, Buzzer=%d\n", ledOn, buzzerOn);
-        
-        // Update beacon control state
-        beaconControl.ledOn = ledOn;
-        beaconControl.buzzerOn = buzzerOn;
-        beaconControl.pendingControl = true;
-        beaconControl.targetBeaconId = latestBeacon.beaconId;
-      }
+    if (!error && (doc["hasCommand"] | false)) {
+      applyServerControl(doc, "poll");
     }
   }
 
-  http.end();
+  serverHttp.end();
 }
 
+
 void registerDeviceWithServer() {
   if (!centralServerEnabled || centralServerUrl.isEmpty() || deviceId.isEmpty()) {
     return;
@@ -1223,6 +3380,72 @@ void saveServerConfig(String url) {
 // NOTE: For now we'll just print to Serial and display; WiFi/web UI can be
 // added in a later iteration.
 
+// One /api/stats "tasks" entry: minimum free stack since boot, plus the task's
+// input queue if it has one (capacity 0 = no queue)
+String taskMetricsJson(const char* name, TaskHandle_t handle, uint32_t queueDepth,
+                       uint32_t queuePeak, uint32_t queueCapacity, uint32_t queueDropped) {
+  String json = "{";
+  json += "\"name\":\"" + String(name) + "\",";
+  json += "\"running\":" + String(handle ? "true" : "false") + ",";
+  json += "\"stackFree\":" + String(handle ? uxTaskGetStackHighWaterMark(handle) : 0);
+  if (queueCapacity > 0) {
+    json += ",\"queueDepth\":" + String(queueDepth);
+    json += ",\"queuePeak\":" + String(queuePeak);
+    json += ",\"queueCapacity\":" + String(queueCapacity);
+    json += ",\"queueDropped\":" + String(queueDropped);
+  }
+  json += "}";
+  return json;
+}
+
+// Micro-benchmarks of the station hot paths (bench_suite.h), on demand from
+// POST /api/bench. They run in their own low-priority task on the app core, so
+// the radio and loop() preempt them (the median absorbs that).
+const uint32_t BENCH_TASK_STACK = 8192;
+const UBaseType_t BENCH_TASK_PRIORITY = 1;
+volatile bool benchRunning = false;
+String benchResult;  // JSON of the last run, set before benchRunning clears
+
+void benchTask(void *param) {
+  BenchRunner bench(ESP.getCpuFreqMHz());
+  runBenchSuite(bench, hal.fs);
+  benchResult = bench.json("esp32");
+  LOG_INFO(LOG_SYSTEM, "Benchmarks done: %u cases", (unsigned)bench.results.size());
+  benchRunning = false;
+  vTaskDelete(NULL);
+}
+
+// paw_http_handler_seconds{route,method}: the time a handler takes to build
+// its response (AsyncTCP sends it afterwards)
+static MetricHistogram* routeLatencyMetric(const char* route, WebRequestMethodComposite method) {
+  char labels[96];
+  snprintf(labels, sizeof(labels), "route=\"%s\",method=\"%s\"", route, method == HTTP_POST ? "POST" : "GET");
+  return new MetricHistogram("paw_http_handler_seconds", "Web handler run time by route",
+                             METRIC_LATENCY_BUCKETS_US, METRIC_LATENCY_BUCKETS, strdup(labels));
+}
+
+// server.on() with the handler timed into the route's latency histogram
+void onTimedRoute(const char* route, WebRequestMethodComposite method, ArRequestHandlerFunction handler) {
+  MetricHistogram* latency = routeLatencyMetric(route, method);
+  server.on(route, method, [latency, handler](AsyncWebServerRequest *request) {
+    uint32_t start = micros();
+    handler(request);
+    latency->observe(micros() - start);
+  });
+}
+
+// Same for routes that do their work in the body handler
+void onTimedRoute(const char* route, WebRequestMethodComposite method, ArRequestHandlerFunction handler,
+                  ArUploadHandlerFunction upload, ArBodyHandlerFunction body) {
+  MetricHistogram* latency = routeLatencyMetric(route, method);
+  server.on(route, method, handler, upload,
+    [latency, body](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+      uint32_t start = micros();
+      body(request, data, len, index, total);
+      latency->observe(micros() - start);
+    });
+}
+
 void setupWiFiAndWebServer() {
   Serial.println("\nInitializing WiFi...");
   
@@ -1280,92 +3503,108 @@ void setupWiFiAndWebServer() {
   // Setup web server routes
   
   // API endpoint to get JSON data (define before static file handler)
-  server.on("/api/data", HTTP_GET, [](AsyncWebServerRequest *request){
-    // Support for legacy single-beacon mode (latestBeacon) and multi-beacon mode
-    String json = "{";
+  onTimedRoute("/api/data", HTTP_GET, [](AsyncWebServerRequest *request){
+    StationSnapshot snap = stationSnapshot.read();
+    const LatestBeaconData &primary = snap.primary;
+    
+    // Legacy single-beacon fields (primary beacon) plus all beacons, see web_json.h
+    std::unique_ptr<BeaconTable> table = readBeaconTable();
+    String json = dataJson(primary, *table, snap.station, millis());
+    request->send(200, "application/json", json);
+  });
+  
+  // Control endpoints - optional ?id=<beaconId> selects the collar (default: primary beacon)
+  onTimedRoute("/led", HTTP_GET, [](AsyncWebServerRequest *request){
+    String target = request->hasParam("id") ? request->getParam("id")->value() : String(stationSnapshot.read().primary.beaconId);
+    if (target.isEmpty()) {
+      request->send(409, "text/plain", "No beacon to control");
+      return;
+    }
+    uint32_t beaconId;
+    if (!parseBeaconId(target.c_str(), beaconId)) {
+      request->send(400, "text/plain", "Invalid beacon ID");
+      return;
+    }
+    Serial.println("LED toggle requested via web for " + target);
+    
+    bool ledOn, buzzerOn;
+    getReportedControlState(beaconId, ledOn, buzzerOn);
+    lockControl();
+    getDesiredControlState(beaconId, ledOn, buzzerOn);
+    // Queued - will be sent in this beacon's next receive window
+    ControlCommand* cmd = enqueueControl(beaconId, !ledOn, buzzerOn);
+    String json = cmd ? controlCommandToJson(*cmd) : "";
+    unlockControl();
+    
+    if (json.isEmpty()) {
+      request->send(503, "text/plain", "Control queue full");
+      return;
+    }
+    request->send(200, "application/json", json);
+  });
+  
+  onTimedRoute("/buzzer", HTTP_GET, [](AsyncWebServerRequest *request){
+    String target = request->hasParam("id") ? request->getParam("id")->value() : String(stationSnapshot.read().primary.beaconId);
+    if (target.isEmpty()) {
+      request->send(409, "text/plain", "No beacon to control");
+      return;
+    }
+    uint32_t beaconId;
+    if (!parseBeaconId(target.c_str(), beaconId)) {
+      request->send(400, "text/plain", "Invalid beacon ID");
+      return;
+    }
+    Serial.println("Buzzer toggle requested via web for " + target);
+    
+    bool ledOn, buzzerOn;
+    getReportedControlState(beaconId, ledOn, buzzerOn);
+    lockControl();
+    getDesiredControlState(beaconId, ledOn, buzzerOn);
+    // Queued - will be sent in this beacon's next receive window
+    ControlCommand* cmd = enqueueControl(beaconId, ledOn, !buzzerOn);
+    String json = cmd ? controlCommandToJson(*cmd) : "";
+    unlockControl();
+    
+    if (json.isEmpty()) {
+      request->send(503, "text/plain", "Control queue full");
+      return;
+    }
+    request->send(200, "application/json", json);
+  });
+  
+  // Control command status - all tracked commands, or one with ?cmd=<id>
+  onTimedRoute("/api/control/status", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (request->hasParam("cmd")) {
+      lockControl();
+      ControlCommand* cmd = findControlById(request->getParam("cmd")->value().toInt());
+      String json = cmd ? controlCommandToJson(*cmd) : "";
+      unlockControl();
+      
+      if (json.isEmpty()) {
+        request->send(404, "text/plain", "Command not found");
+        return;
+      }
+      request->send(200, "application/json", json);
+      return;
+    }
     
-    // Include primary beacon data (backward compatibility)
-    json += "\"hasData\":" + String(latestBeacon.hasData ? "true" : "false") + ",";
-    json += "\"beaconId\":\"" + String(latestBeacon.beaconId) + "\",";
-    json += "\"name\":\"" + getBeaconName(latestBeacon.beaconId) + "\",";
-    json += "\"latitude\":" + String(latestBeacon.latitude, 6) + ",";
-    json += "\"longitude\":" + String(latestBeacon.longitude, 6) + ",";
-    json += "\"hdop\":" + String(latestBeacon.hdop, 2) + ",";
-    json += "\"sats\":" + String(latestBeacon.sats) + ",";
-    json += "\"battery\":" + String(latestBeacon.batteryVoltage, 2) + ",";
-    json += "\"rssi\":" + String(latestBeacon.rssi, 1) + ",";
-    json += "\"snr\":" + String(latestBeacon.snr, 1) + ",";
-    json += "\"ledOn\":" + String(latestBeacon.ledOn ? "true" : "false") + ",";
-    json += "\"buzzerOn\":" + String(latestBeacon.buzzerOn ? "true" : "false") + ",";
-    json += "\"lastControlReceived\":" + String(latestBeacon.lastControlReceived) + ",";
-    json += "\"speed\":" + String(latestBeacon.speed, 2) + ",";
-    json += "\"altitude\":" + String(latestBeacon.altitude, 1) + ",";
-    json += "\"lastUpdate\":" + String(latestBeacon.lastUpdate) + ",";
-    
-    // Add all beacons data
-    json += "\"beacons\":[";
+    String json = "{\"commands\":[";
     bool first = true;
-    for (const auto& pair : beacons) {
+    lockControl();
+    for (uint8_t i = 0; i < CONTROL_COMMAND_SLOTS; i++) {
+      if (controlCommands[i].state == CMD_FREE) continue;
       if (!first) json += ",";
-      const LatestBeaconData& b = pair.second;
-      json += "{";
-      json += "\"id\":\"" + String(b.beaconId) + "\",";
-      json += "\"name\":\"" + getBeaconName(b.beaconId) + "\",";
-      json += "\"latitude\":" + String(b.latitude, 6) + ",";
-      json += "\"longitude\":" + String(b.longitude, 6) + ",";
-      json += "\"hdop\":" + String(b.hdop, 2) + ",";
-      json += "\"sats\":" + String(b.sats) + ",";
-      json += "\"battery\":" + String(b.batteryVoltage, 2) + ",";
-      json += "\"rssi\":" + String(b.rssi, 1) + ",";
-      json += "\"snr\":" + String(b.snr, 1) + ",";
-      json += "\"speed\":" + String(b.speed, 2) + ",";
-      json += "\"altitude\":" + String(b.altitude, 1) + ",";
-      json += "\"lastUpdate\":" + String(b.lastUpdate) + ",";
-      json += "\"hasData\":" + String(b.hasData ? "true" : "false");
-      json += "}";
+      json += controlCommandToJson(controlCommands[i]);
       first = false;
     }
+    unlockControl();
     json += "],";
-    
-    // Station data
-    json += "\"station\":{";
-    json += "\"hasValidFix\":" + String(stationLocation.hasValidFix ? "true" : "false") + ",";
-    json += "\"latitude\":" + String(stationLocation.latitude, 6) + ",";
-    json += "\"longitude\":" + String(stationLocation.longitude, 6) + ",";
-    json += "\"hdop\":" + String(stationLocation.hdop, 2) + ",";
-    json += "\"sats\":" + String(stationLocation.sats) + ",";
-    json += "\"altitude\":" + String(stationLocation.altitude, 1) + ",";
-    json += "\"lastUpdate\":" + String(stationLocation.lastUpdate);
-    json += "},";
     json += "\"serverTime\":" + String(millis());
     json += "}";
     request->send(200, "application/json", json);
   });
   
-  // Control endpoints
-  server.on("/led", HTTP_GET, [](AsyncWebServerRequest *request){
-    Serial.println("LED toggle requested via web");
-    // Toggle LED state
-    beaconControl.ledOn = !beaconControl.ledOn;
-    // Mark control as pending - will be sent after next beacon reception
-    beaconControl.pendingControl = true;
-    Serial.print("LED set to: ");
-    Serial.println(beaconControl.ledOn ? "ON" : "OFF");
-    request->send(200, "text/plain", "OK");
-  });
-  
-  server.on("/buzzer", HTTP_GET, [](AsyncWebServerRequest *request){
-    Serial.println("Buzzer toggle requested via web");
-    // Toggle buzzer state
-    beaconControl.buzzerOn = !beaconControl.buzzerOn;
-    // Mark control as pending - will be sent after next beacon reception
-    beaconControl.pendingControl = true;
-    Serial.print("Buzzer set to: ");
-    Serial.println(beaconControl.buzzerOn ? "ON" : "OFF");
-    request->send(200, "text/plain", "OK");
-  });
-  
-  server.on("/reset-wifi", HTTP_GET, [](AsyncWebServerRequest *request){
+  onTimedRoute("/reset-wifi", HTTP_GET, [](AsyncWebServerRequest *request){
     Serial.println("WiFi reset requested via web");
     request->send(200, "text/plain", "Resetting WiFi and rebooting...");
     
@@ -1384,7 +3623,7 @@ void setupWiFiAndWebServer() {
   // Statistics API endpoints - IMPORTANT: More specific routes first!
   
   // Export stats file as CSV
-  server.on("/api/stats/export", HTTP_GET, [](AsyncWebServerRequest *request){
+  onTimedRoute("/api/stats/export", HTTP_GET, [](AsyncWebServerRequest *request){
     if (!LittleFS.exists(STATS_FILE)) {
       request->send(404, "text/plain", "Stats file not found");
       return;
@@ -1402,88 +3641,127 @@ void setupWiFiAndWebServer() {
   });
   
   // Clear stats file
-  server.on("/api/stats/clear", HTTP_POST, [](AsyncWebServerRequest *request){
-    LittleFS.remove(STATS_FILE);
-    Serial.println("Stats file cleared");
-    
-    // Reinitialize with fresh log
-    logStats();
-    
+  onTimedRoute("/api/stats/clear", HTTP_POST, [](AsyncWebServerRequest *request){
+    if (!queueStorageClear(STORE_CLEAR_STATS)) {
+      request->send(503, "text/plain", "Storage busy, try again");
+      return;
+    }
     request->send(200, "text/plain", "Stats cleared");
   });
   
   // Get stats as JSON (for dashboard)
-  server.on("/api/stats", HTTP_GET, [](AsyncWebServerRequest *request){
-    uint32_t now = millis();
-    uint32_t uptime = (now - bootTime) / 1000;
-    float stationBattery = readBatteryVoltage();
-    uint32_t beaconLastSeen = latestBeacon.hasData ? (now - latestBeacon.lastUpdate) / 1000 : 0;
+  // Prometheus scrape target (see metrics.h)
+  onTimedRoute("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+    metricHeapFree.set(ESP.getFreeHeap());
+    metricHeapMinFree.set(ESP.getMinFreeHeap());
+    metricHeapLargest.set(ESP.getMaxAllocHeap());
     
-    // Read stats file to calculate aggregates
-    float stationAvgBat = 0, stationMinBat = 5.0, stationMaxBat = 0;
-    float beaconAvgBat = 0, beaconMinBat = 5.0, beaconMaxBat = 0;
-    int dataPoints = 0;
-    uint32_t totalUptime = 0;
+    String text;
+    text.reserve(8192);
+    renderMetrics(text);
     
-    File file = LittleFS.open(STATS_FILE, FILE_READ);
-    if (file) {
-      file.readStringUntil('\n'); // Skip header
-      while (file.available()) {
-        String line = file.readStringUntil('\n');
-        if (line.length() > 0) {
-          // Parse: timestamp,stationUptime,stationBattery,beaconUptime,beaconBattery
-          int idx1 = line.indexOf(',');
-          int idx2 = line.indexOf(',', idx1 + 1);
-          int idx3 = line.indexOf(',', idx2 + 1);
-          int idx4 = line.indexOf(',', idx3 + 1);
-          
-          if (idx1 > 0 && idx2 > 0 && idx3 > 0 && idx4 > 0) {
-            uint32_t uptimeVal = line.substring(idx1 + 1, idx2).toInt();
-            float staBat = line.substring(idx2 + 1, idx3).toFloat();
-            float beaBat = line.substring(idx4 + 1).toFloat();
-            
-            totalUptime = max(totalUptime, uptimeVal);
-            stationAvgBat += staBat;
-            beaconAvgBat += beaBat;
-            stationMinBat = min(stationMinBat, staBat);
-            stationMaxBat = max(stationMaxBat, staBat);
-            if (beaBat > 0) {
-              beaconMinBat = min(beaconMinBat, beaBat);
-              beaconMaxBat = max(beaconMaxBat, beaBat);
-            }
-            dataPoints++;
-          }
-        }
-      }
-      file.close();
+    // Per-beacon counts live in the beacon table, not the registry
+    std::unique_ptr<BeaconTable> table = readBeaconTable();
+    text += "# HELP paw_beacon_frames_received_total Frames accepted per beacon\n";
+    text += "# TYPE paw_beacon_frames_received_total counter\n";
+    for (uint8_t i = 0; i < table->size(); i++) {
+      const LatestBeaconData& b = table->at(i);
+      if (b.rxFrames == 0) continue;
+      text += "paw_beacon_frames_received_total{beacon=\"" + String(b.beaconId) + "\"} " + String(b.rxFrames) + "\n";
     }
     
-    if (dataPoints > 0) {
-      stationAvgBat /= dataPoints;
-      beaconAvgBat /= dataPoints;
-    }
+    request->send(200, "text/plain; version=0.0.4", text);
+  });
+  
+  // Recent log records (see "Logging"); poll with since=<next of the last response>
+  onTimedRoute("/api/logs", HTTP_GET, [](AsyncWebServerRequest *request){
+    uint32_t since = request->hasParam("since") ? request->getParam("since")->value().toInt() : 0;
+    request->send(200, "application/json", logsJson(since));
+  });
+  
+#if PAW_PROFILE
+  // Section timings for /profile.html (see profiler.h)
+  onTimedRoute("/api/profile", HTTP_GET, [](AsyncWebServerRequest *request){
+    uint32_t cpuMHz = ESP.getCpuFreqMHz();
+    uint64_t elapsedCycles = (uint64_t)(millis() - profileSinceMs) * cpuMHz * 1000;
+    if (elapsedCycles == 0) elapsedCycles = 1;
     
-    // Get file sizes
-    size_t statsFileSize = 0;
-    File statsFile = LittleFS.open(STATS_FILE, FILE_READ);
-    if (statsFile) {
-      statsFileSize = statsFile.size();
-      statsFile.close();
+    String json = "{";
+    json += "\"cpuMHz\":" + String(cpuMHz) + ",";
+    json += "\"recording\":" + String(profileRecording().load() ? "true" : "false") + ",";
+    json += "\"sinceMs\":" + String(millis() - profileSinceMs) + ",";
+    json += "\"overheadCycles\":" + String(profileOverhead) + ",";
+    json += "\"zones\":[";
+    for (const ProfileZone* z = ProfileZone::first(); z; z = z->next) {
+      uint32_t count = z->count;
+      if (z != ProfileZone::first()) json += ",";
+      json += "{";
+      json += "\"name\":\"" + String(z->name) + "\",";
+      json += "\"count\":" + String(count) + ",";
+      json += "\"minUs\":" + String(count ? (float)z->minCycles / cpuMHz : 0.0f, 1) + ",";
+      json += "\"avgUs\":" + String(count ? (float)z->totalCycles / count / cpuMHz : 0.0f, 1) + ",";
+      json += "\"p99Us\":" + String((float)z->percentile(0.99f) / cpuMHz, 1) + ",";
+      json += "\"maxUs\":" + String((float)z->maxCycles / cpuMHz, 1) + ",";
+      json += "\"sharePercent\":" + String(z->totalCycles * 100.0f / elapsedCycles, 3);
+      json += "}";
     }
-    
-    size_t historyFileSize = 0;
-    File historyFile = LittleFS.open(HISTORY_FILE, FILE_READ);
-    if (historyFile) {
-      historyFileSize = historyFile.size();
-      historyFile.close();
+    json += "],";
+    // Against one core's cycles, so an upper bound
+    json += "\"overheadPercent\":" + String(profileOverheadPercent(profileOverhead, elapsedCycles), 4);
+    json += "}";
+    request->send(200, "application/json", json);
+  });
+  
+  onTimedRoute("/api/profile/reset", HTTP_POST, [](AsyncWebServerRequest *request){
+    for (ProfileZone* z = ProfileZone::first(); z; z = z->next) {
+      z->requestReset();
     }
-    
-    size_t configFileSize = 0;
-    File configFile = LittleFS.open(BEACON_CONFIG_FILE, FILE_READ);
-    if (configFile) {
-      configFileSize = configFile.size();
-      configFile.close();
+    profileSinceMs = millis();
+    profileRecording().store(true);
+    request->send(200, "text/plain", "OK");
+  });
+#endif
+  
+  // Micro-benchmarks (bench_suite.h): POST starts a run of a few seconds, GET returns the last result
+  onTimedRoute("/api/bench", HTTP_POST, [](AsyncWebServerRequest *request){
+    if (benchRunning) {
+      request->send(409, "text/plain", "Benchmarks already running");
+      return;
+    }
+    benchRunning = true;
+    if (xTaskCreatePinnedToCore(benchTask, "bench", BENCH_TASK_STACK, NULL, BENCH_TASK_PRIORITY,
+                                NULL, APP_CORE) != pdPASS) {
+      benchRunning = false;
+      request->send(500, "text/plain", "Failed to start benchmarks");
+      return;
+    }
+    request->send(202, "text/plain", "Benchmarks started");
+  });
+  
+  onTimedRoute("/api/bench", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (benchRunning) {
+      request->send(202, "application/json", "{\"running\":true}");
+      return;
+    }
+    if (benchResult.length() == 0) {
+      request->send(404, "text/plain", "No benchmark run yet");
+      return;
     }
+    request->send(200, "application/json", benchResult);
+  });
+  
+  onTimedRoute("/api/stats", HTTP_GET, [](AsyncWebServerRequest *request){
+    StationSnapshot snap = stationSnapshot.read();
+    uint32_t now = millis();
+    uint32_t uptime = (now - bootTime) / 1000;
+    float stationBattery = snap.stationBattery;
+    BatteryReading stationBatteryReading = battery.read();
+    uint32_t beaconLastSeen = snap.primary.hasData ? (now - snap.primary.lastUpdate) / 1000 : 0;
+    
+    // Files as storageTask last scanned them
+    storageSummaryWantedAt = now;
+    std::unique_ptr<StorageSummary> files(new StorageSummary());
+    storageSummary.read(*files);
     
     // Build JSON response
     String json = "{";
@@ -1494,77 +3772,117 @@ void setupWiFiAndWebServer() {
     json += "\"totalPsram\":" + String(ESP.getPsramSize()) + ",";
     json += "\"sketchSize\":" + String(ESP.getSketchSize()) + ",";
     json += "\"freeSketch\":" + String(ESP.getFreeSketchSpace()) + ",";
-    json += "\"statsFileSize\":" + String(statsFileSize) + ",";
-    json += "\"historyFileSize\":" + String(historyFileSize) + ",";
-    json += "\"configFileSize\":" + String(configFileSize);
+    json += "\"statsFileSize\":" + String(files->statsFileSize) + ",";
+    json += "\"historyFileSize\":" + String(files->historyFileSize) + ",";
+    json += "\"configFileSize\":" + String(files->configFileSize);
     json += "},";
     json += "\"station\":{";
     json += "\"uptime\":" + String(uptime) + ",";
     json += "\"battery\":" + String(stationBattery, 2) + ",";
-    json += "\"rebootCount\":" + String(rebootCount);
+    json += "\"batterySoc\":" + String(stationBatteryReading.socPercent) + ",";
+    json += "\"dischargeMvPerHour\":" + (stationBatteryReading.rateValid ? String(stationBatteryReading.mvPerHour, 1) : String("null")) + ",";
+    json += "\"rebootCount\":" + String(rebootCount) + ",";
+    json += "\"resetReason\":" + String((int)resetReason) + ",";
+    json += "\"fastBoot\":" + String(fastBoot ? "true" : "false") + ",";
+    json += "\"setupMs\":" + String(setupDoneMs);
+    json += "},";
+    json += "\"radio\":{";
+    json += "\"framesQueued\":" + String(rxFramesQueued) + ",";
+    json += "\"framesProcessed\":" + String(rxFramesProcessed) + ",";
+    json += "\"framesPerSecond\":" + String(rxFramesPerSecond, 2) + ",";
+    json += "\"queueOverruns\":" + String(rxQueueOverruns) + ",";
+    json += "\"readErrors\":" + String(rxReadErrors) + ",";
+    json += "\"queueDepth\":" + String(rxQueue.size()) + ",";
+    json += "\"queuePeak\":" + String(rxQueuePeak) + ",";
+    json += "\"queueCapacity\":" + String(rxQueue.capacity()) + ",";
+    json += "\"region\":\"" + String(LORA_REGION.name) + "\",";
+    json += "\"cadChecks\":" + String(lbtStats.cadChecks) + ",";
+    json += "\"cadBusy\":" + String(lbtStats.cadBusy) + ",";
+    json += "\"backoffMs\":" + String(lbtStats.backoffMs) + ",";
+    json += "\"txSentBusy\":" + String(lbtStats.sentBusy) + ",";
+    json += "\"txDropped\":" + String(lbtStats.dropped);
+    json += "},";
+    json += "\"airtime\":{";
+    json += "\"windowS\":" + String(DUTY_CYCLE_WINDOW_MS / 1000) + ",";
+    json += "\"budgetPercent\":" + String(AIRTIME_BUDGET_PERCENT) + ",";
+    json += "\"deferred\":" + String(airtimeDeferred) + ",";
+    json += "\"subBands\":[";
+    for (uint8_t i = 0; i < LORA_REGION.subBandCount; i++) {
+      const SubBand &band = LORA_REGION.subBands[i];
+      if (i > 0) json += ",";
+      json += "{\"name\":\"" + String(band.name) + "\",";
+      json += "\"dutyCycle\":" + String(band.dutyCyclePermille / 10.0, 1) + ",";
+      json += "\"active\":" + String(i == TX_SUB_BAND ? "true" : "false") + ",";
+      json += "\"usedMs\":" + String(airtimeLedgers[i].usedUs(now) / 1000) + ",";
+      json += "\"budgetMs\":" + String(airtimeBudgetUs(i) / 1000) + ",";
+      json += "\"totalMs\":" + String(airtimeLedgers[i].totalUs / 1000);
+      json += "}";
+    }
+    json += "]";
+    json += "},";
+    json += "\"uplink\":{";
+    json += "\"queued\":" + String(uplink.stats.queued) + ",";
+    json += "\"sent\":" + String(uplink.stats.sent) + ",";
+    json += "\"spooled\":" + String(uplink.stats.spooled) + ",";
+    json += "\"dropped\":" + String(uplink.stats.dropped) + ",";
+    json += "\"backlogBytes\":" + String(uplink.stats.backlogBytes) + ",";
+    json += "\"lastHttpCode\":" + String(uplink.stats.lastHttpCode);
+    json += "},";
+    json += "\"serverLink\":{";
+    json += "\"connected\":" + String(serverLinkStats.connected ? "true" : "false") + ",";
+    json += "\"connects\":" + String(serverLinkStats.connects) + ",";
+    json += "\"disconnects\":" + String(serverLinkStats.disconnects) + ",";
+    json += "\"controlsPushed\":" + String(serverLinkStats.controlsPushed) + ",";
+    json += "\"lastControlMs\":" + String(serverLinkStats.lastControlMs) + ",";
+    json += "\"lastControlEndToEndMs\":" + String(serverLinkStats.lastControlEndToEndMs) + ",";
+    json += "\"lastAckMs\":" + String(uplink.stats.lastAckMs);
     json += "},";
+    GpsFix stationFix = gpsFix.read();
+    json += "\"gps\":{";
+    json += "\"sentences\":" + String(gpsStats.sentences) + ",";
+    json += "\"sentencesPerSecond\":" + String(gpsStats.sentencesPerSecond, 2) + ",";
+    json += "\"failedChecksum\":" + String(gpsStats.failedChecksum) + ",";
+    json += "\"rxOverruns\":" + String(gpsStats.rxOverruns) + ",";
+    json += "\"fixAgeMs\":" + String(stationFix.valid ? gpsFixAgeMs(stationFix) : 0);
+    json += "},";
+    json += "\"tasks\":[";
+    json += taskMetricsJson("radio", radioTaskHandle, rxQueue.size(), rxQueuePeak, RX_QUEUE_DEPTH, rxQueueOverruns) + ",";
+    json += taskMetricsJson("loop", stationLoopHandle, 0, 0, 0, 0) + ",";
+    json += taskMetricsJson("gps", gpsTaskHandle, 0, 0, 0, 0) + ",";
+    json += taskMetricsJson("battery", batteryTaskHandle, 0, 0, 0, 0) + ",";
+    json += taskMetricsJson("log", logTaskHandle, 0, 0, 0, 0) + ",";
+    json += taskMetricsJson("storage", storageTaskHandle, storageQueue ? uxQueueMessagesWaiting(storageQueue) : 0,
+                            storageQueuePeak, STORAGE_QUEUE_DEPTH, storageJobsDropped) + ",";
+    json += taskMetricsJson("network", networkTaskHandle, uplinkQueue ? uxQueueMessagesWaiting(uplinkQueue) : 0,
+                            uplink.stats.queuePeak, UPLINK_QUEUE_DEPTH, uplink.stats.dropped) + ",";
+    json += taskMetricsJson("ui", uiTaskHandle, 0, 0, 0, 0);
+    json += "],";
+    json += "\"snapshotVersion\":" + String(stationSnapshot.version()) + ",";
     json += "\"beacon\":{";
-    json += "\"battery\":" + String(latestBeacon.batteryVoltage, 2) + ",";
-    json += "\"rssi\":" + String(latestBeacon.rssi, 1) + ",";
+    json += "\"battery\":" + String(snap.primary.batteryVoltage, 2) + ",";
+    json += "\"rssi\":" + String(snap.primary.rssi, 1) + ",";
     json += "\"lastSeen\":" + String(beaconLastSeen);
     json += "},";
     json += "\"stats\":{";
     json += "\"station\":{";
-    json += "\"avgBattery\":" + String(stationAvgBat, 2) + ",";
-    json += "\"minBattery\":" + String(stationMinBat, 2) + ",";
-    json += "\"maxBattery\":" + String(stationMaxBat, 2) + ",";
-    json += "\"totalUptime\":" + String(totalUptime);
+    json += "\"avgBattery\":" + String(files->stationAvgBattery, 2) + ",";
+    json += "\"minBattery\":" + String(files->stationMinBattery, 2) + ",";
+    json += "\"maxBattery\":" + String(files->stationMaxBattery, 2) + ",";
+    json += "\"totalUptime\":" + String(files->totalUptime);
     json += "},";
     json += "\"beacon\":{";
-    json += "\"avgBattery\":" + String(beaconAvgBat, 2) + ",";
-    json += "\"minBattery\":" + String(beaconMinBat, 2) + ",";
-    json += "\"maxBattery\":" + String(beaconMaxBat, 2) + ",";
-    json += "\"dataPoints\":" + String(dataPoints);
+    json += "\"avgBattery\":" + String(files->beaconAvgBattery, 2) + ",";
+    json += "\"minBattery\":" + String(files->beaconMinBattery, 2) + ",";
+    json += "\"maxBattery\":" + String(files->beaconMaxBattery, 2) + ",";
+    json += "\"dataPoints\":" + String(files->dataPoints);
     json += "}";
     json += "},";
     json += "\"history\":[";
     
-    // Read history data from HISTORY_FILE (last 100 entries) for battery chart
-    // Format: timestamp,beaconId,latitude,longitude,speed,altitude,battery,rssi,snr
-    File histFile = LittleFS.open(HISTORY_FILE, FILE_READ);
-    if (histFile) {
-      histFile.readStringUntil('\n'); // Skip header
-      String entries[100];
-      int entryCount = 0;
-      
-      // Read all entries first
-      while (histFile.available() && entryCount < 100) {
-        String line = histFile.readStringUntil('\n');
-        if (line.length() > 0) {
-          // Parse: timestamp,beaconId,latitude,longitude,speed,altitude,battery,rssi,snr
-          int idx[8];
-          idx[0] = line.indexOf(',');
-          for (int i = 1; i < 8; i++) {
-            idx[i] = line.indexOf(',', idx[i-1] + 1);
-          }
-          
-          if (idx[0] > 0 && idx[6] > 0) {
-            String timestamp = line.substring(0, idx[0]);
-            String beaconId = line.substring(idx[0] + 1, idx[1]);
-            String battery = line.substring(idx[5] + 1, idx[6]);
-            
-            String entry = "{";
-            entry += "\"timestamp\":" + timestamp + ",";
-            entry += "\"beaconId\":\"" + beaconId + "\",";
-            entry += "\"beaconBattery\":" + battery + ",";
-            entry += "\"stationBattery\":" + String(stationBattery, 2); // Current station battery
-            entry += "}";
-            entries[entryCount++] = entry;
-          }
-        }
-      }
-      histFile.close();
-      
-      // Add last 100 entries to JSON
-      for (int i = max(0, entryCount - 100); i < entryCount; i++) {
-        if (i > max(0, entryCount - 100)) json += ",";
-        json += entries[i];
-      }
+    // Newest history rows for the battery chart
+    for (uint8_t i = 0; i < files->historyCount; i++) {
+      if (i > 0) json += ",";
+      json += statsHistoryEntryJson(files->history[i], stationBattery);
     }
     
     json += "]";
@@ -1576,18 +3894,21 @@ void setupWiFiAndWebServer() {
   // Beacon Configuration API endpoints
   
   // Get list of all known beacons
-  server.on("/api/beacons/list", HTTP_GET, [](AsyncWebServerRequest *request){
+  onTimedRoute("/api/beacons/list", HTTP_GET, [](AsyncWebServerRequest *request){
+    std::unique_ptr<BeaconTable> table = readBeaconTable();
     String json = "{\"beacons\":[";
     bool first = true;
-    for (const auto& pair : beacons) {
+    for (uint8_t i = 0; i < table->size(); i++) {
+      const LatestBeaconData& b = table->at(i);
+      if (!b.hasData) continue;
       if (!first) json += ",";
+      first = false;
       json += "{";
-      json += "\"id\":\"" + String(pair.first) + "\",";
-      json += "\"name\":\"" + getBeaconName(pair.first) + "\",";
-      json += "\"lastSeen\":" + String(pair.second.lastUpdate) + ",";
-      json += "\"hasData\":" + String(pair.second.hasData ? "true" : "false");
+      json += "\"id\":\"" + String(b.beaconId) + "\",";
+      json += "\"name\":\"" + String(b.name) + "\",";
+      json += "\"lastSeen\":" + String(b.lastUpdate) + ",";
+      json += "\"hasData\":" + String(b.hasData ? "true" : "false");
       json += "}";
-      first = false;
     }
     json += "],";
     json += "\"disconnectTimeout\":" + String(beaconDisconnectTimeout / 1000) + ","; // Send as seconds
@@ -1597,7 +3918,7 @@ void setupWiFiAndWebServer() {
   });
   
   // Update beacon name
-  server.on("/api/beacons/update", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+  onTimedRoute("/api/beacons/update", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
     [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
       // Parse JSON body: {"id":123,"name":"My Dog"}
       String body = String((char*)data).substring(0, len);
@@ -1618,16 +3939,21 @@ void setupWiFiAndWebServer() {
       int nameEnd = body.indexOf("\"", nameStart);
       String beaconName = body.substring(nameStart, nameEnd);
       
-      // Update beacon name
-      beaconNames[beaconId] = beaconName;
-      saveBeaconConfig();
+      // loop() applies the rename and saves the config
+      BeaconRename rename{};
+      strncpy(rename.beaconId, beaconId.c_str(), sizeof(rename.beaconId) - 1);
+      strncpy(rename.name, beaconName.c_str(), sizeof(rename.name) - 1);
+      if (xQueueSend(beaconRenameQueue, &rename, 0) != pdTRUE) {
+        request->send(503, "text/plain", "Busy, try again");
+        return;
+      }
       
-      Serial.printf("Beacon name updated: %s -> %s\n", beaconId.c_str(), beaconName.c_str());
+      Serial.printf("Beacon name update queued: %s -> %s\n", rename.beaconId, rename.name);
       request->send(200, "text/plain", "OK");
     });
   
   // Update system settings
-  server.on("/api/settings/update", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+  onTimedRoute("/api/settings/update", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
     [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
       // Parse JSON body: {"disconnectTimeout":90}
       String body = String((char*)data).substring(0, len);
@@ -1644,7 +3970,7 @@ void setupWiFiAndWebServer() {
             uint32_t timeout = timeoutStr.toInt();
             if (timeout >= 10 && timeout <= 600) { // 10 seconds to 10 minutes
               beaconDisconnectTimeout = timeout * 1000;
-              saveBeaconConfig();
+              beaconConfigDirty = true;
               Serial.printf("Disconnect timeout updated: %d seconds\n", timeout);
               request->send(200, "text/plain", "OK");
               return;
@@ -1657,7 +3983,7 @@ void setupWiFiAndWebServer() {
     });
   
   // Get beacon configuration file
-  server.on("/api/beacons/config", HTTP_GET, [](AsyncWebServerRequest *request){
+  onTimedRoute("/api/beacons/config", HTTP_GET, [](AsyncWebServerRequest *request){
     if (!LittleFS.exists(BEACON_CONFIG_FILE)) {
       request->send(200, "application/json", "{\"beacons\":[]}");
       return;
@@ -1677,7 +4003,7 @@ void setupWiFiAndWebServer() {
   // History API endpoints - IMPORTANT: More specific routes first!
   
   // Export history as GPX file
-  server.on("/api/history/export/gpx", HTTP_GET, [](AsyncWebServerRequest *request){
+  onTimedRoute("/api/history/export/gpx", HTTP_GET, [](AsyncWebServerRequest *request){
     if (!LittleFS.exists(HISTORY_FILE)) {
       request->send(404, "text/plain", "History file not found");
       return;
@@ -1699,32 +4025,7 @@ void setupWiFiAndWebServer() {
     file.readStringUntil('\n'); // Skip header
     while (file.available()) {
       String line = file.readStringUntil('\n');
-      if (line.length() > 0) {
-        // Parse: timestamp,latitude,longitude,speed,altitude,battery,rssi,snr
-        int idx1 = line.indexOf(',');
-        int idx2 = line.indexOf(',', idx1 + 1);
-        int idx3 = line.indexOf(',', idx2 + 1);
-        int idx4 = line.indexOf(',', idx3 + 1);
-        int idx5 = line.indexOf(',', idx4 + 1);
-        
-        if (idx1 > 0 && idx2 > 0 && idx3 > 0 && idx4 > 0 && idx5 > 0) {
-          uint32_t timestamp = line.substring(0, idx1).toInt();
-          String lat = line.substring(idx1 + 1, idx2);
-          String lon = line.substring(idx2 + 1, idx3);
-          String alt = line.substring(idx4 + 1, idx5);
-          
-          // Convert Unix timestamp to ISO 8601
-          time_t ts = timestamp;
-          struct tm* timeinfo = gmtime(&ts);
-          char timeStr[25];
-          strftime(timeStr, sizeof(timeStr), "%Y-%m-%dT%H:%M:%SZ", timeinfo);
-          
-          gpx += "      <trkpt lat=\"" + lat + "\" lon=\"" + lon + "\">\n";
-          gpx += "        <ele>" + alt + "</ele>\n";
-          gpx += "        <time>" + String(timeStr) + "</time>\n";
-          gpx += "      </trkpt>\n";
-        }
-      }
+      gpx += gpxTrackPoint(line);
     }
     file.close();
     
@@ -1738,7 +4039,7 @@ void setupWiFiAndWebServer() {
   });
   
   // Export history file as CSV
-  server.on("/api/history/export", HTTP_GET, [](AsyncWebServerRequest *request){
+  onTimedRoute("/api/history/export", HTTP_GET, [](AsyncWebServerRequest *request){
     if (!LittleFS.exists(HISTORY_FILE)) {
       request->send(404, "text/plain", "History file not found");
       return;
@@ -1756,14 +4057,16 @@ void setupWiFiAndWebServer() {
   });
   
   // Clear history file
-  server.on("/api/history/clear", HTTP_POST, [](AsyncWebServerRequest *request){
-    LittleFS.remove(HISTORY_FILE);
-    Serial.println("History file cleared");
+  onTimedRoute("/api/history/clear", HTTP_POST, [](AsyncWebServerRequest *request){
+    if (!queueStorageClear(STORE_CLEAR_HISTORY)) {
+      request->send(503, "text/plain", "Storage busy, try again");
+      return;
+    }
     request->send(200, "text/plain", "History cleared");
   });
   
   // Get history as CSV (frontend will parse it)
-  server.on("/api/history", HTTP_GET, [](AsyncWebServerRequest *request){
+  onTimedRoute("/api/history", HTTP_GET, [](AsyncWebServerRequest *request){
     if (!LittleFS.exists(HISTORY_FILE)) {
       request->send(200, "text/csv", "timestamp,latitude,longitude,speed,altitude,battery,rssi,snr\n");
       return;
@@ -1780,8 +4083,48 @@ void setupWiFiAndWebServer() {
     request->send(response);
   });
   
+  // Capture of NMEA and received frames for the replay tool - more specific routes first
+  onTimedRoute("/api/capture/start", HTTP_POST, [](AsyncWebServerRequest *request){
+    captureRequest = CAPTURE_REQ_START;
+    request->send(200, "text/plain", "Capture starting");
+  });
+  
+  onTimedRoute("/api/capture/stop", HTTP_POST, [](AsyncWebServerRequest *request){
+    captureRequest = CAPTURE_REQ_STOP;
+    request->send(200, "text/plain", "Capture stopping");
+  });
+  
+  onTimedRoute("/api/capture/download", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (!LittleFS.exists(CAPTURE_FILE)) {
+      request->send(404, "text/plain", "No capture");
+      return;
+    }
+    
+    File file = LittleFS.open(CAPTURE_FILE, FILE_READ);
+    if (!file) {
+      request->send(500, "text/plain", "Failed to open capture file");
+      return;
+    }
+    
+    AsyncWebServerResponse *response = request->beginResponse(file, CAPTURE_FILE, "application/octet-stream", true);
+    response->addHeader("Content-Disposition", "attachment; filename=capture.bin");
+    request->send(response);
+  });
+  
+  onTimedRoute("/api/capture", HTTP_GET, [](AsyncWebServerRequest *request){
+    String json = "{";
+    json += "\"active\":" + String(captureActive ? "true" : "false") + ",";
+    json += "\"seconds\":" + String(captureActive ? captureMillis() / 1000 : 0) + ",";
+    json += "\"bytes\":" + String(captureBytes) + ",";
+    json += "\"maxBytes\":" + String(CAPTURE_MAX_BYTES) + ",";
+    json += "\"records\":" + String(captureRecords) + ",";
+    json += "\"dropped\":" + String(captureDropped);
+    json += "}";
+    request->send(200, "application/json", json);
+  });
+  
   // Central server configuration API
-  server.on("/api/server/config", HTTP_GET, [](AsyncWebServerRequest *request){
+  onTimedRoute("/api/server/config", HTTP_GET, [](AsyncWebServerRequest *request){
     String json = "{";
     json += "\"serverUrl\":\"" + centralServerUrl + "\",";
     json += "\"deviceId\":\"" + deviceId + "\",";
@@ -1790,7 +4133,7 @@ void setupWiFiAndWebServer() {
     request->send(200, "application/json", json);
   });
   
-  server.on("/api/server/config", HTTP_POST, [](AsyncWebServerRequest *request){
+  onTimedRoute("/api/server/config", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("serverUrl", true)) {
       String url = request->getParam("serverUrl", true)->value();
       saveServerConfig(url);
@@ -1807,7 +4150,7 @@ void setupWiFiAndWebServer() {
   });
   
   // Handle favicon to prevent 404 errors
-  server.on("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest *request){
+  onTimedRoute("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest *request){
     // Return empty 204 No Content to prevent errors
     request->send(204);
   });
@@ -1829,12 +4172,27 @@ void setupWiFiAndWebServer() {
   }
 }
 
+// Forward declarations
+void radioTask(void *param);
+void storageTask(void *param);
+void networkTask(void *param);
+void uiTask(void *param);
+void publishStationSnapshot();
+void publishBeaconTable();
+
 void setupPupStation() {
   Serial.println("\n=== PawTracker PupStation ===");
   
-  initDisplay("PupStation");
+  initDisplay("PupStation", fastBoot ? VEXT_FAST_SETTLE_MS : VEXT_SETTLE_MS);
   initLoRa();
   
+  // From here on only radioTask touches the radio
+  controlMutex = xSemaphoreCreateMutex();
+  beaconRenameQueue = xQueueCreate(BEACON_RENAME_QUEUE_DEPTH, sizeof(BeaconRename));
+  xTaskCreatePinnedToCore(radioTask, "radio", RADIO_TASK_STACK, NULL,
+                          RADIO_TASK_PRIORITY, &radioTaskHandle, APP_CORE);
+  stationLoopHandle = xTaskGetCurrentTaskHandle();
+  
   Serial.println("Initializing actuators and GPS...");
 
   if (LED_PIN >= 0) pinMode(LED_PIN, OUTPUT);
@@ -1842,7 +4200,8 @@ void setupPupStation() {
   setActuators(false, false);
 
   // Initialize GPS for station
-  GPSSerial.begin(115200, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);
+  beginGpsSerial(115200);
+  startGpsTask(false);
   Serial.println("Station GPS initialized at 115200 baud");
 
   // Setup WiFi and web server
@@ -1861,186 +4220,333 @@ void setupPupStation() {
   initStats();
 
   Serial.println("PupStation ready, listening continuously for beacons...");
+  saveBootCache(ROLE_PUP_STATION, 0);
   Serial.println("PupStation setup complete!");
 
   tft.fillScreen(ST77XX_BLACK);
+  
+#if PAW_PROFILE
+  profileOverhead = profileOverheadCycles();
+  Serial.printf("Profiler: %lu cycles per section\n", (unsigned long)profileOverhead);
+#endif
+  
+  // Hand the slow work to its own tasks (see "Station task pipeline")
+  publishStationSnapshot();
+  publishBeaconTable();
+  storageQueue = xQueueCreate(STORAGE_QUEUE_DEPTH, sizeof(StorageJob));
+  uplinkQueue = xQueueCreate(UPLINK_QUEUE_DEPTH, sizeof(UplinkFix));
+  xTaskCreatePinnedToCore(storageTask, "storage", STORAGE_TASK_STACK, NULL,
+                          STORAGE_TASK_PRIORITY, &storageTaskHandle, PROTOCOL_CORE);
+  xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, NULL,
+                          NETWORK_TASK_PRIORITY, &networkTaskHandle, PROTOCOL_CORE);
+  xTaskCreatePinnedToCore(uiTask, "ui", UI_TASK_STACK, NULL,
+                          UI_TASK_PRIORITY, &uiTaskHandle, APP_CORE);
+}
+
+// Validate data ranges
+bool validateBeaconMessage(const BeaconMessage &msg) {
+  bool validData = beaconDataInRange(msg);
+  
+  if (!validData) {
+    LOG_WARN(LOG_BEACON, "Invalid GPS data from %s: lat %.6f, lon %.6f, sats %u",
+             msg.beaconId, msg.latitude, msg.longitude, msg.sats);
+  }
+  return validData;
 }
 
+// Expects a message that passed validateBeaconMessage()
 void handleIncomingBeacon(const BeaconMessage &msg, float rssi, float snr) {
-  Serial.println("\n=== BEACON RECEIVED ===");
-  Serial.printf("Beacon ID: %s\n", msg.beaconId);
+  // Store in the beacon table
+  LatestBeaconData* entry = registerBeacon(msg.beaconId);
+  if (!entry) return;
+  LatestBeaconData& beacon = *entry;
+  applyBeaconMessage(beacon, msg, rssi, snr, millis());
+  
+  // The first beacon heard stays the primary one (display, legacy API fields)
+  if (!primaryBeacon) {
+    primaryBeacon = &beacon;
+  }
   
-  // Validate data ranges
-  bool validData = true;
-  if (msg.latitude < -90.0 || msg.latitude > 90.0) validData = false;
-  if (msg.longitude < -180.0 || msg.longitude > 180.0) validData = false;
-  if (msg.sats > 50) validData = false;
+  queueUplinkFix(beacon, gpsUnixTime());
   
-  if (!validData) {
-    Serial.println("WARNING: Invalid GPS data received!");
-    Serial.print("Raw values - Lat: ");
-    Serial.print(msg.latitude);
-    Serial.print(", Lon: ");
-    Serial.print(msg.longitude);
-    Serial.print(", Sats: ");
-    Serial.println(msg.sats);
+  LOG_INFO(LOG_BEACON, "Beacon %s: RSSI %.1f dBm, SNR %.1f dB, battery %.2f V",
+           msg.beaconId, rssi, snr, msg.batteryVoltage);
+  LOG_DEBUG(LOG_BEACON, "Beacon %s fix: %.6f, %.6f, alt %.1f m, %.1f km/h, %u sats, HDOP %.1f",
+            msg.beaconId, msg.latitude, msg.longitude, msg.altitude, msg.speed, msg.sats, msg.hdop);
+  LOG_DEBUG(LOG_BEACON, "Beacon %s: uptime %lu s, LED %u, buzzer %u, last control %u",
+            msg.beaconId, msg.uptime, msg.ledOn, msg.buzzerOn, msg.lastControlReceived);
+  
+  
+  // Log to history file (written by storageTask)
+  uint32_t timestamp = gpsUnixTime();
+  if (timestamp == 0) {
+    LOG_DEBUG(LOG_STORAGE, "Skipping history log - no GPS time available");
     return;
   }
-  
-  // Store in beacons map
-  String beaconIdStr = String(msg.beaconId);
-  LatestBeaconData& beacon = beacons[beaconIdStr];
-  beacon.beaconId = beaconIdStr;
-  beacon.latitude = msg.latitude;
-  beacon.longitude = msg.longitude;
-  beacon.hdop = msg.hdop;
-  beacon.sats = msg.sats;
-  beacon.batteryVoltage = msg.batteryVoltage;
-  beacon.ledOn = msg.ledOn;
-  beacon.buzzerOn = msg.buzzerOn;
-  beacon.lastControlReceived = msg.lastControlReceived;
-  beacon.speed = msg.speed;
-  beacon.altitude = msg.altitude;
-  beacon.uptime = msg.uptime;
-  beacon.lastUpdate = millis();
-  beacon.rssi = rssi;
-  beacon.snr = snr;
-  beacon.hasData = true;
-  
-  // If this is a new beacon (not in beaconNames yet), add default name and save
-  if (beaconNames.find(beaconIdStr) == beaconNames.end()) {
-    beaconNames[beaconIdStr] = "Beacon-" + beaconIdStr;
-    saveBeaconConfig();
-    Serial.printf("New beacon detected, saved default name: %s\n", beaconIdStr.c_str());
-  }
-  
-  // Also update latestBeacon for backward compatibility (use first or most recent)
-  if (beacons.size() == 1 || beaconIdStr == latestBeacon.beaconId || latestBeacon.beaconId.isEmpty()) {
-    latestBeacon = beacon;
-  }
-  
-  // System Info
-  Serial.print("Uptime:       ");
-  uint32_t uptimeSeconds = msg.uptime;
-  uint32_t days = uptimeSeconds / 86400;
-  uint32_t hours = (uptimeSeconds % 86400) / 3600;
-  uint32_t minutes = (uptimeSeconds % 3600) / 60;
-  uint32_t seconds = uptimeSeconds % 60;
-  if (days > 0) {
-    Serial.print(days);
-    Serial.print("d ");
-  }
-  if (hours > 0 || days > 0) {
-    Serial.print(hours);
-    Serial.print("h ");
-  }
-  Serial.print(minutes);
-  Serial.print("m ");
-  Serial.print(seconds);
-  Serial.println("s");
-  // Serial.println();
-  
-  // GPS Data
-  Serial.print("Lat:     ");
-  Serial.println(msg.latitude, 6);
-  // Serial.println("°");
-  Serial.print("Lon:    ");
-  Serial.println(msg.longitude, 6);
-  // Serial.println("°");
-  Serial.print("Alt:     ");
-  Serial.print(msg.altitude, 1);
-  Serial.println(" m");
-  Serial.print("Speed:        ");
-  Serial.print(msg.speed, 1);
-  Serial.println(" km/h");
-  Serial.print("Satellites:   ");
-  Serial.println(msg.sats);
-  Serial.print("HDOP:         ");
-  Serial.println(msg.hdop, 1);
-  
-  // Power & Signal
-  Serial.print("Battery:      ");
-  Serial.print(msg.batteryVoltage, 2);
-  Serial.println(" V");
-  Serial.print("RSSI:         ");
-  Serial.print(rssi, 1);
-  Serial.println(" dBm");
-  Serial.print("SNR:          ");
-  Serial.print(snr, 1);
-  Serial.println(" dB");
-  
-  // Control Status
-  Serial.print("LED:          ");
-  Serial.println(msg.ledOn ? "ON" : "OFF");
-  Serial.print("Buzzer:       ");
-  Serial.println(msg.buzzerOn ? "ON" : "OFF");
-  Serial.print("Last Control: ");
-  switch(msg.lastControlReceived) {
-    case 0: Serial.println("None"); break;
-    case 1: Serial.println("LED"); break;
-    case 2: Serial.println("Buzzer"); break;
-    case 3: Serial.println("Both"); break;
-    default: Serial.println("Unknown");
-  }
-  
-  Serial.println("=======================\n");
-  
-  // Log to history file
-  logBeaconHistory(msg, rssi, snr);
-}
-
-void sendControl(bool ledOn, bool buzzerOn, const String& targetBeaconId = "") {
-  ControlMessage ctrl{};
-  ctrl.msgType = 0x10;
-  strncpy(ctrl.beaconId, targetBeaconId.c_str(), sizeof(ctrl.beaconId) - 1); // empty = broadcast to all beacons
-  ctrl.beaconId[sizeof(ctrl.beaconId) - 1] = '\0';
-  ctrl.ledOn = ledOn ? 1 : 0;
-  ctrl.buzzerOn = buzzerOn ? 1 : 0;
-
-  Serial.print("Sending control (LED:");
-  Serial.print(ledOn);
-  Serial.print(", Buzzer:");
-  Serial.print(buzzerOn);
-  Serial.println(")...");
-  
-  int state = radio.transmit((uint8_t *)&ctrl, sizeof(ctrl));
-  if (state == RADIOLIB_ERR_NONE) {
-    Serial.println("Control sent");
+  if (!queueStorageJob(STORE_HISTORY, beaconHistoryRecord(msg, rssi, snr, timestamp))) {
+    LOG_WARN(LOG_STORAGE, "Storage queue full, fix %u from %s not stored", msg.seq, msg.beaconId);
+    return;
+  }
+  // Only a fix that is on its way to the file counts as stored, so the same
+  // seq coming back as backfill is still taken
+  uint32_t id;
+  StoredSeqs* stored = parseBeaconId(msg.beaconId, id) ? storedSeqs.findOrAdd(id) : nullptr;
+  if (stored) stored->markLive(msg.seq);
+}
+
+// Build a station -> beacon frame carrying our current ack window for that beacon
+ControlMessage makeReply(uint32_t beaconId, uint8_t msgType) {
+  char text[9];
+  formatBeaconId(beaconId, text);
+  return makeStationReply(text, msgType, rxSeqWindows.find(beaconId));
+}
+
+// Microseconds until the reply slot, REPLY_OFFSET_US after the beacon frame
+// ended; negative once the slot has started
+int32_t replySlotInUs(uint32_t rxDoneUs) {
+  return (int32_t)(rxDoneUs + REPLY_OFFSET_US - micros());
+}
+
+bool replySlotOpen(uint32_t rxDoneUs) {
+  return replySlotInUs(rxDoneUs) >= -(int32_t)REPLY_TOLERANCE_US;
+}
+
+// Hold a reply until its slot. The DIO1 ISR timestamps RxDone from the
+// hardware-timer-backed micros() clock. Sleeps through most of the wait so the
+// loop keeps running, then spins the last millisecond for accuracy.
+// Returns false if the slot has already passed and the beacon stopped listening.
+bool waitForReplySlot(uint32_t rxDoneUs) {
+  int32_t waitUs = replySlotInUs(rxDoneUs);
+  if (!replySlotOpen(rxDoneUs)) {
+    LOG_WARN(LOG_RADIO, "Reply slot missed by %ld us, not replying", (long)-waitUs);
+    return false;
+  }
+  if (waitUs > 2000) {
+    vTaskDelay(pdMS_TO_TICKS((waitUs - 1000) / 1000));
+    waitUs = replySlotInUs(rxDoneUs);
+  }
+  if (waitUs > 0) {
+    delayMicroseconds(waitUs);
+  }
+  return true;
+}
+
+void sendControl(const ControlMessage &ctrl) {
+  // Bound to the reply slot, so no backoff - a busy channel skips the reply
+  int state = loraTransmit((uint8_t *)&ctrl, sizeof(ctrl), false);
+  if (state != RADIOLIB_ERR_NONE) {
+    LOG_WARN(LOG_RADIO, "Reply to %s failed, code: %d", ctrl.beaconId, state);
+  } else if (ctrl.msgType == MSG_CONTROL) {
+    LOG_INFO(LOG_RADIO, "Control sent to %s (LED %u, buzzer %u)", ctrl.beaconId, ctrl.ledOn, ctrl.buzzerOn);
   } else {
-    Serial.print("Control send failed, code: ");
-    Serial.println(state);
+    LOG_DEBUG(LOG_RADIO, "Ack sent to %s", ctrl.beaconId);
   }
-  
-  // Small delay after transmit
-  delay(50);
 }
 
-void loopPupStation() {
+// Called by radioTask right after a packet from a beacon so the reply makes its
+// slot. Its echoed LED/buzzer state confirms a previously sent command;
+// otherwise the command is (re)sent if the beacon is listening. Every reply
+// also acks the frames heard from that beacon.
+void serviceControlQueue(const BeaconMessage &msg, uint32_t beaconId, uint32_t rxDoneUs) {
   uint32_t now = millis();
+  ControlMessage reply;
+  bool haveReply = false;
+  uint16_t sentId = 0;
+  uint8_t sentAttempt = 0;
+  
+  lockControl();
+  expireControlCommands(now);
+  
+  ControlCommand* cmd = findActiveControl(beaconId);
+  
+  if (cmd && cmd->state == CMD_SENT) {
+    if ((msg.ledOn != 0) == cmd->ledOn && (msg.buzzerOn != 0) == cmd->buzzerOn) {
+      cmd->state = CMD_ACKED;
+      cmd->updatedAt = now;
+      LOG_INFO(LOG_RADIO, "Control #%u acknowledged by %s after %u attempt(s)",
+               cmd->id, msg.beaconId, cmd->attempts);
+      cmd = nullptr;
+    } else if (cmd->attempts >= CONTROL_MAX_ATTEMPTS) {
+      cmd->state = CMD_FAILED;
+      cmd->updatedAt = now;
+      LOG_WARN(LOG_RADIO, "Control #%u for %s failed after %u attempts",
+               cmd->id, msg.beaconId, cmd->attempts);
+      cmd = nullptr;
+    }
+  }
+  
+  // Beacon skipped its RX window - the command waits for one it opens.
+  // The command is marked sent before the lock is dropped for the transmit.
+  if (msg.flags & BEACON_FLAG_LISTENING) {
+    if (cmd && replySlotOpen(rxDoneUs)) {
+      reply = makeReply(cmd->beaconId, MSG_CONTROL);
+      reply.ledOn = cmd->ledOn ? 1 : 0;
+      reply.buzzerOn = cmd->buzzerOn ? 1 : 0;
+      cmd->attempts++;
+      cmd->state = CMD_SENT;
+      cmd->updatedAt = now;
+      sentId = cmd->id;
+      sentAttempt = cmd->attempts;
+      haveReply = true;
+    } else if (!cmd && (msg.flags & BEACON_FLAG_ACK_REQUEST)) {
+      reply = makeReply(beaconId, MSG_ACK);
+      reply.flags |= CONTROL_FLAG_IDLE;
+      haveReply = true;
+    }
+  }
+  unlockControl();
+  
+  if (haveReply && waitForReplySlot(rxDoneUs)) {
+    sendControl(reply);
+    if (sentId) {
+      LOG_INFO(LOG_RADIO, "Sent control #%u (attempt %u)", sentId, sentAttempt);
+    }
+  }
+}
+
+// Acknowledge a backfill frame in its reply slot (radioTask)
+void replyToBackfill(uint32_t beaconId, uint32_t rxDoneUs) {
+  ControlMessage ack = makeReply(beaconId, MSG_ACK);
+  ack.flags |= CONTROL_FLAG_BACKFILL_ACK;
+  lockControl();
+  if (!findActiveControl(beaconId)) {
+    ack.flags |= CONTROL_FLAG_IDLE;
+  }
+  unlockControl();
+  if (waitForReplySlot(rxDoneUs)) {
+    sendControl(ack);
+  }
+}
+
+// Queue fixes the beacon stored while out of range for storageTask to merge (already acked by radioTask)
+void handleIncomingBackfill(BackfillMessage &bf, float rssi, float snr) {
+  uint8_t count = min(bf.count, BACKFILL_FIXES_PER_FRAME);
+  
+  uint32_t id;
+  bool known = parseBeaconId(bf.beaconId, id);
+  LatestBeaconData* beacon = known ? beacons.find(id) : nullptr;
+  float battery = beacon ? beacon->batteryVoltage : 0.0f;
+  
+  // Fixes we stored live but whose ack the beacon missed
+  StoredSeqs* stored = known ? storedSeqs.findOrAdd(id) : nullptr;
+  uint8_t duplicates = stored ? dropStoredFixes(bf, *stored) : 0;
+  
+  HistoryRecord records[BACKFILL_FIXES_PER_FRAME];
+  uint8_t usable = backfillHistoryRecords(bf, battery, rssi, snr, records);
+  for (uint8_t i = 0; i < usable; i++) {
+    queueStorageJob(STORE_BACKFILL, records[i]);
+  }
+  if (beacon) {
+    beacon->backfilledFixes += count - duplicates;
+    beacon->rxFrames++;
+  }
   
-  // Update station GPS location
-  static uint32_t lastGpsRead = 0;
-  if (now - lastGpsRead > 1000) { // Read GPS every second
-    lastGpsRead = now;
+  LOG_INFO(LOG_BEACON, "Backfill from %s: %u fixes, %u already stored", bf.beaconId, count, duplicates);
+}
+
+// Everything that has to happen while the frame is fresh: record its seq and
+// answer in the reply slot. Frames that did not fit in rxQueue are not acked,
+// and neither are frames heard while the storage queue is full, so the beacon
+// keeps them for backfill.
+void replyToFrame(const RawFrame &frame) {
+  BeaconMessage msg;
+  if (decodeBeaconMessage(frame.data, frame.len, msg)) {
+    uint32_t id;
+    if (beaconDataInRange(msg) && parseBeaconId(msg.beaconId, id)) {
+      SeqWindow* window = rxSeqWindows.findOrAdd(id);
+      bool storable = !storageQueue || uxQueueSpacesAvailable(storageQueue) > 0;
+      if (window && storable) window->record(msg.seq);
+      serviceControlQueue(msg, id, frame.rxDoneUs);
+    }
+  } else if (frame.data[0] == MSG_BACKFILL && frame.len >= offsetof(BackfillMessage, fixes)) {
+    char beaconId[sizeof(BackfillMessage::beaconId)];
+    memcpy(beaconId, frame.data + offsetof(BackfillMessage, beaconId), sizeof(beaconId));
+    beaconId[sizeof(beaconId) - 1] = '\0';
+    uint32_t id;
+    if (parseBeaconId(beaconId, id)) {
+      replyToBackfill(id, frame.rxDoneUs);
+    }
+  }
+}
+
+// Owns the radio on PupStation. Runs above loop() on the same core, so a packet
+// is read out within microseconds of DIO1 no matter what the loop is doing
+// (display refresh, LittleFS, HTTP sync), and bursts queue up in rxQueue.
+void radioTask(void *param) {
+  hal.radio.startReceive(); // Also clears any IRQ raised before this task existed
+  
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    PROFILE_ZONE(profileRadioRx);
     
-    while (GPSSerial.available() > 0) {
-      char c = GPSSerial.read();
-      gps.encode(c);
+    RawFrame frame;
+    frame.rxDoneUs = rxDoneMicros;
+    int len = hal.radio.receive(frame.data, sizeof(frame.data), frame.rssi, frame.snr);
+    
+    if (len > 0) {
+      metricFramesReceived.inc();
+      frame.len = len;
+      frame.rxMillis = millis();
+      
+      if (rxQueue.push(frame)) {
+        rxFramesQueued++;
+        uint32_t depth = rxQueue.size();
+        if (depth > rxQueuePeak) rxQueuePeak = depth;
+        replyToFrame(frame);
+        if (captureActive) {
+          TraceFrameInfo info = {frame.rssi, frame.snr};
+          captureRecord(TRACE_FRAME, frame.rxMillis - captureStartMs, &info, sizeof(info), frame.data, frame.len);
+        }
+      } else {
+        rxQueueOverruns++;
+      }
+    } else {
+      rxReadErrors++;
     }
     
-    if (gps.location.isUpdated() && gps.location.isValid()) {
-      stationLocation.latitude = gps.location.lat();
-      stationLocation.longitude = gps.location.lng();
-      stationLocation.hdop = gps.hdop.hdop();
-      stationLocation.sats = gps.satellites.value();
-      stationLocation.altitude = gps.altitude.isValid() ? gps.altitude.meters() : 0.0f;
-      stationLocation.hasValidFix = true;
-      stationLocation.lastUpdate = now;
+    // Restart receive mode
+    hal.radio.startReceive();
+  }
+}
+
+// Decode one frame queued by radioTask
+void processFrame(const RawFrame &frame) {
+  bool accepted = false;
+  captureDigest = TRACE_DIGEST_SEED;
+  captureRows = 0;
+  BeaconMessage msg;
+  BackfillMessage bf;
+  if (decodeBeaconMessage(frame.data, frame.len, msg)) {
+    if (validateBeaconMessage(msg)) {
+      PROFILE_ZONE(profileBeaconFrame);
+      handleIncomingBeacon(msg, frame.rssi, frame.snr);
+      accepted = true;
     }
+  } else if (decodeBackfillMessage(frame.data, frame.len, bf)) {
+    handleIncomingBackfill(bf, frame.rssi, frame.snr);
+    accepted = true;
+  }
+  if (accepted) {
+    metricFramesDecoded.inc();
+  } else {
+    metricFramesInvalid.inc();
   }
+  rxFramesProcessed++;
+  
+  if (captureActive) {
+    TraceResult result = {frame.rxMillis - captureStartMs, accepted, captureRows, captureDigest};
+    captureRecord(TRACE_RESULT, captureMillis(), &result, sizeof(result));
+  }
+}
+
+// Redraw the station display from a snapshot (uiTask only touches the TFT
+// once setup is done). Only changed fields are redrawn.
+void updateStationDisplay(const StationSnapshot &snap) {
+  uint32_t now = millis();
+  const LatestBeaconData &beacon = snap.primary;
+  const StationLocation &station = snap.station;
+  float stationVoltage = snap.stationBattery;
   
-  // Update display periodically
-  static uint32_t lastDisplayUpdate = 0;
   static bool lastBeaconHasData = false;
   static bool lastStationFix = false;
   static float lastStationVoltage = 0;
@@ -2048,246 +4554,431 @@ void loopPupStation() {
   static uint32_t lastElapsed = 0;
   static int lastSignalPercent = -1;
   
-  if (now - lastDisplayUpdate > 1000) {
-    lastDisplayUpdate = now;
+  uint32_t elapsed = beacon.hasData ? (now - beacon.lastUpdate) / 1000 : 0;
+  
+  // Calculate signal strength percentage from RSSI
+  // RSSI range: -30 (excellent) to -120 (worst)
+  int signalPercent = 0;
+  if (beacon.hasData && elapsed <= 60) {
+    // Map RSSI from -120..-30 to 0..100%
+    signalPercent = constrain(map((int)beacon.rssi, -120, -30, 0, 100), 0, 100);
+  }
+  
+  // Line 1: IP address on same line as title (draw once after WiFi connected)
+  static bool ipDrawn = false;
+  if (!ipDrawn && WiFi.status() == WL_CONNECTED) {
+    tft.setCursor(75, 2);
+    tft.setTextColor(ST77XX_GREEN);
+    tft.setTextSize(1);
+    tft.print(WiFi.localIP());
+    ipDrawn = true;
+  }
+  
+  // Line 2: Paw GPS + Battery (y=14)
+  // Check if beacon has valid GPS fix (non-zero coords and satellites)
+  bool beaconHasValidGps = (beacon.hasData && 
+                            beacon.latitude != 0.0 && 
+                            beacon.longitude != 0.0 && 
+                            beacon.sats > 0);
+  
+  static bool lastBeaconValidGps = false;
+  bool beaconGpsChanged = (beaconHasValidGps != lastBeaconValidGps) || (beacon.hasData != lastBeaconHasData);
+  bool beaconBatChanged = (abs(beacon.batteryVoltage - lastBeaconVoltage) > 0.05 || 
+                           (beacon.hasData && lastBeaconVoltage == 0));
+  
+  if (beaconGpsChanged || beaconBatChanged) {
+    tft.fillRect(30, 14, 130, 8, ST77XX_BLACK);
+    tft.setTextSize(1);
+    tft.setCursor(30, 14);
+    
+    // Beacon GPS status
+    if (beaconHasValidGps) {
+      tft.setTextColor(ST77XX_GREEN);
+      tft.print("Fix ");
+      tft.setTextColor(ST77XX_WHITE);
+      tft.print(beacon.sats);
+      // tft.print("sat");
+    } else if (beacon.hasData) {
+      tft.setTextColor(ST77XX_YELLOW);
+      tft.print("No Fix ");
+      tft.setTextColor(ST77XX_RED);
+      tft.print(beacon.sats);
+      // tft.print("sat");
+    } else {
+      tft.setTextColor(ST77XX_RED);
+      tft.print("No Data");
+    }
+    
+    lastBeaconValidGps = beaconHasValidGps;
+    
+    // Battery
+    tft.setTextColor(ST77XX_CYAN);
+    tft.setCursor(90, 14);
+    tft.print("Bat: ");
+    if (beacon.hasData) {
+      tft.setTextColor(beacon.batteryVoltage > 3.7 ? ST77XX_GREEN : ST77XX_YELLOW);
+      tft.print(beacon.batteryVoltage, 2);
+      tft.print("V");
+    } else {
+      tft.setTextColor(ST77XX_RED);
+      tft.print("--V");
+    }
+    
+    lastBeaconHasData = beacon.hasData;
+    lastBeaconVoltage = beacon.batteryVoltage;
+  }
+  
+  // Line 3: Sta GPS + Battery (y=26)
+  // Check if station has valid GPS fix (non-zero coords and satellites)
+  bool stationHasValidGps = (station.hasValidFix && 
+                             station.latitude != 0.0 && 
+                             station.longitude != 0.0 && 
+                             station.sats > 0);
+  
+  static bool lastStationValidGps = false;
+  static uint8_t lastStationSats = 0;
+  bool stationGpsChanged = (stationHasValidGps != lastStationValidGps) || 
+                           (station.sats != lastStationSats) ||
+                           (station.hasValidFix != lastStationFix);
+  bool stationBatChanged = (abs(stationVoltage - lastStationVoltage) > 0.05);
+  
+  if (stationGpsChanged || stationBatChanged) {
+    tft.fillRect(30, 26, 130, 8, ST77XX_BLACK);
+    tft.setTextSize(1);
+    tft.setCursor(30, 26);
+    
+    // Station GPS status
+    if (stationHasValidGps) {
+      tft.setTextColor(ST77XX_GREEN);
+      tft.print("Fix ");
+      tft.setTextColor(ST77XX_WHITE);
+      tft.print(station.sats);
+      // tft.print("sat");
+    } else if (station.hasValidFix || station.sats > 0) {
+      tft.setTextColor(ST77XX_YELLOW);
+      tft.print("No Fix ");
+      tft.setTextColor(ST77XX_RED);
+      tft.print(station.sats);
+      // tft.print("sat");
+    } else {
+      tft.setTextColor(ST77XX_RED);
+      tft.print("No Data");
+    }
     
-    float stationVoltage = readBatteryVoltage();
-    uint32_t elapsed = latestBeacon.hasData ? (now - latestBeacon.lastUpdate) / 1000 : 0;
+    lastStationValidGps = stationHasValidGps;
+    lastStationSats = station.sats;
+    
+    // Battery
+    tft.setTextColor(ST77XX_CYAN);
+    tft.setCursor(90, 26);
+    tft.print("Bat: ");
+    tft.setTextColor(stationVoltage > 3.7 ? ST77XX_GREEN : ST77XX_YELLOW);
+    tft.print(stationVoltage, 2);
+    tft.print("V");
+    
+    lastStationFix = station.hasValidFix;
+    lastStationVoltage = stationVoltage;
+  }
+  
+  // Line 4: Signal + Seen (y=38)
+  bool signalChanged = (signalPercent != lastSignalPercent);
+  bool timeChanged = (elapsed != lastElapsed);
+  
+  if (signalChanged || timeChanged) {
+    tft.fillRect(45, 38, 115, 8, ST77XX_BLACK);
+    tft.setTextSize(1);
+    tft.setCursor(45, 38);
     
-    // Calculate signal strength percentage from RSSI
-    // RSSI range: -30 (excellent) to -120 (worst)
-    int signalPercent = 0;
-    if (latestBeacon.hasData && elapsed <= 60) {
-      // Map RSSI from -120..-30 to 0..100%
-      signalPercent = constrain(map((int)latestBeacon.rssi, -120, -30, 0, 100), 0, 100);
+    // Signal strength percentage
+    if (signalPercent >= 70) {
+      tft.setTextColor(ST77XX_GREEN);
+    } else if (signalPercent >= 40) {
+      tft.setTextColor(ST77XX_YELLOW);
+    } else if (signalPercent > 0) {
+      tft.setTextColor(0xFD20); // Orange
+    } else {
+      tft.setTextColor(ST77XX_RED);
     }
+    tft.print(signalPercent);
+    tft.print("%");
     
-    // Line 1: IP address on same line as title (draw once after WiFi connected)
-    static bool ipDrawn = false;
-    if (!ipDrawn && WiFi.status() == WL_CONNECTED) {
-      tft.setCursor(75, 2);
+    // Seen time
+    tft.setTextColor(ST77XX_CYAN);
+    tft.print("  Seen: ");
+    if (!beacon.hasData) {
+      tft.setTextColor(ST77XX_RED);
+      tft.print("--");
+    } else if (elapsed > 60) {
+      tft.setTextColor(ST77XX_RED);
+      tft.print(elapsed / 60);
+      tft.print("m");
+    } else {
       tft.setTextColor(ST77XX_GREEN);
-      tft.setTextSize(1);
-      tft.print(WiFi.localIP());
-      ipDrawn = true;
-    }
-    
-    // Line 2: Paw GPS + Battery (y=14)
-    // Check if beacon has valid GPS fix (non-zero coords and satellites)
-    bool beaconHasValidGps = (latestBeacon.hasData && 
-                              latestBeacon.latitude != 0.0 && 
-                              latestBeacon.longitude != 0.0 && 
-                              latestBeacon.sats > 0);
-    
-    static bool lastBeaconValidGps = false;
-    bool beaconGpsChanged = (beaconHasValidGps != lastBeaconValidGps) || (latestBeacon.hasData != lastBeaconHasData);
-    bool beaconBatChanged = (abs(latestBeacon.batteryVoltage - lastBeaconVoltage) > 0.05 || 
-                             (latestBeacon.hasData && lastBeaconVoltage == 0));
-    
-    if (beaconGpsChanged || beaconBatChanged) {
-      tft.fillRect(30, 14, 130, 8, ST77XX_BLACK);
-      tft.setTextSize(1);
-      tft.setCursor(30, 14);
-      
-      // Beacon GPS status
-      if (beaconHasValidGps) {
-        tft.setTextColor(ST77XX_GREEN);
-        tft.print("Fix ");
-        tft.setTextColor(ST77XX_WHITE);
-        tft.print(latestBeacon.sats);
-        // tft.print("sat");
-      } else if (latestBeacon.hasData) {
-        tft.setTextColor(ST77XX_YELLOW);
-        tft.print("No Fix ");
-        tft.setTextColor(ST77XX_RED);
-        tft.print(latestBeacon.sats);
-        // tft.print("sat");
-      } else {
-        tft.setTextColor(ST77XX_RED);
-        tft.print("No Data");
-      }
-      
-      lastBeaconValidGps = beaconHasValidGps;
-      
-      // Battery
-      tft.setTextColor(ST77XX_CYAN);
-      tft.setCursor(90, 14);
-      tft.print("Bat: ");
-      if (latestBeacon.hasData) {
-        tft.setTextColor(latestBeacon.batteryVoltage > 3.7 ? ST77XX_GREEN : ST77XX_YELLOW);
-        tft.print(latestBeacon.batteryVoltage, 2);
-        tft.print("V");
-      } else {
-        tft.setTextColor(ST77XX_RED);
-        tft.print("--V");
-      }
-      
-      lastBeaconHasData = latestBeacon.hasData;
-      lastBeaconVoltage = latestBeacon.batteryVoltage;
-    }
-    
-    // Line 3: Sta GPS + Battery (y=26)
-    // Check if station has valid GPS fix (non-zero coords and satellites)
-    bool stationHasValidGps = (stationLocation.hasValidFix && 
-                               stationLocation.latitude != 0.0 && 
-                               stationLocation.longitude != 0.0 && 
-                               stationLocation.sats > 0);
-    
-    static bool lastStationValidGps = false;
-    static uint8_t lastStationSats = 0;
-    bool stationGpsChanged = (stationHasValidGps != lastStationValidGps) || 
-                             (stationLocation.sats != lastStationSats) ||
-                             (stationLocation.hasValidFix != lastStationFix);
-    bool stationBatChanged = (abs(stationVoltage - lastStationVoltage) > 0.05);
-    
-    if (stationGpsChanged || stationBatChanged) {
-      tft.fillRect(30, 26, 130, 8, ST77XX_BLACK);
-      tft.setTextSize(1);
-      tft.setCursor(30, 26);
-      
-      // Station GPS status
-      if (stationHasValidGps) {
-        tft.setTextColor(ST77XX_GREEN);
-        tft.print("Fix ");
-        tft.setTextColor(ST77XX_WHITE);
-        tft.print(stationLocation.sats);
-        // tft.print("sat");
-      } else if (stationLocation.hasValidFix || stationLocation.sats > 0) {
-        tft.setTextColor(ST77XX_YELLOW);
-        tft.print("No Fix ");
-        tft.setTextColor(ST77XX_RED);
-        tft.print(stationLocation.sats);
-        // tft.print("sat");
-      } else {
-        tft.setTextColor(ST77XX_RED);
-        tft.print("No Data");
+      tft.print(elapsed);
+      tft.print("s");
+    }
+    
+    lastSignalPercent = signalPercent;
+    lastElapsed = elapsed;
+  }
+  
+  // Draw static labels only once
+  static bool labelsDrawn = false;
+  if (!labelsDrawn) {
+    tft.setTextColor(ST77XX_WHITE);
+    tft.setTextSize(1);
+    tft.setCursor(1, 1);
+    tft.print("PupStation");
+    tft.setTextSize(1);
+    tft.setTextColor(ST77XX_CYAN);
+    tft.setCursor(2, 14);
+    tft.print("Paw:");
+    tft.setCursor(2, 26);
+    tft.print("Sta:");
+    tft.setCursor(2, 38);
+    tft.print("Signal:");
+    labelsDrawn = true;
+  }
+}
+
+// Copy the state loop() owns into stationSnapshot for the other tasks
+void publishStationSnapshot() {
+  StationSnapshot snap;
+  snap.station = stationLocation;
+  snap.stationBattery = batteryVoltage();
+  snap.gpsTime = gpsUnixTime();
+  if (primaryBeacon) {
+    snap.primary = *primaryBeacon;
+  }
+  stationSnapshot.publish(snap);
+}
+
+void publishBeaconTable() {
+  beaconTable.publish(beacons);
+  // Only now, so storageTask never saves a table without the change
+  if (beaconNamesChanged) {
+    beaconNamesChanged = false;
+    beaconConfigDirty = true;
+  }
+}
+
+// Apply renames queued by the web UI
+bool applyBeaconRenames() {
+  bool renamed = false;
+  BeaconRename rename;
+  while (xQueueReceive(beaconRenameQueue, &rename, 0) == pdTRUE) {
+    LatestBeaconData* beacon = registerBeacon(rename.beaconId);
+    if (!beacon) continue;
+    memcpy(beacon->name, rename.name, sizeof(beacon->name));
+    beaconNamesChanged = true;
+    renamed = true;
+    Serial.printf("Beacon name updated: %s -> %s\n", beacon->beaconId, beacon->name);
+  }
+  return renamed;
+}
+
+#if PAW_PROFILE
+// Stop the zones recording if, since the last reset, they cost more than
+// PROFILE_OVERHEAD_BUDGET_PERCENT of one core (storageTask, with the stats
+// log). POST /api/profile/reset starts them again.
+void checkProfileOverhead() {
+  uint32_t sinceMs = millis() - profileSinceMs;
+  if (sinceMs < PROFILE_CHECK_MIN_MS || !profileRecording().load()) return;
+  float percent = profileOverheadPercent(profileOverhead, (uint64_t)sinceMs * ESP.getCpuFreqMHz() * 1000);
+  if (percent > PROFILE_OVERHEAD_BUDGET_PERCENT) {
+    profileRecording().store(false);
+    LOG_WARN(LOG_SYSTEM, "Profiler overhead %.2f%% of a core, over budget: recording stopped", percent);
+  }
+}
+#endif
+
+// Station data files: history appends, backfill merges, beacon config and the
+// stats log. Runs on the protocol core so LittleFS stalls never hold up loop()
+// or the radio.
+void storageTask(void *param) {
+  StorageJob job;
+  bool configSavePending = false;
+  uint32_t configDirtyAt = 0;
+  uint32_t lastSummaryMs = 0;
+  publishStorageSummary();
+  
+  for (;;) {
+    uint32_t waitMs = captureActive ? CAPTURE_DRAIN_MS : 1000;
+    if (xQueueReceive(storageQueue, &job, pdMS_TO_TICKS(waitMs)) == pdTRUE) {
+      storageSummaryDirty = true;
+      switch (job.type) {
+        case STORE_HISTORY: {
+          uint32_t start = micros();
+          appendHistory(job.record);
+          metricHistoryAppend.observe(micros() - start);
+          break;
+        }
+        case STORE_BACKFILL:
+          pendingBackfill.push_back(job.record);
+          lastBackfillRx = millis();
+          break;
+        case STORE_CLEAR_HISTORY:
+          // Backfill not merged yet would bring old rows back
+          pendingBackfill.clear();
+          hal.fs.remove(HISTORY_FILE);
+          LOG_INFO(LOG_STORAGE, "History file cleared");
+          publishStorageSummary();  // The page reloads right after a clear
+          break;
+        case STORE_CLEAR_STATS:
+          hal.fs.remove(STATS_FILE);
+          lastStatsLog = 0;  // A fresh line below
+          LOG_INFO(LOG_STORAGE, "Stats file cleared");
+          publishStorageSummary();  // The page reloads right after a clear
+          break;
       }
-      
-      lastStationValidGps = stationHasValidGps;
-      lastStationSats = stationLocation.sats;
-      
-      // Battery
-      tft.setTextColor(ST77XX_CYAN);
-      tft.setCursor(90, 26);
-      tft.print("Bat: ");
-      tft.setTextColor(stationVoltage > 3.7 ? ST77XX_GREEN : ST77XX_YELLOW);
-      tft.print(stationVoltage, 2);
-      tft.print("V");
-      
-      lastStationFix = stationLocation.hasValidFix;
-      lastStationVoltage = stationVoltage;
     }
     
-    // Line 4: Signal + Seen (y=38)
-    bool signalChanged = (signalPercent != lastSignalPercent);
-    bool timeChanged = (elapsed != lastElapsed);
+    uint32_t now = millis();
     
-    if (signalChanged || timeChanged) {
-      tft.fillRect(45, 38, 115, 8, ST77XX_BLACK);
-      tft.setTextSize(1);
-      tft.setCursor(45, 38);
-      
-      // Signal strength percentage
-      if (signalPercent >= 70) {
-        tft.setTextColor(ST77XX_GREEN);
-      } else if (signalPercent >= 40) {
-        tft.setTextColor(ST77XX_YELLOW);
-      } else if (signalPercent > 0) {
-        tft.setTextColor(0xFD20); // Orange
-      } else {
-        tft.setTextColor(ST77XX_RED);
-      }
-      tft.print(signalPercent);
-      tft.print("%");
-      
-      // Seen time
-      tft.setTextColor(ST77XX_CYAN);
-      tft.print("  Seen: ");
-      if (!latestBeacon.hasData) {
-        tft.setTextColor(ST77XX_RED);
-        tft.print("--");
-      } else if (elapsed > 60) {
-        tft.setTextColor(ST77XX_RED);
-        tft.print(elapsed / 60);
-        tft.print("m");
-      } else {
-        tft.setTextColor(ST77XX_GREEN);
-        tft.print(elapsed);
-        tft.print("s");
-      }
-      
-      lastSignalPercent = signalPercent;
-      lastElapsed = elapsed;
+    serviceCapture();
+    
+    // Merge backfilled fixes into history once a batch is complete or the drain went quiet
+    if (!pendingBackfill.empty() &&
+        (pendingBackfill.size() >= BACKFILL_MERGE_BATCH || now - lastBackfillRx >= BACKFILL_MERGE_IDLE_MS)) {
+      mergeBackfillIntoHistory();
     }
     
-    // Draw static labels only once
-    static bool labelsDrawn = false;
-    if (!labelsDrawn) {
-      tft.setTextColor(ST77XX_WHITE);
-      tft.setTextSize(1);
-      tft.setCursor(1, 1);
-      tft.print("PupStation");
-      tft.setTextSize(1);
-      tft.setTextColor(ST77XX_CYAN);
-      tft.setCursor(2, 14);
-      tft.print("Paw:");
-      tft.setCursor(2, 26);
-      tft.print("Sta:");
-      tft.setCursor(2, 38);
-      tft.print("Signal:");
-      labelsDrawn = true;
-    }
-  }
-  
-  // Check if a packet was received (interrupt-driven)
-  if (receivedFlag) {
-    receivedFlag = false; // Clear flag
-    
-    BeaconMessage msg{};
-    memset(&msg, 0, sizeof(msg)); // Clear buffer first
-    
-    int state = radio.readData((uint8_t *)&msg, sizeof(msg));
-    
-    if (state == RADIOLIB_ERR_NONE) {
-      // Packet received successfully - validate it
-      if (msg.msgType == 0x01) {
-        // Serial.print("Packet received! msgType: 0x");
-        // Serial.print(msg.msgType, HEX);
-        
-        // Get RSSI and SNR
-        float rssi = radio.getRSSI();
-        float snr = radio.getSNR();
-        // Serial.print(", RSSI:  
-        
-        handleIncomingBeacon(msg, rssi, snr);
-        
-        // Check if there's a pending control command to send
-        if (beaconControl.pendingControl) {
-          Serial.println("Sending pending control command...");
-          delay(50); // Small delay to let beacon enter receive mode
-          sendControl(beaconControl.ledOn, beaconControl.buzzerOn, beaconControl.targetBeaconId);
-          beaconControl.pendingControl = false;
-        }
+    // Save beacon names once discoveries and renames have settled
+    if (beaconConfigDirty && !configSavePending) {
+      configSavePending = true;
+      configDirtyAt = now;
+    }
+    if (configSavePending && now - configDirtyAt >= BEACON_CONFIG_SAVE_DELAY_MS) {
+      configSavePending = false;
+      beaconConfigDirty = false;
+      saveBeaconConfig(*readBeaconTable());
+      storageSummaryDirty = true;
+    }
+    
+    // Periodic statistics logging
+    if (now - lastStatsLog >= STATS_LOG_INTERVAL) {
+      lastStatsLog = now;
+      {
+        PROFILE_ZONE(profileLogStats);
+        logStats();
       }
+      storageSummaryDirty = true;
+#if PAW_PROFILE
+      checkProfileOverhead();
+#endif
     }
     
-    // Restart receive mode
-    radio.startReceive();
+    // Refresh what /api/stats shows, while someone is looking at it
+    if (storageSummaryDirty && now - storageSummaryWantedAt < STORAGE_SUMMARY_IDLE_MS &&
+        now - lastSummaryMs >= STORAGE_SUMMARY_INTERVAL_MS) {
+      lastSummaryMs = now;
+      publishStorageSummary();
+    }
+  }
+}
+
+// Central server link: services the push channel every tick, uploads every
+// SERVER_SYNC_INTERVAL (and each tick while a batch waits for its ack).
+// HTTPClient blocks for up to its timeout, which is harmless here: fixes wait
+// in uplinkQueue meanwhile.
+void networkTask(void *param) {
+  serverHttp.setReuse(true);
+  serverHttp.setTimeout(UPLINK_HTTP_TIMEOUT_MS);
+  serverHttp.setConnectTimeout(UPLINK_HTTP_TIMEOUT_MS);
+  uplink.deviceId = deviceId;
+  uplink.bootId = esp_random();
+  
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(NETWORK_TASK_TICK_MS));
+    if (!centralServerEnabled || deviceId.isEmpty() || !WiFi.isConnected()) continue;
+    
+    serviceServerSocket();
+    reportControlResults();
+    bool online = !centralServerUrl.isEmpty();
+    if (uplink.awaitingAck()) {
+      uplink.service(online);
+    }
+    
+    uint32_t now = millis();
+    if (now - lastServerSync < SERVER_SYNC_INTERVAL) continue;
+    lastServerSync = now;
+    
+    PROFILE_ZONE(profileServerSync);
+    uplink.startSync();
+    uplink.service(online);
+    if (!serverLinkStats.connected) {
+      checkServerForControlCommands();
+    }
+  }
+}
+
+// Display refresh at the lowest priority
+void uiTask(void *param) {
+  for (;;) {
+    {
+      PROFILE_ZONE(profileDisplay);
+      updateStationDisplay(stationSnapshot.read());
+    }
+    vTaskDelay(pdMS_TO_TICKS(UI_REFRESH_MS));
+  }
+}
+
+// Owns station state: GPS parsing, frame decoding, the beacon table. Everything
+// slow has been handed to the tasks above.
+void loopPupStation() {
+  uint32_t loopStart = micros();
+  uint32_t now = millis();
+  bool changed = false;
+  
+  // Pick up new station fixes from gpsTask
+  static uint32_t lastGpsVersion = 0;
+  static uint32_t lastGpsFixCount = 0;
+  if (gpsFix.version() != lastGpsVersion) {
+    lastGpsVersion = gpsFix.version();
+    GpsFix fix;
+    gpsFix.read(fix);
+    if (fix.fixCount != lastGpsFixCount) {
+      lastGpsFixCount = fix.fixCount;
+      stationLocation.latitude = fix.latitude;
+      stationLocation.longitude = fix.longitude;
+      stationLocation.hdop = fix.hdop;
+      stationLocation.sats = fix.sats;
+      stationLocation.altitude = fix.altitude;
+      stationLocation.hasValidFix = true;
+      stationLocation.lastUpdate = fix.fixMillis;
+      changed = true;
+    }
   }
   
-  // Periodic statistics logging
-  if (now - lastStatsLog >= STATS_LOG_INTERVAL) {
-    lastStatsLog = now;
-    logStats();
+  // Decode everything radioTask has queued (interrupt-driven)
+  bool beaconsChanged = applyBeaconRenames();
+  RawFrame frame;
+  while (rxQueue.pop(frame)) {
+    processFrame(frame);
+    beaconsChanged = true;
+  }
+  if (beaconsChanged) {
+    publishBeaconTable();
+    changed = true;
   }
   
-  // Send beacon data to central server periodically
-  if (centralServerEnabled && (now - lastServerSync >= SERVER_SYNC_INTERVAL)) {
-    lastServerSync = now;
-    sendBeaconDataToServer();
-    checkServerForControlCommands();
+  static uint32_t lastRateTime = 0;
+  static uint32_t lastRateFrames = 0;
+  if (now - lastRateTime >= 1000) {
+    rxFramesPerSecond = (rxFramesProcessed - lastRateFrames) * 1000.0 / (now - lastRateTime);
+    lastRateFrames = rxFramesProcessed;
+    lastRateTime = now;
+  }
+  
+  // Publish after every change, and once a second for the GPS clock and battery
+  static uint32_t lastPublish = 0;
+  if (changed || now - lastPublish >= 1000) {
+    lastPublish = now;
+    publishStationSnapshot();
   }
   
+  metricLoopTime.observe(micros() - loopStart);
+  
   // Small delay but don't block too long for web server
   delay(10);
 
@@ -2307,10 +4998,22 @@ void loopPupStation() {
   }
 }
 
+#endif // PAW_STATION
+
 // -----------------------------------------------------------------------------
 // Shared setup/loop
 // -----------------------------------------------------------------------------
 
+// Single-role images run their own role whatever the boot asks for
+static void selectRole(DeviceRole role) {
+#if PAW_BEACON && PAW_STATION
+  currentRole = role;
+#else
+  (void)role;
+#endif
+}
+
+#if PAW_BEACON && PAW_STATION
 void selectRoleOnBoot() {
   pinMode(ROLE_SELECT_PIN, INPUT_PULLUP);
   
@@ -2337,10 +5040,10 @@ void selectRoleOnBoot() {
   
   int level = digitalRead(ROLE_SELECT_PIN);
   if (level == LOW) {  // Button pressed (pulled LOW)
-    currentRole = ROLE_PUP_STATION;
+    selectRole(ROLE_PUP_STATION);
     Serial.println("Button PRESSED - Selected: PupStation");
   } else {
-    currentRole = ROLE_PUP_BEACON;
+    selectRole(ROLE_PUP_BEACON);
     Serial.println("Button NOT pressed - Selected: PupBeacon");
   }
   
@@ -2353,40 +5056,75 @@ void selectRoleOnBoot() {
   }
   if (LED_PIN >= 0) digitalWrite(LED_PIN, LOW);
 }
+#endif
 
 void setup() {
   Serial.begin(115200);
   
-  // Wait for USB CDC to be ready (ESP32-S3)
-  unsigned long start = millis();
-  while (!Serial && (millis() - start < 3000)) {
-    delay(10);
+  // A timer wake is the beacon coming out of deep sleep: no role prompt
+  resumedFromDeepSleep = sleepState.begin(esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER);
+  batteryModel.begin();
+  resetReason = esp_reset_reason();
+  bool cached = loadBootCache();
+  
+  // A reset in the field goes back to the role the last full boot selected.
+  // A single-role image only takes a cache its own role saved.
+  fastBoot = !resumedFromDeepSleep && cached && isFieldReset(resetReason) &&
+             ((PAW_BEACON && PAW_STATION) || bootCache.role == currentRole);
+  
+  if (resumedFromDeepSleep) {
+    selectRole(ROLE_PUP_BEACON);
+  } else if (fastBoot) {
+    selectRole((DeviceRole)bootCache.role);
+    Serial.printf("\n=== PawTracker fast boot (reset reason %d) ===\n", (int)resetReason);
+  } else {
+    // Wait for USB CDC to be ready (ESP32-S3)
+    unsigned long start = millis();
+    while (!Serial && (millis() - start < 3000)) {
+      delay(10);
+    }
+    delay(500);
+    
+    Serial.println("\n\n=== PawTracker Initializing ===");
+    Serial.println("Firmware starting...");
+    Serial.flush();
+    
+#if PAW_BEACON && PAW_STATION
+    selectRoleOnBoot();
+#endif
   }
-  delay(500);
-  
-  Serial.println("\n\n=== PawTracker Initializing ===");
-  Serial.println("Firmware starting...");
-  Serial.flush();
-  
-  selectRoleOnBoot();
   
   Serial.print("Selected role: ");
   Serial.println(currentRole == ROLE_PUP_BEACON ? "PupBeacon" : "PupStation");
   Serial.flush();
+  
+  startLogTask();
+  startBatteryMonitor(resumedFromDeepSleep);
 
   if (currentRole == ROLE_PUP_BEACON) {
+#if PAW_BEACON
     setupPupBeacon();
+#endif
   } else {
+#if PAW_STATION
     setupPupStation();
+#endif
   }
   
+  setupDoneMs = millis();
+  LOG_INFO(LOG_SYSTEM, "Setup done after %lu ms, %s boot, reset reason %d",
+           (unsigned long)setupDoneMs, fastBoot ? "fast" : "full", (int)resetReason);
   Serial.println("=== Setup Complete ===\n");
 }
 
 void loop() {
   if (currentRole == ROLE_PUP_BEACON) {
+#if PAW_BEACON
     loopPupBeacon();
+#endif
   } else {
+#if PAW_STATION
     loopPupStation();
+#endif
   }
 }
@@ -0,0 +1,185 @@
+// Station metrics: counters, gauges and fixed-bucket histograms, rendered in
+// Prometheus text format for GET /api/metrics.
+//
+// Every metric links itself into one list when it is constructed, so the
+// exporter has no table to keep in sync. Labels are given preformatted
+// (`route="/api/stats",method="GET"`). Metrics sharing a name (one per label
+// set) must be constructed one after another, since HELP/TYPE is written once
+// per run of equal names.
+//
+// Each metric is updated by one task and read by the web task. Updates are
+// relaxed atomics, so a scrape can see a histogram one observation apart
+// between its buckets and its count; Prometheus tolerates that.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+enum MetricType : uint8_t {
+  METRIC_COUNTER,
+  METRIC_GAUGE,
+  METRIC_HISTOGRAM
+};
+
+class Metric {
+public:
+  const char* name;
+  const char* help;
+  const char* labels;       // Without braces, nullptr for none
+  MetricType type;
+  Metric* next = nullptr;
+
+  static Metric* first() { return head(); }
+
+protected:
+  Metric(MetricType type, const char* name, const char* help, const char* labels)
+    : name(name), help(help), labels(labels), type(type) {
+    Metric** link = &head();
+    while (*link) link = &(*link)->next;
+    *link = this;
+  }
+
+private:
+  static Metric*& head() {
+    static Metric* list = nullptr;
+    return list;
+  }
+};
+
+// Monotonic count. Either owns its value or exports an existing counter
+// (e.g. a field of a stats struct), so nothing is counted twice.
+class MetricCounter : public Metric {
+public:
+  MetricCounter(const char* name, const char* help, const char* labels = nullptr)
+    : Metric(METRIC_COUNTER, name, help, labels) {}
+
+  MetricCounter(const char* name, const char* help, const volatile uint32_t* source)
+    : Metric(METRIC_COUNTER, name, help, nullptr), source(source) {}
+
+  void inc(uint32_t n = 1) { own.fetch_add(n, std::memory_order_relaxed); }
+
+  uint32_t value() const { return source ? *source : own.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint32_t> own{0};
+  const volatile uint32_t* source = nullptr;
+};
+
+class MetricGauge : public Metric {
+public:
+  MetricGauge(const char* name, const char* help, const char* labels = nullptr)
+    : Metric(METRIC_GAUGE, name, help, labels) {}
+
+  void set(float v) { current.store(v, std::memory_order_relaxed); }
+  float value() const { return current.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<float> current{0.0f};
+};
+
+// Durations in microseconds, exported in seconds. boundsUs are the upper
+// bounds of the buckets, ascending; a +Inf bucket is implied.
+class MetricHistogram : public Metric {
+public:
+  static const uint8_t MAX_BUCKETS = 12;
+
+  MetricHistogram(const char* name, const char* help, const uint32_t* boundsUs, uint8_t bucketCount,
+                  const char* labels = nullptr)
+    : Metric(METRIC_HISTOGRAM, name, help, labels),
+      boundsUs(boundsUs), bucketCount(bucketCount < MAX_BUCKETS ? bucketCount : MAX_BUCKETS) {}
+
+  void observe(uint32_t us) {
+    uint8_t i = 0;
+    while (i < bucketCount && us > boundsUs[i]) i++;
+    if (i < bucketCount) buckets[i].fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(us, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const uint32_t* boundsUs;
+  uint8_t bucketCount;
+  std::atomic<uint32_t> buckets[MAX_BUCKETS] = {};  // Not cumulative; the exporter adds them up
+  std::atomic<uint64_t> sumUs{0};
+  std::atomic<uint32_t> count{0};
+};
+
+// Shared bucket layouts
+const uint32_t METRIC_LATENCY_BUCKETS_US[] = {
+  1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000
+};
+const uint8_t METRIC_LATENCY_BUCKETS = sizeof(METRIC_LATENCY_BUCKETS_US) / sizeof(METRIC_LATENCY_BUCKETS_US[0]);
+
+const uint32_t METRIC_LOOP_BUCKETS_US[] = {
+  50, 100, 250, 500, 1000, 2500, 5000, 10000, 50000, 100000, 500000
+};
+const uint8_t METRIC_LOOP_BUCKETS = sizeof(METRIC_LOOP_BUCKETS_US) / sizeof(METRIC_LOOP_BUCKETS_US[0]);
+
+// `{labels,extra}` (extra e.g. `le="0.5"`), or "" with neither
+inline void formatMetricLabels(char* out, size_t size, const Metric& m, const char* extra = nullptr) {
+  if (m.labels && extra) {
+    snprintf(out, size, "{%s,%s}", m.labels, extra);
+  } else if (m.labels) {
+    snprintf(out, size, "{%s}", m.labels);
+  } else if (extra) {
+    snprintf(out, size, "{%s}", extra);
+  } else {
+    out[0] = '\0';
+  }
+}
+
+// Append every metric to out (anything with += const char*, e.g. String)
+template <typename Out>
+void renderMetrics(Out& out) {
+  static const char* TYPE_NAMES[] = {"counter", "gauge", "histogram"};
+  char line[256];
+  char labels[96];
+  const char* lastName = "";
+
+  for (const Metric* m = Metric::first(); m; m = m->next) {
+    if (strcmp(m->name, lastName) != 0) {
+      snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n",
+               m->name, m->help, m->name, TYPE_NAMES[m->type]);
+      out += line;
+      lastName = m->name;
+    }
+
+    if (m->type == METRIC_COUNTER) {
+      formatMetricLabels(labels, sizeof(labels), *m);
+      snprintf(line, sizeof(line), "%s%s %lu\n", m->name, labels,
+               (unsigned long)static_cast<const MetricCounter*>(m)->value());
+      out += line;
+    } else if (m->type == METRIC_GAUGE) {
+      formatMetricLabels(labels, sizeof(labels), *m);
+      snprintf(line, sizeof(line), "%s%s %.10g\n", m->name, labels,
+               (double)static_cast<const MetricGauge*>(m)->value());
+      out += line;
+    } else {
+      const MetricHistogram* h = static_cast<const MetricHistogram*>(m);
+      uint32_t cumulative = 0;
+      char le[24];
+      for (uint8_t i = 0; i < h->bucketCount; i++) {
+        cumulative += h->buckets[i].load(std::memory_order_relaxed);
+        snprintf(le, sizeof(le), "le=\"%g\"", h->boundsUs[i] / 1e6);
+        formatMetricLabels(labels, sizeof(labels), *m, le);
+        snprintf(line, sizeof(line), "%s_bucket%s %lu\n", m->name, labels, (unsigned long)cumulative);
+        out += line;
+      }
+      uint32_t count = h->count.load(std::memory_order_relaxed);
+      formatMetricLabels(labels, sizeof(labels), *m, "le=\"+Inf\"");
+      snprintf(line, sizeof(line), "%s_bucket%s %lu\n", m->name, labels, (unsigned long)count);
+      out += line;
+      formatMetricLabels(labels, sizeof(labels), *m);
+      snprintf(line, sizeof(line), "%s_sum%s %.6f\n", m->name, labels,
+               h->sumUs.load(std::memory_order_relaxed) / 1e6);
+      out += line;
+      snprintf(line, sizeof(line), "%s_count%s %lu\n", m->name, labels, (unsigned long)count);
+      out += line;
+    }
+  }
+}
+
+#endif // METRICS_H
@@ -0,0 +1,170 @@
+// The native harness's simulated beacons and station (native/main.cpp, test/)
+//
+// Beacons send a fix each BEACON_INTERVAL_MS over LoopbackRadio; the station
+// runs the processFrame()/replyToFrame() path of the firmware and writes
+// history.csv through history_store.h.
+
+#ifndef NATIVE_HARNESS_H
+#define NATIVE_HARNESS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "hal_native.h"
+#include "beacon_core.h"
+#include "station_core.h"
+#include "history_store.h"
+
+const uint32_t BEACON_INTERVAL_MS = 2000;
+const uint32_t TICK_MS = 10;
+const uint32_t BASE_UNIX_TIME = 1760000000;       // Simulated GPS time at t = 0
+const double START_LAT = 41.3874;
+const double START_LON = 2.1686;
+
+struct SimBeacon {
+  char beaconId[9];
+  LoopbackRadio radio;
+  FixBacklog backlog;
+  bool stationIdle = false;
+  uint32_t nextFrameMs = 0;
+  uint32_t lastRxMs = 0;
+  uint32_t lastBackfillMs = 0;
+  uint32_t liveFrames = 0;
+  uint32_t backfillFrames = 0;
+  double heading = 0.0;
+};
+
+struct SimStation {
+  LoopbackRadio radio;
+  BeaconTable beacons;
+  BeaconRegistry<SeqWindow, MAX_BEACONS> rxSeqWindows;
+  BeaconRegistry<StoredSeqs, MAX_BEACONS> storedSeqs;
+  std::vector<HistoryRecord> pendingBackfill;
+  uint32_t framesHeard = 0;
+  uint32_t framesDropped = 0;   // Lost to the outage
+  uint32_t historyRows = 0;
+  uint32_t backfilledRows = 0;
+};
+
+// Beacon index of count, cold-booted and in range of the station
+inline void joinStation(SimBeacon& b, SimStation& s, int index, int count) {
+  memset(&b.backlog, 0, sizeof(b.backlog));
+  b.backlog.begin();
+  formatBeaconId(0xB0000000u + index, b.beaconId);
+  b.nextFrameMs = (uint32_t)(index * BEACON_INTERVAL_MS / count);  // Spread over the interval
+  b.heading = index;
+  b.radio.peers.push_back(&s.radio);
+  s.radio.peers.push_back(&b.radio);
+}
+
+// Beacon: next live frame, or a backfill frame when one is due
+inline void beaconTick(SimBeacon& b, uint32_t nowMs) {
+  uint8_t rx[256];
+  float rssi, snr;
+  int len;
+  while ((len = b.radio.receive(rx, sizeof(rx), rssi, snr)) > 0) {
+    if ((size_t)len < sizeof(ControlMessage)) continue;
+    ControlMessage ctrl;
+    memcpy(&ctrl, rx, sizeof(ctrl));
+    if (applyStationReply(b.backlog, ctrl, b.beaconId, b.stationIdle)) {
+      b.lastRxMs = nowMs;
+    }
+  }
+
+  if (nowMs < b.nextFrameMs) return;
+  b.nextFrameMs = nowMs + BEACON_INTERVAL_MS;
+
+  // Walk slowly in a circle around the start point
+  b.heading += 0.01;
+  double latitude = START_LAT + 0.001 * sin(b.heading);
+  double longitude = START_LON + 0.001 * cos(b.heading);
+  uint32_t unixTime = BASE_UNIX_TIME + nowMs / 1000;
+
+  BeaconMessage msg{};
+  msg.msgType = MSG_BEACON;
+  memcpy(msg.beaconId, b.beaconId, sizeof(msg.beaconId));
+  msg.latitude = (float)latitude;
+  msg.longitude = (float)longitude;
+  msg.hdop = 1.0f;
+  msg.sats = 9;
+  msg.batteryVoltage = 3.9f;
+  msg.speed = 4.0f;
+  msg.altitude = 12.0f;
+  msg.uptime = nowMs / 1000;
+  msg.seq = b.backlog.takeSeq();
+  msg.flags = beaconFrameFlags(b.backlog, msg.seq, b.stationIdle);
+  msg.batteryLifeH = BATTERY_LIFE_UNKNOWN;
+  b.backlog.add(makeBacklogFix(unixTime, latitude, longitude, msg.altitude, msg.speed, msg.seq));
+  b.radio.transmit((const uint8_t*)&msg, sizeof(msg));
+  b.liveFrames++;
+
+  if (backfillDue(b.backlog, nowMs, b.lastRxMs, b.lastBackfillMs)) {
+    BackfillMessage bf;
+    size_t bfLen = buildBackfillFrame(b.backlog, b.beaconId, bf);
+    b.radio.transmit((const uint8_t*)&bf, bfLen);
+    b.lastBackfillMs = nowMs;
+    b.backfillFrames++;
+  }
+}
+
+inline void stationReply(SimStation& s, const char* beaconId, uint8_t extraFlags) {
+  uint32_t id;
+  const SeqWindow* window = parseBeaconId(beaconId, id) ? s.rxSeqWindows.find(id) : nullptr;
+  ControlMessage ctrl = makeStationReply(beaconId, MSG_ACK, window);
+  ctrl.flags |= CONTROL_FLAG_IDLE | extraFlags;
+  s.radio.transmit((const uint8_t*)&ctrl, sizeof(ctrl));
+}
+
+// Station: the processFrame()/replyToFrame() path of the firmware
+inline void stationTick(SimStation& s, HalFileSystem& fs, uint32_t nowMs, bool outage) {
+  uint8_t rx[256];
+  float rssi, snr;
+  int len;
+  while ((len = s.radio.receive(rx, sizeof(rx), rssi, snr)) > 0) {
+    if (outage) {
+      s.framesDropped++;
+      continue;
+    }
+    s.framesHeard++;
+
+    BeaconMessage msg;
+    BackfillMessage bf;
+    if (decodeBeaconMessage(rx, len, msg)) {
+      if (!beaconDataInRange(msg)) continue;
+      bool added;
+      uint32_t id;
+      LatestBeaconData* beacon = findOrAddBeacon(s.beacons, msg.beaconId, added);
+      if (!beacon || !parseBeaconId(msg.beaconId, id)) continue;
+      applyBeaconMessage(*beacon, msg, rssi, snr, nowMs);
+      SeqWindow* window = s.rxSeqWindows.findOrAdd(id);
+      if (window) window->record(msg.seq);
+      appendHistoryRecord(fs, beaconHistoryRecord(msg, rssi, snr, BASE_UNIX_TIME + nowMs / 1000));
+      s.historyRows++;
+      StoredSeqs* stored = s.storedSeqs.findOrAdd(id);
+      if (stored) stored->markLive(msg.seq);
+      if (msg.flags & BEACON_FLAG_ACK_REQUEST) stationReply(s, msg.beaconId, 0);
+    } else if (decodeBackfillMessage(rx, len, bf)) {
+      bool added;
+      uint32_t id;
+      LatestBeaconData* beacon = findOrAddBeacon(s.beacons, bf.beaconId, added);
+      if (!beacon || !parseBeaconId(bf.beaconId, id)) continue;
+      StoredSeqs* stored = s.storedSeqs.findOrAdd(id);
+      if (stored) dropStoredFixes(bf, *stored);
+      HistoryRecord rows[BACKFILL_FIXES_PER_FRAME];
+      uint8_t n = backfillHistoryRecords(bf, beacon->batteryVoltage, rssi, snr, rows);
+      s.pendingBackfill.insert(s.pendingBackfill.end(), rows, rows + n);
+      beacon->backfilledFixes += n;
+      beacon->rxFrames++;
+      stationReply(s, bf.beaconId, CONTROL_FLAG_BACKFILL_ACK);
+    }
+  }
+
+  if (s.pendingBackfill.size() >= BACKFILL_MERGE_BATCH) {
+    size_t merged;
+    mergeHistoryRecords(fs, s.pendingBackfill, merged);
+    s.backfilledRows += merged;
+  }
+}
+
+#endif // NATIVE_HARNESS_H
@@ -0,0 +1,97 @@
+// Beacon battery-life estimate
+//
+// The beacon cannot measure its current draw, so it books the time it spends
+// in each power state and prices it with typical currents for the Wireless
+// Tracker (ESP32-S3 + SX1262 + UC6580). The average current over roughly the
+// last hour, against the charge left in the cell (from its voltage), gives
+// the hours of life remaining.
+//
+// BatteryLifeModel is plain data with no constructor so it can live in RTC
+// memory (RTC_DATA_ATTR) and keep its history across deep sleep; call
+// begin() once per boot.
+
+#ifndef POWER_MODEL_H
+#define POWER_MODEL_H
+
+#include <stdint.h>
+
+enum PowerState : uint8_t {
+  POWER_AWAKE = 0,     // CPU running, radio idle
+  POWER_TX,            // Radio transmitting (on top of AWAKE)
+  POWER_RX,            // Radio listening (on top of AWAKE)
+  POWER_LIGHT_SLEEP,
+  POWER_DEEP_SLEEP,
+  POWER_STATES
+};
+
+// Typical draw per state in mA. The GPS stays powered in every state; the
+// display backlight is lit while awake and in light sleep.
+const float POWER_STATE_MA[POWER_STATES] = {
+  45.0f + 30.0f + 15.0f,  // AWAKE: CPU, GPS tracking, backlight
+  118.0f,                 // TX: SX1262 at +22 dBm
+  5.0f,                   // RX
+  1.5f + 30.0f + 15.0f,   // LIGHT_SLEEP: CPU, GPS, backlight
+  0.2f + 30.0f,           // DEEP_SLEEP: RTC domain + GPS kept powered for hot starts
+};
+
+const float BATTERY_CAPACITY_MAH = 1000.0f;  // Set to the fitted cell
+const uint16_t BATTERY_LIFE_UNKNOWN = 0xFFFF;
+
+// Share of capacity left in a 1-cell LiPo at rest, by voltage
+inline float lipoChargeFraction(float volts) {
+  static const float curve[][2] = {
+    {3.30f, 0.00f}, {3.50f, 0.05f}, {3.60f, 0.12f}, {3.70f, 0.30f},
+    {3.80f, 0.50f}, {3.90f, 0.65f}, {4.00f, 0.80f}, {4.10f, 0.92f}, {4.20f, 1.00f},
+  };
+  const int points = sizeof(curve) / sizeof(curve[0]);
+  if (volts <= curve[0][0]) return 0.0f;
+  if (volts >= curve[points - 1][0]) return 1.0f;
+  for (int i = 1; i < points; i++) {
+    if (volts < curve[i][0]) {
+      float t = (volts - curve[i - 1][0]) / (curve[i][0] - curve[i - 1][0]);
+      return curve[i - 1][1] + t * (curve[i][1] - curve[i - 1][1]);
+    }
+  }
+  return 1.0f;
+}
+
+struct BatteryLifeModel {
+  static const uint32_t MAGIC = 0x50574254;     // "PWBT"
+  static const uint32_t WINDOW_MS = 3600000;   // History is halved past this
+
+  uint32_t magic;
+  float chargeMaMs;   // mA x ms booked over the window
+  uint32_t elapsedMs;
+
+  void begin() {
+    if (magic != MAGIC) {
+      magic = MAGIC;
+      chargeMaMs = 0;
+      elapsedMs = 0;
+    }
+  }
+
+  // Book ms in a state. TX and RX add to AWAKE and so do not count as elapsed time.
+  void add(PowerState state, uint32_t ms) {
+    chargeMaMs += POWER_STATE_MA[state] * ms;
+    if (state == POWER_TX || state == POWER_RX) return;
+    elapsedMs += ms;
+    if (elapsedMs > WINDOW_MS) {
+      chargeMaMs *= 0.5f;
+      elapsedMs /= 2;
+    }
+  }
+
+  float averageMa() const {
+    return elapsedMs > 0 ? chargeMaMs / elapsedMs : 0.0f;
+  }
+
+  // Whole hours left at the average draw; BATTERY_LIFE_UNKNOWN until a minute is booked
+  uint16_t hoursLeft(float batteryVolts) const {
+    if (elapsedMs < 60000) return BATTERY_LIFE_UNKNOWN;
+    float hours = BATTERY_CAPACITY_MAH * lipoChargeFraction(batteryVolts) / averageMa();
+    return hours >= BATTERY_LIFE_UNKNOWN - 1 ? BATTERY_LIFE_UNKNOWN - 1 : (uint16_t)hours;
+  }
+};
+
+#endif // POWER_MODEL_H
@@ -0,0 +1,167 @@
+// Scoped section profiler on the CPU cycle counter
+//
+// PROFILE_ZONE(zone) times the rest of the enclosing block into a
+// ProfileZone: count, min, max, total and a log-linear histogram of cycle
+// counts (4 buckets per power of two, so p99 is good to within 19%).
+// With PAW_PROFILE=0 both macros expand to nothing: no zones, no code.
+//
+// The cycle counter is per core, so zones must only be used in tasks pinned
+// to a core (all station tasks are). Each zone is recorded by one task; a
+// reader may see it mid-update. A reset is only requested from outside and
+// applied by the recording task on its next record, so it never races it.
+// Zones record only while profileRecording() is set; the firmware clears it
+// when the measured overhead goes over budget.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#ifndef PAW_PROFILE
+#define PAW_PROFILE 1
+#endif
+
+#ifdef ARDUINO
+#include <Arduino.h>
+inline uint32_t profileCycles() { return ESP.getCycleCount(); }
+#else
+#include <chrono>
+inline uint32_t profileCycles() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+class ProfileZone {
+public:
+  static const uint8_t BUCKETS = 124;  // Covers all of uint32_t
+
+  const char* name;
+  ProfileZone* next = nullptr;
+
+  uint32_t count = 0;
+  uint32_t minCycles = UINT32_MAX;
+  uint32_t maxCycles = 0;
+  uint64_t totalCycles = 0;
+  uint32_t buckets[BUCKETS] = {};
+
+  // listed=false keeps the zone out of first()/next (e.g. for calibration)
+  explicit ProfileZone(const char* name, bool listed = true) : name(name) {
+    if (!listed) return;
+    ProfileZone** link = &head();
+    while (*link) link = &(*link)->next;
+    *link = this;
+  }
+
+  static ProfileZone* first() { return head(); }
+
+  void record(uint32_t cycles) {
+    if (resetPending.exchange(false, std::memory_order_acquire)) {
+      clear();
+    }
+    count++;
+    totalCycles += cycles;
+    if (cycles < minCycles) minCycles = cycles;
+    if (cycles > maxCycles) maxCycles = cycles;
+    buckets[bucketOf(cycles)]++;
+  }
+
+  void requestReset() { resetPending.store(true, std::memory_order_release); }
+
+  // Upper bound of the bucket holding the p-th fraction of records, capped at max
+  uint32_t percentile(float p) const {
+    if (count == 0) return 0;
+    uint32_t target = (uint32_t)(p * count + 0.999f);
+    if (target == 0) target = 1;
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < BUCKETS; b++) {
+      seen += buckets[b];
+      if (seen >= target) {
+        uint32_t upper = b + 1 < BUCKETS ? lowerBound(b + 1) - 1 : UINT32_MAX;
+        return upper < maxCycles ? upper : maxCycles;
+      }
+    }
+    return maxCycles;
+  }
+
+  static uint8_t bucketOf(uint32_t cycles) {
+    if (cycles < 4) return (uint8_t)cycles;
+    uint8_t msb = 31 - __builtin_clz(cycles);
+    return (uint8_t)((msb - 1) * 4 + ((cycles >> (msb - 2)) & 3));
+  }
+
+  static uint32_t lowerBound(uint8_t bucket) {
+    if (bucket < 4) return bucket;
+    uint8_t msb = bucket / 4 + 1;
+    return (uint32_t)(4 + bucket % 4) << (msb - 2);
+  }
+
+private:
+  std::atomic<bool> resetPending{false};
+
+  void clear() {
+    count = 0;
+    minCycles = UINT32_MAX;
+    maxCycles = 0;
+    totalCycles = 0;
+    memset(buckets, 0, sizeof(buckets));
+  }
+
+  static ProfileZone*& head() {
+    static ProfileZone* list = nullptr;
+    return list;
+  }
+};
+
+inline std::atomic<bool>& profileRecording() {
+  static std::atomic<bool> recording{true};
+  return recording;
+}
+
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfileZone& zone) : zone(zone), start(profileCycles()) {}
+  ~ProfileScope() {
+    if (profileRecording().load(std::memory_order_relaxed)) zone.record(profileCycles() - start);
+  }
+
+private:
+  ProfileZone& zone;
+  uint32_t start;
+};
+
+// Cycles one ProfileScope adds to the code it wraps
+inline uint32_t profileOverheadCycles() {
+  static ProfileZone calibration("calibration", false);
+  const uint32_t rounds = 256;
+  uint32_t start = profileCycles();
+  for (uint32_t i = 0; i < rounds; i++) {
+    ProfileScope scope(calibration);
+  }
+  return (profileCycles() - start) / rounds;
+}
+
+// Share of elapsedCycles spent in the profiler: overheadCycles for every
+// section the listed zones recorded
+inline float profileOverheadPercent(uint32_t overheadCycles, uint64_t elapsedCycles) {
+  uint64_t sections = 0;
+  for (const ProfileZone* z = ProfileZone::first(); z; z = z->next) {
+    sections += z->count;
+  }
+  return elapsedCycles ? sections * overheadCycles * 100.0f / elapsedCycles : 0.0f;
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PAW_PROFILE
+#define PROFILE_ZONE_DEFINE(var, name) ProfileZone var(name)
+#define PROFILE_ZONE(var) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(var)
+#else
+#define PROFILE_ZONE_DEFINE(var, name)
+#define PROFILE_ZONE(var)
+#endif
+
+#endif // PROFILER_H
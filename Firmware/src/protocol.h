@@ -0,0 +1,82 @@
+// LoRa message formats shared by PupBeacon and PupStation
+// Both devices must be built from the same definitions (see README.md)
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+
+// Message types
+const uint8_t MSG_BEACON = 0x01;    // BeaconMessage - live fix from beacon
+const uint8_t MSG_BACKFILL = 0x03;  // BackfillMessage - fixes missed while out of range
+const uint8_t MSG_CONTROL = 0x10;   // ControlMessage - actuator command (+ ack)
+const uint8_t MSG_ACK = 0x11;       // ControlMessage - ack only, actuator fields ignored
+
+// BeaconMessage.flags
+const uint8_t BEACON_FLAG_ACK_REQUEST = 0x01;  // Station should reply with an ack
+const uint8_t BEACON_FLAG_LISTENING = 0x02;    // Beacon opens an RX window for the reply slot
+const uint8_t BEACON_FLAG_FAST_BOOT = 0x04;    // This boot skipped detection (cached role and GPS baud)
+
+// ControlMessage.flags
+const uint8_t CONTROL_FLAG_ACK = 0x01;           // ackSeq/ackBitmap are valid
+const uint8_t CONTROL_FLAG_BACKFILL_ACK = 0x02;  // Acknowledges the last BackfillMessage
+const uint8_t CONTROL_FLAG_IDLE = 0x04;          // No control pending - beacon may skip RX windows
+
+// Reply slot: the station starts transmitting REPLY_OFFSET_US after the end of
+// the beacon frame (its RxDone). The beacon listens from its TxDone for the
+// offset plus the reply's time-on-air plus REPLY_TOLERANCE_US.
+const uint32_t REPLY_OFFSET_US = 15000;
+const uint32_t REPLY_TOLERANCE_US = 10000;
+
+struct __attribute__((packed)) BeaconMessage {
+  uint8_t msgType;   // 0x01 = GPS beacon, 0x02 = control ack, etc.
+  char beaconId[9];  // Unique beacon identifier (ESP32 chip ID in hex, null-terminated)
+  float latitude;
+  float longitude;
+  float hdop;
+  uint8_t sats;
+  float batteryVoltage;
+  uint8_t ledOn;
+  uint8_t buzzerOn;
+  uint8_t lastControlReceived; // 0=none, 1=LED, 2=Buzzer, 3=Both
+  float speed;       // Speed in km/h
+  float altitude;    // Altitude in meters
+  uint32_t uptime;   // Beacon uptime in seconds
+  uint16_t seq;      // Per-beacon frame sequence number
+  uint8_t flags;     // BEACON_FLAG_*
+  uint16_t awakeMs;  // Time awake since the previous frame
+  uint16_t batteryLifeH; // Modeled battery life left in hours, 0xFFFF = unknown
+  uint16_t bootMs;   // Reset or deep-sleep wake to this boot's first frame, capped at 0xFFFF
+};
+
+struct __attribute__((packed)) ControlMessage {
+  uint8_t msgType;   // 0x10 = control from station, 0x11 = ack only
+  char beaconId[9];  // Target beacon ID (hex, null-terminated)
+  uint8_t ledOn;     // 0 or 1
+  uint8_t buzzerOn;  // 0 or 1
+  uint8_t flags;     // CONTROL_FLAG_*
+  uint16_t ackSeq;   // Highest BeaconMessage seq received from this beacon
+  uint16_t ackBitmap; // Bit i set = seq (ackSeq - 1 - i) was also received
+};
+
+// Compact fix used for store-and-forward backfill (18 bytes)
+struct __attribute__((packed)) BackfillFix {
+  uint32_t timestamp;  // Unix time from beacon GPS (UTC)
+  int32_t latE7;       // Latitude in 1e-7 degrees
+  int32_t lonE7;       // Longitude in 1e-7 degrees
+  int16_t altitude;    // Meters
+  uint16_t speedX10;   // Speed in 0.1 km/h
+  uint16_t seq;        // seq of the BeaconMessage this fix was first sent in
+};
+
+const uint8_t BACKFILL_FIXES_PER_FRAME = 10;
+
+struct __attribute__((packed)) BackfillMessage {
+  uint8_t msgType;   // 0x03 = backfill
+  char beaconId[9];  // Source beacon ID (hex, null-terminated)
+  uint8_t count;     // Number of valid entries in fixes[]
+  BackfillFix fixes[BACKFILL_FIXES_PER_FRAME];
+};
+// Total size: 191 bytes (fits a single SF7 LoRa frame)
+
+#endif // PROTOCOL_H
@@ -0,0 +1,79 @@
+// Regional LoRa settings shared by PupBeacon and PupStation
+//
+// Select the region with a build flag in platformio.ini (both devices must
+// use the same one):
+//   -D PAW_REGION_EU868   Europe, 868 MHz
+//   (none)                US/AU, 915 MHz
+//
+// Listen-before-talk: every transmission starts with channel activity
+// detection (CAD). While a LoRa preamble is detected the sender backs off for
+// a random time in a window that doubles after each busy check.
+//
+// Duty cycle: airtime is accounted per regulatory sub-band over a one-hour
+// window (airtime.h); we allow ourselves AIRTIME_BUDGET_PERCENT of each
+// sub-band's limit and leave the rest as headroom.
+
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdint.h>
+
+const uint8_t AIRTIME_BUDGET_PERCENT = 90;
+
+struct SubBand {
+  const char* name;
+  float lowMHz;
+  float highMHz;
+  uint16_t dutyCyclePermille;  // 1000 = no duty-cycle limit
+};
+
+const uint8_t MAX_SUB_BANDS = 5;
+
+struct LoRaRegion {
+  const char* name;
+  float frequency;          // MHz
+  uint8_t cadMaxAttempts;   // CAD checks before giving up on a busy channel
+  uint16_t backoffBaseMs;   // First backoff window, doubled after each busy CAD
+  uint16_t backoffMaxMs;    // Cap on a single backoff window
+  bool dropWhenBusy;        // Channel still busy after all attempts: drop (true) or send anyway
+  const SubBand* subBands;
+  uint8_t subBandCount;     // At most MAX_SUB_BANDS
+};
+
+// FCC 15.247 has no duty-cycle limit (the 400 ms dwell time per channel is far
+// above our frame length) and no LBT requirement - CAD only avoids collisions
+// with our own beacons, so after a few tries the frame goes out regardless
+const SubBand US915_SUB_BANDS[] = {
+  {"902-928", 902.0, 928.0, 1000},
+};
+const LoRaRegion REGION_US915 = {"US915", 915.0, 4, 10, 160, false, US915_SUB_BANDS, 1};
+
+// ETSI EN 300 220 / ERC Rec 70-03 sub-bands. LBT: never transmit into a busy
+// channel, defer instead. A dropped fix stays in the beacon's backlog and is
+// sent later as backfill.
+const SubBand EU868_SUB_BANDS[] = {
+  {"g 863-868", 863.0, 868.0, 10},
+  {"g1 868.0-868.6", 868.0, 868.6, 10},
+  {"g2 868.7-869.2", 868.7, 869.2, 1},
+  {"g3 869.4-869.65", 869.4, 869.65, 100},
+  {"g4 869.7-870.0", 869.7, 870.0, 10},
+};
+const LoRaRegion REGION_EU868 = {"EU868", 868.1, 6, 20, 640, true, EU868_SUB_BANDS, 5};
+
+#if defined(PAW_REGION_EU868)
+const LoRaRegion &LORA_REGION = REGION_EU868;
+#else
+const LoRaRegion &LORA_REGION = REGION_US915;
+#endif
+
+// Index of the sub-band containing a frequency, -1 if it is outside the region
+inline int8_t findSubBand(const LoRaRegion &region, float frequency) {
+  for (uint8_t i = 0; i < region.subBandCount; i++) {
+    if (frequency >= region.subBands[i].lowMHz && frequency < region.subBands[i].highMHz) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+#endif // REGION_H
@@ -0,0 +1,320 @@
+// Host replay of a station capture (pio run -e replay)
+//
+// Feeds a trace recorded with /api/capture (trace_format.h) through the
+// station code on a host: NMEA into TinyGPS++ and the station's GPS fix, each
+// frame through the processFrame() path (station_core.h) when the capture
+// says the station processed it, and the history rows into history.csv in a
+// temp directory (history_store.h). Every frame's result - accepted or not,
+// and a digest of the history rows it produced - is compared with the one
+// recorded on the station; differences are reported as divergences.
+//
+//   .pio/build/replay/program capture.bin              As fast as possible
+//   .pio/build/replay/program capture.bin --speed 1    In real time
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include "hal_native.h"
+#include "gps_fix.h"
+#include "station_core.h"
+#include "history_store.h"
+#include "trace_format.h"
+
+const size_t MAX_DIVERGENCES_SHOWN = 10;
+
+// Capture time of the record being replayed; TinyGPS++ ages fields with it
+static uint32_t replayMs = 0;
+
+unsigned long millis() {
+  return replayMs;
+}
+
+struct Options {
+  const char* path = nullptr;
+  double speed = 0.0;   // 0: as fast as possible
+  std::string dir;
+};
+
+struct CapturedFrame {
+  uint32_t ms;
+  TraceFrameInfo info;
+  std::vector<uint8_t> data;
+};
+
+struct Divergence {
+  uint32_t ms;
+  char beaconId[9];
+  TraceResult recorded;
+  TraceResult replayed;
+};
+
+struct Replay {
+  TinyGPSPlus gps;
+  GpsFix fix;
+  BeaconTable beacons;
+  BeaconRegistry<StoredSeqs, MAX_BEACONS> storedSeqs;
+  std::vector<HistoryRecord> pendingBackfill;
+  uint32_t lastBackfillRx = 0;
+  std::deque<CapturedFrame> frames;   // Recorded, not yet processed
+
+  uint32_t records = 0;
+  uint64_t nmeaBytes = 0;
+  uint32_t framesReplayed = 0;
+  uint32_t framesAccepted = 0;
+  uint32_t framesUnanswered = 0;     // No result in the trace (dropped from the capture ring)
+  uint32_t orphanResults = 0;        // Result for a frame not in the trace
+  uint32_t historyRows = 0;
+  uint32_t backfilledRows = 0;
+  uint32_t matched = 0;
+  std::vector<Divergence> divergences;
+  uint32_t divergenceCount = 0;
+};
+
+static void usage(const char* prog) {
+  fprintf(stderr, "usage: %s CAPTURE [--speed X] [--dir PATH]\n", prog);
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (arg[0] != '-') {
+      if (opt.path) return false;
+      opt.path = arg;
+      continue;
+    }
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) return false;
+    if (strcmp(arg, "--speed") == 0) {
+      opt.speed = atof(value);
+    } else if (strcmp(arg, "--dir") == 0) {
+      opt.dir = value;
+    } else {
+      return false;
+    }
+    i++;
+  }
+  return opt.path != nullptr && opt.speed >= 0.0;
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& bytes) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) bytes.insert(bytes.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static void mergeBackfill(Replay& r, HalFileSystem& fs) {
+  size_t merged;
+  mergeHistoryRecords(fs, r.pendingBackfill, merged);
+  r.backfilledRows += merged;
+}
+
+// processFrame() on the station: decode, update the table, queue history rows.
+// Returns the result to compare with the recorded one.
+static TraceResult processFrame(Replay& r, HalFileSystem& fs, const CapturedFrame& frame, char* beaconId) {
+  TraceResult result = {frame.ms, 0, 0, TRACE_DIGEST_SEED};
+  const uint8_t* data = frame.data.data();
+  size_t len = frame.data.size();
+  float rssi = frame.info.rssi;
+  float snr = frame.info.snr;
+  BeaconMessage msg;
+  BackfillMessage bf;
+  beaconId[0] = '\0';
+
+  if (decodeBeaconMessage(data, len, msg)) {
+    memcpy(beaconId, msg.beaconId, sizeof(msg.beaconId));
+    if (!beaconDataInRange(msg)) return result;
+    result.accepted = 1;
+    uint32_t id;
+    bool added;
+    LatestBeaconData* beacon = parseBeaconId(msg.beaconId, id) ? findOrAddBeacon(r.beacons, msg.beaconId, added) : nullptr;
+    if (!beacon) return result;
+    applyBeaconMessage(*beacon, msg, rssi, snr, replayMs);
+    uint32_t timestamp = gpsFixUnixTime(r.fix, replayMs);
+    if (timestamp == 0) return result;
+    HistoryRecord row = beaconHistoryRecord(msg, rssi, snr, timestamp);
+    result.digest = traceDigestRecord(result.digest, row);
+    result.rows++;
+    appendHistoryRecord(fs, row);
+    r.historyRows++;
+    StoredSeqs* stored = r.storedSeqs.findOrAdd(id);
+    if (stored) stored->markLive(msg.seq);
+  } else if (decodeBackfillMessage(data, len, bf)) {
+    memcpy(beaconId, bf.beaconId, sizeof(bf.beaconId));
+    result.accepted = 1;
+    uint32_t id;
+    bool known = parseBeaconId(bf.beaconId, id);
+    LatestBeaconData* beacon = known ? r.beacons.find(id) : nullptr;
+    float battery = beacon ? beacon->batteryVoltage : 0.0f;
+    uint8_t count = bf.count < BACKFILL_FIXES_PER_FRAME ? bf.count : BACKFILL_FIXES_PER_FRAME;
+    StoredSeqs* stored = known ? r.storedSeqs.findOrAdd(id) : nullptr;
+    uint8_t duplicates = stored ? dropStoredFixes(bf, *stored) : 0;
+    HistoryRecord rows[BACKFILL_FIXES_PER_FRAME];
+    uint8_t usable = backfillHistoryRecords(bf, battery, rssi, snr, rows);
+    for (uint8_t i = 0; i < usable; i++) {
+      result.digest = traceDigestRecord(result.digest, rows[i]);
+      result.rows++;
+    }
+    r.pendingBackfill.insert(r.pendingBackfill.end(), rows, rows + usable);
+    r.lastBackfillRx = replayMs;
+    if (beacon) {
+      beacon->backfilledFixes += count - duplicates;
+      beacon->rxFrames++;
+    }
+  }
+  return result;
+}
+
+static void compare(Replay& r, const TraceResult& recorded, const TraceResult& replayed, const char* beaconId) {
+  if (recorded.accepted == replayed.accepted && recorded.rows == replayed.rows &&
+      recorded.digest == replayed.digest) {
+    r.matched++;
+    return;
+  }
+  r.divergenceCount++;
+  if (r.divergences.size() < MAX_DIVERGENCES_SHOWN) {
+    Divergence d;
+    d.ms = replayMs;
+    snprintf(d.beaconId, sizeof(d.beaconId), "%s", beaconId);
+    d.recorded = recorded;
+    d.replayed = replayed;
+    r.divergences.push_back(d);
+  }
+}
+
+// A recorded result: replay the frame it answers, dropping older frames that
+// never got one
+static void onResult(Replay& r, HalFileSystem& fs, const TraceResult& recorded) {
+  while (!r.frames.empty() && r.frames.front().ms < recorded.frameMs) {
+    r.frames.pop_front();
+    r.framesUnanswered++;
+  }
+  if (r.frames.empty() || r.frames.front().ms != recorded.frameMs) {
+    r.orphanResults++;
+    return;
+  }
+  char beaconId[9];
+  TraceResult replayed = processFrame(r, fs, r.frames.front(), beaconId);
+  r.frames.pop_front();
+  r.framesReplayed++;
+  if (replayed.accepted) r.framesAccepted++;
+  compare(r, recorded, replayed, beaconId);
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // GPS time goes through mktime(), which is UTC on the station
+  setenv("TZ", "UTC", 1);
+  tzset();
+
+  std::vector<uint8_t> trace;
+  if (!readFile(opt.path, trace)) {
+    fprintf(stderr, "%s: cannot read\n", opt.path);
+    return 1;
+  }
+  TraceFileHeader header;
+  if (trace.size() < sizeof(header)) {
+    fprintf(stderr, "%s: not a capture\n", opt.path);
+    return 1;
+  }
+  memcpy(&header, trace.data(), sizeof(header));
+  if (header.magic != TRACE_MAGIC || header.version != TRACE_VERSION) {
+    fprintf(stderr, "%s: not a version %u capture\n", opt.path, TRACE_VERSION);
+    return 1;
+  }
+
+  if (opt.dir.empty()) {
+    char tmpl[] = "/tmp/pawreplay-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+      perror("mkdtemp");
+      return 1;
+    }
+    opt.dir = tmpl;
+  }
+  DirFileSystem fs(opt.dir);
+  fs.remove(HISTORY_FILE);
+
+  Replay r;
+  auto wallStart = std::chrono::steady_clock::now();
+  size_t pos = sizeof(header);
+  bool truncated = false;
+  while (pos < trace.size()) {
+    TraceRecordHeader h;
+    if (trace.size() - pos < sizeof(h)) {
+      truncated = true;
+      break;
+    }
+    memcpy(&h, trace.data() + pos, sizeof(h));
+    pos += sizeof(h);
+    if (trace.size() - pos < h.len) {
+      truncated = true;
+      break;
+    }
+    const uint8_t* payload = trace.data() + pos;
+    pos += h.len;
+    r.records++;
+
+    if (opt.speed > 0.0) {
+      auto due = wallStart + std::chrono::microseconds((int64_t)(h.ms * 1000.0 / opt.speed));
+      std::this_thread::sleep_until(due);
+    }
+    if (h.ms > replayMs) replayMs = h.ms;
+
+    // storageTask's merge rule, checked as time passes
+    if (!r.pendingBackfill.empty() &&
+        (r.pendingBackfill.size() >= BACKFILL_MERGE_BATCH || replayMs - r.lastBackfillRx >= BACKFILL_MERGE_IDLE_MS)) {
+      mergeBackfill(r, fs);
+    }
+
+    if (h.type == TRACE_NMEA) {
+      for (uint16_t i = 0; i < h.len; i++) r.gps.encode((char)payload[i]);
+      updateGpsFix(r.gps, r.fix, replayMs);
+      r.nmeaBytes += h.len;
+    } else if (h.type == TRACE_FRAME && h.len >= sizeof(TraceFrameInfo)) {
+      CapturedFrame frame;
+      frame.ms = h.ms;
+      memcpy(&frame.info, payload, sizeof(frame.info));
+      frame.data.assign(payload + sizeof(frame.info), payload + h.len);
+      r.frames.push_back(frame);
+    } else if (h.type == TRACE_RESULT && h.len >= sizeof(TraceResult)) {
+      TraceResult recorded;
+      memcpy(&recorded, payload, sizeof(recorded));
+      onResult(r, fs, recorded);
+    }
+  }
+  r.framesUnanswered += r.frames.size();
+  mergeBackfill(r, fs);
+  double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+  printf("capture: %u records over %.1f s%s\n", r.records, replayMs / 1000.0, truncated ? " (truncated)" : "");
+  printf("gps: %llu NMEA bytes, %u sentences, %u failed checksum, %u fixes\n",
+         (unsigned long long)r.nmeaBytes, (unsigned)r.gps.passedChecksum(), (unsigned)r.gps.failedChecksum(),
+         r.fix.fixCount);
+  printf("frames: %u replayed, %u accepted, %u without result, %u results without frame\n",
+         r.framesReplayed, r.framesAccepted, r.framesUnanswered, r.orphanResults);
+  printf("history: %u live rows, %u backfilled rows, %llu bytes written to %s\n", r.historyRows,
+         r.backfilledRows, (unsigned long long)fs.bytesWritten, fs.hostPath(HISTORY_FILE).c_str());
+  printf("throughput: %.3f s wall, %.0f frames/s, %.2f MB/s of trace\n", wallS,
+         wallS > 0 ? r.framesReplayed / wallS : 0.0, wallS > 0 ? trace.size() / wallS / 1e6 : 0.0);
+  printf("divergence: %u of %u frames differ from the station\n", r.divergenceCount, r.framesReplayed);
+  for (const Divergence& d : r.divergences) {
+    printf("  %10.3f s %-8s recorded accepted %u rows %u digest %08x, replayed accepted %u rows %u digest %08x\n",
+           d.ms / 1000.0, d.beaconId, d.recorded.accepted, d.recorded.rows, d.recorded.digest,
+           d.replayed.accepted, d.replayed.rows, d.replayed.digest);
+  }
+  return r.divergenceCount == 0 ? 0 : 3;
+}
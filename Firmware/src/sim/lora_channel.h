@@ -0,0 +1,182 @@
+// Shared LoRa channel for the simulator (env:sim)
+//
+// Every frame is on air for its real time-on-air (airtime.h). What a node
+// hears of it follows a log-distance path loss with log-normal shadowing
+// drawn per (frame, receiver) from the seed, so results do not depend on the
+// order in which receivers are evaluated. A frame is decoded if its SNR is
+// above the SF7 demodulation floor and it beats the summed power of every
+// frame overlapping it by the capture margin; otherwise it is lost to noise or
+// to a collision.
+
+#ifndef LORA_CHANNEL_H
+#define LORA_CHANNEL_H
+
+#include <stdint.h>
+#include <math.h>
+#include <deque>
+#include <vector>
+#include "airtime.h"
+
+struct SimPoint {
+  double x;  // Meters east
+  double y;  // Meters north
+};
+
+inline double simDistance(const SimPoint& a, const SimPoint& b) {
+  return sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+// Deterministic pseudo-random numbers (splitmix64)
+inline uint64_t simMix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+class SimRandom {
+public:
+  explicit SimRandom(uint64_t seed = 1) : state(seed) {}
+
+  uint64_t next() { return simMix(state++); }
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }  // [0, 1)
+  // [low, high), as Arduino's random(low, high)
+  uint32_t range(uint32_t low, uint32_t high) {
+    return high <= low ? low : low + (uint32_t)(next() % (high - low));
+  }
+
+private:
+  uint64_t state;
+};
+
+// Standard normal from a hash, for draws that must not depend on call order
+inline double simGaussian(uint64_t key) {
+  uint64_t a = simMix(key);
+  uint64_t b = simMix(a);
+  double u1 = ((a >> 11) + 1.0) * (1.0 / 9007199254740993.0);
+  double u2 = (b >> 11) * (1.0 / 9007199254740992.0);
+  return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+struct ChannelParams {
+  float txPowerDbm = 22.0f;         // initLoRa() sets 22 dBm
+  float pathLossAt1mDb = 40.0f;     // Antennas near the ground
+  float pathLossExponent = 3.3f;    // Ground level, some vegetation
+  float shadowingDb = 4.0f;         // Sigma of the per-frame log-normal fading
+  float noiseFloorDbm = -117.0f;    // -174 dBm/Hz + 10log10(125 kHz) + 6 dB noise figure
+  float demodSnrDb = -7.5f;         // SF7 demodulation floor
+  float captureDb = 6.0f;           // Co-SF capture: wanted frame this far above the rest
+};
+
+struct AirFrame {
+  uint32_t id;
+  int sender;                // Node index
+  SimPoint from;             // Sender position at the start of the frame
+  bool blocked;              // Sender in an outage: nothing reaches anyone
+  uint64_t startUs;
+  uint64_t endUs;
+  std::vector<uint8_t> data;
+};
+
+enum RxOutcome : uint8_t {
+  RX_OK,
+  RX_WEAK,       // Below the demodulation floor
+  RX_COLLISION   // Decodable alone, lost to overlapping frames
+};
+
+class LoRaChannel {
+public:
+  ChannelParams params;
+  uint32_t framesSent = 0;
+  uint64_t airUs = 0;        // Total time-on-air of all frames
+
+  explicit LoRaChannel(uint64_t seed) : seed(seed) {}
+
+  const AirFrame& transmit(int sender, const SimPoint& from, bool blocked, uint64_t nowUs,
+                           const uint8_t* data, size_t len) {
+    AirFrame frame;
+    frame.id = nextId++;
+    frame.sender = sender;
+    frame.from = from;
+    frame.blocked = blocked;
+    frame.startUs = nowUs;
+    frame.endUs = nowUs + loraTimeOnAirUs(LORA_MODULATION, len);
+    frame.data.assign(data, data + len);
+    framesSent++;
+    airUs += frame.endUs - frame.startUs;
+    frames.push_back(frame);
+    return frames.back();
+  }
+
+  // Received power of a frame at a node, -inf if it cannot reach it
+  double powerDbm(const AirFrame& frame, int receiver, const SimPoint& at) const {
+    if (frame.blocked) return -INFINITY;
+    double d = simDistance(frame.from, at);
+    if (d < 1.0) d = 1.0;
+    double fading = params.shadowingDb * simGaussian(seed ^ ((uint64_t)frame.id << 20) ^ (uint64_t)receiver);
+    return params.txPowerDbm - params.pathLossAt1mDb - 10.0 * params.pathLossExponent * log10(d) + fading;
+  }
+
+  bool audible(const AirFrame& frame, int receiver, const SimPoint& at) const {
+    return powerDbm(frame, receiver, at) - params.noiseFloorDbm >= params.demodSnrDb;
+  }
+
+  // CAD: a frame from someone else is on air and strong enough to detect
+  bool busy(int node, const SimPoint& at, uint64_t nowUs) const {
+    for (const AirFrame& f : frames) {
+      if (f.sender != node && f.startUs <= nowUs && nowUs < f.endUs && audible(f, node, at)) return true;
+    }
+    return false;
+  }
+
+  // Whether a receiver listening through the whole frame decodes it
+  RxOutcome receive(const AirFrame& frame, int receiver, const SimPoint& at, float& rssi, float& snr) const {
+    double signal = powerDbm(frame, receiver, at);
+    rssi = (float)signal;
+    snr = (float)(signal - params.noiseFloorDbm);
+    if (snr < params.demodSnrDb) return RX_WEAK;
+
+    double interferenceMw = 0.0;
+    for (const AirFrame& f : frames) {
+      if (f.id == frame.id || f.sender == receiver) continue;
+      if (f.endUs <= frame.startUs || f.startUs >= frame.endUs) continue;
+      double p = powerDbm(f, receiver, at);
+      if (p > -INFINITY) interferenceMw += pow(10.0, p / 10.0);
+    }
+    if (interferenceMw > 0.0 && signal - 10.0 * log10(interferenceMw) < params.captureDb) {
+      return RX_COLLISION;
+    }
+    return RX_OK;
+  }
+
+  const AirFrame* find(uint32_t id) const {
+    for (const AirFrame& f : frames) {
+      if (f.id == id) return &f;
+    }
+    return nullptr;
+  }
+
+  // First frame on air at nowUs that started at or after sinceUs and the node
+  // can hear; nullptr if none
+  const AirFrame* receiving(int node, const SimPoint& at, uint64_t sinceUs, uint64_t nowUs) const {
+    for (const AirFrame& f : frames) {
+      if (f.sender != node && f.startUs >= sinceUs && f.startUs <= nowUs && nowUs < f.endUs &&
+          audible(f, node, at)) {
+        return &f;
+      }
+    }
+    return nullptr;
+  }
+
+  // Forget frames that can no longer overlap anything still to be evaluated
+  void prune(uint64_t nowUs, uint64_t horizonUs) {
+    while (!frames.empty() && frames.front().endUs + horizonUs < nowUs) frames.pop_front();
+  }
+
+private:
+  uint64_t seed;
+  uint32_t nextId = 1;
+  std::deque<AirFrame> frames;  // In start order
+};
+
+#endif // LORA_CHANNEL_H
@@ -0,0 +1,775 @@
+// Discrete-event LoRa simulator (pio run -e sim)
+//
+// Runs the beacon cycle of loopPupBeacon() (frame flags, CAD/backoff, reply
+// window, backfill after the live frame) and the station's radioTask/loop()
+// path (ack in the reply slot, beacon table, history.csv, backfill merge) for
+// every node of a scenario (scenario.h) over one shared channel
+// (lora_channel.h). Protocol logic is the firmware's own: beacon_core.h,
+// station_core.h, history_store.h, backfill.h and the region's LBT and duty
+// cycle rules.
+//
+//   .pio/build/sim/program [scenario.txt] [--seed N] [--seconds S] [--json] [--dir PATH]
+//
+// Reports per beacon the share of fixes that reached the station's web state
+// live and in the end (with backfill), and the latency from fix to web state;
+// per station frames lost by cause, replies, CPU time spent in the station
+// code (host time, the only output that is not deterministic) and bytes
+// written to its history file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hal_native.h"
+#include "region.h"
+#include "airtime.h"
+#include "beacon_core.h"
+#include "station_core.h"
+#include "history_store.h"
+#include "lora_channel.h"
+#include "scenario.h"
+
+const uint32_t BASE_UNIX_TIME = 1760000000;       // GPS time at t = 0
+const uint32_t BOOT_SPREAD_MS = 3000;             // Beacons power up within this window
+const uint32_t CAD_US = 2048;                     // Two SF7 symbols at 125 kHz
+const uint32_t STATION_LOOP_MS = 10;              // loopPupStation() delay
+const uint32_t RX_QUEUE_DEPTH = 16;               // As on the station
+const uint64_t FRAME_HORIZON_US = 1000000;        // Longer than any frame
+
+enum EventType : uint8_t {
+  EV_BEACON_WAKE,    // Next beacon cycle is due
+  EV_CAD_DONE,       // Beacon channel scan finished (after backoff, if any)
+  EV_TX_DONE,        // Frame off the air: evaluate every receiver
+  EV_RX_TIMEOUT,     // Beacon reply window closes
+  EV_REPLY_SLOT,     // Station sends a reply
+  EV_STATION_LOOP    // Station loop() processes queued frames
+};
+
+struct Event {
+  uint64_t atUs;
+  uint64_t order;    // FIFO among events at the same time
+  EventType type;
+  int node;
+  uint32_t token;    // Beacon: state generation; EV_TX_DONE: frame ID; EV_REPLY_SLOT: reply index
+};
+
+struct EventLater {
+  bool operator()(const Event& a, const Event& b) const {
+    return a.atUs != b.atUs ? a.atUs > b.atUs : a.order > b.order;
+  }
+};
+
+// Sub-band the radio transmits in and its airtime budget (main.cpp: TX_SUB_BAND)
+const int8_t TX_SUB_BAND = findSubBand(LORA_REGION, LORA_REGION.frequency);
+
+uint32_t airtimeBudgetUs() {
+  return TX_SUB_BAND < 0 ? UINT32_MAX
+                         : dutyCycleBudgetUs(LORA_REGION.subBands[TX_SUB_BAND].dutyCyclePermille, AIRTIME_BUDGET_PERCENT);
+}
+
+uint32_t minTxIntervalMs(size_t len) {
+  if (TX_SUB_BAND < 0) return 0;
+  uint32_t permille = LORA_REGION.subBands[TX_SUB_BAND].dutyCyclePermille;
+  return (uint64_t)loraTimeOnAirUs(LORA_MODULATION, len) * 100 / (permille * AIRTIME_BUDGET_PERCENT);
+}
+
+struct SimNode {
+  int index;
+  const NodeSpec* spec;
+
+  SimPoint position(uint64_t us) const { return spec->position(us / 1e6); }
+  bool offAir(uint64_t us) const { return spec->offAir(us / 1e6); }
+};
+
+enum SimBeaconState : uint8_t {
+  SIM_BEACON_IDLE,
+  SIM_BEACON_CAD,    // Scanning or backing off
+  SIM_BEACON_TX,
+  SIM_BEACON_RX
+};
+
+// One fix the beacon composed, as the station's web state sees it
+struct FixDelivery {
+  uint64_t composedUs;
+  bool live;         // Reached the beacon table in its own frame
+  bool backfilled;   // Reached history through backfill only
+};
+
+struct SimBeacon : SimNode {
+  char beaconId[9];
+  FixBacklog backlog;
+  AirtimeLedger ledger;
+  SimRandom rng;
+  SimBeaconState state = SIM_BEACON_IDLE;
+  uint32_t token = 0;
+  bool stationIdle = false;
+  uint32_t lastSendMs = 0;
+  uint32_t randomOffset = 0;
+  uint32_t lastRxMs = 0;
+  uint32_t lastBackfillMs = 0;
+
+  uint8_t tx[sizeof(BackfillMessage)];
+  size_t txLen = 0;
+  bool txListen = false;
+  bool txBackfill = false;
+  uint8_t cadAttempt = 0;
+  uint32_t txAirUs = 0;
+  uint64_t rxWindowStartUs = 0;
+  uint64_t rxWindowUs = 0;
+
+  std::vector<FixDelivery> fixes;
+  std::vector<int32_t> seqFix;       // seq -> index in fixes, -1 if none
+  std::vector<uint32_t> latencyMs;   // Fix to web state, live frames
+  uint32_t liveFrames = 0;
+  uint32_t backfillFrames = 0;
+  uint32_t busyDropped = 0;
+  uint32_t deferred = 0;
+  uint32_t repliesHeard = 0;
+};
+
+struct QueuedFrame {
+  std::vector<uint8_t> data;
+  float rssi;
+  float snr;
+};
+
+struct SimStation : SimNode {
+  BeaconTable beacons;
+  BeaconRegistry<SeqWindow, MAX_BEACONS> rxSeqWindows;
+  BeaconRegistry<StoredSeqs, MAX_BEACONS> storedSeqs;
+  std::deque<QueuedFrame> rxQueue;
+  uint64_t loopAtUs = 0;             // Next loop() run scheduled, 0 if none
+  std::vector<HistoryRecord> pendingBackfill;
+  uint64_t lastBackfillRxUs = 0;
+  DirFileSystem* fs = nullptr;
+  AirtimeLedger ledger;
+  std::deque<std::pair<uint64_t, uint64_t>> txIntervals;  // Own recent transmissions
+  uint64_t replyFreeUs = 0;          // radioTask busy with a reply until then
+  std::vector<ControlMessage> replies;
+
+  uint32_t framesHeard = 0;
+  uint32_t framesWeak = 0;
+  uint32_t framesCollided = 0;
+  uint32_t framesWhileTx = 0;        // Arrived while the station was transmitting
+  uint32_t framesOffAir = 0;
+  uint32_t queueOverruns = 0;
+  uint32_t repliesSent = 0;
+  uint32_t repliesBusy = 0;          // Channel busy at the slot
+  uint32_t repliesLate = 0;          // Previous reply still on air past the slot
+  uint32_t historyRows = 0;
+  uint32_t backfillRows = 0;
+  uint64_t cpuNs = 0;
+};
+
+class Simulator {
+public:
+  Simulator(Scenario& scenario, const std::string& dir)
+    : scenario(scenario), channel(scenario.seed) {
+    channel.params.pathLossExponent = scenario.pathLossExponent;
+    channel.params.shadowingDb = scenario.shadowingDb;
+    SimRandom boot(scenario.seed ^ 0x424F4F54ull);
+
+    for (size_t i = 0; i < scenario.nodes.size(); i++) {
+      const NodeSpec& spec = scenario.nodes[i];
+      if (spec.station) {
+        SimStation* s = new SimStation();
+        s->index = (int)i;
+        s->spec = &spec;
+        s->ledger = AirtimeLedger();
+        std::string root = dir + "/" + spec.name;
+        mkdir(root.c_str(), 0755);
+        s->fs = new DirFileSystem(root);
+        s->fs->remove(HISTORY_FILE);
+        stations.push_back(s);
+        nodes.push_back(s);
+      } else {
+        SimBeacon* b = new SimBeacon();
+        b->index = (int)i;
+        b->spec = &spec;
+        memset(&b->backlog, 0, sizeof(b->backlog));
+        b->backlog.begin();
+        b->ledger = AirtimeLedger();
+        b->rng = SimRandom(scenario.seed ^ simMix(0x42454143ull + i));
+        uint32_t id = 0xB0000000u + (uint32_t)beaconList.size();
+        formatBeaconId(id, b->beaconId);
+        b->seqFix.assign(65536, -1);
+        beaconById[id] = b;
+        beaconList.push_back(b);
+        nodes.push_back(b);
+        schedule((uint64_t)boot.range(0, BOOT_SPREAD_MS) * 1000, EV_BEACON_WAKE, (int)i, b->token);
+      }
+    }
+  }
+
+  ~Simulator() {
+    for (SimStation* s : stations) delete s->fs;
+    for (SimNode* n : nodes) {
+      if (n->spec->station) delete static_cast<SimStation*>(n); else delete static_cast<SimBeacon*>(n);
+    }
+  }
+
+  void run() {
+    uint64_t endUs = (uint64_t)scenario.durationS * 1000000;
+    while (!events.empty() && events.top().atUs < endUs) {
+      Event ev = events.top();
+      events.pop();
+      nowUs = ev.atUs;
+      dispatch(ev);
+      channel.prune(nowUs, FRAME_HORIZON_US);
+    }
+    nowUs = endUs;
+    for (SimStation* s : stations) {
+      timed(*s, [&] { mergeBackfill(*s); });
+    }
+  }
+
+  void printText() const;
+  void printJson() const;
+
+private:
+  Scenario& scenario;
+  LoRaChannel channel;
+  std::vector<SimNode*> nodes;       // Scenario order
+  std::vector<SimBeacon*> beaconList;
+  std::vector<SimStation*> stations;
+  std::unordered_map<uint32_t, SimBeacon*> beaconById;
+  std::priority_queue<Event, std::vector<Event>, EventLater> events;
+  uint64_t nextOrder = 0;
+  uint64_t nowUs = 0;
+
+  uint32_t nowMs() const { return (uint32_t)(nowUs / 1000); }
+
+  void schedule(uint64_t atUs, EventType type, int node, uint32_t token) {
+    events.push(Event{atUs, nextOrder++, type, node, token});
+  }
+
+  template <typename F>
+  void timed(SimStation& s, F work) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    work();
+    s.cpuNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void dispatch(const Event& ev) {
+    SimNode* node = nodes[ev.node];
+    if (ev.type == EV_TX_DONE) {
+      txDone(ev.node, ev.token);
+      return;
+    }
+    if (node->spec->station) {
+      SimStation& s = *static_cast<SimStation*>(node);
+      if (ev.type == EV_REPLY_SLOT) sendReply(s, ev.token);
+      if (ev.type == EV_STATION_LOOP) timed(s, [&] { stationLoop(s); });
+      return;
+    }
+    SimBeacon& b = *static_cast<SimBeacon*>(node);
+    if (ev.token != b.token) return;  // Superseded
+    switch (ev.type) {
+      case EV_BEACON_WAKE: startBeaconCycle(b); break;
+      case EV_CAD_DONE: cadDone(b); break;
+      case EV_RX_TIMEOUT: rxTimeout(b); break;
+      default: break;
+    }
+  }
+
+  // --- Beacon: stepBeaconCycle() as events ---
+
+  void startBeaconCycle(SimBeacon& b) {
+    b.lastSendMs = nowMs();
+    b.randomOffset = b.rng.range(0, BEACON_SEND_JITTER_MS);
+    beginBeaconFrame(b);
+    if (!startBeaconTx(b)) finishBeaconFrame(b);
+  }
+
+  void beginBeaconFrame(SimBeacon& b) {
+    SimPoint p = b.position(nowUs);
+    double latitude, longitude;
+    toLatLon(p, latitude, longitude);
+
+    BeaconMessage msg{};
+    msg.msgType = MSG_BEACON;
+    memcpy(msg.beaconId, b.beaconId, sizeof(msg.beaconId));
+    msg.latitude = (float)latitude;
+    msg.longitude = (float)longitude;
+    msg.hdop = 0.9f;
+    msg.sats = 10;
+    msg.batteryVoltage = 3.9f;
+    msg.speed = (float)(b.spec->walkSpeed * 3.6);
+    msg.uptime = nowMs() / 1000;
+    msg.seq = b.backlog.takeSeq();
+    msg.flags = beaconFrameFlags(b.backlog, msg.seq, b.stationIdle);
+    msg.batteryLifeH = BATTERY_LIFE_UNKNOWN;
+    b.backlog.add(makeBacklogFix(BASE_UNIX_TIME + nowMs() / 1000, latitude, longitude,
+                                 msg.altitude, msg.speed, msg.seq));
+    b.seqFix[msg.seq] = (int32_t)b.fixes.size();
+    b.fixes.push_back(FixDelivery{nowUs, false, false});
+
+    memcpy(b.tx, &msg, sizeof(msg));
+    b.txLen = sizeof(msg);
+    b.txListen = (msg.flags & BEACON_FLAG_LISTENING) != 0;
+    b.txBackfill = false;
+  }
+
+  bool beginBackfillFrame(SimBeacon& b) {
+    if (!backfillDue(b.backlog, nowMs(), b.lastRxMs, b.lastBackfillMs)) return false;
+    b.lastBackfillMs = nowMs();
+    BackfillMessage bf;
+    b.txLen = buildBackfillFrame(b.backlog, b.beaconId, bf);
+    memcpy(b.tx, &bf, b.txLen);
+    b.txListen = true;
+    b.txBackfill = true;
+    return true;
+  }
+
+  bool startBeaconTx(SimBeacon& b) {
+    b.txAirUs = loraTimeOnAirUs(LORA_MODULATION, b.txLen);
+    b.cadAttempt = 0;
+    if (!b.ledger.allows(nowMs(), b.txAirUs, airtimeBudgetUs())) {
+      b.deferred++;
+      return false;
+    }
+    b.state = SIM_BEACON_CAD;
+    schedule(nowUs + CAD_US, EV_CAD_DONE, b.index, ++b.token);
+    return true;
+  }
+
+  void cadDone(SimBeacon& b) {
+    if (b.offAir(nowUs) || !channel.busy(b.index, b.position(nowUs), nowUs)) {
+      beaconTransmit(b);
+      return;
+    }
+    uint8_t attempt = b.cadAttempt++;
+    if (b.cadAttempt < LORA_REGION.cadMaxAttempts) {
+      uint32_t window = std::min((uint32_t)LORA_REGION.backoffBaseMs << attempt, (uint32_t)LORA_REGION.backoffMaxMs);
+      uint32_t backoffMs = b.rng.range(1, window + 1);
+      schedule(nowUs + (uint64_t)backoffMs * 1000 + CAD_US, EV_CAD_DONE, b.index, ++b.token);
+      return;
+    }
+    if (LORA_REGION.dropWhenBusy) {
+      b.busyDropped++;
+      finishBeaconFrame(b);
+      return;
+    }
+    beaconTransmit(b);
+  }
+
+  void beaconTransmit(SimBeacon& b) {
+    const AirFrame& f = channel.transmit(b.index, b.position(nowUs), b.offAir(nowUs), nowUs, b.tx, b.txLen);
+    b.state = SIM_BEACON_TX;
+    if (b.txBackfill) b.backfillFrames++; else b.liveFrames++;
+    schedule(f.endUs, EV_TX_DONE, b.index, f.id);
+  }
+
+  void beaconTxDone(SimBeacon& b) {
+    b.ledger.record(nowMs(), b.txAirUs);
+    if (!b.txListen) {
+      finishBeaconFrame(b);
+      return;
+    }
+    uint32_t replyAirUs = loraTimeOnAirUs(LORA_MODULATION, sizeof(ControlMessage));
+    b.rxWindowStartUs = nowUs;
+    b.rxWindowUs = REPLY_OFFSET_US + replyAirUs + REPLY_TOLERANCE_US;
+    b.state = SIM_BEACON_RX;
+    schedule(nowUs + b.rxWindowUs, EV_RX_TIMEOUT, b.index, ++b.token);
+  }
+
+  // A preamble caught in the window keeps the radio receiving past the timeout
+  void rxTimeout(SimBeacon& b) {
+    const AirFrame* f = b.offAir(nowUs) ? nullptr
+                                        : channel.receiving(b.index, b.position(nowUs), b.rxWindowStartUs, nowUs);
+    if (f) return;  // Its EV_TX_DONE ends the window
+    finishBeaconFrame(b);
+  }
+
+  void beaconRx(SimBeacon& b, const AirFrame& f) {
+    if (b.state != SIM_BEACON_RX || b.offAir(nowUs)) return;
+    if (f.startUs < b.rxWindowStartUs || f.startUs > b.rxWindowStartUs + b.rxWindowUs) return;
+    SimPoint at = b.position(nowUs);
+    if (!channel.audible(f, b.index, at)) return;  // Never detected, the window goes on
+    float rssi, snr;
+    if (channel.receive(f, b.index, at, rssi, snr) == RX_OK && f.data.size() >= sizeof(ControlMessage)) {
+      ControlMessage ctrl;
+      memcpy(&ctrl, f.data.data(), sizeof(ctrl));
+      if (applyStationReply(b.backlog, ctrl, b.beaconId, b.stationIdle)) {
+        b.lastRxMs = nowMs();
+        b.repliesHeard++;
+      }
+    }
+    finishBeaconFrame(b);  // RxDone, with or without a usable frame
+  }
+
+  void finishBeaconFrame(SimBeacon& b) {
+    b.state = SIM_BEACON_IDLE;
+    if (!b.txBackfill && beginBackfillFrame(b) && startBeaconTx(b)) return;
+    uint32_t interval = std::max(BEACON_SEND_INTERVAL_MS, minTxIntervalMs(sizeof(BeaconMessage)));
+    uint64_t dueUs = (uint64_t)(b.lastSendMs + interval + b.randomOffset) * 1000;
+    schedule(std::max(dueUs, nowUs), EV_BEACON_WAKE, b.index, ++b.token);
+  }
+
+  // --- Channel ---
+
+  void txDone(int sender, uint32_t frameId) {
+    const AirFrame* f = channel.find(frameId);
+    if (!f) return;
+    for (SimNode* n : nodes) {
+      if (n->index == sender) continue;
+      if (n->spec->station) {
+        stationRx(*static_cast<SimStation*>(n), *f);
+      } else {
+        beaconRx(*static_cast<SimBeacon*>(n), *f);
+      }
+    }
+    SimNode* node = nodes[sender];
+    if (!node->spec->station) beaconTxDone(*static_cast<SimBeacon*>(node));
+  }
+
+  // --- Station: radioTask, replyToFrame() and loop() ---
+
+  bool transmittedDuring(SimStation& s, uint64_t startUs, uint64_t endUs) {
+    while (!s.txIntervals.empty() && s.txIntervals.front().second + FRAME_HORIZON_US < nowUs) {
+      s.txIntervals.pop_front();
+    }
+    for (const std::pair<uint64_t, uint64_t>& tx : s.txIntervals) {
+      if (tx.first < endUs && tx.second > startUs) return true;
+    }
+    return false;
+  }
+
+  void stationRx(SimStation& s, const AirFrame& f) {
+    if (s.offAir(nowUs)) {
+      s.framesOffAir++;
+      return;
+    }
+    if (transmittedDuring(s, f.startUs, f.endUs)) {
+      s.framesWhileTx++;
+      return;
+    }
+    float rssi, snr;
+    RxOutcome outcome = channel.receive(f, s.index, s.position(nowUs), rssi, snr);
+    if (outcome == RX_WEAK) {
+      s.framesWeak++;
+      return;
+    }
+    if (outcome == RX_COLLISION) {
+      s.framesCollided++;
+      return;
+    }
+    s.framesHeard++;
+    timed(s, [&] {
+      if (s.rxQueue.size() >= RX_QUEUE_DEPTH) {
+        s.queueOverruns++;
+        return;
+      }
+      s.rxQueue.push_back(QueuedFrame{f.data, rssi, snr});
+      replyToFrame(s, f.data.data(), f.data.size());
+    });
+    uint64_t loopUs = STATION_LOOP_MS * 1000;
+    scheduleStationLoop(s, (nowUs / loopUs + 1) * loopUs);
+  }
+
+  void replyToFrame(SimStation& s, const uint8_t* data, size_t len) {
+    BeaconMessage msg;
+    ControlMessage reply;
+    uint32_t id;
+    if (decodeBeaconMessage(data, len, msg)) {
+      if (!beaconDataInRange(msg) || !parseBeaconId(msg.beaconId, id)) return;
+      SeqWindow* window = s.rxSeqWindows.findOrAdd(id);
+      if (window) window->record(msg.seq);
+      const uint8_t wanted = BEACON_FLAG_LISTENING | BEACON_FLAG_ACK_REQUEST;
+      if ((msg.flags & wanted) != wanted) return;
+      reply = makeStationReply(msg.beaconId, MSG_ACK, window);
+      reply.flags |= CONTROL_FLAG_IDLE;
+    } else if (len >= offsetof(BackfillMessage, fixes) && data[0] == MSG_BACKFILL) {
+      char beaconId[sizeof(BackfillMessage::beaconId)];
+      memcpy(beaconId, data + offsetof(BackfillMessage, beaconId), sizeof(beaconId));
+      beaconId[sizeof(beaconId) - 1] = '\0';
+      const SeqWindow* window = parseBeaconId(beaconId, id) ? s.rxSeqWindows.find(id) : nullptr;
+      reply = makeStationReply(beaconId, MSG_ACK, window);
+      reply.flags |= CONTROL_FLAG_BACKFILL_ACK | CONTROL_FLAG_IDLE;
+    } else {
+      return;
+    }
+
+    // radioTask holds each reply until its slot; one still going out delays the next
+    uint64_t slotUs = nowUs + REPLY_OFFSET_US;
+    uint64_t atUs = std::max(slotUs, s.replyFreeUs);
+    if (atUs > slotUs + REPLY_TOLERANCE_US) {
+      s.repliesLate++;
+      return;
+    }
+    s.replyFreeUs = atUs + loraTimeOnAirUs(LORA_MODULATION, sizeof(ControlMessage));
+    s.replies.push_back(reply);
+    schedule(atUs, EV_REPLY_SLOT, s.index, (uint32_t)(s.replies.size() - 1));
+  }
+
+  // Bound to the slot: one CAD, no backoff
+  void sendReply(SimStation& s, uint32_t replyIndex) {
+    ControlMessage reply = s.replies[replyIndex];
+    if (replyIndex + 1 == s.replies.size()) s.replies.clear();  // Slots come in order
+    uint32_t airUs = loraTimeOnAirUs(LORA_MODULATION, sizeof(reply));
+    if (!s.ledger.allows(nowMs(), airUs, airtimeBudgetUs())) {
+      s.repliesBusy++;
+      return;
+    }
+    if (!s.offAir(nowUs) && channel.busy(s.index, s.position(nowUs), nowUs)) {
+      s.repliesBusy++;
+      return;
+    }
+    const AirFrame& f = channel.transmit(s.index, s.position(nowUs), s.offAir(nowUs), nowUs,
+                                         (const uint8_t*)&reply, sizeof(reply));
+    s.ledger.record(nowMs(), airUs);
+    s.txIntervals.push_back(std::make_pair(f.startUs, f.endUs));
+    s.repliesSent++;
+    schedule(f.endUs, EV_TX_DONE, s.index, f.id);
+  }
+
+  // Earlier runs replace later ones; a superseded run just finds nothing to do
+  void scheduleStationLoop(SimStation& s, uint64_t atUs) {
+    if (s.loopAtUs != 0 && s.loopAtUs <= atUs) return;
+    s.loopAtUs = atUs;
+    schedule(atUs, EV_STATION_LOOP, s.index, 0);
+  }
+
+  void stationLoop(SimStation& s) {
+    if (s.loopAtUs == nowUs) s.loopAtUs = 0;
+    while (!s.rxQueue.empty()) {
+      QueuedFrame frame = s.rxQueue.front();
+      s.rxQueue.pop_front();
+      processFrame(s, frame);
+    }
+    if (!s.pendingBackfill.empty() &&
+        (s.pendingBackfill.size() >= BACKFILL_MERGE_BATCH ||
+         nowUs - s.lastBackfillRxUs >= (uint64_t)BACKFILL_MERGE_IDLE_MS * 1000)) {
+      mergeBackfill(s);
+    }
+    if (!s.pendingBackfill.empty()) {
+      scheduleStationLoop(s, s.lastBackfillRxUs + (uint64_t)BACKFILL_MERGE_IDLE_MS * 1000);
+    }
+  }
+
+  void processFrame(SimStation& s, const QueuedFrame& frame) {
+    BeaconMessage msg;
+    BackfillMessage bf;
+    bool added;
+    if (decodeBeaconMessage(frame.data.data(), frame.data.size(), msg)) {
+      if (!beaconDataInRange(msg)) return;
+      LatestBeaconData* beacon = findOrAddBeacon(s.beacons, msg.beaconId, added);
+      if (!beacon) return;
+      applyBeaconMessage(*beacon, msg, frame.rssi, frame.snr, nowMs());
+      appendHistoryRecord(*s.fs, beaconHistoryRecord(msg, frame.rssi, frame.snr, BASE_UNIX_TIME + nowMs() / 1000));
+      s.historyRows++;
+      uint32_t id;
+      StoredSeqs* stored = parseBeaconId(msg.beaconId, id) ? s.storedSeqs.findOrAdd(id) : nullptr;
+      if (stored) stored->markLive(msg.seq);
+      deliveredLive(msg.beaconId, msg.seq);
+    } else if (decodeBackfillMessage(frame.data.data(), frame.data.size(), bf)) {
+      LatestBeaconData* beacon = findOrAddBeacon(s.beacons, bf.beaconId, added);
+      uint32_t id;
+      StoredSeqs* stored = parseBeaconId(bf.beaconId, id) ? s.storedSeqs.findOrAdd(id) : nullptr;
+      if (stored) dropStoredFixes(bf, *stored);
+      HistoryRecord rows[BACKFILL_FIXES_PER_FRAME];
+      uint8_t n = backfillHistoryRecords(bf, beacon ? beacon->batteryVoltage : 0.0f, frame.rssi, frame.snr, rows);
+      s.pendingBackfill.insert(s.pendingBackfill.end(), rows, rows + n);
+      s.lastBackfillRxUs = nowUs;
+      if (beacon) {
+        beacon->backfilledFixes += bf.count;
+        beacon->rxFrames++;
+      }
+      for (uint8_t i = 0; i < bf.count; i++) deliveredBackfill(bf.beaconId, bf.fixes[i].seq);
+    }
+  }
+
+  void mergeBackfill(SimStation& s) {
+    size_t merged;
+    mergeHistoryRecords(*s.fs, s.pendingBackfill, merged);
+    s.backfillRows += merged;
+  }
+
+  FixDelivery* findFix(const char* beaconId, uint16_t seq) {
+    uint32_t id;
+    if (!parseBeaconId(beaconId, id)) return nullptr;
+    std::unordered_map<uint32_t, SimBeacon*>::iterator it = beaconById.find(id);
+    if (it == beaconById.end() || it->second->seqFix[seq] < 0) return nullptr;
+    return &it->second->fixes[it->second->seqFix[seq]];
+  }
+
+  void deliveredLive(const char* beaconId, uint16_t seq) {
+    FixDelivery* fix = findFix(beaconId, seq);
+    if (!fix || fix->live) return;  // Another station was first
+    fix->live = true;
+    uint32_t id;
+    parseBeaconId(beaconId, id);
+    beaconById[id]->latencyMs.push_back((uint32_t)((nowUs - fix->composedUs) / 1000));
+  }
+
+  void deliveredBackfill(const char* beaconId, uint16_t seq) {
+    FixDelivery* fix = findFix(beaconId, seq);
+    if (fix && !fix->live) fix->backfilled = true;
+  }
+
+  static void toLatLon(const SimPoint& p, double& latitude, double& longitude) {
+    const double ORIGIN_LAT = 41.3874;
+    const double ORIGIN_LON = 2.1686;
+    latitude = ORIGIN_LAT + p.y / 111320.0;
+    longitude = ORIGIN_LON + p.x / (111320.0 * cos(ORIGIN_LAT * 3.141592653589793 / 180.0));
+  }
+
+  // --- Report ---
+
+  struct BeaconSummary {
+    uint32_t fixes;
+    uint32_t live;
+    uint32_t recovered;
+    uint32_t p50Ms;
+    uint32_t p95Ms;
+    double meanMs;
+  };
+
+  static BeaconSummary summarize(const SimBeacon& b) {
+    BeaconSummary sum{};
+    sum.fixes = (uint32_t)b.fixes.size();
+    for (const FixDelivery& f : b.fixes) {
+      if (f.live) sum.live++;
+      if (f.live || f.backfilled) sum.recovered++;
+    }
+    std::vector<uint32_t> sorted = b.latencyMs;
+    std::sort(sorted.begin(), sorted.end());
+    if (!sorted.empty()) {
+      sum.p50Ms = sorted[sorted.size() / 2];
+      sum.p95Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+      double total = 0;
+      for (uint32_t v : sorted) total += v;
+      sum.meanMs = total / sorted.size();
+    }
+    return sum;
+  }
+
+  static double ratio(uint32_t n, uint32_t d) {
+    return d ? (double)n / d : 0.0;
+  }
+};
+
+void Simulator::printText() const {
+  printf("%s, seed %llu, %u s, %zu beacon(s), %zu station(s), channel %.1f%% busy\n",
+         LORA_REGION.name, (unsigned long long)scenario.seed, scenario.durationS,
+         beaconList.size(), stations.size(),
+         100.0 * channel.airUs / ((double)scenario.durationS * 1e6));
+  printf("\n%-10s %-9s %6s %6s %6s %9s %7s %7s %7s %5s\n", "beacon", "id", "fixes", "live%", "final%",
+         "meanMs", "p50Ms", "p95Ms", "bfill", "busy");
+  uint32_t fixes = 0, live = 0, recovered = 0;
+  for (const SimBeacon* b : beaconList) {
+    BeaconSummary sum = summarize(*b);
+    fixes += sum.fixes;
+    live += sum.live;
+    recovered += sum.recovered;
+    printf("%-10s %-9s %6u %6.1f %6.1f %9.1f %7u %7u %7u %5u\n", b->spec->name.c_str(), b->beaconId,
+           sum.fixes, 100.0 * ratio(sum.live, sum.fixes), 100.0 * ratio(sum.recovered, sum.fixes),
+           sum.meanMs, sum.p50Ms, sum.p95Ms, b->backfillFrames, b->busyDropped + b->deferred);
+  }
+  printf("%-10s %-9s %6u %6.1f %6.1f\n", "all", "", fixes, 100.0 * ratio(live, fixes), 100.0 * ratio(recovered, fixes));
+
+  for (const SimStation* s : stations) {
+    printf("\nstation %s: %u frames heard, lost %u collision / %u weak / %u own TX / %u off air / %u queue full\n",
+           s->spec->name.c_str(), s->framesHeard, s->framesCollided, s->framesWeak, s->framesWhileTx,
+           s->framesOffAir, s->queueOverruns);
+    printf("  replies %u sent, %u channel busy, %u late; history %u live + %u backfilled rows\n",
+           s->repliesSent, s->repliesBusy, s->repliesLate, s->historyRows, s->backfillRows);
+    printf("  CPU %.1f ms (%.1f us/frame, host), flash %llu bytes written (%s)\n",
+           s->cpuNs / 1e6, s->framesHeard ? s->cpuNs / 1e3 / s->framesHeard : 0.0,
+           (unsigned long long)s->fs->bytesWritten, s->fs->hostPath(HISTORY_FILE).c_str());
+  }
+}
+
+void Simulator::printJson() const {
+  printf("{\"region\":\"%s\",\"seed\":%llu,\"seconds\":%u,\"channelBusy\":%.4f,\"beacons\":[",
+         LORA_REGION.name, (unsigned long long)scenario.seed, scenario.durationS,
+         channel.airUs / ((double)scenario.durationS * 1e6));
+  for (size_t i = 0; i < beaconList.size(); i++) {
+    const SimBeacon* b = beaconList[i];
+    BeaconSummary sum = summarize(*b);
+    printf("%s{\"name\":\"%s\",\"id\":\"%s\",\"fixes\":%u,\"live\":%u,\"recovered\":%u,"
+           "\"deliveryRatio\":%.4f,\"finalRatio\":%.4f,\"latencyMeanMs\":%.1f,\"latencyP50Ms\":%u,"
+           "\"latencyP95Ms\":%u,\"liveFrames\":%u,\"backfillFrames\":%u,\"busyDropped\":%u,\"deferred\":%u}",
+           i ? "," : "", b->spec->name.c_str(), b->beaconId, sum.fixes, sum.live, sum.recovered,
+           ratio(sum.live, sum.fixes), ratio(sum.recovered, sum.fixes), sum.meanMs, sum.p50Ms, sum.p95Ms,
+           b->liveFrames, b->backfillFrames, b->busyDropped, b->deferred);
+  }
+  printf("],\"stations\":[");
+  for (size_t i = 0; i < stations.size(); i++) {
+    const SimStation* s = stations[i];
+    printf("%s{\"name\":\"%s\",\"framesHeard\":%u,\"lostCollision\":%u,\"lostWeak\":%u,\"lostOwnTx\":%u,"
+           "\"lostOffAir\":%u,\"queueOverruns\":%u,\"repliesSent\":%u,\"repliesBusy\":%u,\"repliesLate\":%u,"
+           "\"historyRows\":%u,\"backfillRows\":%u,\"cpuUs\":%llu,\"flashBytes\":%llu}",
+           i ? "," : "", s->spec->name.c_str(), s->framesHeard, s->framesCollided, s->framesWeak,
+           s->framesWhileTx, s->framesOffAir, s->queueOverruns, s->repliesSent, s->repliesBusy, s->repliesLate,
+           s->historyRows, s->backfillRows, (unsigned long long)(s->cpuNs / 1000),
+           (unsigned long long)s->fs->bytesWritten);
+  }
+  printf("]}\n");
+}
+
+static void usage(const char* prog) {
+  fprintf(stderr, "usage: %s [scenario] [--seed N] [--seconds S] [--json] [--dir PATH]\n", prog);
+}
+
+int main(int argc, char** argv) {
+  Scenario scenario;
+  const char* scenarioPath = nullptr;
+  const char* seed = nullptr;
+  const char* seconds = nullptr;
+  std::string dir;
+  bool json = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (strcmp(arg, "--json") == 0) {
+      json = true;
+    } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+      seed = argv[++i];
+    } else if (strcmp(arg, "--seconds") == 0 && hasValue) {
+      seconds = argv[++i];
+    } else if (strcmp(arg, "--dir") == 0 && hasValue) {
+      dir = argv[++i];
+    } else if (arg[0] != '-' && !scenarioPath) {
+      scenarioPath = arg;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (scenarioPath) {
+    if (!scenario.load(scenarioPath)) return 2;
+  } else {
+    scenario.setDefault();
+  }
+  if (seed) scenario.seed = strtoull(seed, nullptr, 10);
+  if (seconds) scenario.durationS = (uint32_t)strtoul(seconds, nullptr, 10);
+  if (scenario.count(true) == 0 || scenario.count(false) == 0 || scenario.count(false) > MAX_BEACONS) {
+    fprintf(stderr, "scenario needs at least one station and 1-%u beacons\n", MAX_BEACONS);
+    return 2;
+  }
+  scenario.finish();
+
+  if (dir.empty()) {
+    char tmpl[] = "/tmp/pawsim-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+      perror("mkdtemp");
+      return 1;
+    }
+    dir = tmpl;
+  }
+
+  Simulator sim(scenario, dir);
+  sim.run();
+  if (json) sim.printJson(); else sim.printText();
+  return 0;
+}
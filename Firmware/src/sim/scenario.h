@@ -0,0 +1,260 @@
+// Simulator scenarios: nodes, movement and outages
+//
+// A scenario is a text file, one command per line ('#' starts a comment):
+//
+//   seed 42                      Channel fading, backoff and jitter draws
+//   duration 3600                Simulated seconds
+//   channel 3.3 4                Path loss exponent, shadowing sigma (dB)
+//   station S1 0 0               Station at x y (meters east/north)
+//   beacon rex 100 0             Beacon starting at x y
+//   waypoint rex 60 400 0        ...at x y at second 60, straight line in between
+//   trace rex walk.csv           Waypoints from "seconds,x,y" lines
+//   walk 30 500 1.5              30 more beacons (walk00...) on random walks within
+//                                500 m of the first station at 1.5 m/s
+//   outage S1 600 660            Node off the air from second 600 to 660
+//
+// Positions hold their last waypoint. Everything drawn from the seed, so the
+// same scenario and seed give the same run.
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "lora_channel.h"
+
+struct Waypoint {
+  double t;  // Seconds
+  SimPoint at;
+};
+
+struct Outage {
+  double start;  // Seconds
+  double end;
+};
+
+struct NodeSpec {
+  std::string name;
+  bool station;
+  std::vector<Waypoint> path;  // Sorted by t; path[0] is the start position
+  std::vector<Outage> outages;
+  SimPoint walkCenter{0, 0};   // Random walk (walk command), laid out by Scenario::finish()
+  double walkRadius = 0.0;
+  double walkSpeed = 0.0;
+
+  SimPoint position(double t) const {
+    if (t <= path.front().t) return path.front().at;
+    if (t >= path.back().t) return path.back().at;
+    size_t lo = 0, hi = path.size() - 1;  // path[lo].t <= t < path[hi].t
+    while (hi - lo > 1) {
+      size_t mid = (lo + hi) / 2;
+      if (path[mid].t <= t) lo = mid; else hi = mid;
+    }
+    const Waypoint& a = path[lo];
+    const Waypoint& b = path[hi];
+    double f = (t - a.t) / (b.t - a.t);
+    return SimPoint{a.at.x + f * (b.at.x - a.at.x), a.at.y + f * (b.at.y - a.at.y)};
+  }
+
+  bool offAir(double t) const {
+    for (const Outage& o : outages) {
+      if (t >= o.start && t < o.end) return true;
+    }
+    return false;
+  }
+};
+
+struct Scenario {
+  uint64_t seed = 1;
+  uint32_t durationS = 600;
+  float pathLossExponent = 3.3f;
+  float shadowingDb = 4.0f;
+  std::vector<NodeSpec> nodes;
+
+  NodeSpec* find(const std::string& name) {
+    for (NodeSpec& n : nodes) {
+      if (n.name == name) return &n;
+    }
+    return nullptr;
+  }
+
+  size_t count(bool station) const {
+    size_t n = 0;
+    for (const NodeSpec& node : nodes) {
+      if (node.station == station) n++;
+    }
+    return n;
+  }
+
+  // Default: one station with 30 beacons walking around it for 10 minutes
+  void setDefault() {
+    addNode("S1", true, SimPoint{0, 0});
+    addWalkers(30, 500.0, 1.5);
+  }
+
+  NodeSpec& addNode(const std::string& name, bool station, const SimPoint& at) {
+    NodeSpec node;
+    node.name = name;
+    node.station = station;
+    node.path.push_back(Waypoint{0.0, at});
+    nodes.push_back(node);
+    return nodes.back();
+  }
+
+  // Random walks around the first station (or the origin). Start points and
+  // legs are laid out by finish(), once seed and duration are known.
+  void addWalkers(int count, double radius, double speed) {
+    SimPoint center{0, 0};
+    for (const NodeSpec& n : nodes) {
+      if (n.station) {
+        center = n.path.front().at;
+        break;
+      }
+    }
+    for (int i = 0; i < count; i++) {
+      char name[16];
+      snprintf(name, sizeof(name), "walk%02u", (unsigned)walkerCount());
+      NodeSpec& node = addNode(name, false, center);
+      node.walkCenter = center;
+      node.walkRadius = radius;
+      node.walkSpeed = speed;
+    }
+  }
+
+  // Walkers start anywhere in their circle and take a new heading within
+  // +-45 degrees every WALK_LEG_S, turning back at the radius
+  void finish() {
+    const double WALK_LEG_S = 10.0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      NodeSpec& node = nodes[i];
+      if (node.walkSpeed <= 0.0) continue;
+      SimRandom rng(seed ^ simMix(0x57414C4Bull + i));
+      double r = node.walkRadius * sqrt(rng.uniform());
+      double a = 6.283185307179586 * rng.uniform();
+      SimPoint p{node.walkCenter.x + r * cos(a), node.walkCenter.y + r * sin(a)};
+      node.path.assign(1, Waypoint{0.0, p});
+      double step = node.walkSpeed * WALK_LEG_S;
+      double heading = 6.283185307179586 * rng.uniform();
+      for (double t = WALK_LEG_S; t < durationS + WALK_LEG_S; t += WALK_LEG_S) {
+        heading += (rng.uniform() - 0.5) * 1.5707963267948966;
+        SimPoint next{p.x + step * cos(heading), p.y + step * sin(heading)};
+        if (simDistance(next, node.walkCenter) > node.walkRadius) {
+          heading = atan2(node.walkCenter.y - p.y, node.walkCenter.x - p.x);
+          next = SimPoint{p.x + step * cos(heading), p.y + step * sin(heading)};
+        }
+        node.path.push_back(Waypoint{t, next});
+        p = next;
+      }
+    }
+  }
+
+  // Parse a scenario file; prints the first error and returns false
+  bool load(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+      fprintf(stderr, "%s: cannot open\n", path);
+      return false;
+    }
+    char line[256];
+    int lineNo = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+      lineNo++;
+      char* hash = strchr(line, '#');
+      if (hash) *hash = '\0';
+      std::vector<std::string> args;
+      for (char* tok = strtok(line, " \t\r\n"); tok; tok = strtok(nullptr, " \t\r\n")) args.push_back(tok);
+      if (args.empty()) continue;
+      std::string error = command(args);
+      if (!error.empty()) {
+        fprintf(stderr, "%s:%d: %s\n", path, lineNo, error.c_str());
+        ok = false;
+      }
+    }
+    fclose(f);
+    return ok;
+  }
+
+private:
+  size_t walkerCount() const {
+    size_t n = 0;
+    for (const NodeSpec& node : nodes) {
+      if (node.name.compare(0, 4, "walk") == 0) n++;
+    }
+    return n;
+  }
+
+  static bool number(const std::string& s, double& out) {
+    char* end;
+    out = strtod(s.c_str(), &end);
+    return end != s.c_str() && *end == '\0';
+  }
+
+  // One scenario line; returns an error message, empty if it applied
+  std::string command(const std::vector<std::string>& a) {
+    const std::string& cmd = a[0];
+    double v[3];
+    size_t numbers = 0;
+    for (size_t i = 1; i < a.size() && numbers < 3; i++) {
+      if (number(a[i], v[numbers])) numbers++;
+    }
+
+    if (cmd == "seed" && a.size() == 2 && numbers == 1) {
+      seed = (uint64_t)v[0];
+    } else if (cmd == "duration" && a.size() == 2 && numbers == 1 && v[0] > 0) {
+      durationS = (uint32_t)v[0];
+    } else if (cmd == "channel" && a.size() == 3 && numbers == 2) {
+      pathLossExponent = (float)v[0];
+      shadowingDb = (float)v[1];
+    } else if ((cmd == "station" || cmd == "beacon") && a.size() == 4 && numbers == 2) {
+      if (find(a[1])) return "duplicate node " + a[1];
+      addNode(a[1], cmd == "station", SimPoint{v[0], v[1]});
+    } else if (cmd == "waypoint" && a.size() == 5 && numbers == 3) {
+      NodeSpec* node = find(a[1]);
+      if (!node) return "unknown node " + a[1];
+      if (v[0] <= node->path.back().t) return "waypoints must be in time order";
+      node->path.push_back(Waypoint{v[0], SimPoint{v[1], v[2]}});
+    } else if (cmd == "trace" && a.size() == 3) {
+      NodeSpec* node = find(a[1]);
+      if (!node) return "unknown node " + a[1];
+      return loadTrace(*node, a[2]);
+    } else if (cmd == "walk" && a.size() == 4 && numbers == 3) {
+      addWalkers((int)v[0], v[1], v[2]);
+    } else if (cmd == "outage" && a.size() == 4 && numbers == 2) {
+      NodeSpec* node = find(a[1]);
+      if (!node) return "unknown node " + a[1];
+      node->outages.push_back(Outage{v[0], v[1]});
+    } else {
+      return "bad command '" + cmd + "'";
+    }
+    return "";
+  }
+
+  static std::string loadTrace(NodeSpec& node, const std::string& path) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return "cannot open " + path;
+    double t, x, y;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+      if (sscanf(line, "%lf,%lf,%lf", &t, &x, &y) != 3) continue;  // Header, blank lines
+      if (t <= node.path.back().t) {
+        if (t == 0.0) {
+          node.path.front().at = SimPoint{x, y};
+          continue;
+        }
+        fclose(f);
+        return path + ": times must increase";
+      }
+      node.path.push_back(Waypoint{t, SimPoint{x, y}});
+    }
+    fclose(f);
+    return "";
+  }
+};
+
+#endif // SCENARIO_H
@@ -0,0 +1,72 @@
+// Single-writer snapshot for readers on other tasks
+//
+// Seqlock over a double buffer: the writer fills the slot readers are not
+// using, then flips `current`. Each slot's sequence is odd while it is being
+// written; a reader copies the current slot and retries only if that slot's
+// sequence changed during the copy, i.e. the writer published twice in the
+// meantime. Neither side ever blocks or takes a lock.
+//
+// T must be trivially copyable (plain data, no String or containers).
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <atomic>
+#include <type_traits>
+
+template <typename T>
+class Snapshot {
+  static_assert(std::is_trivially_copyable<T>::value, "Snapshot<T> needs plain data");
+
+public:
+  // Writer side - only ever called from one task
+  void publish(const T &value) {
+    uint32_t next = current.load(std::memory_order_relaxed) ^ 1;
+    Slot &slot = slots[next];
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.value = value;
+    slot.seq.store(seq + 2, std::memory_order_release);
+    current.store(next, std::memory_order_release);
+    published.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Reader side - any task, any number of readers
+  T read() const {
+    T out;
+    read(out);
+    return out;
+  }
+
+  // Same, into caller-provided storage (for values too big for a task stack)
+  void read(T &out) const {
+    for (;;) {
+      const Slot &slot = slots[current.load(std::memory_order_acquire)];
+      uint32_t before = slot.seq.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      out = slot.value;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) == before) {
+        return;
+      }
+    }
+  }
+
+  // Number of publish() calls so far
+  uint32_t version() const {
+    return published.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> seq{0};
+    T value{};
+  };
+  Slot slots[2];
+  std::atomic<uint32_t> current{0};
+  std::atomic<uint32_t> published{0};
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,200 @@
+// PupStation frame decoding and beacon state, shared with the host build
+//
+// processFrame() in main.cpp (and the native tools) turn each received frame
+// into beacon-table updates and history rows with these functions; what
+// happens next (queues, uplink, display) stays with the caller.
+
+#ifndef STATION_CORE_H
+#define STATION_CORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "protocol.h"
+#include "backfill.h"
+#include "beacon_registry.h"
+#include "power_model.h"
+
+const uint8_t MAX_BEACONS = 64;      // Beacons the station keeps track of
+const uint8_t BEACON_NAME_LEN = 32;  // Including the terminator
+
+// Latest data from one beacon. Plain data so the table can be published to
+// other tasks as is.
+struct LatestBeaconData {
+  char beaconId[9] = "";
+  char name[BEACON_NAME_LEN] = "";
+  float latitude = 0.0;
+  float longitude = 0.0;
+  float hdop = 0.0;
+  uint8_t sats = 0;
+  float batteryVoltage = 0.0;
+  bool ledOn = false;
+  bool buzzerOn = false;
+  uint8_t lastControlReceived = 0;
+  float speed = 0.0;
+  float altitude = 0.0;
+  uint32_t uptime = 0;
+  uint16_t awakeMs = 0;         // Beacon's awake time in its last frame cycle
+  uint16_t batteryLifeH = BATTERY_LIFE_UNKNOWN;
+  uint16_t bootMs = 0;          // Time to first frame of the beacon's current boot
+  bool fastBoot = false;        // That boot took the fast path
+  uint32_t lastUpdate = 0;
+  float rssi = 0.0;
+  float snr = 0.0;
+  bool hasData = false;
+  uint32_t backfilledFixes = 0; // Fixes recovered through store-and-forward
+  uint32_t rxFrames = 0;        // Beacon and backfill frames accepted
+};
+
+typedef BeaconRegistry<LatestBeaconData, MAX_BEACONS> BeaconTable;
+
+// One history row (history_store.h)
+struct HistoryRecord {
+  uint32_t timestamp;
+  char beaconId[9];
+  float latitude;
+  float longitude;
+  float speed;
+  float altitude;
+  float battery;
+  float rssi;
+  float snr;
+};
+
+// The station's own GPS position
+struct StationLocation {
+  float latitude = 0.0;
+  float longitude = 0.0;
+  float hdop = 0.0;
+  uint8_t sats = 0;
+  float altitude = 0.0;
+  bool hasValidFix = false;
+  uint32_t lastUpdate = 0;
+};
+
+// Entry for a beacon ID, created with its default name on first use.
+// nullptr if the ID is malformed or the table is full.
+inline LatestBeaconData* findOrAddBeacon(BeaconTable& table, const char* beaconId, bool& added) {
+  added = false;
+  uint32_t id;
+  if (!parseBeaconId(beaconId, id)) return nullptr;
+  LatestBeaconData* beacon = table.findOrAdd(id, &added);
+  if (beacon && added) {
+    char formatted[sizeof(beacon->beaconId)];
+    formatBeaconId(id, formatted);
+    memcpy(beacon->beaconId, formatted, sizeof(formatted));
+    snprintf(beacon->name, sizeof(beacon->name), "Beacon-%s", formatted);
+  }
+  return beacon;
+}
+
+// Data ranges a genuine fix can have
+inline bool beaconDataInRange(const BeaconMessage& msg) {
+  if (msg.latitude < -90.0 || msg.latitude > 90.0) return false;
+  if (msg.longitude < -180.0 || msg.longitude > 180.0) return false;
+  if (msg.sats > 50) return false;
+  return true;
+}
+
+inline bool decodeBeaconMessage(const uint8_t* data, size_t len, BeaconMessage& msg) {
+  if (len < sizeof(BeaconMessage) || data[0] != MSG_BEACON) return false;
+  memcpy(&msg, data, sizeof(msg));
+  msg.beaconId[sizeof(msg.beaconId) - 1] = '\0';
+  return true;
+}
+
+// Frames carry only the fixes they need; count is clamped to what arrived
+inline bool decodeBackfillMessage(const uint8_t* data, size_t len, BackfillMessage& bf) {
+  if (len < offsetof(BackfillMessage, fixes) || data[0] != MSG_BACKFILL) return false;
+  memset(&bf, 0, sizeof(bf));
+  memcpy(&bf, data, len < sizeof(bf) ? len : sizeof(bf));
+  bf.beaconId[sizeof(bf.beaconId) - 1] = '\0';
+  size_t arrived = (len - offsetof(BackfillMessage, fixes)) / sizeof(BackfillFix);
+  if (bf.count > arrived) bf.count = (uint8_t)arrived;
+  if (bf.count > BACKFILL_FIXES_PER_FRAME) bf.count = BACKFILL_FIXES_PER_FRAME;
+  return true;
+}
+
+// Store a validated beacon frame in its table entry
+inline void applyBeaconMessage(LatestBeaconData& beacon, const BeaconMessage& msg,
+                               float rssi, float snr, uint32_t nowMs) {
+  beacon.latitude = msg.latitude;
+  beacon.longitude = msg.longitude;
+  beacon.hdop = msg.hdop;
+  beacon.sats = msg.sats;
+  beacon.batteryVoltage = msg.batteryVoltage;
+  beacon.ledOn = msg.ledOn;
+  beacon.buzzerOn = msg.buzzerOn;
+  beacon.lastControlReceived = msg.lastControlReceived;
+  beacon.speed = msg.speed;
+  beacon.altitude = msg.altitude;
+  beacon.uptime = msg.uptime;
+  beacon.awakeMs = msg.awakeMs;
+  beacon.batteryLifeH = msg.batteryLifeH;
+  beacon.bootMs = msg.bootMs;
+  beacon.fastBoot = (msg.flags & BEACON_FLAG_FAST_BOOT) != 0;
+  beacon.lastUpdate = nowMs;
+  beacon.rssi = rssi;
+  beacon.snr = snr;
+  beacon.hasData = true;
+  beacon.rxFrames++;
+}
+
+// History row for a live fix; timestamp is the station's GPS time
+inline HistoryRecord beaconHistoryRecord(const BeaconMessage& msg, float rssi, float snr, uint32_t timestamp) {
+  HistoryRecord r;
+  r.timestamp = timestamp;
+  memcpy(r.beaconId, msg.beaconId, sizeof(r.beaconId));
+  r.latitude = msg.latitude;
+  r.longitude = msg.longitude;
+  r.speed = msg.speed;
+  r.altitude = msg.altitude;
+  r.battery = msg.batteryVoltage;
+  r.rssi = rssi;
+  r.snr = snr;
+  return r;
+}
+
+// History rows for the usable fixes of a backfill frame (timestamped by the
+// beacon, battery from its last live frame). Returns how many went to out.
+inline uint8_t backfillHistoryRecords(const BackfillMessage& bf, float battery, float rssi, float snr,
+                                      HistoryRecord (&out)[BACKFILL_FIXES_PER_FRAME]) {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < bf.count && i < BACKFILL_FIXES_PER_FRAME; i++) {
+    const BackfillFix& fix = bf.fixes[i];
+    HistoryRecord& r = out[n];
+    r.timestamp = fix.timestamp;
+    memcpy(r.beaconId, bf.beaconId, sizeof(r.beaconId));
+    r.latitude = fix.latE7 / 1e7;
+    r.longitude = fix.lonE7 / 1e7;
+    r.speed = fix.speedX10 / 10.0f;
+    r.altitude = fix.altitude;
+    r.battery = battery;
+    r.rssi = rssi;
+    r.snr = snr;
+
+    if (r.timestamp == 0 || r.latitude < -90.0 || r.latitude > 90.0 ||
+        r.longitude < -180.0 || r.longitude > 180.0) {
+      continue;
+    }
+    n++;
+  }
+  return n;
+}
+
+// Station -> beacon frame carrying our current ack window for that beacon
+// (window nullptr if nothing was heard from it). Empty beaconId = broadcast.
+inline ControlMessage makeStationReply(const char* beaconId, uint8_t msgType, const SeqWindow* window) {
+  ControlMessage ctrl{};
+  ctrl.msgType = msgType;
+  snprintf(ctrl.beaconId, sizeof(ctrl.beaconId), "%s", beaconId);
+  if (window && window->valid) {
+    ctrl.flags |= CONTROL_FLAG_ACK;
+    ctrl.ackSeq = window->lastSeq;
+    ctrl.ackBitmap = window->bitmap;
+  }
+  return ctrl;
+}
+
+#endif // STATION_CORE_H
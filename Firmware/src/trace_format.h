@@ -0,0 +1,75 @@
+// Capture traces: what a PupStation heard, for replay on a host
+//
+// A trace is a TraceFileHeader followed by records, each a TraceRecordHeader
+// and `len` payload bytes:
+//
+//   TRACE_NMEA    Raw bytes as read from the GPS UART
+//   TRACE_FRAME   TraceFrameInfo, then the frame as radioTask queued it
+//   TRACE_RESULT  TraceResult of processFrame() for the frame recorded at
+//                 frameMs (frames are processed in arrival order)
+//
+// Times are milliseconds since the capture started. Records are packed and
+// little-endian, as the ESP32 and x86 hosts write them. The replay tool
+// (env:replay) runs the same frames through the station code and compares
+// each result against the recorded one.
+
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "station_core.h"
+#include "history_store.h"
+
+const uint32_t TRACE_MAGIC = 0x52545750;  // "PWTR"
+const uint8_t TRACE_VERSION = 1;
+
+enum TraceRecordType : uint8_t {
+  TRACE_NMEA = 1,
+  TRACE_FRAME = 2,
+  TRACE_RESULT = 3
+};
+
+struct __attribute__((packed)) TraceFileHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t reserved[3];
+};
+
+struct __attribute__((packed)) TraceRecordHeader {
+  uint8_t type;       // TraceRecordType
+  uint16_t len;       // Payload bytes after this header
+  uint32_t ms;        // Since capture start
+};
+
+// Exact floats, so replayed history lines format the same
+struct __attribute__((packed)) TraceFrameInfo {
+  float rssi;
+  float snr;
+};
+
+struct __attribute__((packed)) TraceResult {
+  uint32_t frameMs;   // ms of the TRACE_FRAME record this answers
+  uint8_t accepted;   // Decoded and valid
+  uint8_t rows;       // History rows queued for storageTask
+  uint32_t digest;    // traceDigestRecord() over those rows, in order
+};
+
+const uint32_t TRACE_DIGEST_SEED = 2166136261u;  // FNV-1a offset basis
+
+inline uint32_t traceDigest(uint32_t h, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+// Digest of a history row as it would be written to history.csv
+inline uint32_t traceDigestRecord(uint32_t h, const HistoryRecord& r) {
+  char line[HISTORY_LINE_MAX];
+  size_t n = formatHistoryLine(line, sizeof(line), r);
+  return traceDigest(h, line, n);
+}
+
+#endif // TRACE_FORMAT_H
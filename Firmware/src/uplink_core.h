@@ -0,0 +1,340 @@
+// Central server uplink: fixes in batches, a backlog on flash while the
+// server cannot be reached, and delivery over the push channel or HTTP
+//
+// UplinkSender is networkTask's side. It reaches the fix queue, the socket,
+// HTTP and the metrics through an UplinkLink, so test/test_uplink runs the
+// same code against a stand-in server. Batch JSON is built with String like
+// web_json.h; host builds get a String from src/host/Arduino.h.
+
+#ifndef UPLINK_CORE_H
+#define UPLINK_CORE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "hal.h"
+#include "station_core.h"
+
+// One beacon fix as loop() queues it and the backlog stores it
+struct UplinkFix {
+  uint32_t timestamp;      // Unix time from the station GPS, 0 if unknown
+  char beaconId[9];
+  float latitude;
+  float longitude;
+  float hdop;
+  uint8_t sats;
+  float batteryVoltage;
+  float rssi;
+  float snr;
+  float speed;
+  float altitude;
+  bool ledOn;
+  bool buzzerOn;
+};
+
+const uint8_t UPLINK_BATCH_MAX = 32;                // Fixes per batch
+const uint8_t UPLINK_DRAIN_BATCHES = 4;             // Backlog batches per sync, so live data keeps flowing
+const uint32_t UPLINK_ACK_TIMEOUT_MS = 3000;        // For a batch on the push channel, then it is resent over HTTP
+const char* const UPLINK_BACKLOG_NEW = "/uplink_new.bin"; // Appended while offline
+const char* const UPLINK_BACKLOG_OLD = "/uplink_old.bin"; // Drained first
+const uint32_t UPLINK_BACKLOG_SEGMENT_BYTES = 48 * 1024;  // About 870 fixes; at most two segments
+
+struct UplinkStats {
+  uint32_t queued = 0;
+  uint32_t sent = 0;
+  uint32_t spooled = 0;
+  uint32_t dropped = 0;    // Queue full, backlog full, or no GPS time to spool with
+  uint32_t queuePeak = 0;
+  uint32_t backlogBytes = 0;
+  int lastHttpCode = 0;
+  uint32_t lastAckMs = 0;  // Batch sent on the push channel -> server ack
+};
+
+// Body of POST /api/device/beacons. On the push channel the same object also
+// has "type":"fixes".
+inline String uplinkBatchJson(const String& deviceId, uint32_t boot, uint32_t seq,
+                              const StationLocation& station, const UplinkFix* fixes,
+                              uint8_t count, bool socket) {
+  String json = "{";
+  if (socket) json += "\"type\":\"fixes\",";
+  json += "\"deviceId\":\"" + deviceId + "\",";
+  json += "\"boot\":" + String(boot) + ",";
+  json += "\"seq\":" + String(seq) + ",";
+  if (station.hasValidFix) {
+    json += "\"stationLocation\":{";
+    json += "\"latitude\":" + String(station.latitude, 6) + ",";
+    json += "\"longitude\":" + String(station.longitude, 6) + ",";
+    json += "\"hdop\":" + String(station.hdop, 2) + ",";
+    json += "\"sats\":" + String(station.sats) + ",";
+    json += "\"altitude\":" + String(station.altitude, 1) + ",";
+    json += "\"hasValidFix\":true},";
+  }
+  json += "\"fixes\":[";
+  for (uint8_t i = 0; i < count; i++) {
+    const UplinkFix& fix = fixes[i];
+    if (i > 0) json += ",";
+    json += "{\"trackerId\":\"" + String(fix.beaconId) + "\",";
+    json += "\"time\":" + String(fix.timestamp) + ",";
+    json += "\"latitude\":" + String(fix.latitude, 6) + ",";
+    json += "\"longitude\":" + String(fix.longitude, 6) + ",";
+    json += "\"hdop\":" + String(fix.hdop, 2) + ",";
+    json += "\"sats\":" + String(fix.sats) + ",";
+    json += "\"batteryVoltage\":" + String(fix.batteryVoltage, 2) + ",";
+    json += "\"rssi\":" + String(fix.rssi, 1) + ",";
+    json += "\"snr\":" + String(fix.snr, 1) + ",";
+    json += "\"ledOn\":" + String(fix.ledOn ? "true" : "false") + ",";
+    json += "\"buzzerOn\":" + String(fix.buzzerOn ? "true" : "false") + ",";
+    json += "\"speed\":" + String(fix.speed, 2) + ",";
+    json += "\"altitude\":" + String(fix.altitude, 1) + "}";
+  }
+  json += "]}";
+  return json;
+}
+
+// What UplinkSender needs from its owner
+class UplinkLink {
+public:
+  virtual ~UplinkLink() {}
+  // Fixes queued since the last call, oldest first, at most max
+  virtual uint8_t takeQueued(UplinkFix* fixes, uint8_t max) = 0;
+  virtual StationLocation stationLocation() = 0;
+  virtual bool socketConnected() = 0;
+  virtual bool sendSocket(const String& json) = 0;
+  // HTTP status of POST /api/device/beacons, <= 0 if there was no answer
+  virtual int post(const String& json) = 0;
+  // One delivery attempt ended (metrics)
+  virtual void batchDone(bool, uint32_t) {}
+  // The backlog was full and its older segment was dropped
+  virtual void backlogDropped(uint32_t) {}
+};
+
+enum UplinkResult : uint8_t {
+  UPLINK_FAILED,
+  UPLINK_SENT,       // On the push channel, confirmed when its ack comes in
+  UPLINK_DELIVERED
+};
+
+// The batch being delivered keeps its seq until the server confirms it, over
+// either transport, and the server drops a seq it already stored from this
+// boot - so a resend after a lost ack is not stored twice. While the server
+// cannot be reached the pending batch waits in RAM and newer fixes go to the
+// backlog, which is sent oldest-first once it answers again.
+class UplinkSender {
+public:
+  UplinkStats stats;
+  String deviceId;
+  uint32_t bootId = 0;     // Random per boot, sent with every seq
+
+  UplinkSender(HalFileSystem& fs, HalClock& clock, UplinkLink& link) : fs(fs), clock(clock), link(link) {}
+
+  // Start of a sync: allow UPLINK_DRAIN_BATCHES backlog batches again
+  void startSync() {
+    drainBudget = UPLINK_DRAIN_BATCHES;
+  }
+
+  bool awaitingAck() const {
+    return waitingForAck;
+  }
+
+  // "ack" from the push channel
+  void ackReceived(uint32_t seq) {
+    ackedSeq = seq;
+  }
+
+  // One sync step: the pending batch first, then the backlog, then everything
+  // queued since the last pass. It never waits for an ack: while one is
+  // outstanding it returns, and should be called again shortly.
+  void service(bool online) {
+    if (waitingForAck) {
+      if (ackedSeq == seq) {
+        waitingForAck = false;
+        stats.lastAckMs = clock.millis() - sentAt;
+        confirm();
+      } else if (link.socketConnected() && clock.millis() - sentAt < UPLINK_ACK_TIMEOUT_MS) {
+        return;
+      } else {
+        // Maybe stored, maybe not: the same seq goes over HTTP on the next sync
+        waitingForAck = false;
+        viaHttp = true;
+        link.batchDone(false, clock.micros() - attemptUs);
+        online = false;
+      }
+    }
+
+    while (online) {
+      if (count == 0) {
+        if (drainBudget > 0 && !backlogEmpty()) {
+          drainBudget--;
+          if (!loadBacklogBatch()) continue;
+        } else {
+          count = link.takeQueued(batch, UPLINK_BATCH_MAX);
+          if (count == 0) break;
+          seq++;
+        }
+      }
+
+      UplinkResult result = send();
+      if (result == UPLINK_SENT) {
+        return;
+      }
+      if (result == UPLINK_FAILED) {
+        link.batchDone(false, clock.micros() - attemptUs);
+        online = false;
+        break;
+      }
+      confirm();
+    }
+
+    // Offline: newer fixes go to the backlog
+    uint8_t n;
+    while (!online && (n = link.takeQueued(spoolBatch, UPLINK_BATCH_MAX)) > 0) {
+      spool(spoolBatch, n);
+    }
+
+    stats.backlogBytes = backlogBytes();
+  }
+
+  bool backlogEmpty() {
+    return !fs.exists(UPLINK_BACKLOG_OLD) && !fs.exists(UPLINK_BACKLOG_NEW);
+  }
+
+  uint32_t backlogBytes() {
+    uint32_t bytes = 0;
+    const char* segments[] = {UPLINK_BACKLOG_OLD, UPLINK_BACKLOG_NEW};
+    for (const char* path : segments) {
+      std::unique_ptr<HalFile> file = fs.open(path, HAL_FILE_READ);
+      if (file) bytes += file->size();
+    }
+    return bytes - backlogOffset;
+  }
+
+private:
+  HalFileSystem& fs;
+  HalClock& clock;
+  UplinkLink& link;
+
+  UplinkFix batch[UPLINK_BATCH_MAX];      // Pending batch
+  uint8_t count = 0;                      // 0 = none pending
+  uint32_t seq = 0;
+  uint32_t ackedSeq = 0;                  // Last seq acked on the push channel
+  bool fromBacklog = false;               // Read from UPLINK_BACKLOG_OLD at backlogOffset
+  bool endsSegment = false;               // ...and it was the rest of that segment
+  bool viaHttp = false;                   // Its socket ack timed out, so HTTP is tried next
+  bool waitingForAck = false;
+  uint32_t sentAt = 0;
+  uint32_t attemptUs = 0;
+  uint8_t drainBudget = 0;                // Backlog batches left in this sync
+  uint32_t backlogOffset = 0;             // Bytes of UPLINK_BACKLOG_OLD already sent
+  UplinkFix spoolBatch[UPLINK_BATCH_MAX];
+
+  // Send the pending batch over the push channel, or POST it while that is
+  // down (or did not ack it in time)
+  UplinkResult send() {
+    attemptUs = clock.micros();
+    bool socket = link.socketConnected() && !viaHttp;
+    String json = uplinkBatchJson(deviceId, bootId, seq, link.stationLocation(), batch, count, socket);
+
+    if (socket) {
+      if (!link.sendSocket(json)) {
+        return UPLINK_FAILED;
+      }
+      waitingForAck = true;
+      sentAt = clock.millis();
+      return UPLINK_SENT;
+    }
+
+    stats.lastHttpCode = link.post(json);
+    return stats.lastHttpCode == 200 ? UPLINK_DELIVERED : UPLINK_FAILED;
+  }
+
+  // The server has the pending batch: drop it, and its part of the backlog
+  void confirm() {
+    link.batchDone(true, clock.micros() - attemptUs);
+    stats.sent += count;
+
+    if (fromBacklog) {
+      backlogOffset += count * sizeof(UplinkFix);
+      if (endsSegment) {
+        fs.remove(UPLINK_BACKLOG_OLD);
+        backlogOffset = 0;
+      }
+    }
+    count = 0;
+    fromBacklog = false;
+    viaHttp = false;
+  }
+
+  // The new segment becomes the old one. If an old one is still waiting, it
+  // is dropped: the backlog keeps the most recent fixes.
+  void rotateBacklog() {
+    std::unique_ptr<HalFile> old = fs.open(UPLINK_BACKLOG_OLD, HAL_FILE_READ);
+    if (old) {
+      uint32_t unsent = (old->size() - backlogOffset) / sizeof(UplinkFix);
+      if (fromBacklog) unsent -= count; // Still delivered from RAM
+      old.reset();
+      stats.dropped += unsent;
+      fs.remove(UPLINK_BACKLOG_OLD);
+      fromBacklog = false;
+      link.backlogDropped(unsent);
+    }
+    fs.rename(UPLINK_BACKLOG_NEW, UPLINK_BACKLOG_OLD);
+    backlogOffset = 0;
+  }
+
+  void spool(const UplinkFix* fixes, uint8_t n) {
+    size_t size;
+    uint8_t kept = 0;
+    {
+      std::unique_ptr<HalFile> file = fs.open(UPLINK_BACKLOG_NEW, HAL_FILE_APPEND);
+      if (!file) {
+        stats.dropped += n;
+        return;
+      }
+
+      // A fix without GPS time could not be placed in the history later
+      for (uint8_t i = 0; i < n; i++) {
+        if (fixes[i].timestamp == 0) continue;
+        file->write((const char*)&fixes[i], sizeof(UplinkFix));
+        kept++;
+      }
+      size = file->size();
+    }
+
+    stats.spooled += kept;
+    stats.dropped += n - kept;
+
+    if (size >= UPLINK_BACKLOG_SEGMENT_BYTES) {
+      rotateBacklog();
+    }
+  }
+
+  // Make the oldest fixes in the backlog the pending batch. False if none could be read.
+  bool loadBacklogBatch() {
+    if (!fs.exists(UPLINK_BACKLOG_OLD)) {
+      rotateBacklog();
+    }
+
+    uint8_t n;
+    {
+      std::unique_ptr<HalFile> file = fs.open(UPLINK_BACKLOG_OLD, HAL_FILE_READ);
+      if (!file) {
+        return false;
+      }
+      file->seek(backlogOffset);
+      n = file->read((char*)batch, sizeof(batch)) / sizeof(UplinkFix);
+      endsSegment = backlogOffset + n * sizeof(UplinkFix) >= file->size();
+    }
+
+    if (n == 0) {
+      fs.remove(UPLINK_BACKLOG_OLD);
+      backlogOffset = 0;
+      return false;
+    }
+    count = n;
+    fromBacklog = true;
+    seq++;
+    return true;
+  }
+};
+
+#endif // UPLINK_CORE_H
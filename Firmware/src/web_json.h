@@ -0,0 +1,161 @@
+// Response bodies of the station's busiest web routes
+//
+// /api/data, the history tail of /api/stats and the GPX export are built here
+// from plain data, so the micro-benchmarks (bench_suite.h) time the same code
+// the handlers run. Arduino String throughout; host builds get a String from
+// src/host/Arduino.h.
+
+#ifndef WEB_JSON_H
+#define WEB_JSON_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "station_core.h"
+
+// One entry of the /api/data "beacons" array
+inline String beaconJson(const LatestBeaconData& b) {
+  String json = "{";
+  json += "\"id\":\"" + String(b.beaconId) + "\",";
+  json += "\"name\":\"" + String(b.name) + "\",";
+  json += "\"latitude\":" + String(b.latitude, 6) + ",";
+  json += "\"longitude\":" + String(b.longitude, 6) + ",";
+  json += "\"hdop\":" + String(b.hdop, 2) + ",";
+  json += "\"sats\":" + String(b.sats) + ",";
+  json += "\"battery\":" + String(b.batteryVoltage, 2) + ",";
+  json += "\"rssi\":" + String(b.rssi, 1) + ",";
+  json += "\"snr\":" + String(b.snr, 1) + ",";
+  json += "\"speed\":" + String(b.speed, 2) + ",";
+  json += "\"altitude\":" + String(b.altitude, 1) + ",";
+  json += "\"lastUpdate\":" + String(b.lastUpdate) + ",";
+  json += "\"backfilled\":" + String(b.backfilledFixes) + ",";
+  json += "\"awakeMs\":" + String(b.awakeMs) + ",";
+  json += "\"batteryLifeH\":" + (b.batteryLifeH == BATTERY_LIFE_UNKNOWN ? String("null") : String(b.batteryLifeH)) + ",";
+  json += "\"bootMs\":" + String(b.bootMs) + ",";
+  json += "\"fastBoot\":" + String(b.fastBoot ? "true" : "false") + ",";
+  json += "\"hasData\":" + String(b.hasData ? "true" : "false");
+  json += "}";
+  return json;
+}
+
+// GET /api/data: the primary beacon's fields at the top level (single-beacon
+// clients), every beacon heard, and the station's position
+inline String dataJson(const LatestBeaconData& primary, const BeaconTable& table,
+                       const StationLocation& station, uint32_t serverTime) {
+  String json = "{";
+
+  // Include primary beacon data (backward compatibility)
+  json += "\"hasData\":" + String(primary.hasData ? "true" : "false") + ",";
+  json += "\"beaconId\":\"" + String(primary.beaconId) + "\",";
+  json += "\"name\":\"" + String(primary.name) + "\",";
+  json += "\"latitude\":" + String(primary.latitude, 6) + ",";
+  json += "\"longitude\":" + String(primary.longitude, 6) + ",";
+  json += "\"hdop\":" + String(primary.hdop, 2) + ",";
+  json += "\"sats\":" + String(primary.sats) + ",";
+  json += "\"battery\":" + String(primary.batteryVoltage, 2) + ",";
+  json += "\"rssi\":" + String(primary.rssi, 1) + ",";
+  json += "\"snr\":" + String(primary.snr, 1) + ",";
+  json += "\"ledOn\":" + String(primary.ledOn ? "true" : "false") + ",";
+  json += "\"buzzerOn\":" + String(primary.buzzerOn ? "true" : "false") + ",";
+  json += "\"lastControlReceived\":" + String(primary.lastControlReceived) + ",";
+  json += "\"speed\":" + String(primary.speed, 2) + ",";
+  json += "\"altitude\":" + String(primary.altitude, 1) + ",";
+  json += "\"lastUpdate\":" + String(primary.lastUpdate) + ",";
+
+  // Add all beacons data
+  json += "\"beacons\":[";
+  bool first = true;
+  for (uint8_t i = 0; i < table.size(); i++) {
+    const LatestBeaconData& b = table.at(i);
+    if (!b.hasData) continue; // Named in the config but not heard yet
+    if (!first) json += ",";
+    first = false;
+    json += beaconJson(b);
+  }
+  json += "],";
+
+  // Station data
+  json += "\"station\":{";
+  json += "\"hasValidFix\":" + String(station.hasValidFix ? "true" : "false") + ",";
+  json += "\"latitude\":" + String(station.latitude, 6) + ",";
+  json += "\"longitude\":" + String(station.longitude, 6) + ",";
+  json += "\"hdop\":" + String(station.hdop, 2) + ",";
+  json += "\"sats\":" + String(station.sats) + ",";
+  json += "\"altitude\":" + String(station.altitude, 1) + ",";
+  json += "\"lastUpdate\":" + String(station.lastUpdate);
+  json += "},";
+  json += "\"serverTime\":" + String(serverTime);
+  json += "}";
+  return json;
+}
+
+// One point of the /api/stats "history" tail, parsed by storageTask
+struct StatsHistoryPoint {
+  uint32_t timestamp;
+  char beaconId[9];
+  float beaconBattery;
+};
+
+// From a history.csv line
+// (timestamp,beaconId,latitude,longitude,speed,altitude,battery,rssi,snr);
+// false if the line does not parse
+inline bool parseStatsHistoryPoint(const char* line, StatsHistoryPoint& point) {
+  const char* field[7];
+  field[0] = line;
+  for (int i = 1; i < 7; i++) {
+    const char* comma = strchr(field[i - 1], ',');
+    if (!comma) return false;
+    field[i] = comma + 1;
+  }
+  size_t idLen = field[2] - field[1] - 1;
+  if (field[1] == line + 1 || idLen >= sizeof(point.beaconId)) return false;
+
+  point.timestamp = (uint32_t)strtoul(field[0], nullptr, 10);
+  memcpy(point.beaconId, field[1], idLen);
+  point.beaconId[idLen] = '\0';
+  point.beaconBattery = strtof(field[6], nullptr);
+  return true;
+}
+
+// One /api/stats "history" entry
+inline String statsHistoryEntryJson(const StatsHistoryPoint& point, float stationBattery) {
+  String entry = "{";
+  entry += "\"timestamp\":" + String(point.timestamp) + ",";
+  entry += "\"beaconId\":\"" + String(point.beaconId) + "\",";
+  entry += "\"beaconBattery\":" + String(point.beaconBattery, 2) + ",";
+  entry += "\"stationBattery\":" + String(stationBattery, 2); // Current station battery
+  entry += "}";
+  return entry;
+}
+
+// One GPX <trkpt> from a history.csv line; empty if the line does not parse
+inline String gpxTrackPoint(const String& line) {
+  int idx1 = line.indexOf(',');
+  int idx2 = line.indexOf(',', idx1 + 1);
+  int idx3 = line.indexOf(',', idx2 + 1);
+  int idx4 = line.indexOf(',', idx3 + 1);
+  int idx5 = line.indexOf(',', idx4 + 1);
+  int idx6 = line.indexOf(',', idx5 + 1);
+  if (idx1 <= 0 || idx2 <= 0 || idx3 <= 0 || idx4 <= 0 || idx5 <= 0 || idx6 <= 0) {
+    return String();
+  }
+
+  uint32_t timestamp = line.substring(0, idx1).toInt();
+  String lat = line.substring(idx2 + 1, idx3);
+  String lon = line.substring(idx3 + 1, idx4);
+  String alt = line.substring(idx5 + 1, idx6);
+
+  // Convert Unix timestamp to ISO 8601
+  time_t ts = timestamp;
+  struct tm timeinfo;
+  gmtime_r(&ts, &timeinfo);
+  char timeStr[25];
+  strftime(timeStr, sizeof(timeStr), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+
+  String point = "      <trkpt lat=\"" + lat + "\" lon=\"" + lon + "\">\n";
+  point += "        <ele>" + alt + "</ele>\n";
+  point += "        <time>" + String(timeStr) + "</time>\n";
+  point += "      </trkpt>\n";
+  return point;
+}
+
+#endif // WEB_JSON_H
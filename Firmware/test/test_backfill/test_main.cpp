@@ -0,0 +1,156 @@
+// Store-and-forward end to end: a beacon out of range for 10 minutes must
+// get every fix into history.csv exactly once (pio test -e native)
+
+#include <unity.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include "native/harness.h"
+
+static std::string testDir;
+
+void setUp(void) {
+  char tmpl[] = "/tmp/pawtracker-test-XXXXXX";
+  testDir = mkdtemp(tmpl);
+}
+
+void tearDown(void) {
+  DirFileSystem fs(testDir);
+  fs.remove(HISTORY_FILE);
+  fs.remove(HISTORY_TMP_FILE);
+  rmdir(testDir.c_str());
+}
+
+// Rows per timestamp for one beacon
+static std::map<uint32_t, int> historyRows(DirFileSystem& fs, const char* beaconId) {
+  std::map<uint32_t, int> rows;
+  std::unique_ptr<HalFile> in = fs.open(HISTORY_FILE, HAL_FILE_READ);
+  char line[HISTORY_LINE_MAX];
+  if (!in || in->readLine(line, sizeof(line)) < 0) return rows;
+  while (in->readLine(line, sizeof(line)) >= 0) {
+    uint32_t timestamp = (uint32_t)strtoul(line, nullptr, 10);
+    if (historyLineMatches(line, timestamp, beaconId)) rows[timestamp]++;
+  }
+  return rows;
+}
+
+void test_outage_no_fix_lost_or_duplicated(void) {
+  const uint32_t OUTAGE_START_MS = 60000;
+  const uint32_t OUTAGE_END_MS = OUTAGE_START_MS + 600000;  // 10 minutes, within BACKLOG_CAPACITY
+  const uint32_t END_MS = 1000000;
+
+  ManualClock clock;
+  DirFileSystem fs(testDir);
+  SimStation station;
+  SimBeacon beacon;
+  joinStation(beacon, station, 0, 1);
+
+  while (clock.millis() < END_MS) {
+    uint32_t now = clock.millis();
+    beaconTick(beacon, now);
+    stationTick(station, fs, now, now >= OUTAGE_START_MS && now < OUTAGE_END_MS);
+    clock.delayMs(TICK_MS);
+  }
+  size_t merged;
+  mergeHistoryRecords(fs, station.pendingBackfill, merged);
+
+  TEST_ASSERT_EQUAL(0, beacon.backlog.missedCount());
+  TEST_ASSERT_EQUAL(0, beacon.backlog.dropped);
+  TEST_ASSERT_EQUAL((OUTAGE_END_MS - OUTAGE_START_MS) / BEACON_INTERVAL_MS, station.framesDropped);
+
+  std::map<uint32_t, int> rows = historyRows(fs, beacon.beaconId);
+  uint32_t fixes = END_MS / BEACON_INTERVAL_MS;
+  uint32_t missing = 0;
+  uint32_t duplicated = 0;
+  for (uint32_t i = 0; i < fixes; i++) {
+    auto it = rows.find(BASE_UNIX_TIME + i * BEACON_INTERVAL_MS / 1000);
+    if (it == rows.end()) {
+      missing++;
+    } else if (it->second > 1) {
+      duplicated++;
+    }
+  }
+  TEST_ASSERT_EQUAL(0, missing);
+  TEST_ASSERT_EQUAL(0, duplicated);
+  TEST_ASSERT_EQUAL(fixes, rows.size());
+}
+
+// A fix stored live whose ack was lost comes back as backfill
+void test_stored_seqs_drop_live_fixes(void) {
+  StoredSeqs stored;
+  for (uint16_t seq = 100; seq < 110; seq++) stored.markLive(seq);
+
+  BackfillMessage bf{};
+  bf.count = 3;
+  bf.fixes[0].seq = 95;   // Never stored
+  bf.fixes[1].seq = 104;  // Stored live
+  bf.fixes[2].seq = 96;
+  bf.fixes[0].timestamp = bf.fixes[1].timestamp = bf.fixes[2].timestamp = BASE_UNIX_TIME;
+  TEST_ASSERT_EQUAL(1, dropStoredFixes(bf, stored));
+  TEST_ASSERT_EQUAL(2, bf.count);
+  TEST_ASSERT_EQUAL(95, bf.fixes[0].seq);
+  TEST_ASSERT_EQUAL(96, bf.fixes[1].seq);
+
+  // The same frame again after its backfill ack was lost
+  bf.count = 2;
+  TEST_ASSERT_EQUAL(2, dropStoredFixes(bf, stored));
+  TEST_ASSERT_EQUAL(0, bf.count);
+
+  // The beacon restarted its sequence: old seqs no longer count
+  stored.markLive(3);
+  TEST_ASSERT_TRUE(stored.markBackfill(2));
+  TEST_ASSERT_FALSE(stored.markBackfill(3));
+}
+
+// Rows the file already has are not merged again
+void test_merge_skips_rows_in_file(void) {
+  DirFileSystem fs(testDir);
+  HistoryRecord r{};
+  r.timestamp = BASE_UNIX_TIME;
+  snprintf(r.beaconId, sizeof(r.beaconId), "B0000000");
+  appendHistoryRecord(fs, r);
+
+  std::vector<HistoryRecord> pending;
+  pending.push_back(r);
+  HistoryRecord other = r;
+  snprintf(other.beaconId, sizeof(other.beaconId), "B0000001");
+  pending.push_back(other);
+  HistoryRecord later = r;
+  later.timestamp++;
+  pending.push_back(later);
+
+  size_t merged;
+  mergeHistoryRecords(fs, pending, merged);
+  TEST_ASSERT_EQUAL(2, merged);
+  TEST_ASSERT_EQUAL(2, historyRows(fs, "B0000000").size());
+  TEST_ASSERT_EQUAL(1, historyRows(fs, "B0000001").size());
+}
+
+// A merge that takes the file over the limit rotates it like an append
+void test_merge_rotates(void) {
+  DirFileSystem fs(testDir);
+  std::vector<HistoryRecord> pending;
+  for (uint32_t i = 0; i < 1000; i++) {  // About 60 KB
+    HistoryRecord r{};
+    r.timestamp = BASE_UNIX_TIME + i;
+    snprintf(r.beaconId, sizeof(r.beaconId), "B0000000");
+    r.latitude = START_LAT;
+    r.longitude = START_LON;
+    pending.push_back(r);
+  }
+  size_t merged;
+  mergeHistoryRecords(fs, pending, merged);
+  std::unique_ptr<HalFile> in = fs.open(HISTORY_FILE, HAL_FILE_READ);
+  TEST_ASSERT_TRUE(in != nullptr);
+  TEST_ASSERT_TRUE(in->size() < MAX_HISTORY_FILE_SIZE);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_outage_no_fix_lost_or_duplicated);
+  RUN_TEST(test_stored_seqs_drop_live_fixes);
+  RUN_TEST(test_merge_skips_rows_in_file);
+  RUN_TEST(test_merge_rotates);
+  return UNITY_END();
+}
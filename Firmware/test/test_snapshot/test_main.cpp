@@ -0,0 +1,114 @@
+// Snapshot<T> under contention: one writer thread per snapshot publishing as
+// fast as it can, several readers checking that no read is torn or goes back
+// in time (pio test -e native)
+
+#include <unity.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "snapshot.h"
+
+const uint32_t PUBLISHES = 200000;
+const int READERS = 3;
+
+// Every word holds the publish number, so a torn copy mixes two of them
+template <size_t WORDS>
+struct Stamped {
+  uint32_t words[WORDS];
+};
+
+struct ReadResult {
+  uint32_t reads = 0;
+  uint32_t torn = 0;
+  uint32_t backwards = 0;
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+template <size_t WORDS>
+static void hammer(Snapshot<Stamped<WORDS>>& snapshot, std::vector<ReadResult>& results) {
+  std::atomic<bool> done{false};
+  results.assign(READERS, ReadResult());
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < READERS; r++) {
+    readers.emplace_back([&snapshot, &done, &results, r] {
+      ReadResult& result = results[r];
+      uint32_t last = 0;
+      Stamped<WORDS> value;
+      while (!done.load(std::memory_order_relaxed)) {
+        snapshot.read(value);
+        result.reads++;
+        for (size_t i = 1; i < WORDS; i++) {
+          if (value.words[i] != value.words[0]) {
+            result.torn++;
+            break;
+          }
+        }
+        if (value.words[0] < last) result.backwards++;
+        last = value.words[0];
+      }
+    });
+  }
+
+  std::thread writer([&snapshot] {
+    Stamped<WORDS> value;
+    for (uint32_t n = 1; n <= PUBLISHES; n++) {
+      for (size_t i = 0; i < WORDS; i++) value.words[i] = n;
+      snapshot.publish(value);
+    }
+  });
+  writer.join();
+  done.store(true);
+  for (std::thread& t : readers) t.join();
+}
+
+static void assertClean(const std::vector<ReadResult>& results) {
+  for (const ReadResult& result : results) {
+    TEST_ASSERT_GREATER_THAN(0, result.reads);
+    TEST_ASSERT_EQUAL(0, result.torn);
+    TEST_ASSERT_EQUAL(0, result.backwards);
+  }
+}
+
+// About the size of StationSnapshot
+void test_small_snapshot_never_torn(void) {
+  static Snapshot<Stamped<64>> snapshot;
+  std::vector<ReadResult> results;
+  hammer(snapshot, results);
+  assertClean(results);
+  TEST_ASSERT_EQUAL(PUBLISHES, snapshot.version());
+  TEST_ASSERT_EQUAL(PUBLISHES, snapshot.read().words[0]);
+}
+
+// Big enough that a copy regularly overlaps a publish
+void test_large_snapshot_never_torn(void) {
+  static Snapshot<Stamped<2048>> snapshot;
+  std::vector<ReadResult> results;
+  hammer(snapshot, results);
+  assertClean(results);
+}
+
+// Two snapshots, each with its own writer, read at the same time
+void test_independent_writers(void) {
+  static Snapshot<Stamped<64>> first;
+  static Snapshot<Stamped<256>> second;
+  std::vector<ReadResult> firstResults;
+  std::vector<ReadResult> secondResults;
+  std::thread a([&] { hammer(first, firstResults); });
+  std::thread b([&] { hammer(second, secondResults); });
+  a.join();
+  b.join();
+  assertClean(firstResults);
+  assertClean(secondResults);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_small_snapshot_never_torn);
+  RUN_TEST(test_large_snapshot_never_torn);
+  RUN_TEST(test_independent_writers);
+  return UNITY_END();
+}
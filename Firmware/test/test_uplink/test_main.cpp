@@ -0,0 +1,319 @@
+// Central server uplink against a stand-in for Server/src/server.js: the batch
+// format, the backlog while the server is down, oldest-first drain once it is
+// back, and no batch stored twice after a lost ack (pio test -e native)
+
+#include <unity.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "hal_native.h"
+#include "uplink_core.h"
+
+const uint32_t BASE_UNIX_TIME = 1700000000;
+const uint32_t SYNC_INTERVAL_MS = 5000;
+
+static std::string testDir;
+
+// Does what server.js does with a batch: drop a (boot, seq) it already
+// stored, otherwise record every fix. Either transport can be down, and the
+// push channel can lose its acks.
+class StandInServer : public UplinkLink {
+public:
+  UplinkSender* sender = nullptr;
+  bool up = true;
+  bool socket = false;
+  bool loseAcks = false;
+
+  std::deque<UplinkFix> queued;       // Fixes loop() has queued
+  std::vector<std::string> batches;   // Every batch that reached the server
+  std::vector<uint32_t> stored;       // Fix times in the order they were stored
+  uint32_t posts = 0;
+  uint32_t dropped = 0;
+
+  uint8_t takeQueued(UplinkFix* fixes, uint8_t max) override {
+    uint8_t n = 0;
+    while (n < max && !queued.empty()) {
+      fixes[n++] = queued.front();
+      queued.pop_front();
+    }
+    return n;
+  }
+
+  StationLocation stationLocation() override {
+    StationLocation station{};
+    station.hasValidFix = true;
+    station.latitude = 51.5f;
+    station.longitude = -0.12f;
+    station.hdop = 0.9f;
+    station.sats = 9;
+    return station;
+  }
+
+  bool socketConnected() override {
+    return up && socket;
+  }
+
+  bool sendSocket(const String& json) override {
+    if (!up) return false;
+    receive(json.c_str());
+    if (!loseAcks) sender->ackReceived(numberField(json.c_str(), "seq"));
+    return true;
+  }
+
+  int post(const String& json) override {
+    if (!up) return -1;
+    posts++;
+    receive(json.c_str());
+    return 200;
+  }
+
+  void backlogDropped(uint32_t count) override {
+    dropped += count;
+  }
+
+  static double numberField(const std::string& json, const char* key, size_t from = 0) {
+    size_t at = json.find("\"" + std::string(key) + "\":", from);
+    if (at == std::string::npos) return -1;
+    return strtod(json.c_str() + at + strlen(key) + 3, nullptr);
+  }
+
+  // Fix objects of a batch
+  static std::vector<std::string> fixesOf(const std::string& json) {
+    std::vector<std::string> fixes;
+    size_t at = json.find("\"fixes\":[");
+    while ((at = json.find("{\"trackerId\":", at)) != std::string::npos) {
+      size_t end = json.find('}', at);
+      fixes.push_back(json.substr(at, end - at + 1));
+      at = end;
+    }
+    return fixes;
+  }
+
+private:
+  bool known = false;
+  uint32_t boot = 0;
+  uint32_t seq = 0;
+
+  void receive(const std::string& json) {
+    batches.push_back(json);
+    uint32_t batchBoot = (uint32_t)numberField(json, "boot");
+    uint32_t batchSeq = (uint32_t)numberField(json, "seq");
+    if (known && batchBoot == boot && batchSeq <= seq) return;
+    known = true;
+    boot = batchBoot;
+    seq = batchSeq;
+    for (const std::string& fix : fixesOf(json)) {
+      stored.push_back((uint32_t)numberField(fix, "time"));
+    }
+  }
+};
+
+struct Rig {
+  ManualClock clock;
+  DirFileSystem fs;
+  StandInServer server;
+  UplinkSender sender;
+  uint32_t nextTime = BASE_UNIX_TIME;
+
+  Rig() : fs(testDir), sender(fs, clock, server) {
+    server.sender = &sender;
+    sender.deviceId = "station-test";
+    sender.bootId = 1234;
+  }
+
+  void queueFixes(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+      UplinkFix fix{};
+      fix.timestamp = nextTime++;
+      snprintf(fix.beaconId, sizeof(fix.beaconId), "0000ABCD");
+      fix.latitude = 51.5f;
+      fix.longitude = -0.12f;
+      fix.sats = 8;
+      server.queued.push_back(fix);
+    }
+  }
+
+  // One SERVER_SYNC_INTERVAL of networkTask
+  void sync() {
+    sender.startSync();
+    sender.service(true);
+    uint32_t start = clock.millis();
+    while (clock.millis() - start < SYNC_INTERVAL_MS) {
+      clock.delayMs(100);
+      if (sender.awaitingAck()) sender.service(true);
+    }
+  }
+};
+
+void setUp(void) {
+  char tmpl[] = "/tmp/pawtracker-test-XXXXXX";
+  testDir = mkdtemp(tmpl);
+}
+
+void tearDown(void) {
+  DirFileSystem fs(testDir);
+  fs.remove(UPLINK_BACKLOG_NEW);
+  fs.remove(UPLINK_BACKLOG_OLD);
+  rmdir(testDir.c_str());
+}
+
+// Times stored once each, and how many were stored more than once
+static uint32_t duplicates(const std::vector<uint32_t>& stored) {
+  std::map<uint32_t, int> seen;
+  uint32_t dup = 0;
+  for (uint32_t t : stored) {
+    if (++seen[t] > 1) dup++;
+  }
+  return dup;
+}
+
+// Every field server.js reads, in the batch it gets over HTTP and the socket
+void test_batch_format(void) {
+  Rig rig;
+  rig.queueFixes(3);
+  rig.sync();
+  rig.server.socket = true;
+  rig.queueFixes(2);
+  rig.sync();
+
+  TEST_ASSERT_EQUAL(2, rig.server.batches.size());
+  const std::string& http = rig.server.batches[0];
+  const std::string& socket = rig.server.batches[1];
+  TEST_ASSERT_EQUAL('{', http[0]);
+  TEST_ASSERT_EQUAL('}', http[http.size() - 1]);
+  TEST_ASSERT_TRUE(http.find("\"type\"") == std::string::npos);
+  TEST_ASSERT_TRUE(socket.find("{\"type\":\"fixes\",") == 0);
+  TEST_ASSERT_TRUE(http.find("\"deviceId\":\"station-test\"") != std::string::npos);
+  TEST_ASSERT_EQUAL(1234, StandInServer::numberField(http, "boot"));
+  TEST_ASSERT_EQUAL(1, StandInServer::numberField(http, "seq"));
+  TEST_ASSERT_EQUAL(2, StandInServer::numberField(socket, "seq"));
+  TEST_ASSERT_TRUE(http.find("\"stationLocation\":{\"latitude\":51.500000,") != std::string::npos);
+  TEST_ASSERT_TRUE(http.find("\"hasValidFix\":true}") != std::string::npos);
+
+  const char* keys[] = {"trackerId", "time", "latitude", "longitude", "hdop", "sats",
+                        "batteryVoltage", "rssi", "snr", "ledOn", "buzzerOn", "speed", "altitude"};
+  std::vector<std::string> fixes = StandInServer::fixesOf(http);
+  TEST_ASSERT_EQUAL(3, fixes.size());
+  for (const std::string& fix : fixes) {
+    for (const char* key : keys) {
+      TEST_ASSERT_TRUE_MESSAGE(fix.find("\"" + std::string(key) + "\":") != std::string::npos, key);
+    }
+    TEST_ASSERT_TRUE(fix.find("\"trackerId\":\"0000ABCD\"") != std::string::npos);
+  }
+  TEST_ASSERT_EQUAL(BASE_UNIX_TIME, StandInServer::numberField(fixes[0], "time"));
+  TEST_ASSERT_EQUAL(5, rig.sender.stats.sent);
+}
+
+// Server down for 1200 fixes, so the backlog rotates once; then it comes back
+// while new fixes keep arriving
+void test_spool_then_drain_oldest_first(void) {
+  const uint32_t OUTAGE_FIXES = 1200;
+  Rig rig;
+  rig.server.up = false;
+  for (uint32_t i = 0; i < OUTAGE_FIXES / 40; i++) {
+    rig.queueFixes(40);
+    rig.sync();
+  }
+  TEST_ASSERT_EQUAL(0, rig.server.stored.size());
+  TEST_ASSERT_FALSE(rig.sender.backlogEmpty());
+  TEST_ASSERT_TRUE(rig.server.queued.empty());
+  TEST_ASSERT_TRUE(rig.sender.stats.spooled > UPLINK_BACKLOG_SEGMENT_BYTES / sizeof(UplinkFix));
+  TEST_ASSERT_EQUAL(0, rig.sender.stats.dropped);
+
+  rig.server.up = true;
+  uint32_t syncs = 0;
+  while (!rig.sender.backlogEmpty() && syncs < 100) {
+    rig.queueFixes(2);
+    rig.sync();
+    syncs++;
+  }
+  rig.sync();
+  TEST_ASSERT_TRUE(rig.sender.backlogEmpty());
+  TEST_ASSERT_EQUAL(0, rig.sender.backlogBytes());
+  TEST_ASSERT_EQUAL(0, rig.server.dropped);
+
+  // Everything stored exactly once
+  uint32_t total = rig.nextTime - BASE_UNIX_TIME;
+  TEST_ASSERT_EQUAL(total, rig.server.stored.size());
+  TEST_ASSERT_EQUAL(0, duplicates(rig.server.stored));
+
+  // The outage fixes went out oldest first, the batch held in RAM before any
+  // of the backlog
+  uint32_t last = 0;
+  for (uint32_t t : rig.server.stored) {
+    if (t >= BASE_UNIX_TIME + OUTAGE_FIXES) continue;
+    TEST_ASSERT_TRUE(t > last);
+    last = t;
+  }
+  TEST_ASSERT_EQUAL(BASE_UNIX_TIME, rig.server.stored[0]);
+}
+
+// More than two segments while down: the oldest segment goes, the newest fixes stay
+void test_full_backlog_keeps_newest(void) {
+  Rig rig;
+  rig.server.up = false;
+  uint32_t segmentFixes = UPLINK_BACKLOG_SEGMENT_BYTES / sizeof(UplinkFix);
+  while (rig.sender.stats.dropped == 0) {
+    rig.queueFixes(40);
+    rig.sync();
+  }
+  TEST_ASSERT_EQUAL(rig.sender.stats.dropped, rig.server.dropped);
+  TEST_ASSERT_TRUE(rig.server.dropped >= segmentFixes);
+
+  rig.server.up = true;
+  for (int i = 0; i < 100 && !rig.sender.backlogEmpty(); i++) {
+    rig.sync();
+  }
+  uint32_t total = rig.nextTime - BASE_UNIX_TIME;
+  TEST_ASSERT_EQUAL(total - rig.sender.stats.dropped, rig.server.stored.size());
+  TEST_ASSERT_EQUAL(0, duplicates(rig.server.stored));
+  TEST_ASSERT_EQUAL(rig.nextTime - 1, rig.server.stored.back());
+}
+
+// The server stores a batch from the socket but its ack never arrives: the
+// same seq goes over HTTP and is dropped there
+void test_lost_ack_not_stored_twice(void) {
+  Rig rig;
+  rig.server.socket = true;
+  rig.server.loseAcks = true;
+  rig.queueFixes(10);
+  rig.sync();
+  TEST_ASSERT_FALSE(rig.sender.awaitingAck());
+  TEST_ASSERT_EQUAL(0, rig.server.posts);
+
+  rig.server.loseAcks = false;
+  rig.queueFixes(5);
+  rig.sync();
+  TEST_ASSERT_EQUAL(1, rig.server.posts);
+  TEST_ASSERT_EQUAL(3, rig.server.batches.size());
+  TEST_ASSERT_EQUAL(StandInServer::numberField(rig.server.batches[0], "seq"),
+                    StandInServer::numberField(rig.server.batches[1], "seq"));
+  TEST_ASSERT_EQUAL(15, rig.server.stored.size());
+  TEST_ASSERT_EQUAL(0, duplicates(rig.server.stored));
+  TEST_ASSERT_EQUAL(15, rig.sender.stats.sent);
+}
+
+// A timely ack confirms the batch without an HTTP request
+void test_socket_ack(void) {
+  Rig rig;
+  rig.server.socket = true;
+  rig.queueFixes(4);
+  rig.sync();
+  TEST_ASSERT_FALSE(rig.sender.awaitingAck());
+  TEST_ASSERT_EQUAL(0, rig.server.posts);
+  TEST_ASSERT_EQUAL(4, rig.sender.stats.sent);
+  TEST_ASSERT_TRUE(rig.sender.stats.lastAckMs < UPLINK_ACK_TIMEOUT_MS);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_batch_format);
+  RUN_TEST(test_spool_then_drain_oldest_first);
+  RUN_TEST(test_full_backlog_keeps_newest);
+  RUN_TEST(test_lost_ack_not_stored_twice);
+  RUN_TEST(test_socket_ack);
+  return UNITY_END();
+}
@@ -133,35 +133,35 @@ app.post('/api/device/register', (req, res) => {
   res.json({ success: true, deviceId });
 });
 
-// PupStation sends beacon data here
-app.post('/api/device/beacon', (req, res) => {
-  const { deviceId, beaconData, stationLocation } = req.body;
-
-  if (!deviceId || !beaconData) {
-    return res.status(400).json({ error: 'Device ID and beacon data required' });
+// Keep history in time order: backlogged fixes arrive after newer live ones
+function insertByTime(history, entry, limit) {
+  let i = history.length;
+  while (i > 0 && history[i - 1].timestamp > entry.timestamp) {
+    i--;
   }
+  history.splice(i, 0, entry);
 
-  const device = devices.get(deviceId);
-  if (!device) {
-    return res.status(404).json({ error: 'Device not registered' });
+  // Keep only the newest `limit` points
+  if (history.length > limit) {
+    history.shift();
   }
+}
 
-  // Update device data
-  device.lastSeen = new Date();
-  
-  // Update station location if provided
-  if (stationLocation) {
-    device.stationLocation = {
-      latitude: stationLocation.latitude,
-      longitude: stationLocation.longitude,
-      hdop: stationLocation.hdop,
-      sats: stationLocation.sats,
-      altitude: stationLocation.altitude,
-      hasValidFix: stationLocation.hasValidFix,
-      timestamp: new Date()
-    };
-  }
-  
+function updateStationLocation(device, stationLocation) {
+  if (!stationLocation) return;
+  device.stationLocation = {
+    latitude: stationLocation.latitude,
+    longitude: stationLocation.longitude,
+    hdop: stationLocation.hdop,
+    sats: stationLocation.sats,
+    altitude: stationLocation.altitude,
+    hasValidFix: stationLocation.hasValidFix,
+    timestamp: new Date()
+  };
+}
+
+// Store one beacon fix. `timestamp` is when the station heard it (now for live data).
+function recordBeaconData(device, deviceId, beaconData, timestamp) {
   const trackerId = beaconData.trackerId || 'unknown';
   
   // Initialize beacons Map if needed
@@ -181,25 +181,35 @@ app.post('/api/device/beacon', (req, res) => {
   
   const beacon = device.beacons.get(trackerId);
   
-  // Update current beacon location
-  beacon.lastSeen = new Date();
-  beacon.location = {
-    latitude: beaconData.latitude,
-    longitude: beaconData.longitude,
-    hdop: beaconData.hdop,
-    sats: beaconData.sats,
-    batteryVoltage: beaconData.batteryVoltage,
-    rssi: beaconData.rssi,
-    snr: beaconData.snr,
-    speed: beaconData.speed,
-    altitude: beaconData.altitude,
-    ledOn: beaconData.ledOn,
-    buzzerOn: beaconData.buzzerOn,
-    timestamp: new Date()
-  };
+  // Update current beacon location (unless this fix is older than it)
+  if (!beacon.location || beacon.location.timestamp <= timestamp) {
+    beacon.lastSeen = timestamp;
+    beacon.location = {
+      latitude: beaconData.latitude,
+      longitude: beaconData.longitude,
+      hdop: beaconData.hdop,
+      sats: beaconData.sats,
+      batteryVoltage: beaconData.batteryVoltage,
+      rssi: beaconData.rssi,
+      snr: beaconData.snr,
+      speed: beaconData.speed,
+      altitude: beaconData.altitude,
+      ledOn: beaconData.ledOn,
+      buzzerOn: beaconData.buzzerOn,
+      timestamp
+    };
+
+    // Broadcast to all connected WebSocket clients
+    broadcastToClients({
+      type: 'beacon_update',
+      deviceId,
+      trackerId,
+      data: beacon.location
+    });
+  }
   
   // Add to history
-  beacon.history.push({
+  insertByTime(beacon.history, {
     latitude: beaconData.latitude,
     longitude: beaconData.longitude,
     hdop: beaconData.hdop,
@@ -209,20 +219,14 @@ app.post('/api/device/beacon', (req, res) => {
     snr: beaconData.snr,
     speed: beaconData.speed,
     altitude: beaconData.altitude,
-    timestamp: new Date()
-  });
-  
-  // Keep only last 1000 points per beacon
-  if (beacon.history.length > 1000) {
-    beacon.history.shift();
-  }
+    timestamp
+  }, 1000);
   
   // Also store in global tracker history for backwards compatibility
   if (!trackerHistory.has(trackerId)) {
     trackerHistory.set(trackerId, []);
   }
-  const history = trackerHistory.get(trackerId);
-  history.push({
+  insertByTime(trackerHistory.get(trackerId), {
     latitude: beaconData.latitude,
     longitude: beaconData.longitude,
     hdop: beaconData.hdop,
@@ -232,25 +236,77 @@ app.post('/api/device/beacon', (req, res) => {
     snr: beaconData.snr,
     speed: beaconData.speed,
     altitude: beaconData.altitude,
-    timestamp: new Date(),
+    timestamp,
     deviceId
-  });
-  
-  if (history.length > 1000) {
-    history.shift();
+  }, 1000);
+}
+
+// PupStation sends beacon data here
+app.post('/api/device/beacon', (req, res) => {
+  const { deviceId, beaconData, stationLocation } = req.body;
+
+  if (!deviceId || !beaconData) {
+    return res.status(400).json({ error: 'Device ID and beacon data required' });
   }
 
-  // Broadcast to all connected WebSocket clients
-  broadcastToClients({
-    type: 'beacon_update',
-    deviceId,
-    trackerId,
-    data: beacon.location
-  });
+  const device = devices.get(deviceId);
+  if (!device) {
+    return res.status(404).json({ error: 'Device not registered' });
+  }
+
+  device.lastSeen = new Date();
+  updateStationLocation(device, stationLocation);
+  recordBeaconData(device, deviceId, beaconData, new Date());
 
   res.json({ success: true });
 });
 
+// A station numbers its batches per boot and sends one at a time until it is
+// confirmed, over the socket or HTTP. A batch resent after its ack was lost
+// has a seq we already have: confirm it again without storing it twice.
+function isNewBatch(device, boot, seq) {
+  if (seq === undefined) {
+    return true; // Firmware that does not number its batches
+  }
+  if (device.uplinkBoot === boot && seq <= device.uplinkSeq) {
+    return false;
+  }
+  device.uplinkBoot = boot;
+  device.uplinkSeq = seq;
+  return true;
+}
+
+function recordBatch(device, deviceId, batch) {
+  device.lastSeen = new Date();
+  updateStationLocation(device, batch.stationLocation);
+  if (!isNewBatch(device, batch.boot, batch.seq)) {
+    return;
+  }
+  for (const fix of batch.fixes) {
+    const timestamp = fix.time ? new Date(fix.time * 1000) : new Date();
+    recordBeaconData(device, deviceId, fix, timestamp);
+  }
+}
+
+// PupStation sends every fix it heard since the last upload, oldest first.
+// `time` is Unix seconds from the station GPS, 0 if it had no time yet.
+app.post('/api/device/beacons', (req, res) => {
+  const { deviceId, fixes } = req.body;
+
+  if (!deviceId || !Array.isArray(fixes)) {
+    return res.status(400).json({ error: 'Device ID and fixes array required' });
+  }
+
+  const device = devices.get(deviceId);
+  if (!device) {
+    return res.status(404).json({ error: 'Device not registered' });
+  }
+
+  recordBatch(device, deviceId, req.body);
+
+  res.json({ success: true, accepted: fixes.length });
+});
+
 // PupStation sends control command status
 app.post('/api/device/control-status', (req, res) => {
   const { deviceId, ledOn, buzzerOn } = req.body;
@@ -296,6 +352,8 @@ app.get('/api/devices', requireAuth, (req, res) => {
       lastSeen: device.lastSeen,
       registeredAt: device.registeredAt,
       controlState: device.controlState,
+      connected: stationSockets.has(device.id),
+      lastCommandLatency: device.lastCommandLatency,
       stationLocation: device.stationLocation,
       beacons: beaconList,
       beaconCount: beaconList.length
@@ -361,19 +419,31 @@ app.get('/api/tracker/:trackerId/history', requireAuth, (req, res) => {
 
 app.post('/api/device/:deviceId/control', requireAuth, (req, res) => {
   const { deviceId } = req.params;
-  const { ledOn, buzzerOn } = req.body;
+  const { ledOn, buzzerOn, trackerId } = req.body;
 
   const device = devices.get(deviceId);
   if (!device) {
     return res.status(404).json({ error: 'Device not found' });
   }
 
-  // Store the control command for the device to retrieve
-  device.pendingControl = { ledOn, buzzerOn, timestamp: new Date() };
+  // Push the command if the station is connected, otherwise keep it for its
+  // next poll (trackerId optional - the station falls back to its primary beacon)
+  const command = { commandId: nextCommandId++, ledOn, buzzerOn, trackerId, issuedAt: Date.now() };
+  commandTimes.set(command.commandId, { deviceId, issuedAt: command.issuedAt });
+  if (!pushToStation(deviceId, {
+    type: 'control',
+    commandId: command.commandId,
+    trackerId: trackerId || '',
+    ledOn,
+    buzzerOn
+  })) {
+    device.pendingControl = command;
+  }
 
   broadcastToClients({
     type: 'control_command',
     deviceId,
+    trackerId,
     ledOn,
     buzzerOn
   });
@@ -395,6 +465,8 @@ app.get('/api/device/:deviceId/control', (req, res) => {
 
   res.json({
     hasCommand: true,
+    commandId: command.commandId,
+    trackerId: command.trackerId || '',
     ledOn: command.ledOn,
     buzzerOn: command.buzzerOn
   });
@@ -502,7 +574,140 @@ const wss = new WebSocketServer({ server, path: '/ws' });
 
 const clients = new Set();
 
+// PupStations keep a socket open on /ws?deviceId=<id>: control commands are
+// pushed down it and beacon fixes come up it (same format as
+// POST /api/device/beacons, acked by batch seq).
+const stationSockets = new Map(); // deviceId -> ws
+const STATION_PING_MS = 30000;
+
+let nextCommandId = 1;
+const commandTimes = new Map(); // commandId -> { deviceId, issuedAt, deliveredMs }
+const COMMAND_TIMES_MAX = 100;
+
+function pushToStation(deviceId, message) {
+  const ws = stationSockets.get(deviceId);
+  if (!ws || ws.readyState !== 1) {
+    return false;
+  }
+  ws.send(JSON.stringify(message));
+  return true;
+}
+
+// End-to-end command latency: issued on the dashboard -> received by the
+// station (deliveredMs) -> confirmed by the collar (completedMs)
+function recordCommandTiming(message) {
+  const timing = commandTimes.get(message.commandId);
+  if (!timing) return;
+
+  const elapsedMs = Date.now() - timing.issuedAt;
+  if (message.type === 'control_received') {
+    timing.deliveredMs = elapsedMs;
+    return;
+  }
+
+  commandTimes.delete(message.commandId);
+  const result = {
+    type: 'control_result',
+    deviceId: timing.deviceId,
+    commandId: message.commandId,
+    state: message.state,
+    attempts: message.attempts,
+    deliveredMs: timing.deliveredMs,
+    completedMs: elapsedMs,
+    stationMs: message.stationMs
+  };
+  const device = devices.get(timing.deviceId);
+  if (device) {
+    device.lastCommandLatency = result;
+  }
+  console.log(`Command ${message.commandId} ${message.state}: delivered in ${timing.deliveredMs} ms, done in ${elapsedMs} ms`);
+  broadcastToClients(result);
+  pushToStation(timing.deviceId, result); // So the station reports it too
+}
+
+function handleStationSocket(ws, deviceId) {
+  const previous = stationSockets.get(deviceId);
+  if (previous && previous !== ws) {
+    previous.terminate();
+  }
+  stationSockets.set(deviceId, ws);
+  console.log(`Station ${deviceId} connected`);
+
+  // A command queued while the station was offline goes out now
+  const device = devices.get(deviceId);
+  if (device && device.pendingControl) {
+    const command = device.pendingControl;
+    delete device.pendingControl;
+    pushToStation(deviceId, {
+      type: 'control',
+      commandId: command.commandId,
+      trackerId: command.trackerId || '',
+      ledOn: command.ledOn,
+      buzzerOn: command.buzzerOn
+    });
+  }
+
+  ws.isAlive = true;
+  ws.on('pong', () => {
+    ws.isAlive = true;
+  });
+
+  ws.on('message', (data) => {
+    let message;
+    try {
+      message = JSON.parse(data);
+    } catch (error) {
+      return;
+    }
+
+    if (message.type === 'fixes') {
+      const device = devices.get(deviceId);
+      if (!device || !Array.isArray(message.fixes)) {
+        return; // Not acked: the station resends over HTTP, which re-registers it
+      }
+      recordBatch(device, deviceId, message);
+      ws.send(JSON.stringify({ type: 'ack', seq: message.seq }));
+    } else if (message.type === 'control_received' || message.type === 'control_done') {
+      recordCommandTiming(message);
+    }
+  });
+
+  ws.on('close', () => {
+    if (stationSockets.get(deviceId) === ws) {
+      stationSockets.delete(deviceId);
+    }
+    console.log(`Station ${deviceId} disconnected`);
+  });
+
+  ws.on('error', (error) => {
+    console.error(`Station ${deviceId} socket error:`, error);
+  });
+}
+
+// Drop station sockets that stopped answering pings
+setInterval(() => {
+  for (const ws of stationSockets.values()) {
+    if (!ws.isAlive) {
+      ws.terminate();
+      continue;
+    }
+    ws.isAlive = false;
+    ws.ping();
+  }
+
+  // Forget timings of commands that never finished
+  while (commandTimes.size > COMMAND_TIMES_MAX) {
+    commandTimes.delete(commandTimes.keys().next().value);
+  }
+}, STATION_PING_MS);
+
 wss.on('connection', (ws, req) => {
+  const stationId = new URL(req.url, 'http://localhost').searchParams.get('deviceId');
+  if (stationId) {
+    handleStationSocket(ws, stationId);
+    return;
+  }
+
   // Check if user is authenticated via session
   // (This is simplified; in production, use proper WebSocket auth)
   clients.add(ws);